@@ -1,4 +1,3 @@
-
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -6,19 +5,38 @@
 #include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "lcd.h"
+#include "bmp.h"
+
+#define BMP_CACHE_SIZE 8 //最多缓存的图片数
+
+//解码后的图片：自上而下排列的XRGB像素，与帧缓冲格式相同
+typedef struct
+{
+    int width;
+    int height;
+    unsigned int *pixels;
+} bmp_surface_t;
+
+//已解码的图片缓存
+typedef struct
+{
+    char file[64];
+    bmp_surface_t surface;
+} bmp_cache_entry_t;
+
+static bmp_cache_entry_t bmp_cache[BMP_CACHE_SIZE];
+static int bmp_cache_next = 0; //缓存满时下一个被替换的位置
+static pthread_mutex_t bmp_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /*
-    bmp_display: 在屏幕的坐标(x0,y0)处显示一张指定的bmp图片
-    @bmp_file: 要显示的bmp图片的文件名
-    @x0: 显示位置左上顶点的x轴坐标
-    @y0: 显示位置左上顶点的y轴坐标
-    返回值：
-        无。
+    bmp_decode: 把bmp文件解码成自上而下、与帧缓冲格式相同的XRGB像素
+    整个文件一次读入内存，再逐行转换（行序和左右翻转在这里一次性处理）
 */
-void bmp_display(const char * bmp_file, 
-                int x0, int y0)
+static int bmp_decode(const char *bmp_file, bmp_surface_t *surface)
 {
     int fd;
 
@@ -27,34 +45,42 @@ void bmp_display(const char * bmp_file,
     if (fd == -1)
     {
         perror("failed to open bmp_file");
-        return ;
+        return -1;
     }
 
-    int width, height;
-    short depth;
-    
-
-    lseek(fd, 0x12, SEEK_SET);
-    read(fd, &width, 4);
-    
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size < 54)
+    {
+        close(fd);
+        return -1;
+    }
 
+    unsigned char *file = (unsigned char *) malloc(st.st_size);
+    if (file == NULL || read(fd, file, st.st_size) != st.st_size)
+    {
+        perror("failed to read bmp_file");
+        free(file);
+        close(fd);
+        return -1;
+    }
+    close(fd);
 
-    lseek(fd, 0x16, SEEK_SET);
-    read(fd, &height, 4);
-    
+    int offset, width, height;
+    short depth;
 
-    lseek(fd, 0x1C, SEEK_SET);
-    read(fd, &depth, 2);
-   
+    memcpy(&offset, file + 0x0A, 4);
+    memcpy(&width, file + 0x12, 4);
+    memcpy(&height, file + 0x16, 4);
+    memcpy(&depth, file + 0x1C, 2);
 
     printf("%d x %d\n", width, height);
 
     if ( !(depth == 24 || depth == 32))
     {
         printf("Sorry, Not Supported Bmp Format!\n");
-        close(fd);
+        free(file);
 
-        return ;
+        return -1;
     }
 
 
@@ -62,9 +88,10 @@ void bmp_display(const char * bmp_file,
     int laizi = 0; // 每一行末尾的填充的“赖子”数
     int total_bytes_per_line; //每一行实际的字节数.
     int total_bytes; //整个像素数组的字节数
+    int bytes_per_pixel = depth / 8;
 
 
-    valid_bytes_per_line =  abs(width) * (depth / 8);
+    valid_bytes_per_line =  abs(width) * bytes_per_pixel;
     if (valid_bytes_per_line % 4)
     {
         laizi = 4 - valid_bytes_per_line % 4;
@@ -72,45 +99,186 @@ void bmp_display(const char * bmp_file,
     total_bytes_per_line = valid_bytes_per_line + laizi;
     total_bytes = abs(height) * total_bytes_per_line;
 
-    unsigned char * pixel = (unsigned char*) malloc( total_bytes );
-    lseek(fd, 54, SEEK_SET);
-    read(fd, pixel, total_bytes);
+    if (offset < 54 || offset + total_bytes > st.st_size)
+    {
+        printf("Sorry, Truncated Bmp File!\n");
+        free(file);
+        return -1;
+    }
 
-    // 解析像素数据，并在屏幕上显示
-    unsigned char a,r, g,b;
-    int color;
-    int i = 0;
+    surface->width = abs(width);
+    surface->height = abs(height);
+    surface->pixels = (unsigned int *) malloc(surface->width * surface->height * sizeof(unsigned int));
+    if (surface->pixels == NULL)
+    {
+        free(file);
+        return -1;
+    }
+
+    // 解析像素数据，颜色与原来逐点显示时完全相同：(a << 24) | (r << 16) | (g << 8) | b
     int x,y;
+    for (y = 0; y < surface->height; y++)
+    {
+        const unsigned char *src = file + offset + y * total_bytes_per_line;
+        int row = (height > 0) ? (surface->height - 1 - y) : y;
+        unsigned int *dst = surface->pixels + row * surface->width;
 
-    for (y = 0; y < abs(height); y++)
+        for (x = 0; x < surface->width; x++)
+        {
+            unsigned int a = (depth == 32) ? src[3] : 0;
+            unsigned int color = (a << 24) | (src[2] << 16) | (src[1] << 8) | src[0];
+            int x1 = (width > 0) ? x : (surface->width - 1 - x);
+
+            dst[x1] = color;
+            src += bytes_per_pixel;
+        }
+    }
+
+    free(file);
+    return 0;
+}
+
+/*
+    bmp_lookup_locked: 在缓存中查找图片，第一次使用时解码并放入缓存
+    调用者必须持有bmp_cache_mutex，返回的图片在解锁前有效（解锁后可能被替换或释放）
+    文件名放不进缓存项时拒绝，避免截断后两个不同的文件名冲突
+*/
+static const bmp_surface_t *bmp_lookup_locked(const char *bmp_file)
+{
+    int i;
+
+    if (strlen(bmp_file) >= sizeof(bmp_cache[0].file))
+    {
+        printf("bmp file name too long: %s\n", bmp_file);
+        return NULL;
+    }
+
+    for (i = 0; i < BMP_CACHE_SIZE; i++)
     {
-        for (x = 0; x < abs(width); x++)
+        if (bmp_cache[i].surface.pixels != NULL && strcmp(bmp_cache[i].file, bmp_file) == 0)
         {
-            b = pixel[i++];
-            g = pixel[i++];
-            r = pixel[i++];
-            if (depth == 32)
-            {
-                a = pixel[i++];
-            }
-            else
-            {
-                a = 0;
-            }
-            color = (a << 24) | (r << 16) | (g << 8) | b;
-
-            int x1, y1; //该像素点在屏幕上显示的  坐标
-
-            x1 = (width > 0) ? (x0 + x) : (x0 + abs(width) - 1 - x);
-            y1 = (height > 0) ?  (y0 + height - 1 - y) : y0 + y;
-            display_point(x1, y1, color); 
+            return &bmp_cache[i].surface;
         }
+    }
 
-        i += laizi; //跳过“赖子”
+    bmp_surface_t decoded;
+    if (bmp_decode(bmp_file, &decoded) < 0)
+    {
+        return NULL;
     }
 
-    free(pixel);
+    bmp_cache_entry_t *entry = &bmp_cache[bmp_cache_next];
+    bmp_cache_next = (bmp_cache_next + 1) % BMP_CACHE_SIZE;
 
+    free(entry->surface.pixels);
+    strcpy(entry->file, bmp_file);
+    entry->surface = decoded;
+    return &entry->surface;
 }
 
+/*
+    bmp_load: 预加载图片到缓存
+*/
+int bmp_load(const char *bmp_file)
+{
+    pthread_mutex_lock(&bmp_cache_mutex);
+    int ret = bmp_lookup_locked(bmp_file) != NULL ? 0 : -1;
+    pthread_mutex_unlock(&bmp_cache_mutex);
+    return ret;
+}
 
+/*
+    bmp_cache_clear: 释放所有缓存的图片
+*/
+void bmp_cache_clear(void)
+{
+    int i;
+
+    pthread_mutex_lock(&bmp_cache_mutex);
+    for (i = 0; i < BMP_CACHE_SIZE; i++)
+    {
+        free(bmp_cache[i].surface.pixels);
+        memset(&bmp_cache[i], 0, sizeof(bmp_cache[i]));
+    }
+    bmp_cache_next = 0;
+    pthread_mutex_unlock(&bmp_cache_mutex);
+}
+
+/*
+    bmp_get_size: 读取bmp图片的宽和高(取绝对值)
+*/
+int bmp_get_size(const char *bmp_file,int *width,int *height)
+{
+    pthread_mutex_lock(&bmp_cache_mutex);
+
+    const bmp_surface_t *surface = bmp_lookup_locked(bmp_file);
+    if (surface != NULL)
+    {
+        *width = surface->width;
+        *height = surface->height;
+    }
+
+    pthread_mutex_unlock(&bmp_cache_mutex);
+    return surface != NULL ? 0 : -1;
+}
+
+/*
+    bmp_display: 在屏幕的坐标(x0,y0)处显示一张指定的bmp图片
+    @bmp_file: 要显示的bmp图片的文件名
+    @x0: 显示位置左上顶点的x轴坐标
+    @y0: 显示位置左上顶点的y轴坐标
+    返回值：
+        无。
+*/
+void bmp_display(const char * bmp_file,
+                int x0, int y0)
+{
+    bmp_display_clip(bmp_file, x0, y0, NULL);
+}
+
+/*
+    bmp_display_clip: 和bmp_display相同，只画落在clip矩形内的像素
+    缓存命中时只是逐行memcpy；复制期间持有缓存锁，图片不会被其他线程替换或释放
+*/
+void bmp_display_clip(const char * bmp_file,
+                int x0, int y0, const lcd_rect_t *clip)
+{
+    pthread_mutex_lock(&bmp_cache_mutex);
+
+    const bmp_surface_t *surface = bmp_lookup_locked(bmp_file);
+    if (surface == NULL)
+    {
+        pthread_mutex_unlock(&bmp_cache_mutex);
+        return ;
+    }
+
+    int sx = 0, sy = 0;
+    int w = surface->width, h = surface->height;
+
+    if (clip != NULL)
+    {
+        //图片矩形与clip求交，换算成源图偏移
+        int cx0 = x0 > clip->x ? x0 : clip->x;
+        int cy0 = y0 > clip->y ? y0 : clip->y;
+        int cx1 = (x0 + w) < (clip->x + clip->w) ? (x0 + w) : (clip->x + clip->w);
+        int cy1 = (y0 + h) < (clip->y + clip->h) ? (y0 + h) : (clip->y + clip->h);
+
+        if (cx1 <= cx0 || cy1 <= cy0)
+        {
+            pthread_mutex_unlock(&bmp_cache_mutex);
+            return ;
+        }
+
+        sx = cx0 - x0;
+        sy = cy0 - y0;
+        w = cx1 - cx0;
+        h = cy1 - cy0;
+        x0 = cx0;
+        y0 = cy0;
+    }
+
+    lcd_blit_xrgb(surface->pixels + sy * surface->width + sx, surface->width,
+                  w, h, x0, y0);
+
+    pthread_mutex_unlock(&bmp_cache_mutex);
+}
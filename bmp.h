@@ -1,8 +1,11 @@
 #ifndef __BMP_H__
 #define __BMP_H__
 
+#include "lcd.h"
+
 /*
     bmp_display:这个函数的作用是在开发板对应的位置开始显示一张Bmp图片。
+    图片第一次使用时解码并缓存，之后只是逐行复制（受lcd_set_clip裁剪）。
     @bmp_file:要显示的bmp图片的文件名
     @x0,y0:显示起始位置的坐标
 
@@ -10,5 +13,32 @@
 */
 void bmp_display(const char *bmp_file,int x0 ,int y0);
 
+/*
+    bmp_display_clip:和bmp_display相同，但只画落在clip矩形内的像素。
+    @clip:屏幕上的裁剪矩形，为NULL时不裁剪
+
+    返回值：无
+*/
+void bmp_display_clip(const char *bmp_file,int x0 ,int y0,const lcd_rect_t *clip);
+
+/*
+    bmp_get_size:读取bmp图片的宽和高。
+    返回值：成功返回0，失败返回-1
+*/
+int bmp_get_size(const char *bmp_file,int *width,int *height);
+
+/*
+    bmp_load:把图片读入缓存(预加载)，之后的显示不再读文件。
+    缓存的图片只在bmp.c内部加锁使用，不把指针交给调用者(缓存满时会被替换)。
+    文件名不能超过63个字节。
+    返回值：成功返回0，失败返回-1
+*/
+int bmp_load(const char *bmp_file);
+
+/*
+    bmp_cache_clear:释放所有缓存的图片。
+*/
+void bmp_cache_clear(void);
+
 
 #endif
\ No newline at end of file
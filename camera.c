@@ -7,6 +7,8 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/select.h>
+#include <errno.h>
 #include <linux/videodev2.h>
 
 // 颜色转换辅助函数
@@ -15,10 +17,277 @@ static inline int clip(int value)
   return value < 0 ? 0 : (value > 255 ? 255 : value);
 }
 
+/**
+ * @brief 把像素格式转换成可读字符串
+ */
+const char *camera_fourcc_str(unsigned int fourcc, char *buf)
+{
+  buf[0] = fourcc & 0xFF;
+  buf[1] = (fourcc >> 8) & 0xFF;
+  buf[2] = (fourcc >> 16) & 0xFF;
+  buf[3] = (fourcc >> 24) & 0xFF;
+  buf[4] = '\0';
+  return buf;
+}
+
+/**
+ * @brief 分辨率代价：正好等于目标最好，其次是能覆盖目标的最小尺寸，最后是最大的较小尺寸
+ */
+static long size_cost(int w, int h, int tw, int th)
+{
+  long area = (long)w * h;
+  long target = (long)tw * th;
+
+  if (w == tw && h == th)
+    return 0;
+  if (w >= tw && h >= th)
+    return 1 + (area - target);
+  return 0x40000000L + (target - area);
+}
+
+/**
+ * @brief 在驱动支持的分辨率中选出最接近目标的一个
+ * @return 驱动支持枚举返回0，否则返回-1（此时直接使用目标分辨率）
+ */
+static int pick_frame_size(int fd, unsigned int fourcc, int tw, int th, int *w, int *h)
+{
+  struct v4l2_frmsizeenum fs;
+  long best = -1;
+
+  memset(&fs, 0, sizeof(fs));
+  fs.pixel_format = fourcc;
+
+  for (fs.index = 0; ioctl(fd, VIDIOC_ENUM_FRAMESIZES, &fs) == 0; fs.index++)
+  {
+    int cw, ch;
+
+    if (fs.type == V4L2_FRMSIZE_TYPE_DISCRETE)
+    {
+      cw = fs.discrete.width;
+      ch = fs.discrete.height;
+    }
+    else
+    {
+      // 连续/步进：把目标夹到范围内并对齐步长
+      struct v4l2_frmsize_stepwise *sw = &fs.stepwise;
+      unsigned int sx = sw->step_width ? sw->step_width : 1;
+      unsigned int sy = sw->step_height ? sw->step_height : 1;
+      unsigned int x = tw < (int)sw->min_width ? sw->min_width : (tw > (int)sw->max_width ? sw->max_width : (unsigned int)tw);
+      unsigned int y = th < (int)sw->min_height ? sw->min_height : (th > (int)sw->max_height ? sw->max_height : (unsigned int)th);
+      cw = sw->min_width + (x - sw->min_width) / sx * sx;
+      ch = sw->min_height + (y - sw->min_height) / sy * sy;
+    }
+
+    long cost = size_cost(cw, ch, tw, th);
+    if (best < 0 || cost < best)
+    {
+      best = cost;
+      *w = cw;
+      *h = ch;
+    }
+
+    if (fs.type != V4L2_FRMSIZE_TYPE_DISCRETE)
+      break;
+  }
+
+  if (best < 0)
+  {
+    *w = tw;
+    *h = th;
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief 在指定格式和分辨率下选出最合适的帧间隔
+ *        有目标帧率时取不低于目标的最低帧率（达不到则取最高的），否则取最高帧率
+ * @return 选中的帧率，驱动不支持枚举时返回0
+ */
+static int pick_frame_rate(int fd, unsigned int fourcc, int w, int h, int target, struct v4l2_fract *interval)
+{
+  struct v4l2_frmivalenum fi;
+  int best = 0;
+
+  memset(&fi, 0, sizeof(fi));
+  fi.pixel_format = fourcc;
+  fi.width = w;
+  fi.height = h;
+
+  for (fi.index = 0; ioctl(fd, VIDIOC_ENUM_FRAMEINTERVALS, &fi) == 0; fi.index++)
+  {
+    struct v4l2_fract cand;
+
+    if (fi.type == V4L2_FRMIVAL_TYPE_DISCRETE)
+    {
+      cand = fi.discrete;
+    }
+    else
+    {
+      // 连续/步进：间隔越小帧率越高
+      struct v4l2_frmival_stepwise *sw = &fi.stepwise;
+      cand = sw->min;
+      if (target > 0 && sw->min.numerator && sw->max.numerator)
+      {
+        double want = 1.0 / target;
+        double lo = (double)sw->min.numerator / sw->min.denominator;
+        double hi = (double)sw->max.numerator / sw->max.denominator;
+        if (want >= lo && want <= hi)
+        {
+          cand.numerator = 1;
+          cand.denominator = target;
+        }
+      }
+    }
+
+    if (cand.numerator == 0)
+      continue;
+
+    int fps = (int)((cand.denominator + cand.numerator / 2) / cand.numerator);
+    int better;
+    if (best == 0)
+      better = 1;
+    else if (target <= 0)
+      better = fps > best;
+    else if (best < target)
+      better = fps > best;
+    else
+      better = fps >= target && fps < best;
+
+    if (better)
+    {
+      best = fps;
+      *interval = cand;
+    }
+
+    if (fi.type != V4L2_FRMIVAL_TYPE_DISCRETE)
+      break;
+  }
+
+  return best;
+}
+
+/**
+ * @brief YUYV的行是否有填充（bytesperline大于width*2）
+ *        LCD显示、移动检测、差分、变换和JPEG编码都按width*2的行距处理YUYV，有填充的格式不能使用
+ */
+static int yuyv_is_padded(unsigned int bytesperline, int width)
+{
+  return bytesperline != 0 && bytesperline != (unsigned int)width * 2;
+}
+
+/**
+ * @brief 用VIDIOC_TRY_FMT检查YUYV在该分辨率下是否带行填充（驱动不支持TRY_FMT时按无填充处理）
+ */
+static int yuyv_try_padded(int fd, int width, int height)
+{
+  struct v4l2_format fmt;
+  memset(&fmt, 0, sizeof(fmt));
+  fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  fmt.fmt.pix.width = width;
+  fmt.fmt.pix.height = height;
+  fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+  fmt.fmt.pix.field = V4L2_FIELD_ANY;
+
+  if (ioctl(fd, VIDIOC_TRY_FMT, &fmt) < 0)
+  {
+    return 0;
+  }
+  return yuyv_is_padded(fmt.fmt.pix.bytesperline, fmt.fmt.pix.width);
+}
+
+/**
+ * @brief 与驱动协商格式、分辨率和帧率
+ * @return 成功返回0，没有可用格式返回-1
+ */
+static int negotiate_format(camera_t *cam, const camera_config_t *config,
+                            unsigned int *fourcc, int *width, int *height, struct v4l2_fract *interval)
+{
+  static const unsigned int default_formats[] = {V4L2_PIX_FMT_YUYV, 0};
+  const unsigned int *formats = config->formats ? config->formats : default_formats;
+  struct v4l2_fmtdesc desc;
+  long best_cost = -1;
+  int best_fps = 0, best_rank = 0;
+  char name[5];
+
+  memset(&desc, 0, sizeof(desc));
+  desc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+  for (desc.index = 0; ioctl(cam->fd, VIDIOC_ENUM_FMT, &desc) == 0; desc.index++)
+  {
+    int rank;
+    for (rank = 0; formats[rank] && formats[rank] != desc.pixelformat; rank++)
+      ;
+    if (!formats[rank])
+      continue;
+
+    int w, h;
+    struct v4l2_fract ival = {0, 0};
+    pick_frame_size(cam->fd, desc.pixelformat, config->width, config->height, &w, &h);
+    int fps = pick_frame_rate(cam->fd, desc.pixelformat, w, h, config->fps, &ival);
+    long cost = size_cost(w, h, config->width, config->height);
+
+    printf("  %s %dx%d @%dfps\n", camera_fourcc_str(desc.pixelformat, name), w, h, fps);
+
+    // 带行填充的YUYV会画歪、读越界，不作为候选
+    if (desc.pixelformat == V4L2_PIX_FMT_YUYV && yuyv_try_padded(cam->fd, w, h))
+    {
+      printf("    padded lines, skipped\n");
+      continue;
+    }
+
+    // 先比分辨率，再比能达到的帧率（不超过目标），最后按配置的优先级
+    int eff = (config->fps > 0 && fps > config->fps) ? config->fps : fps;
+    int best_eff = (config->fps > 0 && best_fps > config->fps) ? config->fps : best_fps;
+    if (best_cost < 0 || cost < best_cost ||
+        (cost == best_cost && (eff > best_eff || (eff == best_eff && rank < best_rank))))
+    {
+      best_cost = cost;
+      best_fps = fps;
+      best_rank = rank;
+      *fourcc = desc.pixelformat;
+      *width = w;
+      *height = h;
+      *interval = ival;
+    }
+  }
+
+  if (best_cost < 0)
+  {
+    // 驱动不支持枚举格式时按首选格式和目标分辨率直接设置
+    if (desc.index > 0)
+    {
+      fprintf(stderr, "camera supports none of the requested formats\n");
+      return -1;
+    }
+    *fourcc = formats[0];
+    *width = config->width;
+    *height = config->height;
+    interval->numerator = config->fps > 0 ? 1 : 0;
+    interval->denominator = config->fps;
+  }
+
+  return 0;
+}
+
 /**
  * @brief 初始化摄像头
  */
 camera_t *camera_init(const char *dev_name, int width, int height)
+{
+  camera_config_t config;
+  memset(&config, 0, sizeof(config));
+  config.width = width;
+  config.height = height;
+
+  return camera_init_ex(dev_name, &config);
+}
+
+/**
+ * @brief 按配置初始化摄像头
+ */
+camera_t *camera_init_ex(const char *dev_name, const camera_config_t *config)
 {
   camera_t *cam = (camera_t *)malloc(sizeof(camera_t));
   if (!cam)
@@ -28,8 +297,6 @@ camera_t *camera_init(const char *dev_name, int width, int height)
   }
 
   memset(cam, 0, sizeof(camera_t));
-  cam->width = width;
-  cam->height = height;
 
   // 1. 打开摄像头设备
   cam->fd = open(dev_name, O_RDWR);
@@ -52,14 +319,24 @@ camera_t *camera_init(const char *dev_name, int width, int height)
 
   printf("Camera: %s\n", cap.card);
 
-  // 3. 设置视频格式
+  // 3. 协商视频格式
+  unsigned int fourcc;
+  int width, height;
+  struct v4l2_fract interval;
+  if (negotiate_format(cam, config, &fourcc, &width, &height, &interval) < 0)
+  {
+    close(cam->fd);
+    free(cam);
+    return NULL;
+  }
+
   struct v4l2_format fmt;
   memset(&fmt, 0, sizeof(fmt));
   fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
   fmt.fmt.pix.width = width;
   fmt.fmt.pix.height = height;
-  fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV; // YUYV格式
-  fmt.fmt.pix.field = V4L2_FIELD_INTERLACED;
+  fmt.fmt.pix.pixelformat = fourcc;
+  fmt.fmt.pix.field = V4L2_FIELD_ANY; // 由驱动选择
 
   if (ioctl(cam->fd, VIDIOC_S_FMT, &fmt) < 0)
   {
@@ -69,14 +346,56 @@ camera_t *camera_init(const char *dev_name, int width, int height)
     return NULL;
   }
 
-  // 4. 请求缓冲区
+  // 驱动可能调整了参数，以返回值为准
+  cam->width = fmt.fmt.pix.width;
+  cam->height = fmt.fmt.pix.height;
+  cam->pixelformat = fmt.fmt.pix.pixelformat;
+  cam->bytesperline = fmt.fmt.pix.bytesperline;
+  cam->sizeimage = fmt.fmt.pix.sizeimage;
+
+  // 协商时已跳过带填充的YUYV，这里防止驱动在S_FMT时给出和TRY_FMT不同的行距
+  if (cam->pixelformat == V4L2_PIX_FMT_YUYV && yuyv_is_padded(cam->bytesperline, cam->width))
+  {
+    fprintf(stderr, "YUYV bytesperline %u != width*2 (%d), padded lines are not supported\n",
+            cam->bytesperline, cam->width * 2);
+    close(cam->fd);
+    free(cam);
+    return NULL;
+  }
+
+  // 4. 设置帧率
+  struct v4l2_streamparm parm;
+  memset(&parm, 0, sizeof(parm));
+  parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  if (ioctl(cam->fd, VIDIOC_G_PARM, &parm) == 0 &&
+      (parm.parm.capture.capability & V4L2_CAP_TIMEPERFRAME))
+  {
+    if (interval.numerator && interval.denominator)
+    {
+      parm.parm.capture.timeperframe = interval;
+      if (ioctl(cam->fd, VIDIOC_S_PARM, &parm) < 0)
+      {
+        perror("VIDIOC_S_PARM failed");
+      }
+    }
+
+    struct v4l2_fract *tpf = &parm.parm.capture.timeperframe;
+    if (tpf->numerator)
+    {
+      cam->fps = (tpf->denominator + tpf->numerator / 2) / tpf->numerator;
+    }
+  }
+
+  // 5. 请求缓冲区
   struct v4l2_requestbuffers req;
   memset(&req, 0, sizeof(req));
-  req.count = 4; // 请求4个缓冲区
+  req.count = config->buffers > 0 ? config->buffers : CAMERA_BUFFER_COUNT;
+  if (req.count > CAMERA_MAX_BUFFERS)
+    req.count = CAMERA_MAX_BUFFERS;
   req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
   req.memory = V4L2_MEMORY_MMAP;
 
-  if (ioctl(cam->fd, VIDIOC_REQBUFS, &req) < 0)
+  if (ioctl(cam->fd, VIDIOC_REQBUFS, &req) < 0 || req.count < 2)
   {
     perror("VIDIOC_REQBUFS failed");
     close(cam->fd);
@@ -84,8 +403,10 @@ camera_t *camera_init(const char *dev_name, int width, int height)
     return NULL;
   }
 
-  // 5. 映射缓冲区并加入队列
-  for (int i = 0; i < 4; i++)
+  cam->buffer_count = req.count > CAMERA_MAX_BUFFERS ? CAMERA_MAX_BUFFERS : req.count;
+
+  // 6. 映射缓冲区并加入队列
+  for (int i = 0; i < cam->buffer_count; i++)
   {
     struct v4l2_buffer buf;
     memset(&buf, 0, sizeof(buf));
@@ -120,10 +441,20 @@ camera_t *camera_init(const char *dev_name, int width, int height)
     }
   }
 
-  printf("Camera initialized: %dx%d\n", width, height);
+  char name[5];
+  printf("Camera initialized: %s %dx%d @%dfps, %d buffers\n",
+         camera_fourcc_str(cam->pixelformat, name), cam->width, cam->height, cam->fps, cam->buffer_count);
   return cam;
 }
 
+/**
+ * @brief 摄像头输出是否为压缩格式
+ */
+int camera_is_compressed(const camera_t *cam)
+{
+  return cam->pixelformat == V4L2_PIX_FMT_MJPEG || cam->pixelformat == V4L2_PIX_FMT_JPEG;
+}
+
 /**
  * @brief 开始视频采集
  */
@@ -186,6 +517,86 @@ int camera_release_frame(camera_t *cam)
   return 0;
 }
 
+/**
+ * @brief 等待摄像头有新帧可读
+ */
+int camera_wait_frame(camera_t *cam, int timeout_ms)
+{
+  if (!cam)
+    return -1;
+
+  fd_set fds;
+  FD_ZERO(&fds);
+  FD_SET(cam->fd, &fds);
+
+  struct timeval tv;
+  tv.tv_sec = timeout_ms / 1000;
+  tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+  int ret = select(cam->fd + 1, &fds, NULL, NULL, &tv);
+  if (ret < 0)
+  {
+    if (errno == EINTR)
+      return 0;
+    perror("select camera failed");
+    return -1;
+  }
+
+  return ret > 0 ? 1 : 0;
+}
+
+/**
+ * @brief 从驱动队列取出一个已填充的缓冲区
+ */
+int camera_dequeue_buffer(camera_t *cam, int *index, unsigned char **data,
+                          unsigned int *data_size, struct timeval *timestamp)
+{
+  if (!cam || !index || !data || !data_size)
+    return -1;
+
+  struct v4l2_buffer buf;
+  memset(&buf, 0, sizeof(buf));
+  buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  buf.memory = V4L2_MEMORY_MMAP;
+
+  if (ioctl(cam->fd, VIDIOC_DQBUF, &buf) < 0)
+  {
+    perror("VIDIOC_DQBUF failed");
+    return -1;
+  }
+
+  *index = buf.index;
+  *data = (unsigned char *)cam->mptr[buf.index];
+  *data_size = buf.bytesused;
+  if (timestamp)
+    *timestamp = buf.timestamp;
+
+  return 0;
+}
+
+/**
+ * @brief 将缓冲区归还驱动队列
+ */
+int camera_queue_buffer(camera_t *cam, int index)
+{
+  if (!cam || index < 0 || index >= cam->buffer_count)
+    return -1;
+
+  struct v4l2_buffer buf;
+  memset(&buf, 0, sizeof(buf));
+  buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  buf.memory = V4L2_MEMORY_MMAP;
+  buf.index = index;
+
+  if (ioctl(cam->fd, VIDIOC_QBUF, &buf) < 0)
+  {
+    perror("VIDIOC_QBUF failed");
+    return -1;
+  }
+
+  return 0;
+}
+
 /**
  * @brief 停止视频采集
  */
@@ -214,7 +625,7 @@ void camera_close(camera_t *cam)
     return;
 
   // 取消内存映射
-  for (int i = 0; i < 4; i++)
+  for (int i = 0; i < cam->buffer_count; i++)
   {
     if (cam->mptr[i] && cam->mptr[i] != MAP_FAILED)
     {
@@ -227,6 +638,7 @@ void camera_close(camera_t *cam)
     close(cam->fd);
   }
 
+  jpeg_decoder_destroy(cam->jpeg);
   free(cam);
   printf("Camera closed\n");
 }
@@ -261,6 +673,65 @@ void yuyv_to_rgb888(const unsigned char *yuyv, unsigned char *rgb, int width, in
   }
 }
 
+/**
+ * @brief JPEG解码输出回调：每个MCU行直接画到LCD
+ */
+static void jpeg_blit_rows(void *arg, const unsigned int *xrgb, int stride, int y, int width, int rows)
+{
+  const int *origin = (const int *)arg;
+  lcd_blit_xrgb(xrgb, stride, width, rows, origin[0], origin[1] + y);
+}
+
+/**
+ * @brief 解码一帧MJPEG并显示
+ */
+static int display_jpeg(camera_t *cam, const unsigned char *data, unsigned int size, int x0, int y0)
+{
+  if (!cam->jpeg)
+  {
+    cam->jpeg = jpeg_decoder_create();
+    if (!cam->jpeg)
+      return -1;
+  }
+
+  // 选最小的缩小倍数，使画面放得进显示区域
+  lcd_rect_t clip;
+  lcd_get_clip(&clip);
+  int max_w = clip.x + clip.w - x0;
+  int max_h = clip.y + clip.h - y0;
+  int scale = 1;
+  while (scale < 8 && ((cam->width + scale - 1) / scale > max_w ||
+                       (cam->height + scale - 1) / scale > max_h))
+  {
+    scale *= 2;
+  }
+
+  int origin[2] = {x0, y0};
+  return jpeg_decode(cam->jpeg, data, size, scale, jpeg_blit_rows, origin);
+}
+
+/**
+ * @brief 在LCD上显示一帧已获取的图像
+ */
+int camera_display_frame(camera_t *cam, const unsigned char *data, unsigned int size, int x0, int y0)
+{
+  if (!cam || !data)
+    return -1;
+
+  if (camera_is_compressed(cam))
+  {
+    return display_jpeg(cam, data, size, x0, y0);
+  }
+
+  if (size < (unsigned int)(cam->width * cam->height * 2))
+    return -1;
+
+  // 逐行转换后直接写入帧缓冲，不分配中间缓冲区
+  lcd_blit_yuyv(data, cam->width, cam->height, x0, y0);
+
+  return 0;
+}
+
 /**
  * @brief 在LCD上显示摄像头图像
  */
@@ -278,36 +749,8 @@ int camera_display(camera_t *cam, int x0, int y0)
     return -1;
   }
 
-  // 分配RGB缓冲区
-  unsigned char *rgb_data = (unsigned char *)malloc(cam->width * cam->height * 3);
-  if (!rgb_data)
-  {
-    perror("malloc rgb_data failed");
-    camera_release_frame(cam);
-    return -1;
-  }
-
-  // 转换YUYV到RGB
-  yuyv_to_rgb888(yuyv_data, rgb_data, cam->width, cam->height);
-
-  // 显示到LCD
-  for (int y = 0; y < cam->height; y++)
-  {
-    for (int x = 0; x < cam->width; x++)
-    {
-      int idx = (y * cam->width + x) * 3;
-      int r = rgb_data[idx];
-      int g = rgb_data[idx + 1];
-      int b = rgb_data[idx + 2];
-
-      // RGB888转RGB565或ARGB8888(根据LCD格式)
-      int color = (r << 16) | (g << 8) | b | 0xFF000000;
-      display_point(x0 + x, y0 + y, color);
-    }
-  }
-
-  free(rgb_data);
+  int ret = camera_display_frame(cam, yuyv_data, data_size, x0, y0);
   camera_release_frame(cam);
 
-  return 0;
-}
+  return ret;
+}
\ No newline at end of file
@@ -4,16 +4,37 @@
 #include <linux/videodev2.h>
 #include <linux/fb.h>
 #include <linux/input.h>
+#include <sys/time.h>
+#include "jpeg_decoder.h"
+
+#define CAMERA_BUFFER_COUNT 4 // 默认V4L2 MMAP缓冲区数量
+#define CAMERA_MAX_BUFFERS 8  // 缓冲区数量上限
+
+// 采集参数：camera_init_ex据此与驱动协商格式、分辨率和帧率
+typedef struct
+{
+  int width;                   // 目标宽度
+  int height;                  // 目标高度
+  int fps;                     // 目标帧率，0表示取能达到的最高帧率
+  const unsigned int *formats; // 可接受的像素格式(V4L2_PIX_FMT_*)，按优先级排列，0结尾；NULL表示只用YUYV
+  int buffers;                 // 缓冲区数量，0表示CAMERA_BUFFER_COUNT
+} camera_config_t;
 
 // 摄像头设备结构体
 typedef struct
 {
   int fd;                 // 设备文件描述符
   struct v4l2_buffer buf; // 缓冲区信息
-  void *mptr[4];          // 映射内存指针数组
-  unsigned int size[4];   // 每个缓冲区大小
-  int width;              // 图像宽度
-  int height;             // 图像高度
+  void *mptr[CAMERA_MAX_BUFFERS];         // 映射内存指针数组
+  unsigned int size[CAMERA_MAX_BUFFERS];  // 每个缓冲区大小
+  int buffer_count;       // 实际缓冲区数量
+  int width;              // 图像宽度（协商结果）
+  int height;             // 图像高度（协商结果）
+  unsigned int pixelformat;  // 像素格式（协商结果，V4L2_PIX_FMT_*）
+  unsigned int bytesperline; // 每行字节数（YUYV时保证为width*2，带填充的格式在协商时被拒绝）
+  unsigned int sizeimage;    // 一帧最大字节数
+  int fps;                // 帧率（协商结果，0表示未知）
+  jpeg_decoder_t *jpeg;   // MJPEG预览解码器（首次显示时创建）
 } camera_t;
 
 /**
@@ -25,6 +46,31 @@ typedef struct
  */
 camera_t *camera_init(const char *dev_name, int width, int height);
 
+/**
+ * @brief 按配置初始化摄像头
+ *        枚举VIDIOC_ENUM_FMT / ENUM_FRAMESIZES / ENUM_FRAMEINTERVALS，
+ *        选出最接近目标的格式、分辨率和帧率，并用VIDIOC_S_PARM设置帧率
+ * @param dev_name 摄像头设备路径
+ * @param config 采集参数
+ * @return 成功返回摄像头结构体指针（width/height/pixelformat/fps为协商结果），失败返回NULL
+ */
+camera_t *camera_init_ex(const char *dev_name, const camera_config_t *config);
+
+/**
+ * @brief 把像素格式转换成可读字符串，如"YUYV"
+ * @param fourcc V4L2像素格式
+ * @param buf 至少5字节的输出缓冲区
+ * @return buf
+ */
+const char *camera_fourcc_str(unsigned int fourcc, char *buf);
+
+/**
+ * @brief 摄像头输出是否为压缩格式（MJPEG/JPEG）
+ * @param cam 摄像头结构体指针
+ * @return 压缩格式返回1，否则返回0
+ */
+int camera_is_compressed(const camera_t *cam);
+
 /**
  * @brief 开始视频采集
  * @param cam 摄像头结构体指针
@@ -48,6 +94,35 @@ int camera_get_frame(camera_t *cam, unsigned char **yuyv_data, unsigned int *dat
  */
 int camera_release_frame(camera_t *cam);
 
+/**
+ * @brief 等待摄像头有新帧可读
+ * @param cam 摄像头结构体指针
+ * @param timeout_ms 超时时间（毫秒）
+ * @return 有新帧返回1，超时返回0，失败返回-1
+ */
+int camera_wait_frame(camera_t *cam, int timeout_ms);
+
+/**
+ * @brief 从驱动队列取出一个已填充的缓冲区
+ *        与camera_get_frame不同，缓冲区索引由调用者保存，可同时持有多个缓冲区
+ * @param cam 摄像头结构体指针
+ * @param index 输出缓冲区索引
+ * @param data 输出帧数据指针（指向mmap缓冲区）
+ * @param data_size 输出数据大小
+ * @param timestamp 输出驱动采集时间戳
+ * @return 成功返回0，失败返回-1
+ */
+int camera_dequeue_buffer(camera_t *cam, int *index, unsigned char **data,
+                          unsigned int *data_size, struct timeval *timestamp);
+
+/**
+ * @brief 将缓冲区归还驱动队列
+ * @param cam 摄像头结构体指针
+ * @param index 缓冲区索引
+ * @return 成功返回0，失败返回-1
+ */
+int camera_queue_buffer(camera_t *cam, int index);
+
 /**
  * @brief 停止视频采集
  * @param cam 摄像头结构体指针
@@ -70,6 +145,19 @@ void camera_close(camera_t *cam);
  */
 void yuyv_to_rgb888(const unsigned char *yuyv, unsigned char *rgb, int width, int height);
 
+/**
+ * @brief 在LCD上显示一帧已获取的图像
+ *        YUYV直接转换写入帧缓冲；MJPEG用内置解码器解码，
+ *        帧比显示区域(LCD裁剪区)大时按1/2、1/4、1/8缩小解码
+ * @param cam 摄像头结构体指针
+ * @param data 帧数据（格式为cam->pixelformat）
+ * @param size 帧数据大小
+ * @param x0 显示起始x坐标
+ * @param y0 显示起始y坐标
+ * @return 成功返回0，失败返回-1
+ */
+int camera_display_frame(camera_t *cam, const unsigned char *data, unsigned int size, int x0, int y0);
+
 /**
  * @brief 在LCD上显示摄像头图像
  * @param cam 摄像头结构体指针
@@ -3,11 +3,78 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+/**
+ * @brief 把帧发布为最新帧，并释放上一帧的模块引用
+ */
+static void publish_frame(camera_module_t *cam_module, camera_frame_t *frame)
+{
+  pthread_mutex_lock(&cam_module->mutex);
+  camera_frame_t *old = cam_module->latest;
+  cam_module->latest = frame;
+  pthread_cond_broadcast(&cam_module->frame_cond);
+  pthread_mutex_unlock(&cam_module->mutex);
+
+  if (old)
+  {
+    camera_module_release_frame(cam_module, old);
+  }
+}
+
+/**
+ * @brief 采集线程：唯一调用DQBUF的地方，把每个缓冲区发布到帧环
+ */
+static void *capture_thread_func(void *arg)
+{
+  camera_module_t *cam_module = (camera_module_t *)arg;
+  camera_t *cam = cam_module->camera;
+
+  printf("摄像头采集线程启动\n");
+
+  while (cam_module->is_running)
+  {
+    // 带超时等待，保证停止时能及时退出
+    int ret = camera_wait_frame(cam, 200);
+    if (ret <= 0)
+    {
+      if (ret < 0)
+      {
+        usleep(10000);
+      }
+      continue;
+    }
+
+    int index;
+    unsigned char *data;
+    unsigned int size;
+    struct timeval timestamp;
+    if (camera_dequeue_buffer(cam, &index, &data, &size, &timestamp) < 0)
+    {
+      usleep(10000);
+      continue;
+    }
+
+    camera_frame_t *frame = &cam_module->ring[index];
+    frame->index = index;
+    frame->data = data;
+    frame->size = size ? size : cam->size[index]; // 部分驱动bytesused为0
+    frame->seq = ++cam_module->frame_seq;
+    frame->timestamp = timestamp;
+    frame->refcount = 1; // 模块自身持有的"最新帧"引用
+
+    publish_frame(cam_module, frame);
+  }
+
+  printf("摄像头采集线程退出\n");
+  return NULL;
+}
 
 /**
  * @brief 初始化摄像头模块
  */
-camera_module_t *camera_module_init(const char *dev_name, int width, int height)
+camera_module_t *camera_module_init(const char *dev_name, const camera_config_t *config)
 {
   camera_module_t *cam_module = (camera_module_t *)malloc(sizeof(camera_module_t));
   if (!cam_module)
@@ -26,19 +93,23 @@ camera_module_t *camera_module_init(const char *dev_name, int width, int height)
     return NULL;
   }
 
+  pthread_cond_init(&cam_module->frame_cond, NULL);
+
   // 初始化摄像头
-  cam_module->camera = camera_init(dev_name, width, height);
+  cam_module->camera = camera_init_ex(dev_name, config);
   if (!cam_module->camera)
   {
     fprintf(stderr, "摄像头初始化失败\n");
+    pthread_cond_destroy(&cam_module->frame_cond);
     pthread_mutex_destroy(&cam_module->mutex);
     free(cam_module);
     return NULL;
   }
 
   cam_module->is_running = 0;
-  cam_module->last_frame = NULL;
-  cam_module->last_frame_size = 0;
+  cam_module->latest = NULL;
+  cam_module->frame_seq = 0;
+  cam_module->display_seq = 0;
   cam_module->capture_request = 0;
 
   printf("摄像头模块初始化成功\n");
@@ -62,6 +133,14 @@ int camera_module_start(camera_module_t *cam_module)
   }
 
   cam_module->is_running = 1;
+  if (pthread_create(&cam_module->capture_thread, NULL, capture_thread_func, cam_module) != 0)
+  {
+    perror("创建采集线程失败");
+    cam_module->is_running = 0;
+    camera_stop(cam_module->camera);
+    return -1;
+  }
+
   printf("摄像头模块启动成功\n");
   return 0;
 }
@@ -76,7 +155,25 @@ int camera_module_stop(camera_module_t *cam_module)
     return -1;
   }
 
-  cam_module->is_running = 0;
+  if (cam_module->is_running)
+  {
+    pthread_mutex_lock(&cam_module->mutex);
+    cam_module->is_running = 0;
+    pthread_cond_broadcast(&cam_module->frame_cond); // 唤醒等待新帧的读者
+    pthread_mutex_unlock(&cam_module->mutex);
+
+    pthread_join(cam_module->capture_thread, NULL);
+
+    // 释放模块持有的最新帧引用
+    pthread_mutex_lock(&cam_module->mutex);
+    camera_frame_t *old = cam_module->latest;
+    cam_module->latest = NULL;
+    pthread_mutex_unlock(&cam_module->mutex);
+    if (old)
+    {
+      camera_module_release_frame(cam_module, old);
+    }
+  }
 
   if (camera_stop(cam_module->camera) < 0)
   {
@@ -103,11 +200,7 @@ void camera_module_close(camera_module_t *cam_module)
     camera_close(cam_module->camera);
   }
 
-  if (cam_module->last_frame)
-  {
-    free(cam_module->last_frame);
-  }
-
+  pthread_cond_destroy(&cam_module->frame_cond);
   pthread_mutex_destroy(&cam_module->mutex);
   free(cam_module);
 
@@ -115,41 +208,79 @@ void camera_module_close(camera_module_t *cam_module)
 }
 
 /**
- * @brief 获取一帧图像数据（带锁保护）
+ * @brief 获取最新一帧（增加引用计数）
  */
-int camera_module_get_frame(camera_module_t *cam_module, unsigned char **yuyv_data, unsigned int *data_size)
+camera_frame_t *camera_module_acquire_frame(camera_module_t *cam_module, unsigned long long after_seq, int timeout_ms)
 {
   if (!cam_module || !cam_module->camera)
   {
-    return -1;
+    return NULL;
+  }
+
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += timeout_ms / 1000;
+  deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L)
+  {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
   }
 
+  // 锁只用于取得latest指针，读帧数据时不持锁
   pthread_mutex_lock(&cam_module->mutex);
-  int ret = camera_get_frame(cam_module->camera, yuyv_data, data_size);
+  while (cam_module->is_running &&
+         (!cam_module->latest || cam_module->latest->seq <= after_seq))
+  {
+    if (pthread_cond_timedwait(&cam_module->frame_cond, &cam_module->mutex, &deadline) == ETIMEDOUT)
+    {
+      break;
+    }
+  }
+
+  camera_frame_t *frame = cam_module->latest;
+  if (frame && frame->seq > after_seq)
+  {
+    __sync_fetch_and_add(&frame->refcount, 1);
+  }
+  else
+  {
+    frame = NULL;
+  }
   pthread_mutex_unlock(&cam_module->mutex);
 
-  return ret;
+  return frame;
 }
 
 /**
- * @brief 释放一帧图像（带锁保护）
+ * @brief 为已持有的帧再增加一个引用
  */
-int camera_module_release_frame(camera_module_t *cam_module)
+void camera_module_ref_frame(camera_frame_t *frame)
 {
-  if (!cam_module || !cam_module->camera)
+  if (frame)
   {
-    return -1;
+    __sync_fetch_and_add(&frame->refcount, 1);
   }
+}
 
-  pthread_mutex_lock(&cam_module->mutex);
-  int ret = camera_release_frame(cam_module->camera);
-  pthread_mutex_unlock(&cam_module->mutex);
+/**
+ * @brief 释放一帧（引用计数归零时缓冲区归还驱动）
+ */
+void camera_module_release_frame(camera_module_t *cam_module, camera_frame_t *frame)
+{
+  if (!cam_module || !frame)
+  {
+    return;
+  }
 
-  return ret;
+  if (__sync_sub_and_fetch(&frame->refcount, 1) == 0)
+  {
+    camera_queue_buffer(cam_module->camera, frame->index);
+  }
 }
 
 /**
- * @brief 在LCD上显示摄像头图像（带锁保护）
+ * @brief 在LCD上显示下一帧摄像头图像
  */
 int camera_module_display(camera_module_t *cam_module, int x0, int y0)
 {
@@ -158,9 +289,15 @@ int camera_module_display(camera_module_t *cam_module, int x0, int y0)
     return -1;
   }
 
-  pthread_mutex_lock(&cam_module->mutex);
-  int ret = camera_display(cam_module->camera, x0, y0);
-  pthread_mutex_unlock(&cam_module->mutex);
+  camera_frame_t *frame = camera_module_acquire_frame(cam_module, cam_module->display_seq, 1000);
+  if (!frame)
+  {
+    return -1;
+  }
+
+  cam_module->display_seq = frame->seq;
+  int ret = camera_display_frame(cam_module->camera, frame->data, frame->size, x0, y0);
+  camera_module_release_frame(cam_module, frame);
 
   return ret;
 }
@@ -175,44 +312,27 @@ int camera_module_capture_frame(camera_module_t *cam_module, unsigned char **yuy
     return -1;
   }
 
-  pthread_mutex_lock(&cam_module->mutex);
-
-  // 获取当前帧
-  unsigned char *frame_data = NULL;
-  unsigned int frame_size = 0;
-
-  if (camera_get_frame(cam_module->camera, &frame_data, &frame_size) < 0)
+  // 与LCD共享最新帧，不再单独DQBUF
+  camera_frame_t *frame = camera_module_acquire_frame(cam_module, 0, 1000);
+  if (!frame)
   {
-    pthread_mutex_unlock(&cam_module->mutex);
     return -1;
   }
 
-  // 释放旧的截屏缓冲区
-  if (cam_module->last_frame)
-  {
-    free(cam_module->last_frame);
-  }
-
-  // 分配新的缓冲区并复制数据
-  cam_module->last_frame = (unsigned char *)malloc(frame_size);
-  if (!cam_module->last_frame)
+  // 复制到调用者持有的缓冲区：环形缓冲的帧马上还回去，并发截屏之间也互不影响
+  unsigned char *buf = (unsigned char *)malloc(frame->size);
+  if (!buf)
   {
     perror("malloc capture frame failed");
-    camera_release_frame(cam_module->camera);
-    pthread_mutex_unlock(&cam_module->mutex);
+    camera_module_release_frame(cam_module, frame);
     return -1;
   }
 
-  memcpy(cam_module->last_frame, frame_data, frame_size);
-  cam_module->last_frame_size = frame_size;
-
-  // 返回截屏数据
-  *yuyv_data = cam_module->last_frame;
-  *data_size = cam_module->last_frame_size;
-
-  camera_release_frame(cam_module->camera);
-  pthread_mutex_unlock(&cam_module->mutex);
+  memcpy(buf, frame->data, frame->size);
+  *yuyv_data = buf;
+  *data_size = frame->size;
+  camera_module_release_frame(cam_module, frame);
 
-  printf("截屏成功，帧大小: %u bytes\n", frame_size);
+  printf("截屏成功，帧大小: %u bytes\n", *data_size);
   return 0;
 }
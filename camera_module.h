@@ -4,25 +4,41 @@
 #include <pthread.h>
 #include "camera.h"
 
+#define CAMERA_RING_SIZE CAMERA_MAX_BUFFERS // 帧环槽位数（与V4L2缓冲区一一对应）
+
+// 帧环中的一帧（引用计数，所有读者释放后才归还驱动）
+typedef struct
+{
+  int index;                // V4L2缓冲区索引
+  unsigned char *data;      // 帧数据（直接指向mmap缓冲区，只读）
+  unsigned int size;        // 有效数据大小
+  unsigned long long seq;   // 帧序号（从1开始递增）
+  struct timeval timestamp; // 驱动采集时间戳
+  int refcount;             // 引用计数（原子操作）
+} camera_frame_t;
+
 // 摄像头模块结构
 typedef struct
 {
   camera_t *camera;
-  pthread_mutex_t mutex;
+  pthread_mutex_t mutex;      // 仅保护latest指针的切换
+  pthread_cond_t frame_cond;  // 新帧到达通知
+  pthread_t capture_thread;   // 唯一的采集线程（唯一调用DQBUF的地方）
   int is_running;
-  unsigned char *last_frame;
-  unsigned int last_frame_size;
+  camera_frame_t ring[CAMERA_RING_SIZE];
+  camera_frame_t *latest;     // 最新一帧（模块自身持有一个引用）
+  unsigned long long frame_seq;
+  unsigned long long display_seq; // LCD最后显示的帧序号
   int capture_request; // 截屏请求标志
 } camera_module_t;
 
 /**
  * @brief 初始化摄像头模块
  * @param dev_name 摄像头设备路径
- * @param width 图像宽度
- * @param height 图像高度
+ * @param config 采集参数（目标格式、分辨率、帧率）
  * @return 成功返回摄像头模块指针，失败返回NULL
  */
-camera_module_t *camera_module_init(const char *dev_name, int width, int height);
+camera_module_t *camera_module_init(const char *dev_name, const camera_config_t *config);
 
 /**
  * @brief 启动摄像头模块
@@ -45,23 +61,29 @@ int camera_module_stop(camera_module_t *cam_module);
 void camera_module_close(camera_module_t *cam_module);
 
 /**
- * @brief 获取一帧图像数据（带锁保护）
+ * @brief 获取最新一帧（增加引用计数，多个读者可同时持有同一帧）
  * @param cam_module 摄像头模块指针
- * @param yuyv_data 输出YUYV格式图像数据指针
- * @param data_size 输出数据大小
- * @return 成功返回0，失败返回-1
+ * @param after_seq 只返回序号大于该值的帧，传0表示任意最新帧
+ * @param timeout_ms 等待新帧的超时时间（毫秒）
+ * @return 成功返回帧指针，超时或模块已停止返回NULL
  */
-int camera_module_get_frame(camera_module_t *cam_module, unsigned char **yuyv_data, unsigned int *data_size);
+camera_frame_t *camera_module_acquire_frame(camera_module_t *cam_module, unsigned long long after_seq, int timeout_ms);
 
 /**
- * @brief 释放一帧图像（带锁保护）
+ * @brief 为已持有的帧再增加一个引用（例如交给发送队列继续使用）
+ * @param frame camera_module_acquire_frame返回的帧
+ */
+void camera_module_ref_frame(camera_frame_t *frame);
+
+/**
+ * @brief 释放一帧（引用计数归零时缓冲区归还驱动）
  * @param cam_module 摄像头模块指针
- * @return 成功返回0，失败返回-1
+ * @param frame camera_module_acquire_frame返回的帧
  */
-int camera_module_release_frame(camera_module_t *cam_module);
+void camera_module_release_frame(camera_module_t *cam_module, camera_frame_t *frame);
 
 /**
- * @brief 在LCD上显示摄像头图像（带锁保护）
+ * @brief 在LCD上显示下一帧摄像头图像（等待新帧到达）
  * @param cam_module 摄像头模块指针
  * @param x0 显示起始x坐标
  * @param y0 显示起始y坐标
@@ -70,8 +92,10 @@ int camera_module_release_frame(camera_module_t *cam_module);
 int camera_module_display(camera_module_t *cam_module, int x0, int y0);
 
 /**
- * @brief 请求截屏
+ * @brief 请求截屏（复制最新一帧，不影响LCD显示）
  * @param cam_module 摄像头模块指针
+ * @param yuyv_data 输出截屏数据指针（新分配的缓冲区，调用者用free释放）
+ * @param data_size 输出数据大小
  * @return 成功返回0，失败返回-1
  */
 int camera_module_capture_frame(camera_module_t *cam_module, unsigned char **yuyv_data, unsigned int *data_size);
@@ -17,6 +17,7 @@
 #include "ts.h"
 #include "camera_module.h"
 #include "server_module.h"
+#include "compositor.h"
 
 // 全局变量声明
 extern int g_running;
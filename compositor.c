@@ -0,0 +1,319 @@
+#include "compositor.h"
+#include "bmp.h"
+#include <stdio.h>
+#include <string.h>
+
+#define COMP_MAX_DIRTY 8 // 脏区个数上限，超过后合并为一个包围盒
+
+// 图片层
+typedef struct
+{
+  int used;
+  char file[64];
+  int x;
+  int y;
+  lcd_rect_t area; // 该层在屏幕上占用的区域（图片 ∩ clip ∩ 屏幕）
+} comp_image_t;
+
+static comp_image_t g_layers[COMP_LAYER_COUNT];
+static int g_video_enabled = 0;
+static lcd_rect_t g_video_rect;
+static lcd_rect_t g_dirty[COMP_MAX_DIRTY];
+static int g_dirty_count = 0;
+
+static const lcd_rect_t g_screen = {0, 0, LCD_WIDTH, LCD_HEIGHT};
+
+/**
+ * @brief 求两个矩形的交集，交集为空返回0
+ */
+static int rect_intersect(const lcd_rect_t *a, const lcd_rect_t *b, lcd_rect_t *out)
+{
+  int x0 = a->x > b->x ? a->x : b->x;
+  int y0 = a->y > b->y ? a->y : b->y;
+  int x1 = (a->x + a->w) < (b->x + b->w) ? (a->x + a->w) : (b->x + b->w);
+  int y1 = (a->y + a->h) < (b->y + b->h) ? (a->y + a->h) : (b->y + b->h);
+
+  if (x1 <= x0 || y1 <= y0)
+  {
+    return 0;
+  }
+
+  out->x = x0;
+  out->y = y0;
+  out->w = x1 - x0;
+  out->h = y1 - y0;
+  return 1;
+}
+
+/**
+ * @brief a是否完全包含b
+ */
+static int rect_contains(const lcd_rect_t *a, const lcd_rect_t *b)
+{
+  return b->x >= a->x && b->y >= a->y &&
+         b->x + b->w <= a->x + a->w && b->y + b->h <= a->y + a->h;
+}
+
+/**
+ * @brief 计算 a - b，最多得到4个矩形
+ * @return 结果矩形个数
+ */
+static int rect_subtract(const lcd_rect_t *a, const lcd_rect_t *b, lcd_rect_t out[4])
+{
+  lcd_rect_t in;
+  if (!rect_intersect(a, b, &in))
+  {
+    out[0] = *a;
+    return 1;
+  }
+
+  int n = 0;
+  if (in.y > a->y) // 上
+  {
+    out[n].x = a->x;
+    out[n].y = a->y;
+    out[n].w = a->w;
+    out[n].h = in.y - a->y;
+    n++;
+  }
+  if (in.y + in.h < a->y + a->h) // 下
+  {
+    out[n].x = a->x;
+    out[n].y = in.y + in.h;
+    out[n].w = a->w;
+    out[n].h = a->y + a->h - (in.y + in.h);
+    n++;
+  }
+  if (in.x > a->x) // 左
+  {
+    out[n].x = a->x;
+    out[n].y = in.y;
+    out[n].w = in.x - a->x;
+    out[n].h = in.h;
+    n++;
+  }
+  if (in.x + in.w < a->x + a->w) // 右
+  {
+    out[n].x = in.x + in.w;
+    out[n].y = in.y;
+    out[n].w = a->x + a->w - (in.x + in.w);
+    out[n].h = in.h;
+    n++;
+  }
+
+  return n;
+}
+
+/**
+ * @brief 初始化合成器
+ */
+void compositor_init(void)
+{
+  memset(g_layers, 0, sizeof(g_layers));
+  g_video_enabled = 0;
+  g_dirty_count = 0;
+  lcd_set_clip(NULL);
+  compositor_invalidate(NULL);
+}
+
+/**
+ * @brief 标记一块区域需要重画
+ */
+void compositor_invalidate(const lcd_rect_t *rect)
+{
+  lcd_rect_t r;
+  if (!rect_intersect(rect ? rect : &g_screen, &g_screen, &r))
+  {
+    return;
+  }
+
+  for (int i = 0; i < g_dirty_count; i++)
+  {
+    if (rect_contains(&g_dirty[i], &r))
+    {
+      return;
+    }
+  }
+
+  if (g_dirty_count < COMP_MAX_DIRTY)
+  {
+    g_dirty[g_dirty_count++] = r;
+    return;
+  }
+
+  // 脏区太多：合并成一个包围盒
+  int x0 = r.x, y0 = r.y, x1 = r.x + r.w, y1 = r.y + r.h;
+  for (int i = 0; i < g_dirty_count; i++)
+  {
+    if (g_dirty[i].x < x0)
+      x0 = g_dirty[i].x;
+    if (g_dirty[i].y < y0)
+      y0 = g_dirty[i].y;
+    if (g_dirty[i].x + g_dirty[i].w > x1)
+      x1 = g_dirty[i].x + g_dirty[i].w;
+    if (g_dirty[i].y + g_dirty[i].h > y1)
+      y1 = g_dirty[i].y + g_dirty[i].h;
+  }
+  g_dirty[0].x = x0;
+  g_dirty[0].y = y0;
+  g_dirty[0].w = x1 - x0;
+  g_dirty[0].h = y1 - y0;
+  g_dirty_count = 1;
+}
+
+/**
+ * @brief 设置图片层内容
+ */
+void compositor_set_image(comp_layer_t layer, const char *bmp_file, int x, int y, const lcd_rect_t *clip)
+{
+  if (layer == COMP_LAYER_VIDEO || layer >= COMP_LAYER_COUNT)
+  {
+    return;
+  }
+
+  comp_image_t *img = &g_layers[layer];
+  comp_image_t next;
+  memset(&next, 0, sizeof(next));
+
+  if (bmp_file)
+  {
+    lcd_rect_t full;
+    full.x = x;
+    full.y = y;
+    if (bmp_get_size(bmp_file, &full.w, &full.h) < 0)
+    {
+      return;
+    }
+
+    if (!rect_intersect(&full, &g_screen, &next.area) ||
+        (clip && !rect_intersect(&next.area, clip, &next.area)))
+    {
+      next.area.w = next.area.h = 0;
+    }
+
+    next.used = 1;
+    next.x = x;
+    next.y = y;
+    snprintf(next.file, sizeof(next.file), "%s", bmp_file);
+  }
+
+  // 内容没变则不用重画
+  if (img->used == next.used && (!next.used ||
+      (strcmp(img->file, next.file) == 0 && img->x == next.x && img->y == next.y &&
+       memcmp(&img->area, &next.area, sizeof(next.area)) == 0)))
+  {
+    return;
+  }
+
+  if (img->used)
+  {
+    compositor_invalidate(&img->area);
+  }
+  if (next.used)
+  {
+    compositor_invalidate(&next.area);
+  }
+
+  *img = next;
+}
+
+/**
+ * @brief 开启/关闭视频层
+ */
+void compositor_set_video(int enabled, const lcd_rect_t *rect)
+{
+  if (enabled && rect)
+  {
+    if (g_video_enabled && memcmp(&g_video_rect, rect, sizeof(*rect)) == 0)
+    {
+      return;
+    }
+    if (g_video_enabled)
+    {
+      compositor_invalidate(&g_video_rect);
+    }
+    g_video_enabled = 1;
+    g_video_rect = *rect;
+    lcd_set_clip(rect); // 视频绘制不会越过自己的区域
+  }
+  else if (g_video_enabled)
+  {
+    // 视频区域交还给下面的图层
+    g_video_enabled = 0;
+    compositor_invalidate(&g_video_rect);
+    lcd_set_clip(NULL);
+  }
+}
+
+/**
+ * @brief 用各图层重画一块不被视频覆盖的区域
+ */
+static void paint_rect(const lcd_rect_t *r)
+{
+  lcd_rect_t part;
+
+  // 从完全覆盖该区域的最上层开始画，被挡住的图层不用画
+  int first = COMP_LAYER_COUNT - 1;
+  while (first >= 0 && !(g_layers[first].used && rect_contains(&g_layers[first].area, r)))
+  {
+    first--;
+  }
+
+  // 没有任何图层完全覆盖时先填黑
+  if (first < 0)
+  {
+    lcd_fill_rect(r->x, r->y, r->w, r->h, 0);
+    first = COMP_LAYER_BACKGROUND;
+  }
+
+  for (int layer = first; layer < COMP_LAYER_COUNT; layer++)
+  {
+    comp_image_t *img = &g_layers[layer];
+    if (img->used && rect_intersect(&img->area, r, &part))
+    {
+      bmp_display_clip(img->file, img->x, img->y, &part);
+    }
+  }
+}
+
+/**
+ * @brief 重画所有脏区并翻页
+ */
+void compositor_render(void)
+{
+  if (g_dirty_count == 0)
+  {
+    return;
+  }
+
+  lcd_rect_t saved_clip;
+  lcd_get_clip(&saved_clip);
+  lcd_set_clip(NULL);
+
+  int painted = 0;
+  for (int i = 0; i < g_dirty_count; i++)
+  {
+    lcd_rect_t parts[4];
+    int n = 1;
+    parts[0] = g_dirty[i];
+
+    if (g_video_enabled)
+    {
+      n = rect_subtract(&g_dirty[i], &g_video_rect, parts);
+    }
+
+    for (int j = 0; j < n; j++)
+    {
+      paint_rect(&parts[j]);
+      painted++;
+    }
+  }
+
+  g_dirty_count = 0;
+  lcd_set_clip(&saved_clip);
+
+  if (painted)
+  {
+    lcd_flip(1);
+  }
+}
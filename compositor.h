@@ -0,0 +1,65 @@
+#ifndef __COMPOSITOR_H__
+#define __COMPOSITOR_H__
+
+#include "lcd.h"
+
+/*
+ * LCD合成器：按层(背景/视频/按钮)记录屏幕内容和脏区，只重画变化的区域。
+ * 视频层由显示线程直接绘制，合成器不会重画视频层覆盖的区域；
+ * compositor_render与显示线程不能同时绘制（模式切换时显示线程未运行）。
+ */
+
+// 屏幕布局
+#define VIDEO_REGION_X 0
+#define VIDEO_REGION_Y 0
+#define VIDEO_REGION_W 640
+#define VIDEO_REGION_H 480
+
+#define PANEL_REGION_X 640
+#define PANEL_REGION_Y 0
+#define PANEL_REGION_W 160
+#define PANEL_REGION_H 480
+
+// 图层（从下到上）
+typedef enum
+{
+  COMP_LAYER_BACKGROUND = 0, // 背景图片
+  COMP_LAYER_VIDEO,          // 摄像头画面（显示线程绘制）
+  COMP_LAYER_OVERLAY,        // 按钮面板等覆盖层
+  COMP_LAYER_COUNT
+} comp_layer_t;
+
+/**
+ * @brief 初始化合成器（整屏标记为脏）
+ */
+void compositor_init(void);
+
+/**
+ * @brief 设置图片层内容，内容不变时不产生脏区
+ * @param layer COMP_LAYER_BACKGROUND 或 COMP_LAYER_OVERLAY
+ * @param bmp_file BMP文件名，NULL表示清空该层
+ * @param x 图片左上角x坐标
+ * @param y 图片左上角y坐标
+ * @param clip 该层只占用图片的这部分区域，NULL表示整张图片
+ */
+void compositor_set_image(comp_layer_t layer, const char *bmp_file, int x, int y, const lcd_rect_t *clip);
+
+/**
+ * @brief 开启/关闭视频层，开启时视频区域交给显示线程，并把块绘制裁剪到该区域
+ * @param enabled 非0开启
+ * @param rect 视频区域，开启时有效
+ */
+void compositor_set_video(int enabled, const lcd_rect_t *rect);
+
+/**
+ * @brief 标记一块区域需要重画
+ * @param rect 屏幕矩形，NULL表示整个屏幕
+ */
+void compositor_invalidate(const lcd_rect_t *rect);
+
+/**
+ * @brief 重画所有脏区并翻页，没有脏区时什么也不做
+ */
+void compositor_render(void);
+
+#endif // __COMPOSITOR_H__
@@ -0,0 +1,494 @@
+#include "delta_codec.h"
+#include "protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DELTA_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DELTA_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#define BLOCK_BYTES (DELTA_BLOCK * 2) // 一个整块每行的YUYV字节数
+
+// 整块(16x16)SAD，a和b的行跨度相同
+typedef unsigned int (*sad_fn)(const unsigned char *a, const unsigned char *b, int stride);
+
+struct delta_encoder
+{
+  int width;
+  int height;
+  int stride;       // 每行字节数
+  int blocks_x;
+  int blocks_y;
+  int threshold;
+  int key_interval;
+  int since_key;    // 距上一个关键帧的帧数
+  unsigned long long seq;
+  int have_ref;
+
+  unsigned char *ref;    // DELTA_HEADER_SIZE + 重建图像：重新同步时直接作为关键帧输出
+  unsigned char *out;    // 编码输出（关键帧或增量帧）
+  unsigned int out_capacity;
+};
+
+static sad_fn g_sad;
+static const char *g_sad_name = "c";
+static pthread_once_t g_sad_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief 标量SAD，也用于右/下边缘不足一整块的块
+ */
+static unsigned int sad_rect_c(const unsigned char *a, const unsigned char *b, int stride, int bytes, int rows)
+{
+  unsigned int sum = 0;
+  for (int y = 0; y < rows; y++)
+  {
+    for (int x = 0; x < bytes; x++)
+    {
+      int d = a[x] - b[x];
+      sum += d < 0 ? -d : d;
+    }
+    a += stride;
+    b += stride;
+  }
+  return sum;
+}
+
+static unsigned int sad_c(const unsigned char *a, const unsigned char *b, int stride)
+{
+  return sad_rect_c(a, b, stride, BLOCK_BYTES, DELTA_BLOCK);
+}
+
+#ifdef DELTA_HAVE_NEON
+/**
+ * @brief NEON SAD：逐字节差的绝对值累加到16位（每行两次vabal，16行不会溢出）
+ */
+static unsigned int sad_neon(const unsigned char *a, const unsigned char *b, int stride)
+{
+  uint16x8_t acc = vdupq_n_u16(0);
+  for (int y = 0; y < DELTA_BLOCK; y++)
+  {
+    uint8x16_t a0 = vld1q_u8(a);
+    uint8x16_t a1 = vld1q_u8(a + 16);
+    uint8x16_t b0 = vld1q_u8(b);
+    uint8x16_t b1 = vld1q_u8(b + 16);
+    acc = vpadalq_u8(acc, vabdq_u8(a0, b0));
+    acc = vpadalq_u8(acc, vabdq_u8(a1, b1));
+    a += stride;
+    b += stride;
+  }
+
+  uint32x4_t s32 = vpaddlq_u16(acc);
+  uint64x2_t s64 = vpaddlq_u32(s32);
+  return (unsigned int)(vgetq_lane_u64(s64, 0) + vgetq_lane_u64(s64, 1));
+}
+#endif // DELTA_HAVE_NEON
+
+#ifdef DELTA_HAVE_X86
+/**
+ * @brief SSE2 SAD：_mm_sad_epu8每16字节得到两个64位部分和
+ */
+__attribute__((target("sse2"))) static unsigned int sad_sse2(const unsigned char *a, const unsigned char *b, int stride)
+{
+  __m128i acc = _mm_setzero_si128();
+  for (int y = 0; y < DELTA_BLOCK; y++)
+  {
+    __m128i a0 = _mm_loadu_si128((const __m128i *)a);
+    __m128i a1 = _mm_loadu_si128((const __m128i *)(a + 16));
+    __m128i b0 = _mm_loadu_si128((const __m128i *)b);
+    __m128i b1 = _mm_loadu_si128((const __m128i *)(b + 16));
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(a0, b0));
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(a1, b1));
+    a += stride;
+    b += stride;
+  }
+
+  return (unsigned int)(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+}
+
+/**
+ * @brief AVX2 SAD：一行32字节一次完成
+ */
+__attribute__((target("avx2"))) static unsigned int sad_avx2(const unsigned char *a, const unsigned char *b, int stride)
+{
+  __m256i acc = _mm256_setzero_si256();
+  for (int y = 0; y < DELTA_BLOCK; y++)
+  {
+    __m256i va = _mm256_loadu_si256((const __m256i *)a);
+    __m256i vb = _mm256_loadu_si256((const __m256i *)b);
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(va, vb));
+    a += stride;
+    b += stride;
+  }
+
+  __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+  return (unsigned int)(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+}
+#endif // DELTA_HAVE_X86
+
+/**
+ * @brief 选择SAD内核（只执行一次），DELTA_KERNEL=c|sse2|avx2|neon 可强制指定
+ */
+static void select_sad(void)
+{
+  const char *force = getenv("DELTA_KERNEL");
+
+  g_sad = sad_c;
+
+#ifdef DELTA_HAVE_NEON
+  if (!force || strcmp(force, "neon") == 0)
+  {
+    g_sad = sad_neon;
+    g_sad_name = "neon";
+  }
+#endif
+
+#ifdef DELTA_HAVE_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && (!force || strcmp(force, "avx2") == 0))
+  {
+    g_sad = sad_avx2;
+    g_sad_name = "avx2";
+  }
+  else if (__builtin_cpu_supports("sse2") && (!force || strcmp(force, "sse2") == 0))
+  {
+    g_sad = sad_sse2;
+    g_sad_name = "sse2";
+  }
+#endif
+
+  (void)force;
+}
+
+/**
+ * @brief 写负载头
+ */
+static void put_header(unsigned char *out, unsigned int type, unsigned int blocks,
+                       unsigned long long seq, unsigned long long base_seq)
+{
+  out[0] = type;
+  out[1] = DELTA_BLOCK;
+  protocol_put_le16(out + 2, 0);
+  protocol_put_le32(out + 4, blocks);
+  protocol_put_le64(out + 8, seq);
+  protocol_put_le64(out + 16, base_seq);
+}
+
+/**
+ * @brief 创建编码器
+ */
+delta_encoder_t *delta_encoder_create(int width, int height, int threshold, int key_interval)
+{
+  if (width <= 0 || height <= 0 || (width & 1))
+  {
+    fprintf(stderr, "增量编码器不支持的分辨率: %dx%d\n", width, height);
+    return NULL;
+  }
+
+  delta_encoder_t *enc = (delta_encoder_t *)calloc(1, sizeof(delta_encoder_t));
+  if (!enc)
+  {
+    perror("malloc delta_encoder_t failed");
+    return NULL;
+  }
+
+  enc->width = width;
+  enc->height = height;
+  enc->stride = width * 2;
+  enc->blocks_x = (width + DELTA_BLOCK - 1) / DELTA_BLOCK;
+  enc->blocks_y = (height + DELTA_BLOCK - 1) / DELTA_BLOCK;
+  enc->threshold = threshold > 0 ? threshold : DELTA_THRESHOLD;
+  enc->key_interval = key_interval > 0 ? key_interval : DELTA_KEY_INTERVAL;
+
+  // 最坏情况（所有块都变化）比关键帧多一个位图，超过关键帧大小时改发关键帧
+  unsigned int frame_size = (unsigned int)enc->stride * height;
+  enc->out_capacity = DELTA_HEADER_SIZE + frame_size;
+  enc->ref = (unsigned char *)malloc(DELTA_HEADER_SIZE + frame_size);
+  enc->out = (unsigned char *)malloc(enc->out_capacity);
+  if (!enc->ref || !enc->out)
+  {
+    perror("malloc delta buffer failed");
+    delta_encoder_destroy(enc);
+    return NULL;
+  }
+
+  pthread_once(&g_sad_once, select_sad);
+  return enc;
+}
+
+/**
+ * @brief 销毁编码器
+ */
+void delta_encoder_destroy(delta_encoder_t *enc)
+{
+  if (!enc)
+  {
+    return;
+  }
+
+  free(enc->ref);
+  free(enc->out);
+  free(enc);
+}
+
+/**
+ * @brief 整帧替换重建图像并输出关键帧
+ */
+static int encode_key(delta_encoder_t *enc, const unsigned char *yuyv, unsigned long long seq,
+                      const unsigned char **out, unsigned int *out_size)
+{
+  unsigned int frame_size = (unsigned int)enc->stride * enc->height;
+
+  memcpy(enc->out + DELTA_HEADER_SIZE, yuyv, frame_size);
+  memcpy(enc->ref + DELTA_HEADER_SIZE, yuyv, frame_size);
+  put_header(enc->out, DELTA_TYPE_KEY, 0, seq, 0);
+
+  enc->seq = seq;
+  enc->have_ref = 1;
+  enc->since_key = 0;
+  *out = enc->out;
+  *out_size = DELTA_HEADER_SIZE + frame_size;
+  return DELTA_TYPE_KEY;
+}
+
+/**
+ * @brief 编码一帧
+ */
+int delta_encode_yuyv(delta_encoder_t *enc, const unsigned char *yuyv, unsigned long long seq,
+                      const unsigned char **out, unsigned int *out_size)
+{
+  if (!enc || !yuyv)
+  {
+    return -1;
+  }
+
+  if (!enc->have_ref || ++enc->since_key >= enc->key_interval)
+  {
+    return encode_key(enc, yuyv, seq, out, out_size);
+  }
+
+  unsigned char *recon = enc->ref + DELTA_HEADER_SIZE;
+  unsigned int nblocks = enc->blocks_x * enc->blocks_y;
+  unsigned int bitmap_size = (nblocks + 7) / 8;
+  unsigned char *bitmap = enc->out + DELTA_HEADER_SIZE;
+  unsigned char *p = bitmap + bitmap_size;
+  unsigned char *end = enc->out + enc->out_capacity;
+  unsigned int changed = 0;
+
+  memset(bitmap, 0, bitmap_size);
+
+  for (int by = 0; by < enc->blocks_y; by++)
+  {
+    int y0 = by * DELTA_BLOCK;
+    int rows = enc->height - y0 < DELTA_BLOCK ? enc->height - y0 : DELTA_BLOCK;
+
+    for (int bx = 0; bx < enc->blocks_x; bx++)
+    {
+      int x0 = bx * DELTA_BLOCK;
+      int bytes = (enc->width - x0 < DELTA_BLOCK ? enc->width - x0 : DELTA_BLOCK) * 2;
+      unsigned int offset = (unsigned int)y0 * enc->stride + x0 * 2;
+      const unsigned char *src = yuyv + offset;
+      unsigned char *dst = recon + offset;
+
+      // 边缘块按面积缩放阈值
+      unsigned int sad, threshold;
+      if (bytes == BLOCK_BYTES && rows == DELTA_BLOCK)
+      {
+        sad = g_sad(src, dst, enc->stride);
+        threshold = enc->threshold;
+      }
+      else
+      {
+        sad = sad_rect_c(src, dst, enc->stride, bytes, rows);
+        threshold = (unsigned int)enc->threshold * bytes * rows / (BLOCK_BYTES * DELTA_BLOCK);
+      }
+
+      if (sad <= threshold)
+      {
+        continue;
+      }
+
+      // 变化的块太多，增量帧比关键帧还大
+      if (p + bytes * rows > end)
+      {
+        return encode_key(enc, yuyv, seq, out, out_size);
+      }
+
+      unsigned int index = by * enc->blocks_x + bx;
+      bitmap[index >> 3] |= 1 << (index & 7);
+      for (int y = 0; y < rows; y++)
+      {
+        memcpy(p, src, bytes);
+        memcpy(dst, src, bytes);
+        p += bytes;
+        src += enc->stride;
+        dst += enc->stride;
+      }
+      changed++;
+    }
+  }
+
+  put_header(enc->out, DELTA_TYPE_DELTA, changed, seq, enc->seq);
+
+  // 更新重建图像的序号，之后的增量帧以本帧为参考
+  enc->seq = seq;
+  *out = enc->out;
+  *out_size = p - enc->out;
+  return DELTA_TYPE_DELTA;
+}
+
+/**
+ * @brief 把当前重建图像输出为关键帧
+ */
+int delta_encode_resync(delta_encoder_t *enc, const unsigned char **out, unsigned int *out_size)
+{
+  if (!enc || !enc->have_ref)
+  {
+    return -1;
+  }
+
+  put_header(enc->ref, DELTA_TYPE_KEY, 0, enc->seq, 0);
+  *out = enc->ref;
+  *out_size = DELTA_HEADER_SIZE + (unsigned int)enc->stride * enc->height;
+  return 0;
+}
+
+/**
+ * @brief 应用一帧负载
+ */
+int delta_decode(delta_decoder_t *dec, const unsigned char *payload, unsigned int size, int width, int height)
+{
+  if (size < DELTA_HEADER_SIZE || payload[1] != DELTA_BLOCK || width <= 0 || height <= 0 || (width & 1))
+  {
+    return -1;
+  }
+
+  unsigned int type = payload[0];
+  unsigned int blocks = protocol_get_le32(payload + 4);
+  unsigned long long seq = protocol_get_le64(payload + 8);
+  unsigned long long base_seq = protocol_get_le64(payload + 16);
+  unsigned int stride = (unsigned int)width * 2;
+  unsigned int frame_size = stride * height;
+  const unsigned char *p = payload + DELTA_HEADER_SIZE;
+  const unsigned char *end = payload + size;
+
+  if (type == DELTA_TYPE_KEY)
+  {
+    if (size - DELTA_HEADER_SIZE < frame_size)
+    {
+      return -1;
+    }
+
+    if (!dec->frame || dec->width != width || dec->height != height)
+    {
+      unsigned char *frame = (unsigned char *)realloc(dec->frame, frame_size);
+      if (!frame)
+      {
+        perror("malloc delta frame failed");
+        return -1;
+      }
+      dec->frame = frame;
+      dec->width = width;
+      dec->height = height;
+    }
+
+    memcpy(dec->frame, p, frame_size);
+    dec->seq = seq;
+    dec->valid = 1;
+    return 0;
+  }
+
+  if (type != DELTA_TYPE_DELTA)
+  {
+    return -1;
+  }
+
+  // 参考图像不对（丢过帧或还没收到关键帧）：跳过，直到下一个关键帧
+  if (!dec->valid || dec->seq != base_seq || dec->width != width || dec->height != height)
+  {
+    dec->valid = 0;
+    return 1;
+  }
+
+  int blocks_x = (width + DELTA_BLOCK - 1) / DELTA_BLOCK;
+  int blocks_y = (height + DELTA_BLOCK - 1) / DELTA_BLOCK;
+  unsigned int bitmap_size = (blocks_x * blocks_y + 7) / 8;
+  const unsigned char *bitmap = p;
+  if ((unsigned int)(end - p) < bitmap_size)
+  {
+    return -1;
+  }
+  p += bitmap_size;
+
+  unsigned int applied = 0;
+  for (int by = 0; by < blocks_y; by++)
+  {
+    int y0 = by * DELTA_BLOCK;
+    int rows = height - y0 < DELTA_BLOCK ? height - y0 : DELTA_BLOCK;
+
+    for (int bx = 0; bx < blocks_x; bx++)
+    {
+      unsigned int index = by * blocks_x + bx;
+      if (!(bitmap[index >> 3] & (1 << (index & 7))))
+      {
+        continue;
+      }
+
+      int x0 = bx * DELTA_BLOCK;
+      int bytes = (width - x0 < DELTA_BLOCK ? width - x0 : DELTA_BLOCK) * 2;
+      if (end - p < bytes * rows)
+      {
+        dec->valid = 0;
+        return -1;
+      }
+
+      unsigned char *dst = dec->frame + (unsigned int)y0 * stride + x0 * 2;
+      for (int y = 0; y < rows; y++)
+      {
+        memcpy(dst, p, bytes);
+        p += bytes;
+        dst += stride;
+      }
+      applied++;
+    }
+  }
+
+  if (applied != blocks)
+  {
+    dec->valid = 0;
+    return -1;
+  }
+
+  dec->seq = seq;
+  return 0;
+}
+
+/**
+ * @brief 释放解码端状态
+ */
+void delta_decoder_free(delta_decoder_t *dec)
+{
+  if (!dec)
+  {
+    return;
+  }
+
+  free(dec->frame);
+  memset(dec, 0, sizeof(*dec));
+}
+
+/**
+ * @brief 返回当前选用的SAD内核名称
+ */
+const char *delta_kernel_name(void)
+{
+  pthread_once(&g_sad_once, select_sad);
+  return g_sad_name;
+}
@@ -0,0 +1,94 @@
+#ifndef __DELTA_CODEC_H__
+#define __DELTA_CODEC_H__
+
+/*
+ * YUYV块级帧间增量编码（FRAME_FORMAT_YUYV_DELTA），用于低带宽直播：
+ * 编码器保存客户端应有的重建图像，每帧按16x16块与重建图像比较SAD(NEON/SSE2/AVX2)，
+ * 只发送变化超过阈值的块并更新重建图像；每隔固定帧数发送一次完整关键帧。
+ *
+ * 负载格式（所有字段小端）：
+ *   0  type u8（DELTA_TYPE_KEY/DELTA_TYPE_DELTA）  1  block u8（块边长，像素）  2  reserved u16
+ *   4  blocks u32（增量帧中变化的块数）
+ *   8  seq u64（解码后图像的序号）                 16 base_seq u64（增量帧依赖的图像序号）
+ *   24 关键帧：整帧YUYV（width*height*2字节）
+ *      增量帧：按光栅顺序每块1位的位图，之后是变化块的YUYV数据（逐行，右/下边缘的块按实际大小裁剪）
+ * 增量帧只有在解码端当前图像序号等于base_seq时才能应用，否则必须等下一个关键帧。
+ */
+
+#define DELTA_HEADER_SIZE 24
+#define DELTA_BLOCK 16 // 块边长（像素）
+
+#define DELTA_TYPE_KEY 0
+#define DELTA_TYPE_DELTA 1
+
+#define DELTA_THRESHOLD 1536   // 整块SAD阈值（16x16块512字节，平均每字节差3）
+#define DELTA_KEY_INTERVAL 150 // 关键帧间隔（帧）
+
+typedef struct delta_encoder delta_encoder_t;
+
+// 解码端状态（调用者置零后使用，delta_decoder_free释放）
+typedef struct
+{
+  int width;
+  int height;
+  unsigned char *frame;   // 当前完整图像（YUYV）
+  unsigned long long seq; // frame对应的序号
+  int valid;              // 是否已收到关键帧
+} delta_decoder_t;
+
+/**
+ * @brief 创建编码器
+ * @param width 图像宽度（偶数）
+ * @param height 图像高度
+ * @param threshold 整块SAD阈值，<=0使用DELTA_THRESHOLD
+ * @param key_interval 关键帧间隔（帧），<=0使用DELTA_KEY_INTERVAL
+ * @return 成功返回编码器，失败返回NULL
+ */
+delta_encoder_t *delta_encoder_create(int width, int height, int threshold, int key_interval);
+
+/**
+ * @brief 销毁编码器
+ */
+void delta_encoder_destroy(delta_encoder_t *enc);
+
+/**
+ * @brief 编码一帧（与重建图像比较，必要时输出关键帧）
+ * @param enc 编码器
+ * @param yuyv YUYV数据，每行width*2字节
+ * @param seq 本帧序号（递增）
+ * @param out 输出负载指针，指向编码器内部缓冲区，下次调用前有效
+ * @param out_size 输出负载大小
+ * @return 成功返回DELTA_TYPE_KEY或DELTA_TYPE_DELTA，失败返回-1
+ */
+int delta_encode_yuyv(delta_encoder_t *enc, const unsigned char *yuyv, unsigned long long seq,
+                      const unsigned char **out, unsigned int *out_size);
+
+/**
+ * @brief 把当前重建图像输出为关键帧（给新连接或丢过帧的客户端重新同步）
+ *        输出与delta_encode_yuyv的输出使用不同缓冲区，可同时有效
+ * @return 成功返回0，还没有编码过任何帧返回-1
+ */
+int delta_encode_resync(delta_encoder_t *enc, const unsigned char **out, unsigned int *out_size);
+
+/**
+ * @brief 应用一帧负载
+ * @param dec 解码端状态
+ * @param payload 负载
+ * @param size 负载大小
+ * @param width 图像宽度（来自包头）
+ * @param height 图像高度
+ * @return 0表示dec->frame是完整图像；1表示缺少参考图像，已跳过（等待关键帧）；-1表示数据错误
+ */
+int delta_decode(delta_decoder_t *dec, const unsigned char *payload, unsigned int size, int width, int height);
+
+/**
+ * @brief 释放解码端状态
+ */
+void delta_decoder_free(delta_decoder_t *dec);
+
+/**
+ * @brief 返回当前选用的SAD内核名称
+ */
+const char *delta_kernel_name(void);
+
+#endif // __DELTA_CODEC_H__
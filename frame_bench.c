@@ -0,0 +1,205 @@
+#include "frame_bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/**
+ * @brief 初始化
+ */
+void frame_bench_init(frame_bench_t *bench)
+{
+  memset(bench, 0, sizeof(*bench));
+}
+
+/**
+ * @brief 记录一帧
+ */
+int frame_bench_add(frame_bench_t *bench, unsigned long long arrival_us, unsigned int bytes, long long latency_us)
+{
+  if (bench->count == bench->capacity)
+  {
+    unsigned int capacity = bench->capacity ? bench->capacity * 2 : 4096;
+    bench_sample_t *samples = realloc(bench->samples, capacity * sizeof(bench_sample_t));
+    if (!samples)
+    {
+      perror("malloc失败");
+      return -1;
+    }
+    bench->samples = samples;
+    bench->capacity = capacity;
+  }
+
+  bench_sample_t *sample = &bench->samples[bench->count++];
+  sample->arrival_us = arrival_us;
+  sample->latency_us = latency_us;
+  sample->bytes = bytes;
+  return 0;
+}
+
+static int compare_ll(const void *a, const void *b)
+{
+  long long x = *(const long long *)a;
+  long long y = *(const long long *)b;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief 已排序数组的分位数（最近秩）
+ */
+static long long percentile(const long long *sorted, unsigned int count, double p)
+{
+  unsigned int rank = (unsigned int)(p * count);
+  if (rank < p * count)
+  {
+    rank++;
+  }
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/**
+ * @brief 取出到达间隔和已知的延迟并排序
+ * @param intervals 输出到达间隔，count-1个
+ * @param latencies 输出延迟
+ * @return 已知延迟的帧数
+ */
+static unsigned int collect(const frame_bench_t *bench, long long *intervals, long long *latencies)
+{
+  unsigned int known = 0;
+
+  for (unsigned int i = 0; i < bench->count; i++)
+  {
+    if (i > 0)
+    {
+      intervals[i - 1] = (long long)(bench->samples[i].arrival_us - bench->samples[i - 1].arrival_us);
+    }
+    if (bench->samples[i].latency_us >= 0)
+    {
+      latencies[known++] = bench->samples[i].latency_us;
+    }
+  }
+
+  qsort(intervals, bench->count - 1, sizeof(long long), compare_ll);
+  qsort(latencies, known, sizeof(long long), compare_ll);
+  return known;
+}
+
+/**
+ * @brief 打印吞吐量、抖动和延迟分位数
+ */
+void frame_bench_report(const frame_bench_t *bench)
+{
+  if (bench->count < 2)
+  {
+    printf("  基准测试: 收到 %u 帧，不足以统计\n", bench->count);
+    return;
+  }
+
+  long long *intervals = malloc(sizeof(long long) * bench->count * 2);
+  if (!intervals)
+  {
+    perror("malloc失败");
+    return;
+  }
+  long long *latencies = intervals + bench->count;
+  unsigned int known = collect(bench, intervals, latencies);
+  unsigned int n = bench->count - 1;
+
+  // 吞吐量按第一帧收完之后的帧计算
+  double seconds = (bench->samples[n].arrival_us - bench->samples[0].arrival_us) / 1000000.0;
+  unsigned long long bytes = 0;
+  for (unsigned int i = 1; i < bench->count; i++)
+  {
+    bytes += bench->samples[i].bytes;
+  }
+
+  // 抖动：到达间隔的标准差
+  double mean = 0, variance = 0;
+  for (unsigned int i = 0; i < n; i++)
+  {
+    mean += intervals[i];
+  }
+  mean /= n;
+  for (unsigned int i = 0; i < n; i++)
+  {
+    variance += (intervals[i] - mean) * (intervals[i] - mean);
+  }
+
+  printf("  基准测试: %u 帧, 用时 %.2f 秒\n", bench->count, seconds);
+  if (seconds > 0)
+  {
+    printf("  吞吐量: %.1f fps, %.2f MB/s\n", n / seconds, bytes / seconds / (1024.0 * 1024.0));
+  }
+  printf("  到达间隔: 平均 %.2f ms, 抖动(标准差) %.2f ms, p99 %.2f ms, 最大 %.2f ms\n", mean / 1000.0,
+         sqrt(variance / n) / 1000.0, percentile(intervals, n, 0.99) / 1000.0, intervals[n - 1] / 1000.0);
+  if (known > 0)
+  {
+    printf("  延迟(采集->收到, %u 帧): p50 %.2f ms, p99 %.2f ms, 最大 %.2f ms\n", known,
+           percentile(latencies, known, 0.50) / 1000.0, percentile(latencies, known, 0.99) / 1000.0,
+           latencies[known - 1] / 1000.0);
+  }
+  else
+  {
+    printf("  延迟: 没有采集时间或时钟偏移（需要v2服务器的HELLO回复），不统计\n");
+  }
+
+  free(intervals);
+}
+
+/**
+ * @brief 值所在的桶
+ */
+static unsigned int bucket_of(long long us)
+{
+  long long bucket = us / BENCH_BUCKET_US;
+  if (bucket < 0)
+  {
+    return 0;
+  }
+  return bucket < BENCH_BUCKETS ? (unsigned int)bucket : BENCH_BUCKETS - 1;
+}
+
+/**
+ * @brief 打印CSV直方图的数据行
+ */
+void frame_bench_print_csv(const frame_bench_t *bench, const char *name)
+{
+  unsigned int latency[BENCH_BUCKETS];
+  unsigned int interval[BENCH_BUCKETS];
+  int last = -1;
+
+  memset(latency, 0, sizeof(latency));
+  memset(interval, 0, sizeof(interval));
+  for (unsigned int i = 0; i < bench->count; i++)
+  {
+    const bench_sample_t *sample = &bench->samples[i];
+    unsigned int b;
+
+    if (sample->latency_us >= 0)
+    {
+      b = bucket_of(sample->latency_us);
+      latency[b]++;
+      last = (int)b > last ? (int)b : last;
+    }
+    if (i > 0)
+    {
+      b = bucket_of((long long)(sample->arrival_us - bench->samples[i - 1].arrival_us));
+      interval[b]++;
+      last = (int)b > last ? (int)b : last;
+    }
+  }
+
+  for (int b = 0; b <= last; b++)
+  {
+    printf("%s,%d,%u,%u\n", name, b * BENCH_BUCKET_US / 1000, latency[b], interval[b]);
+  }
+}
+
+/**
+ * @brief 释放记录
+ */
+void frame_bench_free(frame_bench_t *bench)
+{
+  free(bench->samples);
+  memset(bench, 0, sizeof(*bench));
+}
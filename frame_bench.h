@@ -0,0 +1,60 @@
+#ifndef __FRAME_BENCH_H__
+#define __FRAME_BENCH_H__
+
+/*
+ * 客户端基准测试（video_client --bench 使用）：记录每帧收完的时间、字节数和采集->收到的延迟，
+ * 退出时统计吞吐量（MB/s、fps）、到达间隔的抖动、延迟的p50/p99/最大值，并输出CSV直方图。
+ * 延迟需要v2包头的采集时间和HELLO回复中的时钟偏移；服务器在另一台机器上时依赖两端时钟同步。
+ */
+
+#define BENCH_BUCKET_US 1000 // 直方图桶宽
+#define BENCH_BUCKETS 250    // 最后一个桶包含所有更大的值
+
+// 一帧的记录
+typedef struct
+{
+  unsigned long long arrival_us; // 收完的时间（本地单调时钟）
+  long long latency_us;          // 采集->收到，没有时钟信息时为-1
+  unsigned int bytes;            // 包头 + 图像数据
+} bench_sample_t;
+
+typedef struct
+{
+  bench_sample_t *samples;
+  unsigned int count;
+  unsigned int capacity;
+} frame_bench_t;
+
+/**
+ * @brief 初始化
+ */
+void frame_bench_init(frame_bench_t *bench);
+
+/**
+ * @brief 记录一帧
+ * @param bench 统计
+ * @param arrival_us 收完的时间（单调时钟，微秒）
+ * @param bytes 字节数
+ * @param latency_us 采集->收到的延迟，-1表示未知
+ * @return 成功返回0，内存不足返回-1
+ */
+int frame_bench_add(frame_bench_t *bench, unsigned long long arrival_us, unsigned int bytes, long long latency_us);
+
+/**
+ * @brief 打印吞吐量、抖动和延迟分位数
+ */
+void frame_bench_report(const frame_bench_t *bench);
+
+/**
+ * @brief 打印CSV直方图的数据行：名称,桶下限(ms),延迟帧数,到达间隔帧数（只输出到最后一个非空的桶）
+ * @param bench 统计
+ * @param name 第一列的名称（服务器）
+ */
+void frame_bench_print_csv(const frame_bench_t *bench, const char *name);
+
+/**
+ * @brief 释放记录
+ */
+void frame_bench_free(frame_bench_t *bench);
+
+#endif // __FRAME_BENCH_H__
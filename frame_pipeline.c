@@ -0,0 +1,160 @@
+#include "frame_pipeline.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief 初始化流水线并预分配缓冲区
+ */
+int frame_pipeline_init(frame_pipeline_t *pipeline, int slot_count, unsigned int slot_size)
+{
+  memset(pipeline, 0, sizeof(*pipeline));
+  if (slot_count < 1 || slot_count > FRAME_PIPELINE_MAX_SLOTS)
+  {
+    fprintf(stderr, "缓冲区个数 %d 无效 (1~%d)\n", slot_count, FRAME_PIPELINE_MAX_SLOTS);
+    return -1;
+  }
+
+  for (int i = 0; i < slot_count; i++)
+  {
+    frame_slot_t *slot = &pipeline->slots[i];
+    if (frame_slot_reserve(slot, slot_size) < 0)
+    {
+      frame_pipeline_destroy(pipeline);
+      return -1;
+    }
+    pipeline->free_slots[i] = slot;
+  }
+
+  pipeline->slot_count = slot_count;
+  pipeline->free_count = slot_count;
+  pthread_mutex_init(&pipeline->mutex, NULL);
+  pthread_cond_init(&pipeline->cond, NULL);
+  return 0;
+}
+
+/**
+ * @brief 释放所有缓冲区
+ */
+void frame_pipeline_destroy(frame_pipeline_t *pipeline)
+{
+  for (int i = 0; i < FRAME_PIPELINE_MAX_SLOTS; i++)
+  {
+    free(pipeline->slots[i].data);
+    pipeline->slots[i].data = NULL;
+    pipeline->slots[i].capacity = 0;
+  }
+
+  if (pipeline->slot_count > 0)
+  {
+    pthread_mutex_destroy(&pipeline->mutex);
+    pthread_cond_destroy(&pipeline->cond);
+    pipeline->slot_count = 0;
+  }
+}
+
+/**
+ * @brief 取一个空闲缓冲区
+ */
+frame_slot_t *frame_pipeline_acquire(frame_pipeline_t *pipeline)
+{
+  frame_slot_t *slot = NULL;
+
+  pthread_mutex_lock(&pipeline->mutex);
+  if (pipeline->free_count > 0)
+  {
+    slot = pipeline->free_slots[--pipeline->free_count];
+  }
+  else
+  {
+    pipeline->dropped++;
+  }
+  pthread_mutex_unlock(&pipeline->mutex);
+  return slot;
+}
+
+/**
+ * @brief 保证缓冲区至少有size字节
+ */
+int frame_slot_reserve(frame_slot_t *slot, unsigned int size)
+{
+  if (size > slot->capacity)
+  {
+    unsigned char *data = realloc(slot->data, size);
+    if (!data)
+    {
+      perror("malloc失败");
+      return -1;
+    }
+    slot->data = data;
+    slot->capacity = size;
+  }
+  return 0;
+}
+
+/**
+ * @brief 把收好的帧放入队列
+ */
+int frame_pipeline_submit(frame_pipeline_t *pipeline, frame_slot_t *slot)
+{
+  pthread_mutex_lock(&pipeline->mutex);
+
+  // 队列槽位与缓冲区一一对应，不会溢出
+  pipeline->queue[(pipeline->head + pipeline->count) % pipeline->slot_count] = slot;
+  pipeline->count++;
+  pipeline->queued++;
+
+  // 正在保存的帧也占着缓冲区，一起算作队列深度：深度到达slot_count时开始丢帧
+  int depth = pipeline->slot_count - pipeline->free_count;
+  if (depth > pipeline->max_depth)
+  {
+    pipeline->max_depth = depth;
+  }
+
+  pthread_cond_signal(&pipeline->cond);
+  pthread_mutex_unlock(&pipeline->mutex);
+  return depth;
+}
+
+/**
+ * @brief 取下一帧
+ */
+frame_slot_t *frame_pipeline_take(frame_pipeline_t *pipeline)
+{
+  frame_slot_t *slot = NULL;
+
+  pthread_mutex_lock(&pipeline->mutex);
+  while (pipeline->count == 0 && !pipeline->closed)
+  {
+    pthread_cond_wait(&pipeline->cond, &pipeline->mutex);
+  }
+  if (pipeline->count > 0)
+  {
+    slot = pipeline->queue[pipeline->head];
+    pipeline->head = (pipeline->head + 1) % pipeline->slot_count;
+    pipeline->count--;
+  }
+  pthread_mutex_unlock(&pipeline->mutex);
+  return slot;
+}
+
+/**
+ * @brief 把缓冲区还回缓冲池
+ */
+void frame_pipeline_release(frame_pipeline_t *pipeline, frame_slot_t *slot)
+{
+  pthread_mutex_lock(&pipeline->mutex);
+  pipeline->free_slots[pipeline->free_count++] = slot;
+  pthread_mutex_unlock(&pipeline->mutex);
+}
+
+/**
+ * @brief 关闭队列
+ */
+void frame_pipeline_close(frame_pipeline_t *pipeline)
+{
+  pthread_mutex_lock(&pipeline->mutex);
+  pipeline->closed = 1;
+  pthread_cond_broadcast(&pipeline->cond);
+  pthread_mutex_unlock(&pipeline->mutex);
+}
@@ -0,0 +1,95 @@
+#ifndef __FRAME_PIPELINE_H__
+#define __FRAME_PIPELINE_H__
+
+#include <pthread.h>
+#include "protocol.h"
+
+/*
+ * 客户端的接收/保存流水线（video_client.c使用）：
+ * 接收线程从缓冲池取一个空闲帧缓冲区，把整帧直接收进去后放入队列；
+ * 保存线程从队列取帧，转换格式、写盘后把缓冲区还回缓冲池。
+ * 缓冲池在启动时一次分配好，池的大小就是队列的上限；
+ * 写盘跟不上时池中没有空闲缓冲区，接收线程把这一帧读出后丢弃而不是等待，
+ * socket始终按线路速率读空，不会因为磁盘慢而在服务器端积压。
+ */
+
+#define FRAME_PIPELINE_SLOTS 8  // 默认缓冲区个数（队列上限）
+#define FRAME_PIPELINE_MAX_SLOTS 64
+
+// 一个帧缓冲区
+typedef struct
+{
+  protocol_frame_t header;
+  unsigned char *data;
+  unsigned int capacity;
+  int frame_num;          // 接收序号（保存的文件名）
+  int source;             // 来源（多个服务器时的连接编号）
+  unsigned long long recv_us; // 收到的时间（本地单调时钟，微秒）
+} frame_slot_t;
+
+typedef struct
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  frame_slot_t slots[FRAME_PIPELINE_MAX_SLOTS];
+  frame_slot_t *free_slots[FRAME_PIPELINE_MAX_SLOTS]; // 空闲缓冲区（栈）
+  int free_count;
+  frame_slot_t *queue[FRAME_PIPELINE_MAX_SLOTS];      // 待保存的帧（环形队列）
+  int head;
+  int count;
+  int slot_count;
+  int closed;
+  unsigned long long queued;  // 入队总数
+  unsigned long long dropped; // 没有空闲缓冲区而丢弃的帧数
+  int max_depth;              // 最大队列深度（排队和正在保存的帧）
+} frame_pipeline_t;
+
+/**
+ * @brief 初始化流水线并预分配缓冲区
+ * @param pipeline 流水线
+ * @param slot_count 缓冲区个数（1~FRAME_PIPELINE_MAX_SLOTS）
+ * @param slot_size 每个缓冲区的初始字节数，帧更大时按需扩容
+ * @return 成功返回0，失败返回-1
+ */
+int frame_pipeline_init(frame_pipeline_t *pipeline, int slot_count, unsigned int slot_size);
+
+/**
+ * @brief 释放所有缓冲区（保存线程都已退出后调用）
+ */
+void frame_pipeline_destroy(frame_pipeline_t *pipeline);
+
+/**
+ * @brief 取一个空闲缓冲区（接收线程调用，不阻塞）
+ * @return 没有空闲缓冲区时计一次丢帧并返回NULL
+ */
+frame_slot_t *frame_pipeline_acquire(frame_pipeline_t *pipeline);
+
+/**
+ * @brief 保证缓冲区至少有size字节
+ * @return 成功返回0，失败返回-1（原数据保留）
+ */
+int frame_slot_reserve(frame_slot_t *slot, unsigned int size);
+
+/**
+ * @brief 把收好的帧放入队列，唤醒一个保存线程
+ * @return 入队后的队列深度（排队和正在保存的帧数）
+ */
+int frame_pipeline_submit(frame_pipeline_t *pipeline, frame_slot_t *slot);
+
+/**
+ * @brief 取下一帧（保存线程调用），队列为空时等待
+ * @return 队列关闭且已取空时返回NULL
+ */
+frame_slot_t *frame_pipeline_take(frame_pipeline_t *pipeline);
+
+/**
+ * @brief 把缓冲区还回缓冲池
+ */
+void frame_pipeline_release(frame_pipeline_t *pipeline, frame_slot_t *slot);
+
+/**
+ * @brief 关闭队列：不再有新帧，保存线程取完剩余的帧后退出
+ */
+void frame_pipeline_close(frame_pipeline_t *pipeline);
+
+#endif // __FRAME_PIPELINE_H__
@@ -0,0 +1,188 @@
+#include "frame_queue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief 分配并填好包头
+ */
+static frame_packet_t *packet_new(const void *header, unsigned int header_size, unsigned int data_size)
+{
+  if (header_size > FRAME_PACKET_HEADER_MAX)
+  {
+    fprintf(stderr, "包头过大: %u\n", header_size);
+    return NULL;
+  }
+
+  frame_packet_t *packet = (frame_packet_t *)malloc(sizeof(frame_packet_t) + data_size);
+  if (!packet)
+  {
+    perror("malloc frame_packet_t failed");
+    return NULL;
+  }
+
+  packet->refcount = 1;
+  packet->is_snapshot = 0;
+  packet->is_ctrl = 0;
+  packet->header_size = header_size;
+  memcpy(packet->header, header, header_size);
+  packet->release = NULL;
+  packet->release_owner = NULL;
+  packet->release_data = NULL;
+  return packet;
+}
+
+/**
+ * @brief 分配数据包
+ */
+frame_packet_t *frame_packet_alloc(const void *header, unsigned int header_size, unsigned int payload_size)
+{
+  frame_packet_t *packet = packet_new(header, header_size, payload_size);
+  if (!packet)
+  {
+    return NULL;
+  }
+
+  packet->payload = packet->data;
+  packet->payload_size = payload_size;
+  packet->size = header_size + payload_size;
+  return packet;
+}
+
+/**
+ * @brief 创建借用外部图像数据的数据包
+ */
+frame_packet_t *frame_packet_wrap(const void *header, unsigned int header_size,
+                                  const unsigned char *payload, unsigned int payload_size,
+                                  frame_release_func release, void *owner, void *data)
+{
+  frame_packet_t *packet = packet_new(header, header_size, 0);
+  if (!packet)
+  {
+    return NULL;
+  }
+
+  packet->payload = payload;
+  packet->payload_size = payload_size;
+  packet->size = header_size + payload_size;
+  packet->release = release;
+  packet->release_owner = owner;
+  packet->release_data = data;
+  return packet;
+}
+
+/**
+ * @brief 增加数据包引用
+ */
+frame_packet_t *frame_packet_ref(frame_packet_t *packet)
+{
+  __sync_fetch_and_add(&packet->refcount, 1);
+  return packet;
+}
+
+/**
+ * @brief 释放数据包引用
+ */
+void frame_packet_unref(frame_packet_t *packet)
+{
+  if (packet && __sync_sub_and_fetch(&packet->refcount, 1) == 0)
+  {
+    if (packet->release)
+    {
+      packet->release(packet->release_owner, packet->release_data);
+    }
+    free(packet);
+  }
+}
+
+/**
+ * @brief 初始化发送队列
+ */
+void frame_queue_init(frame_queue_t *queue)
+{
+  memset(queue, 0, sizeof(frame_queue_t));
+  pthread_mutex_init(&queue->mutex, NULL);
+}
+
+/**
+ * @brief 销毁发送队列
+ */
+void frame_queue_destroy(frame_queue_t *queue)
+{
+  for (int i = 0; i < queue->count; i++)
+  {
+    frame_packet_unref(queue->items[(queue->head + i) % FRAME_QUEUE_LEN]);
+  }
+  queue->count = 0;
+
+  pthread_mutex_destroy(&queue->mutex);
+}
+
+/**
+ * @brief 数据包入队，队列满时丢弃最旧的直播帧
+ */
+int frame_queue_push(frame_queue_t *queue, frame_packet_t *packet)
+{
+  frame_packet_t *drop = NULL;
+
+  pthread_mutex_lock(&queue->mutex);
+  if (queue->count == FRAME_QUEUE_LEN)
+  {
+    // 找最旧的直播帧，全是截屏时丢最旧的
+    int victim = 0;
+    for (int i = 0; i < queue->count; i++)
+    {
+      if (!queue->items[(queue->head + i) % FRAME_QUEUE_LEN]->is_snapshot)
+      {
+        victim = i;
+        break;
+      }
+    }
+
+    drop = queue->items[(queue->head + victim) % FRAME_QUEUE_LEN];
+    for (int i = victim; i > 0; i--) // 把它前面的包后移一格
+    {
+      queue->items[(queue->head + i) % FRAME_QUEUE_LEN] = queue->items[(queue->head + i - 1) % FRAME_QUEUE_LEN];
+    }
+    queue->head = (queue->head + 1) % FRAME_QUEUE_LEN;
+    queue->count--;
+    queue->dropped++;
+  }
+
+  queue->items[(queue->head + queue->count) % FRAME_QUEUE_LEN] = frame_packet_ref(packet);
+  queue->count++;
+  pthread_mutex_unlock(&queue->mutex);
+
+  frame_packet_unref(drop);
+  return drop ? 1 : 0;
+}
+
+/**
+ * @brief 队列是否已满
+ */
+int frame_queue_full(frame_queue_t *queue)
+{
+  pthread_mutex_lock(&queue->mutex);
+  int full = queue->count == FRAME_QUEUE_LEN;
+  pthread_mutex_unlock(&queue->mutex);
+  return full;
+}
+
+/**
+ * @brief 取出队首数据包，队列为空时返回NULL
+ */
+frame_packet_t *frame_queue_pop(frame_queue_t *queue)
+{
+  frame_packet_t *packet = NULL;
+
+  pthread_mutex_lock(&queue->mutex);
+  if (queue->count > 0)
+  {
+    packet = queue->items[queue->head];
+    queue->head = (queue->head + 1) % FRAME_QUEUE_LEN;
+    queue->count--;
+  }
+  pthread_mutex_unlock(&queue->mutex);
+
+  return packet;
+}
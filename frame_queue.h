@@ -0,0 +1,96 @@
+#ifndef __FRAME_QUEUE_H__
+#define __FRAME_QUEUE_H__
+
+#include <pthread.h>
+
+#define FRAME_QUEUE_LEN 4         // 每个客户端最多排队的帧数
+#define FRAME_PACKET_HEADER_MAX 64 // 包头最大字节数
+
+// 借用的图像数据的释放回调
+typedef void (*frame_release_func)(void *owner, void *data);
+
+// 待发送的数据包（包头 + 图像数据，用sendmsg一次发出），一帧只编码/序列化一次，
+// 所有客户端共享同一个包，引用计数归零时释放。
+// 图像数据可以放在包自带的data中，也可以直接借用摄像头缓冲区（零拷贝）
+typedef struct
+{
+  int refcount;                                 // 引用计数（原子操作）
+  int is_snapshot;                              // 截屏包：队列满时优先丢弃直播帧
+  int is_ctrl;                                  // 控制消息：header是控制消息头，原样发送（只发给v2客户端）
+  unsigned int size;                            // 总字节数（包头 + 图像数据）
+  unsigned int header_size;
+  unsigned char header[FRAME_PACKET_HEADER_MAX];
+  const unsigned char *payload;                 // 图像数据（指向data或借用的缓冲区）
+  unsigned int payload_size;
+  frame_release_func release;                   // 借用缓冲区的释放回调，NULL表示payload在data中
+  void *release_owner;
+  void *release_data;
+  unsigned char data[];
+} frame_packet_t;
+
+// 单个客户端的有界发送队列（非阻塞环形队列）：满时丢弃最旧的帧，慢客户端不会拖慢采集和其它客户端。
+// 采集/广播线程入队，只有网络事件线程出队，出队不等待（socket可写时由epoll驱动）
+typedef struct
+{
+  pthread_mutex_t mutex;
+  frame_packet_t *items[FRAME_QUEUE_LEN];
+  int head;
+  int count;
+  unsigned long long dropped; // 因队列满被丢弃的帧数
+} frame_queue_t;
+
+/**
+ * @brief 分配数据包（引用计数为1），图像数据由调用者写入packet->data
+ * @param header 包头
+ * @param header_size 包头大小（不超过FRAME_PACKET_HEADER_MAX）
+ * @param payload_size 图像数据大小
+ * @return 成功返回数据包，失败返回NULL
+ */
+frame_packet_t *frame_packet_alloc(const void *header, unsigned int header_size, unsigned int payload_size);
+
+/**
+ * @brief 创建借用外部图像数据的数据包（不拷贝），引用计数归零时调用release(owner, data)
+ * @return 成功返回数据包，失败返回NULL（此时不会调用release）
+ */
+frame_packet_t *frame_packet_wrap(const void *header, unsigned int header_size,
+                                  const unsigned char *payload, unsigned int payload_size,
+                                  frame_release_func release, void *owner, void *data);
+
+/**
+ * @brief 增加数据包引用
+ */
+frame_packet_t *frame_packet_ref(frame_packet_t *packet);
+
+/**
+ * @brief 释放数据包引用，归零时释放内存
+ */
+void frame_packet_unref(frame_packet_t *packet);
+
+/**
+ * @brief 初始化发送队列
+ */
+void frame_queue_init(frame_queue_t *queue);
+
+/**
+ * @brief 销毁发送队列（释放仍在排队的数据包）
+ */
+void frame_queue_destroy(frame_queue_t *queue);
+
+/**
+ * @brief 数据包入队（队列持有一个新引用），队列满时丢弃最旧的直播帧
+ * @return 返回0，丢弃了一个旧包时返回1
+ */
+int frame_queue_push(frame_queue_t *queue, frame_packet_t *packet);
+
+/**
+ * @brief 队列是否已满（再入队会丢弃旧包）
+ */
+int frame_queue_full(frame_queue_t *queue);
+
+/**
+ * @brief 取出队首数据包（调用者负责unref），不等待
+ * @return 成功返回数据包，队列为空返回NULL
+ */
+frame_packet_t *frame_queue_pop(frame_queue_t *queue);
+
+#endif // __FRAME_QUEUE_H__
@@ -0,0 +1,493 @@
+#define _GNU_SOURCE // fallocate
+#include "frame_recorder.h"
+#include "jpeg_tables.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+#define AVI_HEADER_SIZE 224 // RIFF头 + hdrl(avih, strl(strh, strf)) + movi的LIST头
+#define AVI_MOVI_OFFSET 220 // 'movi'标记的位置，idx1中的偏移相对于这里
+#define AVI_HEADER_AVIH 24
+#define AVI_HEADER_STRH 100
+#define AVI_HEADER_STRF 164
+#define AVIF_HASINDEX 0x10
+#define AVIIF_KEYFRAME 0x10
+#define Y4M_HEADER_MAX 96
+#define DEFAULT_FRAME_US 33333 // 时间戳不足两帧时按30fps
+
+/**
+ * @brief 初始化录像
+ */
+void frame_recorder_init(frame_recorder_t *recorder, const char *prefix)
+{
+  memset(recorder, 0, sizeof(*recorder));
+  recorder->prefix = prefix;
+  recorder->fd = -1;
+}
+
+/**
+ * @brief 写入一组数据（处理部分写入），更新文件长度
+ */
+static int write_iov(frame_recorder_t *recorder, struct iovec *iov, int count)
+{
+  while (count > 0)
+  {
+    ssize_t n = writev(recorder->fd, iov, count);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      perror("写录像文件失败");
+      return -1;
+    }
+    recorder->offset += n;
+
+    while (count > 0 && (size_t)n >= iov->iov_len)
+    {
+      n -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0)
+    {
+      iov->iov_base = (char *)iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief 保证文件至少预分配到end（不改变文件长度），文件系统不支持时不再尝试
+ */
+static void preallocate(frame_recorder_t *recorder, unsigned long long end)
+{
+  if (!recorder->prealloc || end <= recorder->allocated)
+  {
+    return;
+  }
+
+  unsigned long long len = (end - recorder->allocated + RECORD_PREALLOC - 1) / RECORD_PREALLOC * RECORD_PREALLOC;
+  if (fallocate(recorder->fd, FALLOC_FL_KEEP_SIZE, recorder->allocated, len) < 0)
+  {
+    recorder->prealloc = 0;
+    return;
+  }
+  recorder->allocated += len;
+}
+
+/**
+ * @brief 按时间戳计算平均帧间隔（微秒）
+ */
+static unsigned int frame_interval_us(const frame_recorder_t *recorder)
+{
+  if (recorder->frames < 2)
+  {
+    return DEFAULT_FRAME_US;
+  }
+
+  unsigned long long first = recorder->index[0].timestamp_us;
+  unsigned long long last = recorder->index[recorder->frames - 1].timestamp_us;
+  if (last <= first)
+  {
+    return DEFAULT_FRAME_US;
+  }
+  unsigned long long interval = (last - first) / (recorder->frames - 1);
+  return interval > 0 ? (unsigned int)interval : 1;
+}
+
+/**
+ * @brief 编码Y4M文件头（帧率字段定长，关闭时原位回填）
+ * @return 字节数
+ */
+static unsigned int y4m_build_header(const frame_recorder_t *recorder, unsigned char *out, unsigned int interval_us)
+{
+  return snprintf((char *)out, Y4M_HEADER_MAX, "YUV4MPEG2 W%d H%d F%010u:%010u Ip A1:1 %s\n",
+                  recorder->width, recorder->height, 1000000u, interval_us,
+                  recorder->format == FRAME_FORMAT_I420 ? "C420jpeg" : "C422");
+}
+
+/**
+ * @brief 写RIFF块头
+ */
+static void put_chunk(unsigned char *p, const char *id, unsigned int size)
+{
+  memcpy(p, id, 4);
+  protocol_put_le32(p + 4, size);
+}
+
+/**
+ * @brief 编码AVI文件头：RIFF('AVI ' LIST('hdrl' avih LIST('strl' strh strf)) LIST('movi' ...
+ *        帧数、帧率和各块大小用当前的值，关闭时重新编码并回填
+ * @param file_size 文件总长度
+ */
+static void avi_build_header(const frame_recorder_t *recorder, unsigned char *out, unsigned long long file_size)
+{
+  unsigned int interval_us = frame_interval_us(recorder);
+  unsigned int buffer_size = recorder->max_frame_size + 8;
+  unsigned char *p;
+
+  memset(out, 0, AVI_HEADER_SIZE);
+  put_chunk(out, "RIFF", file_size - 8);
+  memcpy(out + 8, "AVI ", 4);
+  put_chunk(out + 12, "LIST", AVI_HEADER_SIZE - 12 - 12 - 8);
+  memcpy(out + 20, "hdrl", 4);
+
+  // MainAVIHeader
+  p = out + AVI_HEADER_AVIH;
+  put_chunk(p, "avih", 56);
+  protocol_put_le32(p + 8, interval_us);
+  protocol_put_le32(p + 12, (unsigned int)((unsigned long long)buffer_size * 1000000 / interval_us));
+  protocol_put_le32(p + 20, AVIF_HASINDEX);
+  protocol_put_le32(p + 24, recorder->frames);
+  protocol_put_le32(p + 32, 1); // 流数
+  protocol_put_le32(p + 36, buffer_size);
+  protocol_put_le32(p + 40, recorder->width);
+  protocol_put_le32(p + 44, recorder->height);
+
+  put_chunk(out + AVI_HEADER_AVIH + 64, "LIST", AVI_HEADER_STRF + 48 - (AVI_HEADER_AVIH + 64) - 8);
+  memcpy(out + AVI_HEADER_AVIH + 72, "strl", 4);
+
+  // AVIStreamHeader：帧率 = dwRate / dwScale
+  p = out + AVI_HEADER_STRH;
+  put_chunk(p, "strh", 56);
+  memcpy(p + 8, "vids", 4);
+  memcpy(p + 12, "MJPG", 4);
+  protocol_put_le32(p + 28, interval_us);
+  protocol_put_le32(p + 32, 1000000);
+  protocol_put_le32(p + 40, recorder->frames);
+  protocol_put_le32(p + 44, buffer_size);
+  protocol_put_le32(p + 48, 0xFFFFFFFF); // dwQuality：默认
+  protocol_put_le16(p + 60, recorder->width);
+  protocol_put_le16(p + 62, recorder->height);
+
+  // BITMAPINFOHEADER
+  p = out + AVI_HEADER_STRF;
+  put_chunk(p, "strf", 40);
+  protocol_put_le32(p + 8, 40);
+  protocol_put_le32(p + 12, recorder->width);
+  protocol_put_le32(p + 16, recorder->height);
+  protocol_put_le16(p + 20, 1);
+  protocol_put_le16(p + 22, 24);
+  memcpy(p + 24, "MJPG", 4);
+  protocol_put_le32(p + 28, recorder->width * recorder->height * 3);
+
+  // movi的大小到写索引之前的文件末尾为止
+  put_chunk(out + AVI_MOVI_OFFSET - 8, "LIST", recorder->movi_end - AVI_MOVI_OFFSET);
+  memcpy(out + AVI_MOVI_OFFSET, "movi", 4);
+}
+
+/**
+ * @brief 在文件末尾写AVI索引：标准idx1，之后是每帧时间戳的ctim块
+ */
+static int avi_write_index(frame_recorder_t *recorder)
+{
+  unsigned int idx_size = recorder->frames * 16;
+  unsigned int ts_size = recorder->frames * 8;
+  unsigned char *buf = malloc(8 + idx_size + 8 + ts_size);
+  if (!buf)
+  {
+    perror("malloc失败");
+    return -1;
+  }
+
+  unsigned char *p = buf;
+  put_chunk(p, "idx1", idx_size);
+  p += 8;
+  for (unsigned int i = 0; i < recorder->frames; i++, p += 16)
+  {
+    memcpy(p, "00dc", 4);
+    protocol_put_le32(p + 4, AVIIF_KEYFRAME);
+    protocol_put_le32(p + 8, recorder->index[i].offset - 8 - AVI_MOVI_OFFSET);
+    protocol_put_le32(p + 12, recorder->index[i].size);
+  }
+
+  put_chunk(p, "ctim", ts_size);
+  p += 8;
+  for (unsigned int i = 0; i < recorder->frames; i++, p += 8)
+  {
+    protocol_put_le64(p, recorder->index[i].timestamp_us);
+  }
+
+  struct iovec iov;
+  iov.iov_base = buf;
+  iov.iov_len = p - buf;
+  int ret = write_iov(recorder, &iov, 1);
+  free(buf);
+  return ret;
+}
+
+/**
+ * @brief 回填文件头，截掉预分配的多余部分并关闭当前文件
+ */
+static void finish_segment(frame_recorder_t *recorder)
+{
+  if (recorder->fd < 0)
+  {
+    return;
+  }
+
+  unsigned char header[AVI_HEADER_SIZE > Y4M_HEADER_MAX ? AVI_HEADER_SIZE : Y4M_HEADER_MAX];
+  unsigned int header_size;
+  if (recorder->container == RECORD_CONTAINER_AVI)
+  {
+    recorder->movi_end = recorder->offset;
+    avi_write_index(recorder);
+    avi_build_header(recorder, header, recorder->offset);
+    header_size = AVI_HEADER_SIZE;
+  }
+  else
+  {
+    header_size = y4m_build_header(recorder, header, frame_interval_us(recorder));
+  }
+
+  if (pwrite(recorder->fd, header, header_size, 0) != (ssize_t)header_size)
+  {
+    perror("回填录像文件头失败");
+  }
+  if (ftruncate(recorder->fd, recorder->offset) < 0)
+  {
+    perror("ftruncate失败");
+  }
+  close(recorder->fd);
+  recorder->fd = -1;
+
+  printf("录像文件 %s: %u 帧, %.1f MB, %.1f fps\n", recorder->filename, recorder->frames,
+         recorder->offset / (1024.0 * 1024.0), 1000000.0 / frame_interval_us(recorder));
+}
+
+/**
+ * @brief 为帧的格式和分辨率创建下一个文件并写入文件头
+ */
+static int open_segment(frame_recorder_t *recorder, int container, const protocol_frame_t *header)
+{
+  snprintf(recorder->filename, sizeof(recorder->filename), "%s_%03d.%s", recorder->prefix, recorder->segment,
+           container == RECORD_CONTAINER_AVI ? "avi" : "y4m");
+
+  recorder->fd = open(recorder->filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (recorder->fd < 0)
+  {
+    perror("创建录像文件失败");
+    return -1;
+  }
+
+  recorder->segment++;
+  recorder->files++;
+  recorder->container = container;
+  recorder->format = header->format;
+  recorder->width = header->width;
+  recorder->height = header->height;
+  recorder->frames = 0;
+  recorder->offset = 0;
+  recorder->movi_end = 0;
+  recorder->max_frame_size = 0;
+  recorder->allocated = 0;
+  recorder->prealloc = 1;
+
+  // 先写占位的文件头，关闭时回填
+  unsigned char buf[AVI_HEADER_SIZE > Y4M_HEADER_MAX ? AVI_HEADER_SIZE : Y4M_HEADER_MAX];
+  struct iovec iov;
+  iov.iov_base = buf;
+  if (container == RECORD_CONTAINER_AVI)
+  {
+    recorder->movi_end = AVI_HEADER_SIZE;
+    avi_build_header(recorder, buf, AVI_HEADER_SIZE);
+    iov.iov_len = AVI_HEADER_SIZE;
+  }
+  else
+  {
+    iov.iov_len = y4m_build_header(recorder, buf, DEFAULT_FRAME_US);
+  }
+
+  preallocate(recorder, iov.iov_len);
+  if (write_iov(recorder, &iov, 1) < 0)
+  {
+    close(recorder->fd);
+    recorder->fd = -1;
+    return -1;
+  }
+
+  printf("开始录像: %s\n", recorder->filename);
+  return 0;
+}
+
+/**
+ * @brief YUYV转平面4:2:2（Y平面，之后U、V平面各为宽度的一半）
+ */
+static void yuyv_to_planar422(const unsigned char *yuyv, int width, int height, unsigned char *out)
+{
+  unsigned int pixels = (unsigned int)width * height;
+  unsigned char *y = out;
+  unsigned char *u = out + pixels;
+  unsigned char *v = u + pixels / 2;
+
+  for (unsigned int i = 0; i < pixels / 2; i++)
+  {
+    y[0] = yuyv[0];
+    u[i] = yuyv[1];
+    y[1] = yuyv[2];
+    v[i] = yuyv[3];
+    y += 2;
+    yuyv += 4;
+  }
+}
+
+/**
+ * @brief 追加一帧
+ */
+int frame_recorder_write(frame_recorder_t *recorder, const protocol_frame_t *header, const unsigned char *data,
+                         unsigned long long timestamp_us)
+{
+  int container;
+  unsigned int size;
+
+  if (header->format == FRAME_FORMAT_JPEG || header->format == FRAME_FORMAT_MJPEG)
+  {
+    container = RECORD_CONTAINER_AVI;
+    size = header->frame_size;
+  }
+  else if (header->format == FRAME_FORMAT_YUYV)
+  {
+    container = RECORD_CONTAINER_Y4M;
+    size = header->width * header->height * 2;
+  }
+  else if (header->format == FRAME_FORMAT_I420)
+  {
+    container = RECORD_CONTAINER_Y4M;
+    size = header->width * header->height * 3 / 2;
+  }
+  else
+  {
+    fprintf(stderr, "录像不支持格式 %u\n", header->format);
+    return -1;
+  }
+
+  // MJPEG帧常省略DHT，补上标准Huffman表
+  unsigned char dht[JPEG_STD_DHT_SIZE];
+  unsigned int dht_size = 0;
+  unsigned int sos = 0;
+  if (container == RECORD_CONTAINER_AVI && size > 4 && !jpeg_has_dht(data, size, &sos) && sos > 0)
+  {
+    dht_size = jpeg_write_std_dht(dht);
+  }
+  else
+  {
+    sos = size;
+  }
+  unsigned int frame_size = size + dht_size;
+
+  // 格式或分辨率变化（同一个文件中帧格式必须一致）、AVI超过大小上限（算上每帧24字节的索引）时换下一个文件
+  if (recorder->fd >= 0 &&
+      (header->format != recorder->format || (int)header->width != recorder->width ||
+       (int)header->height != recorder->height ||
+       (container == RECORD_CONTAINER_AVI &&
+        recorder->offset + frame_size + 24ull * (recorder->frames + 1) + 64 > AVI_SEGMENT_MAX)))
+  {
+    finish_segment(recorder);
+  }
+  if (recorder->fd < 0 && open_segment(recorder, container, header) < 0)
+  {
+    return -1;
+  }
+
+  if (recorder->frames == recorder->index_capacity)
+  {
+    unsigned int capacity = recorder->index_capacity ? recorder->index_capacity * 2 : 1024;
+    record_index_t *index = realloc(recorder->index, capacity * sizeof(record_index_t));
+    if (!index)
+    {
+      perror("malloc失败");
+      return -1;
+    }
+    recorder->index = index;
+    recorder->index_capacity = capacity;
+  }
+
+  // 帧头 + 数据一次writev写出
+  unsigned char frame_header[Y4M_FRAME_HEADER_SIZE + 1];
+  static const unsigned char pad = 0;
+  struct iovec iov[5];
+  int count = 0;
+  unsigned int header_size;
+
+  if (container == RECORD_CONTAINER_AVI)
+  {
+    header_size = 8;
+    put_chunk(frame_header, "00dc", frame_size);
+    iov[count].iov_base = frame_header;
+    iov[count++].iov_len = header_size;
+    iov[count].iov_base = (void *)data;
+    iov[count++].iov_len = sos;
+    iov[count].iov_base = dht;
+    iov[count++].iov_len = dht_size;
+    iov[count].iov_base = (void *)(data + sos);
+    iov[count++].iov_len = size - sos;
+    iov[count].iov_base = (void *)&pad;
+    iov[count++].iov_len = frame_size & 1; // RIFF块按2字节对齐
+  }
+  else
+  {
+    header_size = snprintf((char *)frame_header, sizeof(frame_header), "FRAME XT=%020llu\n", timestamp_us);
+    iov[count].iov_base = frame_header;
+    iov[count++].iov_len = header_size;
+
+    if (header->format == FRAME_FORMAT_YUYV)
+    {
+      if (size > recorder->planar_capacity)
+      {
+        unsigned char *planar = realloc(recorder->planar, size);
+        if (!planar)
+        {
+          perror("malloc失败");
+          return -1;
+        }
+        recorder->planar = planar;
+        recorder->planar_capacity = size;
+      }
+      yuyv_to_planar422(data, header->width, header->height, recorder->planar);
+      data = recorder->planar;
+    }
+    iov[count].iov_base = (void *)data;
+    iov[count++].iov_len = size;
+  }
+
+  record_index_t *entry = &recorder->index[recorder->frames];
+  entry->offset = recorder->offset + header_size;
+  entry->size = frame_size;
+  entry->timestamp_us = timestamp_us;
+
+  preallocate(recorder, recorder->offset + header_size + frame_size + 1);
+  if (write_iov(recorder, iov, count) < 0)
+  {
+    return -1;
+  }
+
+  recorder->frames++;
+  recorder->total_frames++;
+  recorder->total_bytes += frame_size;
+  if (frame_size > recorder->max_frame_size)
+  {
+    recorder->max_frame_size = frame_size;
+  }
+  return 0;
+}
+
+/**
+ * @brief 关闭录像
+ */
+void frame_recorder_close(frame_recorder_t *recorder)
+{
+  finish_segment(recorder);
+  free(recorder->index);
+  free(recorder->planar);
+  recorder->index = NULL;
+  recorder->planar = NULL;
+  recorder->index_capacity = 0;
+  recorder->planar_capacity = 0;
+}
@@ -0,0 +1,82 @@
+#ifndef __FRAME_RECORDER_H__
+#define __FRAME_RECORDER_H__
+
+#include "protocol.h"
+
+/*
+ * 客户端录像（video_client.c -r 使用）：所有帧追加到一个文件，而不是每帧一个小文件。
+ *   JPEG/MJPEG帧 -> <前缀>_NNN.avi：RIFF AVI 1.0，MJPG编码，movi之后是标准idx1索引
+ *                    （每帧在文件中的位置和大小），再之后是自定义的ctim块：每帧一个小端u64时间戳（微秒）
+ *   YUYV/I420帧  -> <前缀>_NNN.y4m：YUV4MPEG2，YUYV转为平面4:2:2（C422），I420按C420jpeg原样写入。
+ *                    每帧的帧头定长：“FRAME XT=<20位十进制时间戳>\n”，第n帧位于
+ *                    文件头长度 + n * (Y4M_FRAME_HEADER_SIZE + 帧字节数)，不需要另外的索引
+ * 时间戳是服务器的采集时间（v2包头），老服务器为客户端收到帧的时间。
+ * 文件头中的帧率在关闭时按实际时间戳回填；格式或分辨率变化、AVI超过AVI_SEGMENT_MAX时换下一个文件。
+ * 每帧用一次writev顺序写出，文件按RECORD_PREALLOC提前fallocate，关闭时截掉多余部分。
+ */
+
+#define RECORD_PREALLOC (64 * 1024 * 1024)
+#define AVI_SEGMENT_MAX (1000u * 1024 * 1024) // AVI 1.0的idx1偏移是32位，老播放器只支持1GB以内
+#define Y4M_FRAME_HEADER_SIZE 30              // "FRAME XT=" + 20位时间戳 + "\n"
+
+#define RECORD_CONTAINER_NONE 0
+#define RECORD_CONTAINER_Y4M 1
+#define RECORD_CONTAINER_AVI 2
+
+// 一帧的索引项
+typedef struct
+{
+  unsigned long long offset;       // 帧数据在文件中的位置
+  unsigned int size;
+  unsigned long long timestamp_us;
+} record_index_t;
+
+typedef struct
+{
+  const char *prefix;
+  char filename[256];              // 当前文件名
+  int fd;
+  int container;                   // 当前文件的格式（RECORD_CONTAINER_*）
+  int segment;                     // 下一个文件的编号
+  unsigned int format;             // 当前文件的帧格式和分辨率
+  int width;
+  int height;
+  unsigned long long offset;       // 文件当前长度
+  unsigned long long movi_end;     // AVI：movi数据的结束位置
+  unsigned long long allocated;    // 已预分配到的位置
+  int prealloc;                    // 文件系统是否支持fallocate
+  unsigned int max_frame_size;
+  record_index_t *index;
+  unsigned int frames;             // 当前文件的帧数
+  unsigned int index_capacity;
+  unsigned char *planar;           // YUYV转平面格式的缓冲区
+  unsigned int planar_capacity;
+  unsigned long long total_frames; // 所有文件的帧数和字节数
+  unsigned long long total_bytes;
+  int files;
+} frame_recorder_t;
+
+/**
+ * @brief 初始化录像（第一帧到达时才创建文件）
+ * @param recorder 录像状态
+ * @param prefix 文件名前缀
+ */
+void frame_recorder_init(frame_recorder_t *recorder, const char *prefix);
+
+/**
+ * @brief 追加一帧
+ * @param recorder 录像状态
+ * @param header 帧包头（JPEG、MJPEG、YUYV或I420）
+ * @param data 图像数据
+ * @param timestamp_us 时间戳（微秒）
+ * @return 成功返回0，失败返回-1
+ */
+int frame_recorder_write(frame_recorder_t *recorder, const protocol_frame_t *header, const unsigned char *data,
+                         unsigned long long timestamp_us);
+
+/**
+ * @brief 回填文件头和索引，关闭当前文件并释放缓冲区
+ */
+void frame_recorder_close(frame_recorder_t *recorder);
+
+#endif // __FRAME_RECORDER_H__
@@ -0,0 +1,356 @@
+#include "frame_transform.h"
+#include "protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TRANSFORM_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TRANSFORM_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+// 纵向求和：rows行（每行bytes字节，行距stride）逐字节相加，结果为16位（最多FRAME_TRANSFORM_MAX_SCALE行，不会溢出）
+typedef void (*row_sum_fn)(const unsigned char *src, int stride, int rows, int bytes, unsigned short *acc);
+
+static row_sum_fn g_row_sum;
+static const char *g_row_sum_name = "c";
+static pthread_once_t g_row_sum_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief 标量实现
+ */
+static void row_sum_c(const unsigned char *src, int stride, int rows, int bytes, unsigned short *acc)
+{
+  for (int i = 0; i < bytes; i++)
+  {
+    const unsigned char *p = src + i;
+    unsigned int sum = 0;
+    for (int r = 0; r < rows; r++)
+    {
+      sum += *p;
+      p += stride;
+    }
+    acc[i] = sum;
+  }
+}
+
+#ifdef TRANSFORM_HAVE_NEON
+/**
+ * @brief NEON实现：每次16字节，vaddw_u8扩展到16位累加
+ */
+static void row_sum_neon(const unsigned char *src, int stride, int rows, int bytes, unsigned short *acc)
+{
+  int i = 0;
+  for (; i + 16 <= bytes; i += 16)
+  {
+    const unsigned char *p = src + i;
+    uint16x8_t lo = vdupq_n_u16(0);
+    uint16x8_t hi = vdupq_n_u16(0);
+    for (int r = 0; r < rows; r++)
+    {
+      uint8x16_t v = vld1q_u8(p);
+      lo = vaddw_u8(lo, vget_low_u8(v));
+      hi = vaddw_u8(hi, vget_high_u8(v));
+      p += stride;
+    }
+    vst1q_u16(acc + i, lo);
+    vst1q_u16(acc + i + 8, hi);
+  }
+
+  if (i < bytes)
+  {
+    row_sum_c(src + i, stride, rows, bytes - i, acc + i);
+  }
+}
+#endif // TRANSFORM_HAVE_NEON
+
+#ifdef TRANSFORM_HAVE_X86
+/**
+ * @brief SSE2实现：每次16字节，与零交错解包成16位后累加
+ */
+__attribute__((target("sse2"))) static void row_sum_sse2(const unsigned char *src, int stride, int rows, int bytes,
+                                                          unsigned short *acc)
+{
+  const __m128i zero = _mm_setzero_si128();
+  int i = 0;
+
+  for (; i + 16 <= bytes; i += 16)
+  {
+    const unsigned char *p = src + i;
+    __m128i lo = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+    for (int r = 0; r < rows; r++)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *)p);
+      lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero));
+      hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero));
+      p += stride;
+    }
+    _mm_storeu_si128((__m128i *)(acc + i), lo);
+    _mm_storeu_si128((__m128i *)(acc + i + 8), hi);
+  }
+
+  if (i < bytes)
+  {
+    row_sum_c(src + i, stride, rows, bytes - i, acc + i);
+  }
+}
+#endif // TRANSFORM_HAVE_X86
+
+/**
+ * @brief 选择内核（只执行一次），TRANSFORM_KERNEL=c|sse2|neon 可强制指定
+ */
+static void select_row_sum(void)
+{
+  const char *force = getenv("TRANSFORM_KERNEL");
+
+  g_row_sum = row_sum_c;
+
+#ifdef TRANSFORM_HAVE_NEON
+  if (!force || strcmp(force, "neon") == 0)
+  {
+    g_row_sum = row_sum_neon;
+    g_row_sum_name = "neon";
+  }
+#endif
+
+#ifdef TRANSFORM_HAVE_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2") && (!force || strcmp(force, "sse2") == 0))
+  {
+    g_row_sum = row_sum_sse2;
+    g_row_sum_name = "sse2";
+  }
+#endif
+
+  (void)force;
+}
+
+/**
+ * @brief 规范变换
+ */
+void frame_transform_normalize(frame_transform_t *t, int width, int height)
+{
+  if (t->scale != 1 && t->scale != 2 && t->scale != 4)
+  {
+    t->scale = 1;
+  }
+  if (t->format != FRAME_FORMAT_YUYV && t->format != FRAME_FORMAT_I420 && t->format != FRAME_FORMAT_JPEG)
+  {
+    t->format = FRAME_FORMAT_YUYV;
+  }
+
+  if (t->w == 0 || t->h == 0 || t->x >= width || t->y >= height)
+  {
+    t->x = t->y = 0;
+    t->w = width;
+    t->h = height;
+  }
+  if (t->x + t->w > width)
+  {
+    t->w = width - t->x;
+  }
+  if (t->y + t->h > height)
+  {
+    t->h = height - t->y;
+  }
+  t->x &= ~1;
+
+  // 输出宽度必须是偶数（宏像素），I420输出高度也必须是偶数
+  int unit_w = 2 * t->scale;
+  int unit_h = t->format == FRAME_FORMAT_I420 ? 2 * t->scale : t->scale;
+  t->w -= t->w % unit_w;
+  t->h -= t->h % unit_h;
+  if (t->w == 0 || t->h == 0)
+  {
+    // 裁剪区域比一个输出像素还小，改为整帧
+    t->x = t->y = 0;
+    t->w = width - width % unit_w;
+    t->h = height - height % unit_h;
+  }
+}
+
+/**
+ * @brief 是否等同于原始直播流
+ */
+int frame_transform_is_identity(const frame_transform_t *t, int width, int height, int format)
+{
+  return t->x == 0 && t->y == 0 && t->w == width && t->h == height && t->scale == 1 && t->format == format;
+}
+
+/**
+ * @brief 两个变换是否相同
+ */
+int frame_transform_equal(const frame_transform_t *a, const frame_transform_t *b)
+{
+  return a->x == b->x && a->y == b->y && a->w == b->w && a->h == b->h && a->scale == b->scale &&
+         a->format == b->format;
+}
+
+/**
+ * @brief 计算输出尺寸
+ */
+unsigned int frame_transform_output_size(const frame_transform_t *t, int *out_w, int *out_h)
+{
+  *out_w = t->w / t->scale;
+  *out_h = t->h / t->scale;
+
+  unsigned int pixels = (unsigned int)*out_w * *out_h;
+  return t->format == FRAME_FORMAT_I420 ? pixels * 3 / 2 : pixels * 2;
+}
+
+/**
+ * @brief 横向合并亮度：每个输出像素取s个源像素（acc为s行的纵向和）
+ */
+static void emit_luma(const unsigned short *acc, int out_w, int s, int shift, unsigned char *out, int step)
+{
+  unsigned int round = (1u << shift) >> 1;
+
+  for (int j = 0; j < out_w; j++)
+  {
+    const unsigned short *p = acc + j * s * 2;
+    unsigned int sum = 0;
+    for (int k = 0; k < s; k++)
+    {
+      sum += p[k * 2];
+    }
+    out[j * step] = (sum + round) >> shift;
+  }
+}
+
+/**
+ * @brief 横向合并色度：每个输出色度样本取s个源宏像素（b不为NULL时再加上b的纵向和，用于I420）
+ */
+static void emit_chroma(const unsigned short *a, const unsigned short *b, int count, int s, int shift,
+                        unsigned char *u, unsigned char *v, int step)
+{
+  unsigned int round = (1u << shift) >> 1;
+
+  for (int c = 0; c < count; c++)
+  {
+    int base = c * s * 4;
+    unsigned int su = 0, sv = 0;
+    for (int k = 0; k < s; k++)
+    {
+      su += a[base + k * 4 + 1];
+      sv += a[base + k * 4 + 3];
+      if (b)
+      {
+        su += b[base + k * 4 + 1];
+        sv += b[base + k * 4 + 3];
+      }
+    }
+    u[c * step] = (su + round) >> shift;
+    v[c * step] = (sv + round) >> shift;
+  }
+}
+
+/**
+ * @brief 对一帧做变换
+ */
+int frame_transform_apply(const frame_transform_t *t, const unsigned char *yuyv, int width, unsigned char *out)
+{
+  int stride = width * 2;
+  int s = t->scale;
+  int bytes = t->w * 2;
+  int out_w, out_h;
+  const unsigned char *src = yuyv + (size_t)t->y * stride + t->x * 2;
+
+  frame_transform_output_size(t, &out_w, &out_h);
+  pthread_once(&g_row_sum_once, select_row_sum);
+
+  if (s == 1 && t->format != FRAME_FORMAT_I420)
+  {
+    // 只裁剪：逐行拷贝
+    for (int r = 0; r < out_h; r++)
+    {
+      memcpy(out + (size_t)r * bytes, src + (size_t)r * stride, bytes);
+    }
+    return 0;
+  }
+
+  unsigned short *acc = (unsigned short *)malloc(bytes * 2 * sizeof(unsigned short));
+  if (!acc)
+  {
+    perror("malloc transform buffer failed");
+    return -1;
+  }
+  unsigned short *acc2 = acc + bytes;
+
+  // s*s个样本取平均（s为2的幂，除法用移位）
+  int shift = 0;
+  while ((1 << shift) < s * s)
+  {
+    shift++;
+  }
+
+  if (t->format != FRAME_FORMAT_I420)
+  {
+    for (int r = 0; r < out_h; r++)
+    {
+      unsigned char *row = out + (size_t)r * out_w * 2;
+      g_row_sum(src + (size_t)r * s * stride, stride, s, bytes, acc);
+      emit_luma(acc, out_w, s, shift, row, 2);
+      emit_chroma(acc, NULL, out_w / 2, s, shift, row + 1, row + 3, 4);
+    }
+  }
+  else
+  {
+    // 每次处理两个输出行：两组s行分别得到两行亮度，合起来得到一行色度（2*s*s个样本）
+    unsigned char *py = out;
+    unsigned char *pu = py + out_w * out_h;
+    unsigned char *pv = pu + (out_w / 2) * (out_h / 2);
+    for (int r = 0; r < out_h / 2; r++)
+    {
+      const unsigned char *p = src + (size_t)2 * r * s * stride;
+      g_row_sum(p, stride, s, bytes, acc);
+      g_row_sum(p + (size_t)s * stride, stride, s, bytes, acc2);
+      emit_luma(acc, out_w, s, shift, py + (size_t)2 * r * out_w, 1);
+      emit_luma(acc2, out_w, s, shift, py + (size_t)(2 * r + 1) * out_w, 1);
+      emit_chroma(acc, acc2, out_w / 2, s, shift + 1, pu + (size_t)r * (out_w / 2), pv + (size_t)r * (out_w / 2), 1);
+    }
+  }
+
+  free(acc);
+  return 0;
+}
+
+/**
+ * @brief I420转回YUYV
+ */
+void frame_i420_to_yuyv(const unsigned char *i420, int width, int height, unsigned char *yuyv)
+{
+  const unsigned char *py = i420;
+  const unsigned char *pu = py + width * height;
+  const unsigned char *pv = pu + (width / 2) * (height / 2);
+
+  for (int y = 0; y < height; y++)
+  {
+    const unsigned char *yr = py + (size_t)y * width;
+    const unsigned char *ur = pu + (size_t)(y / 2) * (width / 2);
+    const unsigned char *vr = pv + (size_t)(y / 2) * (width / 2);
+    unsigned char *out = yuyv + (size_t)y * width * 2;
+    for (int x = 0; x < width / 2; x++)
+    {
+      out[x * 4] = yr[x * 2];
+      out[x * 4 + 1] = ur[x];
+      out[x * 4 + 2] = yr[x * 2 + 1];
+      out[x * 4 + 3] = vr[x];
+    }
+  }
+}
+
+/**
+ * @brief 返回当前选用的内核名称
+ */
+const char *frame_transform_kernel_name(void)
+{
+  pthread_once(&g_row_sum_once, select_row_sum);
+  return g_row_sum_name;
+}
@@ -0,0 +1,79 @@
+#ifndef __FRAME_TRANSFORM_H__
+#define __FRAME_TRANSFORM_H__
+
+/*
+ * 直播帧的按订阅变换（服务器端）：从YUYV源图像裁剪一个矩形，按2x/4x做盒式缩小，
+ * 输出YUYV(4:2:2)或平面I420(4:2:0)。
+ * 纵向的多行求和直接在YUYV数据上用SIMD(NEON/SSE2)按16位累加，横向合并和取整用标量完成；
+ * 缩放为1且输出YUYV时逐行拷贝。
+ *
+ * I420输出：Y平面 w*h，之后U、V平面各 (w/2)*(h/2)，w/h为输出尺寸。
+ */
+
+#define FRAME_TRANSFORM_MAX_SCALE 4
+
+// 一个变换（字段都是源图像像素坐标），使用前先frame_transform_normalize
+typedef struct
+{
+  unsigned short x; // 裁剪区域
+  unsigned short y;
+  unsigned short w; // 0表示整帧
+  unsigned short h;
+  unsigned char scale;  // 缩小倍数：1、2、4
+  unsigned char format; // 输出格式：FRAME_FORMAT_YUYV、FRAME_FORMAT_I420或FRAME_FORMAT_JPEG（YUYV再编码）
+} frame_transform_t;
+
+/**
+ * @brief 把变换规范到源图像范围内并对齐：
+ *        裁剪区域限制在图像内（为空时取整帧），x按宏像素对齐，
+ *        w对齐到2*scale（输出宽度为偶数），h对齐到scale（I420为2*scale）；不认识的缩放/格式按1/YUYV处理
+ * @param t 变换
+ * @param width 源图像宽度（偶数）
+ * @param height 源图像高度
+ */
+void frame_transform_normalize(frame_transform_t *t, int width, int height);
+
+/**
+ * @brief 是否等同于原始直播流（整帧、不缩放、格式为format）
+ */
+int frame_transform_is_identity(const frame_transform_t *t, int width, int height, int format);
+
+/**
+ * @brief 两个变换是否相同
+ */
+int frame_transform_equal(const frame_transform_t *a, const frame_transform_t *b);
+
+/**
+ * @brief 计算输出尺寸
+ * @param t 已规范的变换
+ * @param out_w 输出宽度
+ * @param out_h 输出高度
+ * @return apply输出的字节数（YUYV: w*h*2，I420: w*h*3/2）
+ */
+unsigned int frame_transform_output_size(const frame_transform_t *t, int *out_w, int *out_h);
+
+/**
+ * @brief 对一帧做变换
+ * @param t 已规范的变换
+ * @param yuyv 源YUYV数据
+ * @param width 源图像宽度（每行width*2字节）
+ * @param out 输出缓冲区，至少frame_transform_output_size字节
+ * @return 成功返回0，失败返回-1
+ */
+int frame_transform_apply(const frame_transform_t *t, const unsigned char *yuyv, int width, unsigned char *out);
+
+/**
+ * @brief I420转回YUYV（客户端保存图像用，色度按行复制）
+ * @param i420 I420数据
+ * @param width 图像宽度（偶数）
+ * @param height 图像高度（偶数）
+ * @param yuyv 输出，width*height*2字节
+ */
+void frame_i420_to_yuyv(const unsigned char *i420, int width, int height, unsigned char *yuyv);
+
+/**
+ * @brief 返回当前选用的内核名称
+ */
+const char *frame_transform_kernel_name(void);
+
+#endif // __FRAME_TRANSFORM_H__
@@ -0,0 +1,119 @@
+#include "http_stream.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char g_index_page[] =
+    "<!DOCTYPE html><html><head><meta charset=\"utf-8\"><title>智能家庭视频监控</title></head>"
+    "<body style=\"margin:0;background:#000\"><img src=\"/stream\" style=\"max-width:100%\"></body></html>";
+
+/**
+ * @brief 解析请求行
+ */
+int http_parse_request(const unsigned char *buf, unsigned int size, int *route)
+{
+  const unsigned char *end = memchr(buf, '\n', size);
+  if (!end)
+  {
+    return 0;
+  }
+
+  // 请求行：方法 路径 版本
+  char line[256];
+  unsigned int len = end - buf;
+  if (len >= sizeof(line))
+  {
+    len = sizeof(line) - 1;
+  }
+  memcpy(line, buf, len);
+  line[len] = '\0';
+
+  char method[16], path[200];
+  if (sscanf(line, "%15s %199s", method, path) != 2 || strcmp(method, "GET") != 0)
+  {
+    *route = HTTP_ROUTE_BAD_REQUEST;
+    return 1;
+  }
+
+  // 忽略查询参数（浏览器常加时间戳防缓存）
+  char *query = strchr(path, '?');
+  if (query)
+  {
+    *query = '\0';
+  }
+
+  if (strcmp(path, "/") == 0 || strcmp(path, "/index.html") == 0)
+  {
+    *route = HTTP_ROUTE_INDEX;
+  }
+  else if (strcmp(path, "/stream") == 0)
+  {
+    *route = HTTP_ROUTE_STREAM;
+  }
+  else if (strcmp(path, "/snapshot") == 0 || strcmp(path, "/snapshot.jpg") == 0)
+  {
+    *route = HTTP_ROUTE_SNAPSHOT;
+  }
+  else
+  {
+    *route = HTTP_ROUTE_NOT_FOUND;
+  }
+  return 1;
+}
+
+/**
+ * @brief 编码请求的响应
+ */
+unsigned int http_encode_response(unsigned char *out, unsigned int size, int route)
+{
+  int len = 0;
+
+  switch (route)
+  {
+  case HTTP_ROUTE_INDEX:
+    len = snprintf((char *)out, size,
+                   "HTTP/1.0 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: %u\r\n"
+                   "Connection: close\r\n\r\n%s",
+                   (unsigned int)strlen(g_index_page), g_index_page);
+    break;
+
+  case HTTP_ROUTE_STREAM:
+    len = snprintf((char *)out, size,
+                   "HTTP/1.0 200 OK\r\nContent-Type: multipart/x-mixed-replace; boundary=" HTTP_BOUNDARY "\r\n"
+                   "Cache-Control: no-cache, no-store\r\nPragma: no-cache\r\nConnection: close\r\n\r\n");
+    break;
+
+  case HTTP_ROUTE_SNAPSHOT:
+    return 0;
+
+  case HTTP_ROUTE_NOT_FOUND:
+    len = snprintf((char *)out, size, "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    break;
+
+  default:
+    len = snprintf((char *)out, size, "HTTP/1.0 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    break;
+  }
+
+  return len > 0 && (unsigned int)len < size ? (unsigned int)len : 0;
+}
+
+/**
+ * @brief 编码直播流中一段的分隔行和段头
+ */
+unsigned int http_encode_part(unsigned char *out, int first, unsigned int length)
+{
+  return snprintf((char *)out, HTTP_PART_HEADER_MAX,
+                  "%s--" HTTP_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n",
+                  first ? "" : "\r\n", length);
+}
+
+/**
+ * @brief 编码单张JPEG的响应头
+ */
+unsigned int http_encode_jpeg(unsigned char *out, unsigned int length)
+{
+  return snprintf((char *)out, HTTP_PART_HEADER_MAX,
+                  "HTTP/1.0 200 OK\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n"
+                  "Cache-Control: no-cache\r\nConnection: close\r\n\r\n",
+                  length);
+}
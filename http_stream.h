@@ -0,0 +1,58 @@
+#ifndef __HTTP_STREAM_H__
+#define __HTTP_STREAM_H__
+
+/*
+ * 内置HTTP服务的报文格式（server_module.c使用），局域网内的浏览器不需要video_client就能观看：
+ *   GET /          内嵌直播流的网页
+ *   GET /stream    multipart/x-mixed-replace的MJPEG流，每一段是一张完整的JPEG
+ *   GET /snapshot  下一帧的单张JPEG
+ * 只看请求行，不解析请求头；响应都是HTTP/1.0短连接，发完（或观看者断开）就关闭。
+ */
+
+#define HTTP_DEFAULT_PORT 8080
+#define HTTP_BOUNDARY "scrudframe"
+#define HTTP_PART_HEADER_MAX 128 // 直播流一段的分隔行和段头、单张JPEG的响应头的最大长度
+
+// 请求的资源
+#define HTTP_ROUTE_INDEX 1
+#define HTTP_ROUTE_STREAM 2
+#define HTTP_ROUTE_SNAPSHOT 3
+#define HTTP_ROUTE_NOT_FOUND 4
+#define HTTP_ROUTE_BAD_REQUEST 5 // 不是GET，或请求行格式错误
+
+/**
+ * @brief 解析请求行
+ * @param buf 已收到的数据
+ * @param size 字节数
+ * @param route 输出请求的资源（HTTP_ROUTE_*）
+ * @return 请求行完整返回1，还需要更多数据返回0
+ */
+int http_parse_request(const unsigned char *buf, unsigned int size, int *route);
+
+/**
+ * @brief 编码请求的响应（直播流为multipart响应头，单张JPEG的响应头要等到有帧时用http_encode_jpeg编码）
+ * @param out 输出缓冲区
+ * @param size 缓冲区大小
+ * @param route 请求的资源
+ * @return 响应字节数，HTTP_ROUTE_SNAPSHOT返回0
+ */
+unsigned int http_encode_response(unsigned char *out, unsigned int size, int route);
+
+/**
+ * @brief 编码直播流中一段的分隔行和段头
+ * @param out 输出缓冲区，至少HTTP_PART_HEADER_MAX字节
+ * @param first 是否第一段（之后的段先结束上一段的数据）
+ * @param length 这一段JPEG的字节数
+ * @return 字节数
+ */
+unsigned int http_encode_part(unsigned char *out, int first, unsigned int length);
+
+/**
+ * @brief 编码单张JPEG的响应头
+ * @param out 输出缓冲区，至少HTTP_PART_HEADER_MAX字节
+ * @param length JPEG字节数
+ * @return 字节数
+ */
+unsigned int http_encode_jpeg(unsigned char *out, unsigned int length);
+
+#endif // __HTTP_STREAM_H__
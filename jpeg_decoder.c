@@ -0,0 +1,1057 @@
+#include "jpeg_decoder.h"
+#include "jpeg_tables.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HUFF_LOOKAHEAD 9 // 码长不超过9位的码字查表一次解出
+
+// 整数IDCT定点参数（与IJG libjpeg的islow实现相同，误差满足IEEE 1180）
+#define CONST_BITS 13
+#define PASS1_BITS 2
+
+#define FIX_0_211164243 1730
+#define FIX_0_298631336 2446
+#define FIX_0_390180644 3196
+#define FIX_0_509795579 4176
+#define FIX_0_541196100 4433
+#define FIX_0_601344887 4926
+#define FIX_0_720959822 5906
+#define FIX_0_765366865 6270
+#define FIX_0_850430095 6967
+#define FIX_0_899976223 7373
+#define FIX_1_061594337 8697
+#define FIX_1_175875602 9633
+#define FIX_1_272758580 10426
+#define FIX_1_451774981 11893
+#define FIX_1_501321110 12299
+#define FIX_1_847759065 15137
+#define FIX_1_961570560 16069
+#define FIX_2_053119869 16819
+#define FIX_2_172734803 17799
+#define FIX_2_562915447 20995
+#define FIX_3_072711026 25172
+#define FIX_3_624509785 29692
+
+#define COEF_LIMIT 4096 // 8位图像反量化后的系数不超过±2^11，超出说明数据损坏
+
+#define DESCALE(x, n) (((x) + (1 << ((n)-1))) >> (n))
+#define LSHIFT(x, n) ((x) * (1 << (n)))
+
+// Huffman解码表
+typedef struct
+{
+  unsigned char look_len[1 << HUFF_LOOKAHEAD]; // 前9位对应的码长，0表示需要慢速查找
+  unsigned char look_val[1 << HUFF_LOOKAHEAD];
+  int maxcode[18];         // 码长为l的最大码字，-1表示没有
+  int valoffset[17];       // 码字 + valoffset[l] = values下标
+  unsigned char values[256];
+} huff_table_t;
+
+// 颜色分量
+typedef struct
+{
+  int id;
+  int h, v;               // 采样因子
+  int tq;                 // 量化表号
+  const huff_table_t *dc; // 本次扫描使用的Huffman表
+  const huff_table_t *ac;
+  int dc_pred;            // DC预测值
+  int hshift, vshift;     // 输出时相对亮度缩小的位数（0或1）
+  int bs;                 // 每块输出的边长
+  void (*idct)(const int *coef, unsigned char *out, int stride);
+  unsigned char *plane;   // 一个MCU行的样本
+  int stride;
+} jpeg_component_t;
+
+typedef void (*idct_func)(const int *coef, unsigned char *out, int stride);
+
+struct jpeg_decoder
+{
+  unsigned short qt[4][64]; // 量化表（Z字形顺序）
+  int qt_mask;              // 本帧定义过的量化表
+
+  huff_table_t std_dc[2]; // 缺省Huffman表（亮度、色度）
+  huff_table_t std_ac[2];
+  huff_table_t dht_dc[4]; // 帧内DHT定义的表
+  huff_table_t dht_ac[4];
+  const huff_table_t *dc_tab[4];
+  const huff_table_t *ac_tab[4];
+
+  jpeg_component_t comp[3];
+  int ncomp;
+  int width, height;
+  int hmax, vmax;
+  int restart_interval;
+
+  // 熵编码数据读取
+  const unsigned char *p;
+  const unsigned char *end;
+  unsigned int bitbuf; // 高位对齐
+  int bits;
+  int marker;          // 遇到的标记，0表示没有
+
+  // YCbCr -> RGB 查找表
+  int cr_r[256];
+  int cb_b[256];
+  int cr_g[256];
+  int cb_g[256];
+
+  unsigned char *planes; // 各分量的MCU行缓冲
+  size_t planes_size;
+  unsigned int *band;    // 一个MCU行的XRGB输出
+  size_t band_size;
+};
+
+static inline unsigned char clamp_sample(int v)
+{
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+// 限制系数范围，保证损坏的数据在IDCT里也不会溢出
+static inline int clamp_coef(int v)
+{
+  return v < -COEF_LIMIT ? -COEF_LIMIT : (v > COEF_LIMIT ? COEF_LIMIT : v);
+}
+
+/**
+ * @brief 根据码长个数和符号生成Huffman解码表
+ * @return 成功返回0，码表无效返回-1
+ */
+static int build_huff(huff_table_t *t, const unsigned char *bits, const unsigned char *vals)
+{
+  int code = 0, k = 0;
+
+  memset(t->look_len, 0, sizeof(t->look_len));
+
+  for (int l = 1; l <= 16; l++)
+  {
+    t->valoffset[l] = k - code;
+    for (int i = 0; i < bits[l - 1]; i++, code++, k++)
+    {
+      // 码字必须在l位之内，否则码表无效（先检查再写查找表，防止越界）
+      if (k >= 256 || code >= (1 << l))
+      {
+        return -1;
+      }
+      t->values[k] = vals[k];
+
+      if (l <= HUFF_LOOKAHEAD)
+      {
+        int shift = HUFF_LOOKAHEAD - l;
+        for (int j = 0; j < (1 << shift); j++)
+        {
+          t->look_len[(code << shift) | j] = l;
+          t->look_val[(code << shift) | j] = vals[k];
+        }
+      }
+    }
+
+    t->maxcode[l] = bits[l - 1] ? code - 1 : -1;
+    code <<= 1;
+  }
+
+  t->maxcode[17] = 0x7FFFFFFF;
+  return 0;
+}
+
+/**
+ * @brief 补充位缓冲区到至少25位
+ *        遇到标记后不再读入，用0填充（由重启处理或解码结束来消耗标记）
+ */
+static void fill_bits(jpeg_decoder_t *d)
+{
+  while (d->bits <= 24)
+  {
+    unsigned int c = 0;
+
+    if (!d->marker && d->p < d->end)
+    {
+      c = *d->p++;
+      if (c == 0xFF)
+      {
+        const unsigned char *q = d->p;
+        while (q < d->end && *q == 0xFF)
+        {
+          q++;
+        }
+
+        if (q < d->end && *q == 0x00) // 0xFF00是数据中的0xFF
+        {
+          d->p = q + 1;
+        }
+        else
+        {
+          d->marker = q < d->end ? *q : JPEG_EOI;
+          d->p = q - 1; // 指向标记前的0xFF
+          c = 0;
+        }
+      }
+    }
+
+    d->bitbuf |= c << (24 - d->bits);
+    d->bits += 8;
+  }
+}
+
+static inline int get_bits(jpeg_decoder_t *d, int n)
+{
+  if (d->bits < n)
+  {
+    fill_bits(d);
+  }
+
+  int v = d->bitbuf >> (32 - n);
+  d->bitbuf <<= n;
+  d->bits -= n;
+  return v;
+}
+
+/**
+ * @brief 读n位并按T.81的EXTEND规则还原为有符号数
+ */
+static inline int get_signed(jpeg_decoder_t *d, int n)
+{
+  int v = get_bits(d, n);
+  return v < (1 << (n - 1)) ? v - (1 << n) + 1 : v;
+}
+
+/**
+ * @brief 解码一个Huffman符号
+ * @return 符号值，码字无效返回-1
+ */
+static inline int huff_decode(jpeg_decoder_t *d, const huff_table_t *t)
+{
+  if (d->bits < 16)
+  {
+    fill_bits(d);
+  }
+
+  unsigned int look = d->bitbuf >> (32 - HUFF_LOOKAHEAD);
+  int len = t->look_len[look];
+  if (len)
+  {
+    d->bitbuf <<= len;
+    d->bits -= len;
+    return t->look_val[look];
+  }
+
+  for (len = HUFF_LOOKAHEAD + 1; len <= 16; len++)
+  {
+    int code = d->bitbuf >> (32 - len);
+    if (code <= t->maxcode[len])
+    {
+      d->bitbuf <<= len;
+      d->bits -= len;
+      return t->values[code + t->valoffset[len]];
+    }
+  }
+
+  return -1;
+}
+
+/**
+ * @brief 处理重启标记：丢弃剩余位、跳过RSTn并复位DC预测
+ */
+static void process_restart(jpeg_decoder_t *d)
+{
+  d->bitbuf = 0;
+  d->bits = 0;
+
+  if (!d->marker)
+  {
+    while (d->p + 1 < d->end && !(d->p[0] == 0xFF && d->p[1] != 0x00 && d->p[1] != 0xFF))
+    {
+      d->p++;
+    }
+    if (d->p + 1 < d->end)
+    {
+      d->marker = d->p[1];
+    }
+  }
+
+  // 不是RSTn（数据损坏）时保留标记，后面的块按0解码
+  if (d->marker >= JPEG_RST0 && d->marker <= JPEG_RST0 + 7)
+  {
+    d->p += 2;
+    d->marker = 0;
+  }
+
+  for (int i = 0; i < d->ncomp; i++)
+  {
+    d->comp[i].dc_pred = 0;
+  }
+}
+
+/**
+ * @brief 解码一个8x8块的系数并反量化（输出为自然顺序）
+ * @return 成功返回0，数据无效返回-1
+ */
+static int decode_block(jpeg_decoder_t *d, jpeg_component_t *c, int coef[64])
+{
+  const unsigned short *q = d->qt[c->tq];
+
+  int s = huff_decode(d, c->dc);
+  if (s < 0 || s > 11)
+  {
+    return -1;
+  }
+  if (s)
+  {
+    c->dc_pred = clamp_coef(c->dc_pred + get_signed(d, s));
+  }
+
+  memset(coef, 0, 64 * sizeof(int));
+  coef[0] = clamp_coef(c->dc_pred * q[0]);
+
+  for (int k = 1; k < 64; k++)
+  {
+    int rs = huff_decode(d, c->ac);
+    if (rs < 0)
+    {
+      return -1;
+    }
+
+    int r = rs >> 4;
+    s = rs & 15;
+    if (s == 0)
+    {
+      if (r != 15) // EOB
+      {
+        break;
+      }
+      k += 15; // ZRL：16个0
+      continue;
+    }
+
+    k += r;
+    if (k > 63)
+    {
+      return -1;
+    }
+    coef[jpeg_zigzag_order[k]] = clamp_coef(get_signed(d, s) * q[k]);
+  }
+
+  return 0;
+}
+
+/**
+ * @brief 8点一维IDCT（偶数部分旋转 + 奇数部分4路乘加），结果右移descale位
+ */
+static inline void idct8_1d(const int *in, int step, int *out, int out_step, int descale)
+{
+  int z1, z2, z3, z4, z5;
+  int tmp0, tmp1, tmp2, tmp3, tmp10, tmp11, tmp12, tmp13;
+
+  // 偶数部分
+  z2 = in[step * 2];
+  z3 = in[step * 6];
+  z1 = (z2 + z3) * FIX_0_541196100;
+  tmp2 = z1 - z3 * FIX_1_847759065;
+  tmp3 = z1 + z2 * FIX_0_765366865;
+
+  tmp0 = LSHIFT(in[0] + in[step * 4], CONST_BITS);
+  tmp1 = LSHIFT(in[0] - in[step * 4], CONST_BITS);
+
+  tmp10 = tmp0 + tmp3;
+  tmp13 = tmp0 - tmp3;
+  tmp11 = tmp1 + tmp2;
+  tmp12 = tmp1 - tmp2;
+
+  // 奇数部分
+  tmp0 = in[step * 7];
+  tmp1 = in[step * 5];
+  tmp2 = in[step * 3];
+  tmp3 = in[step * 1];
+
+  z1 = tmp0 + tmp3;
+  z2 = tmp1 + tmp2;
+  z3 = tmp0 + tmp2;
+  z4 = tmp1 + tmp3;
+  z5 = (z3 + z4) * FIX_1_175875602;
+
+  tmp0 *= FIX_0_298631336;
+  tmp1 *= FIX_2_053119869;
+  tmp2 *= FIX_3_072711026;
+  tmp3 *= FIX_1_501321110;
+  z1 *= -FIX_0_899976223;
+  z2 *= -FIX_2_562915447;
+  z3 = z3 * -FIX_1_961570560 + z5;
+  z4 = z4 * -FIX_0_390180644 + z5;
+
+  tmp0 += z1 + z3;
+  tmp1 += z2 + z4;
+  tmp2 += z2 + z3;
+  tmp3 += z1 + z4;
+
+  out[out_step * 0] = DESCALE(tmp10 + tmp3, descale);
+  out[out_step * 7] = DESCALE(tmp10 - tmp3, descale);
+  out[out_step * 1] = DESCALE(tmp11 + tmp2, descale);
+  out[out_step * 6] = DESCALE(tmp11 - tmp2, descale);
+  out[out_step * 2] = DESCALE(tmp12 + tmp1, descale);
+  out[out_step * 5] = DESCALE(tmp12 - tmp1, descale);
+  out[out_step * 3] = DESCALE(tmp13 + tmp0, descale);
+  out[out_step * 4] = DESCALE(tmp13 - tmp0, descale);
+}
+
+/**
+ * @brief 8x8整数IDCT，先列后行，全零的列/行只算DC
+ */
+static void idct_8x8(const int *coef, unsigned char *out, int stride)
+{
+  int ws[64];
+  int row[8];
+
+  for (int col = 0; col < 8; col++)
+  {
+    const int *in = coef + col;
+    if (!(in[8] | in[16] | in[24] | in[32] | in[40] | in[48] | in[56]))
+    {
+      int dc = LSHIFT(in[0], PASS1_BITS);
+      for (int i = 0; i < 8; i++)
+      {
+        ws[i * 8 + col] = dc;
+      }
+      continue;
+    }
+    idct8_1d(in, 8, ws + col, 8, CONST_BITS - PASS1_BITS);
+  }
+
+  for (int y = 0; y < 8; y++, out += stride)
+  {
+    const int *w = ws + y * 8;
+    if (!(w[1] | w[2] | w[3] | w[4] | w[5] | w[6] | w[7]))
+    {
+      memset(out, clamp_sample(DESCALE(w[0], PASS1_BITS + 3) + 128), 8);
+      continue;
+    }
+
+    idct8_1d(w, 1, row, 1, CONST_BITS + PASS1_BITS + 3);
+    for (int x = 0; x < 8; x++)
+    {
+      out[x] = clamp_sample(row[x] + 128);
+    }
+  }
+}
+
+/**
+ * @brief 4点缩小IDCT：由8x8系数直接得到4x4样本（1/2解码）
+ */
+static void idct_4x4(const int *coef, unsigned char *out, int stride)
+{
+  int ws[8 * 4];
+  int tmp0, tmp2, tmp10, tmp12;
+
+  for (int col = 0; col < 8; col++)
+  {
+    const int *in = coef + col;
+    if (col == 4) // 第二遍不会用到第4列
+    {
+      continue;
+    }
+
+    if (!(in[8] | in[16] | in[24] | in[40] | in[48] | in[56]))
+    {
+      int dc = LSHIFT(in[0], PASS1_BITS);
+      ws[col] = ws[8 + col] = ws[16 + col] = ws[24 + col] = dc;
+      continue;
+    }
+
+    tmp0 = LSHIFT(in[0], CONST_BITS + 1);
+    tmp2 = in[16] * FIX_1_847759065 - in[48] * FIX_0_765366865;
+    tmp10 = tmp0 + tmp2;
+    tmp12 = tmp0 - tmp2;
+
+    tmp0 = in[56] * -FIX_0_211164243 + in[40] * FIX_1_451774981 +
+           in[24] * -FIX_2_172734803 + in[8] * FIX_1_061594337;
+    tmp2 = in[56] * -FIX_0_509795579 + in[40] * -FIX_0_601344887 +
+           in[24] * FIX_0_899976223 + in[8] * FIX_2_562915447;
+
+    ws[col] = DESCALE(tmp10 + tmp2, CONST_BITS - PASS1_BITS + 1);
+    ws[24 + col] = DESCALE(tmp10 - tmp2, CONST_BITS - PASS1_BITS + 1);
+    ws[8 + col] = DESCALE(tmp12 + tmp0, CONST_BITS - PASS1_BITS + 1);
+    ws[16 + col] = DESCALE(tmp12 - tmp0, CONST_BITS - PASS1_BITS + 1);
+  }
+
+  for (int y = 0; y < 4; y++, out += stride)
+  {
+    const int *w = ws + y * 8;
+    if (!(w[1] | w[2] | w[3] | w[5] | w[6] | w[7]))
+    {
+      memset(out, clamp_sample(DESCALE(w[0], PASS1_BITS + 3) + 128), 4);
+      continue;
+    }
+
+    tmp0 = LSHIFT(w[0], CONST_BITS + 1);
+    tmp2 = w[2] * FIX_1_847759065 - w[6] * FIX_0_765366865;
+    tmp10 = tmp0 + tmp2;
+    tmp12 = tmp0 - tmp2;
+
+    tmp0 = w[7] * -FIX_0_211164243 + w[5] * FIX_1_451774981 +
+           w[3] * -FIX_2_172734803 + w[1] * FIX_1_061594337;
+    tmp2 = w[7] * -FIX_0_509795579 + w[5] * -FIX_0_601344887 +
+           w[3] * FIX_0_899976223 + w[1] * FIX_2_562915447;
+
+    out[0] = clamp_sample(DESCALE(tmp10 + tmp2, CONST_BITS + PASS1_BITS + 3 + 1) + 128);
+    out[3] = clamp_sample(DESCALE(tmp10 - tmp2, CONST_BITS + PASS1_BITS + 3 + 1) + 128);
+    out[1] = clamp_sample(DESCALE(tmp12 + tmp0, CONST_BITS + PASS1_BITS + 3 + 1) + 128);
+    out[2] = clamp_sample(DESCALE(tmp12 - tmp0, CONST_BITS + PASS1_BITS + 3 + 1) + 128);
+  }
+}
+
+/**
+ * @brief 2点缩小IDCT：由8x8系数直接得到2x2样本（1/4解码）
+ */
+static void idct_2x2(const int *coef, unsigned char *out, int stride)
+{
+  int ws[8 * 2];
+  int tmp0, tmp10;
+
+  for (int col = 0; col < 8; col++)
+  {
+    const int *in = coef + col;
+    if (col == 2 || col == 4 || col == 6) // 第二遍只用到0、1、3、5、7列
+    {
+      continue;
+    }
+
+    if (!(in[8] | in[24] | in[40] | in[56]))
+    {
+      ws[col] = ws[8 + col] = LSHIFT(in[0], PASS1_BITS);
+      continue;
+    }
+
+    tmp10 = LSHIFT(in[0], CONST_BITS + 2);
+    tmp0 = in[56] * -FIX_0_720959822 + in[40] * FIX_0_850430095 +
+           in[24] * -FIX_1_272758580 + in[8] * FIX_3_624509785;
+
+    ws[col] = DESCALE(tmp10 + tmp0, CONST_BITS - PASS1_BITS + 2);
+    ws[8 + col] = DESCALE(tmp10 - tmp0, CONST_BITS - PASS1_BITS + 2);
+  }
+
+  for (int y = 0; y < 2; y++, out += stride)
+  {
+    const int *w = ws + y * 8;
+    if (!(w[1] | w[3] | w[5] | w[7]))
+    {
+      out[0] = out[1] = clamp_sample(DESCALE(w[0], PASS1_BITS + 3) + 128);
+      continue;
+    }
+
+    tmp10 = LSHIFT(w[0], CONST_BITS + 2);
+    tmp0 = w[7] * -FIX_0_720959822 + w[5] * FIX_0_850430095 +
+           w[3] * -FIX_1_272758580 + w[1] * FIX_3_624509785;
+
+    out[0] = clamp_sample(DESCALE(tmp10 + tmp0, CONST_BITS + PASS1_BITS + 3 + 2) + 128);
+    out[1] = clamp_sample(DESCALE(tmp10 - tmp0, CONST_BITS + PASS1_BITS + 3 + 2) + 128);
+  }
+}
+
+/**
+ * @brief 1/8解码：每块只取DC
+ */
+static void idct_1x1(const int *coef, unsigned char *out, int stride)
+{
+  (void)stride;
+  out[0] = clamp_sample(DESCALE(coef[0], 3) + 128);
+}
+
+static int parse_sof(jpeg_decoder_t *d, const unsigned char *seg, int len)
+{
+  if (len < 6 || seg[0] != 8) // 只支持8位精度
+  {
+    return -1;
+  }
+
+  d->height = (seg[1] << 8) | seg[2];
+  d->width = (seg[3] << 8) | seg[4];
+  d->ncomp = seg[5];
+  if (d->width == 0 || d->height == 0 || (d->ncomp != 1 && d->ncomp != 3) || len < 6 + 3 * d->ncomp)
+  {
+    return -1;
+  }
+
+  d->hmax = d->vmax = 1;
+  for (int i = 0; i < d->ncomp; i++)
+  {
+    jpeg_component_t *c = &d->comp[i];
+    c->id = seg[6 + 3 * i];
+    c->h = seg[7 + 3 * i] >> 4;
+    c->v = seg[7 + 3 * i] & 15;
+    c->tq = seg[8 + 3 * i];
+
+    // 单分量扫描的MCU就是一个块，采样因子无意义
+    if (d->ncomp == 1)
+    {
+      c->h = c->v = 1;
+    }
+    if (c->h < 1 || c->h > 2 || c->v < 1 || c->v > 2 || c->tq > 3)
+    {
+      return -1;
+    }
+    if (c->h > d->hmax)
+      d->hmax = c->h;
+    if (c->v > d->vmax)
+      d->vmax = c->v;
+  }
+
+  return 0;
+}
+
+static int parse_dqt(jpeg_decoder_t *d, const unsigned char *seg, int len)
+{
+  while (len > 0)
+  {
+    int pq = seg[0] >> 4;
+    int tq = seg[0] & 15;
+    int n = pq ? 128 : 64;
+    if (tq > 3 || len < 1 + n)
+    {
+      return -1;
+    }
+
+    for (int k = 0; k < 64; k++)
+    {
+      d->qt[tq][k] = pq ? ((seg[1 + 2 * k] << 8) | seg[2 + 2 * k]) : seg[1 + k];
+    }
+    d->qt_mask |= 1 << tq;
+
+    seg += 1 + n;
+    len -= 1 + n;
+  }
+
+  return 0;
+}
+
+static int parse_dht(jpeg_decoder_t *d, const unsigned char *seg, int len)
+{
+  while (len > 0)
+  {
+    if (len < 17)
+    {
+      return -1;
+    }
+
+    int tc = seg[0] >> 4;
+    int th = seg[0] & 15;
+    int n = 0;
+    for (int i = 0; i < 16; i++)
+    {
+      n += seg[1 + i];
+    }
+    if (tc > 1 || th > 3 || n > 256 || len < 17 + n)
+    {
+      return -1;
+    }
+
+    huff_table_t *t = tc ? &d->dht_ac[th] : &d->dht_dc[th];
+    if (build_huff(t, seg + 1, seg + 17) < 0)
+    {
+      return -1;
+    }
+    if (tc)
+      d->ac_tab[th] = t;
+    else
+      d->dc_tab[th] = t;
+
+    seg += 17 + n;
+    len -= 17 + n;
+  }
+
+  return 0;
+}
+
+static int parse_sos(jpeg_decoder_t *d, const unsigned char *seg, int len)
+{
+  // 只支持包含全部分量的交织扫描（基线MJPEG都是这样）
+  if (len < 1 || seg[0] != d->ncomp || len < 1 + 2 * d->ncomp + 3)
+  {
+    return -1;
+  }
+
+  for (int i = 0; i < d->ncomp; i++)
+  {
+    int cs = seg[1 + 2 * i];
+    int td = seg[2 + 2 * i] >> 4;
+    int ta = seg[2 + 2 * i] & 15;
+
+    jpeg_component_t *c = NULL;
+    for (int j = 0; j < d->ncomp; j++)
+    {
+      if (d->comp[j].id == cs)
+        c = &d->comp[j];
+    }
+    if (!c || td > 3 || ta > 3 || !(d->qt_mask & (1 << c->tq)))
+    {
+      return -1;
+    }
+
+    c->dc = d->dc_tab[td];
+    c->ac = d->ac_tab[ta];
+  }
+
+  return 0;
+}
+
+/**
+ * @brief 解析SOI到SOS之间的标记段，返回时d->p指向熵编码数据
+ * @return 成功返回0，失败返回-1
+ */
+static int parse_headers(jpeg_decoder_t *d, const unsigned char *data, unsigned int size)
+{
+  const unsigned char *p = data;
+  const unsigned char *end = data + size;
+  int have_sof = 0;
+
+  if (size < 4 || p[0] != 0xFF || p[1] != JPEG_SOI)
+  {
+    return -1;
+  }
+  p += 2;
+
+  // 每帧从缺省Huffman表开始，帧内DHT会覆盖
+  d->qt_mask = 0;
+  d->restart_interval = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    d->dc_tab[i] = &d->std_dc[i ? 1 : 0];
+    d->ac_tab[i] = &d->std_ac[i ? 1 : 0];
+  }
+
+  for (;;)
+  {
+    while (p < end && *p != 0xFF)
+      p++;
+    while (p < end && *p == 0xFF)
+      p++;
+    if (p >= end)
+    {
+      return -1;
+    }
+
+    int marker = *p++;
+    if (marker == JPEG_SOI || marker == 0x01 || (marker >= JPEG_RST0 && marker <= JPEG_RST0 + 7))
+    {
+      continue; // 无长度的标记
+    }
+    if (marker == JPEG_EOI || end - p < 2)
+    {
+      return -1;
+    }
+
+    int len = (p[0] << 8) | p[1];
+    if (len < 2 || len > end - p)
+    {
+      return -1;
+    }
+
+    const unsigned char *seg = p + 2;
+    p += len;
+    len -= 2;
+
+    switch (marker)
+    {
+    case JPEG_SOF0:
+    case JPEG_SOF1:
+      if (parse_sof(d, seg, len) < 0)
+        return -1;
+      have_sof = 1;
+      break;
+
+    case JPEG_DQT:
+      if (parse_dqt(d, seg, len) < 0)
+        return -1;
+      break;
+
+    case JPEG_DHT:
+      if (parse_dht(d, seg, len) < 0)
+        return -1;
+      break;
+
+    case JPEG_DRI:
+      if (len < 2)
+        return -1;
+      d->restart_interval = (seg[0] << 8) | seg[1];
+      break;
+
+    case JPEG_SOS:
+      if (!have_sof || parse_sos(d, seg, len) < 0)
+        return -1;
+      d->p = p;
+      d->end = end;
+      return 0;
+
+    default:
+      // 其他SOFn（渐进、无损、算术编码）不支持，APPn/COM等直接跳过
+      if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC8 && marker != 0xCC)
+      {
+        return -1;
+      }
+      break;
+    }
+  }
+}
+
+/**
+ * @brief 把一个MCU行的分量样本转换成XRGB（色度按最近邻放大）
+ */
+static void convert_band(jpeg_decoder_t *d, int width, int rows)
+{
+  unsigned int *dst = d->band;
+
+  if (d->ncomp == 1)
+  {
+    const jpeg_component_t *c = &d->comp[0];
+    for (int y = 0; y < rows; y++, dst += width)
+    {
+      const unsigned char *s = c->plane + y * c->stride;
+      for (int x = 0; x < width; x++)
+      {
+        dst[x] = 0xFF000000 | (s[x] * 0x010101);
+      }
+    }
+    return;
+  }
+
+  const jpeg_component_t *cy = &d->comp[0];
+  const jpeg_component_t *cb = &d->comp[1];
+  const jpeg_component_t *cr = &d->comp[2];
+
+  for (int y = 0; y < rows; y++, dst += width)
+  {
+    const unsigned char *py = cy->plane + (y >> cy->vshift) * cy->stride;
+    const unsigned char *pb = cb->plane + (y >> cb->vshift) * cb->stride;
+    const unsigned char *pr = cr->plane + (y >> cr->vshift) * cr->stride;
+
+    for (int x = 0; x < width; x++)
+    {
+      int Y = py[x >> cy->hshift];
+      int u = pb[x >> cb->hshift];
+      int v = pr[x >> cr->hshift];
+
+      int r = Y + d->cr_r[v];
+      int g = Y + ((d->cb_g[u] + d->cr_g[v]) >> 16);
+      int b = Y + d->cb_b[u];
+
+      dst[x] = 0xFF000000 | (clamp_sample(r) << 16) | (clamp_sample(g) << 8) | clamp_sample(b);
+    }
+  }
+}
+
+/**
+ * @brief 创建解码器
+ */
+jpeg_decoder_t *jpeg_decoder_create(void)
+{
+  jpeg_decoder_t *dec = (jpeg_decoder_t *)malloc(sizeof(jpeg_decoder_t));
+  if (!dec)
+  {
+    perror("malloc jpeg_decoder_t failed");
+    return NULL;
+  }
+
+  memset(dec, 0, sizeof(jpeg_decoder_t));
+
+  build_huff(&dec->std_dc[0], jpeg_std_dc_luma_bits, jpeg_std_dc_luma_vals);
+  build_huff(&dec->std_ac[0], jpeg_std_ac_luma_bits, jpeg_std_ac_luma_vals);
+  build_huff(&dec->std_dc[1], jpeg_std_dc_chroma_bits, jpeg_std_dc_chroma_vals);
+  build_huff(&dec->std_ac[1], jpeg_std_ac_chroma_bits, jpeg_std_ac_chroma_vals);
+
+  // JFIF的YCbCr是全范围的，系数放大2^16取整
+  for (int i = 0; i < 256; i++)
+  {
+    int x = i - 128;
+    dec->cr_r[i] = (91881 * x + 32768) >> 16;  // 1.40200
+    dec->cb_b[i] = (116130 * x + 32768) >> 16; // 1.77200
+    dec->cr_g[i] = -46802 * x;                 // 0.71414
+    dec->cb_g[i] = -22554 * x + 32768;         // 0.34414
+  }
+
+  return dec;
+}
+
+/**
+ * @brief 销毁解码器
+ */
+void jpeg_decoder_destroy(jpeg_decoder_t *dec)
+{
+  if (!dec)
+  {
+    return;
+  }
+
+  free(dec->planes);
+  free(dec->band);
+  free(dec);
+}
+
+/**
+ * @brief 读取图像尺寸
+ */
+int jpeg_read_size(const unsigned char *data, unsigned int size, int *width, int *height)
+{
+  unsigned int pos = 2;
+
+  if (size < 4 || data[0] != 0xFF || data[1] != JPEG_SOI)
+  {
+    return -1;
+  }
+
+  while (pos + 4 <= size && data[pos] == 0xFF)
+  {
+    unsigned char marker = data[pos + 1];
+    if (marker == 0xFF)
+    {
+      pos++;
+      continue;
+    }
+    if (marker == JPEG_SOS || marker == JPEG_EOI)
+    {
+      break;
+    }
+
+    unsigned int len = (data[pos + 2] << 8) | data[pos + 3];
+    if (marker >= 0xC0 && marker <= 0xCF && marker != JPEG_DHT && marker != 0xC8 && marker != 0xCC)
+    {
+      if (len < 7 || pos + 2 + len > size)
+      {
+        return -1;
+      }
+      *height = (data[pos + 5] << 8) | data[pos + 6];
+      *width = (data[pos + 7] << 8) | data[pos + 8];
+      return 0;
+    }
+
+    pos += 2 + len;
+  }
+
+  return -1;
+}
+
+/**
+ * @brief 解码一帧JPEG
+ */
+int jpeg_decode(jpeg_decoder_t *dec, const unsigned char *data, unsigned int size, int scale,
+                jpeg_output_func output, void *arg)
+{
+  static const idct_func idcts[4] = {idct_1x1, idct_2x2, idct_4x4, idct_8x8};
+
+  if (!dec || !data || !output || (scale != 1 && scale != 2 && scale != 4 && scale != 8))
+  {
+    return -1;
+  }
+
+  if (parse_headers(dec, data, size) < 0)
+  {
+    return -1;
+  }
+
+  int bs = 8 / scale; // 亮度每块输出的边长
+  int mcu_w = 8 * dec->hmax;
+  int mcu_h = 8 * dec->vmax;
+  int mcux = (dec->width + mcu_w - 1) / mcu_w;
+  int mcuy = (dec->height + mcu_h - 1) / mcu_h;
+  int out_w = (dec->width + scale - 1) / scale;
+  int out_h = (dec->height + scale - 1) / scale;
+  int band_h = dec->vmax * bs;
+
+  // 缩小解码4:2:0时色度块改用大一倍的IDCT，省去放大
+  for (int i = 0; i < dec->ncomp; i++)
+  {
+    jpeg_component_t *c = &dec->comp[i];
+    int up = scale > 1 && c->h < dec->hmax && c->v < dec->vmax;
+    int log2bs = (scale == 1 ? 3 : scale == 2 ? 2 : scale == 4 ? 1 : 0) + up;
+
+    c->bs = 1 << log2bs;
+    c->idct = idcts[log2bs];
+    c->hshift = !up && c->h < dec->hmax;
+    c->vshift = !up && c->v < dec->vmax;
+  }
+
+  // 按需扩大MCU行缓冲和输出缓冲
+  size_t need = 0;
+  for (int i = 0; i < dec->ncomp; i++)
+  {
+    need += (size_t)mcux * dec->comp[i].h * dec->comp[i].bs * dec->comp[i].v * dec->comp[i].bs;
+  }
+  if (need > dec->planes_size)
+  {
+    unsigned char *planes = (unsigned char *)realloc(dec->planes, need);
+    if (!planes)
+    {
+      perror("malloc jpeg planes failed");
+      return -1;
+    }
+    dec->planes = planes;
+    dec->planes_size = need;
+  }
+
+  need = (size_t)out_w * band_h * sizeof(unsigned int);
+  if (need > dec->band_size)
+  {
+    unsigned int *band = (unsigned int *)realloc(dec->band, need);
+    if (!band)
+    {
+      perror("malloc jpeg band failed");
+      return -1;
+    }
+    dec->band = band;
+    dec->band_size = need;
+  }
+
+  unsigned char *plane = dec->planes;
+  for (int i = 0; i < dec->ncomp; i++)
+  {
+    jpeg_component_t *c = &dec->comp[i];
+    c->plane = plane;
+    c->stride = mcux * c->h * c->bs;
+    c->dc_pred = 0;
+    plane += c->stride * c->v * c->bs;
+  }
+
+  dec->bitbuf = 0;
+  dec->bits = 0;
+  dec->marker = 0;
+
+  int coef[64];
+  int restarts_left = dec->restart_interval;
+
+  for (int my = 0; my < mcuy; my++)
+  {
+    for (int mx = 0; mx < mcux; mx++)
+    {
+      if (dec->restart_interval)
+      {
+        if (restarts_left == 0)
+        {
+          process_restart(dec);
+          restarts_left = dec->restart_interval;
+        }
+        restarts_left--;
+      }
+
+      for (int i = 0; i < dec->ncomp; i++)
+      {
+        jpeg_component_t *c = &dec->comp[i];
+        for (int by = 0; by < c->v; by++)
+        {
+          for (int bx = 0; bx < c->h; bx++)
+          {
+            if (decode_block(dec, c, coef) < 0)
+            {
+              return -1;
+            }
+            c->idct(coef, c->plane + by * c->bs * c->stride + (mx * c->h + bx) * c->bs, c->stride);
+          }
+        }
+      }
+    }
+
+    int y = my * band_h;
+    int rows = out_h - y < band_h ? out_h - y : band_h;
+    convert_band(dec, out_w, rows);
+    output(arg, dec->band, out_w, y, out_w, rows);
+  }
+
+  return 0;
+}
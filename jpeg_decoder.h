@@ -0,0 +1,56 @@
+#ifndef __JPEG_DECODER_H__
+#define __JPEG_DECODER_H__
+
+/*
+ * 基线JPEG解码器（不依赖外部库），用于在LCD上预览MJPEG摄像头画面。
+ * 支持：8位基线/扩展基线Huffman编码、灰度和YCbCr（4:4:4/4:2:2/4:2:0）、
+ * 重启间隔(DRI/RSTn)、缺省Huffman表（UVC的MJPEG帧不带DHT），
+ * 以及1/2、1/4、1/8缩小解码（直接用4x4/2x2/1x1整数IDCT，不做完整IDCT）。
+ * 不支持渐进式和算术编码。
+ */
+
+typedef struct jpeg_decoder jpeg_decoder_t;
+
+/**
+ * @brief 输出回调：每解码完一个MCU行调用一次
+ * @param arg 调用者参数
+ * @param xrgb 本段像素（0xFFRRGGBB）
+ * @param stride 每行像素数
+ * @param y 本段第一行在输出图像中的行号
+ * @param width 输出图像宽度
+ * @param rows 本段行数
+ */
+typedef void (*jpeg_output_func)(void *arg, const unsigned int *xrgb, int stride,
+                                 int y, int width, int rows);
+
+/**
+ * @brief 创建解码器（内部缓冲区在多帧之间复用）
+ * @return 成功返回解码器，失败返回NULL
+ */
+jpeg_decoder_t *jpeg_decoder_create(void);
+
+/**
+ * @brief 销毁解码器
+ */
+void jpeg_decoder_destroy(jpeg_decoder_t *dec);
+
+/**
+ * @brief 读取图像尺寸（只解析到SOF）
+ * @return 成功返回0，失败返回-1
+ */
+int jpeg_read_size(const unsigned char *data, unsigned int size, int *width, int *height);
+
+/**
+ * @brief 解码一帧JPEG
+ * @param dec 解码器
+ * @param data JPEG数据
+ * @param size 数据大小
+ * @param scale 缩小倍数：1、2、4或8，输出尺寸为原尺寸/scale（向上取整）
+ * @param output 输出回调
+ * @param arg 回调参数
+ * @return 成功返回0，数据无效或不支持返回-1
+ */
+int jpeg_decode(jpeg_decoder_t *dec, const unsigned char *data, unsigned int size, int scale,
+                jpeg_output_func output, void *arg);
+
+#endif // __JPEG_DECODER_H__
@@ -0,0 +1,858 @@
+#include "jpeg_encoder.h"
+#include "jpeg_tables.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define JPEG_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define JPEG_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#define JPEG_MAX_THREADS 8
+#define JPEG_HEADER_MAX 1024   // 文件头(SOI~SOS)的最大长度
+#define JPEG_MCU_MAX_BYTES 2048 // 一个MCU(4个块)熵编码后的最大字节数（含0xFF填充）
+
+// 整数FDCT定点参数（与IJG libjpeg的islow实现相同，输出放大8倍）
+#define CONST_BITS 13
+#define PASS1_BITS 2
+
+#define FIX_0_298631336 2446
+#define FIX_0_390180644 3196
+#define FIX_0_541196100 4433
+#define FIX_0_765366865 6270
+#define FIX_0_899976223 7373
+#define FIX_1_175875602 9633
+#define FIX_1_501321110 12299
+#define FIX_1_847759065 15137
+#define FIX_1_961570560 16069
+#define FIX_2_053119869 16819
+#define FIX_2_562915447 20995
+#define FIX_3_072711026 25172
+
+#define DESCALE(x, n) (((x) + (1 << ((n)-1))) >> (n))
+#define LSHIFT(x, n) ((x) * (1 << (n)))
+
+// 量化除数：q = ((|x| + corr) * recip >> 16) * scale >> 16，用乘法代替除法，结果与四舍五入除法相同
+typedef struct
+{
+  unsigned short recip[64];
+  unsigned short corr[64];
+  unsigned short scale[64];
+} jpeg_divisors_t;
+
+// Huffman编码表（按符号索引）
+typedef struct
+{
+  unsigned short code[256];
+  unsigned char size[256];
+} huff_code_t;
+
+// 条带：一段MCU行的熵编码输出
+typedef struct
+{
+  unsigned char *data;
+  size_t size;
+  size_t capacity;
+  unsigned int acc; // 未输出的位（低bits位有效）
+  int bits;
+  int failed;       // 内存不足
+} jpeg_strip_t;
+
+typedef void (*quantize_fn)(const short *coef, const jpeg_divisors_t *div, short *out);
+
+struct jpeg_encoder
+{
+  int quality;                 // 当前量化表对应的质量，0表示未设置
+  unsigned char qt[2][64];     // 量化表（自然顺序）：亮度、色度
+  jpeg_divisors_t divisors[2];
+
+  huff_code_t dc_code[2];      // 亮度、色度
+  huff_code_t ac_code[2];
+
+  short y_lut[256];            // 有限范围Y -> 全范围，减128
+  short c_lut[256];            // 有限范围Cb/Cr -> 全范围，减128
+
+  // 当前任务
+  const unsigned char *yuyv;
+  int width;
+  int height;
+  int mcux;
+  int mcuy;
+  int strip_rows;              // 每个条带的MCU行数
+  int nstrips;
+  jpeg_strip_t strips[JPEG_MAX_THREADS * 2];
+
+  // 线程池
+  pthread_t threads[JPEG_MAX_THREADS];
+  int nthreads;                // 工作线程数（不含调用线程）
+  pthread_mutex_t mutex;
+  pthread_cond_t start_cond;
+  pthread_cond_t done_cond;
+  unsigned int generation;     // 每提交一次任务加1
+  int next_strip;
+  int done_strips;
+  int quit;
+
+  unsigned char *out;
+  size_t out_capacity;
+};
+
+static quantize_fn g_quantize;
+static const char *g_quantize_name = "c";
+static pthread_once_t g_quantize_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief 标量量化（参考实现）
+ */
+static void quantize_c(const short *coef, const jpeg_divisors_t *div, short *out)
+{
+  for (int i = 0; i < 64; i++)
+  {
+    int x = coef[i];
+    unsigned int t = (unsigned int)(x < 0 ? -x : x) + div->corr[i];
+    t = (t * div->recip[i]) >> 16;
+    t = (t * div->scale[i]) >> 16;
+    out[i] = x < 0 ? -(int)t : (int)t;
+  }
+}
+
+#ifdef JPEG_HAVE_NEON
+/**
+ * @brief NEON量化，一次8个系数
+ */
+static void quantize_neon(const short *coef, const jpeg_divisors_t *div, short *out)
+{
+  for (int i = 0; i < 64; i += 8)
+  {
+    int16x8_t x = vld1q_s16(coef + i);
+    int16x8_t sign = vshrq_n_s16(x, 15);
+    uint16x8_t a = vaddq_u16(vreinterpretq_u16_s16(vabsq_s16(x)), vld1q_u16(div->corr + i));
+
+    uint16x8_t recip = vld1q_u16(div->recip + i);
+    uint32x4_t lo = vmull_u16(vget_low_u16(a), vget_low_u16(recip));
+    uint32x4_t hi = vmull_u16(vget_high_u16(a), vget_high_u16(recip));
+    a = vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16));
+
+    uint16x8_t scale = vld1q_u16(div->scale + i);
+    lo = vmull_u16(vget_low_u16(a), vget_low_u16(scale));
+    hi = vmull_u16(vget_high_u16(a), vget_high_u16(scale));
+    a = vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16));
+
+    int16x8_t r = vreinterpretq_s16_u16(a);
+    vst1q_s16(out + i, vsubq_s16(veorq_s16(r, sign), sign));
+  }
+}
+#endif // JPEG_HAVE_NEON
+
+#ifdef JPEG_HAVE_X86
+/**
+ * @brief SSE2量化，一次8个系数（_mm_mulhi_epu16取乘积高16位）
+ */
+__attribute__((target("sse2"))) static void quantize_sse2(const short *coef, const jpeg_divisors_t *div, short *out)
+{
+  for (int i = 0; i < 64; i += 8)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i *)(coef + i));
+    __m128i sign = _mm_srai_epi16(x, 15);
+    __m128i a = _mm_sub_epi16(_mm_xor_si128(x, sign), sign);
+
+    a = _mm_add_epi16(a, _mm_loadu_si128((const __m128i *)(div->corr + i)));
+    a = _mm_mulhi_epu16(a, _mm_loadu_si128((const __m128i *)(div->recip + i)));
+    a = _mm_mulhi_epu16(a, _mm_loadu_si128((const __m128i *)(div->scale + i)));
+
+    _mm_storeu_si128((__m128i *)(out + i), _mm_sub_epi16(_mm_xor_si128(a, sign), sign));
+  }
+}
+#endif // JPEG_HAVE_X86
+
+/**
+ * @brief 选择量化内核（只执行一次），JPEG_KERNEL=c|sse2|neon 可强制指定
+ */
+static void select_quantize(void)
+{
+  const char *force = getenv("JPEG_KERNEL");
+
+  g_quantize = quantize_c;
+
+#ifdef JPEG_HAVE_NEON
+  if (!force || strcmp(force, "neon") == 0)
+  {
+    g_quantize = quantize_neon;
+    g_quantize_name = "neon";
+  }
+#endif
+
+#ifdef JPEG_HAVE_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2") && (!force || strcmp(force, "sse2") == 0))
+  {
+    g_quantize = quantize_sse2;
+    g_quantize_name = "sse2";
+  }
+#endif
+
+  (void)force;
+}
+
+/**
+ * @brief 计算除数的倒数表示（同libjpeg-turbo的compute_reciprocal）
+ */
+static void compute_divisor(unsigned int divisor, jpeg_divisors_t *div, int i)
+{
+  int r = 16 + (31 - __builtin_clz(divisor));
+  unsigned int fq = (1u << r) / divisor;
+  unsigned int fr = (1u << r) % divisor;
+  unsigned int c = divisor / 2; // 四舍五入
+
+  if (fr == 0) // 2的幂
+  {
+    fq >>= 1;
+    r--;
+  }
+  else if (fr <= divisor / 2)
+  {
+    c++;
+  }
+  else
+  {
+    fq++;
+  }
+
+  div->recip[i] = fq;
+  div->corr[i] = c;
+  div->scale[i] = 1u << (32 - r);
+}
+
+/**
+ * @brief 按IJG的质量缩放规则生成量化表
+ */
+static void set_quality(jpeg_encoder_t *enc, int quality)
+{
+  const unsigned char *base[2] = {jpeg_std_luma_quant, jpeg_std_chroma_quant};
+  int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+
+  for (int t = 0; t < 2; t++)
+  {
+    for (int i = 0; i < 64; i++)
+    {
+      int q = (base[t][i] * scale + 50) / 100;
+      q = q < 1 ? 1 : (q > 255 ? 255 : q);
+      enc->qt[t][i] = q;
+      compute_divisor(q * 8, &enc->divisors[t], i); // FDCT输出放大了8倍
+    }
+  }
+
+  enc->quality = quality;
+}
+
+/**
+ * @brief 由码长个数和符号生成Huffman编码表
+ */
+static void build_huff_code(huff_code_t *h, const unsigned char *bits, const unsigned char *vals)
+{
+  int code = 0, k = 0;
+
+  memset(h, 0, sizeof(*h));
+  for (int l = 1; l <= 16; l++)
+  {
+    for (int i = 0; i < bits[l - 1]; i++, k++, code++)
+    {
+      h->code[vals[k]] = code;
+      h->size[vals[k]] = l;
+    }
+    code <<= 1;
+  }
+}
+
+/**
+ * @brief 8x8整数FDCT（先行后列），输入为减128后的样本，输出放大8倍
+ */
+static void fdct_islow(short *data)
+{
+  int ws[64];
+  int tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+  int tmp10, tmp11, tmp12, tmp13;
+  int z1, z2, z3, z4, z5;
+
+  for (int pass = 0; pass < 2; pass++)
+  {
+    for (int i = 0; i < 8; i++)
+    {
+      // 第一遍处理行(步长1)，第二遍处理列(步长8)
+      int step = pass ? 8 : 1;
+      int base = pass ? i : i * 8;
+      int d[8];
+      for (int k = 0; k < 8; k++)
+      {
+        d[k] = pass ? ws[base + k * step] : data[base + k * step];
+      }
+
+      tmp0 = d[0] + d[7];
+      tmp7 = d[0] - d[7];
+      tmp1 = d[1] + d[6];
+      tmp6 = d[1] - d[6];
+      tmp2 = d[2] + d[5];
+      tmp5 = d[2] - d[5];
+      tmp3 = d[3] + d[4];
+      tmp4 = d[3] - d[4];
+
+      // 偶数部分
+      tmp10 = tmp0 + tmp3;
+      tmp13 = tmp0 - tmp3;
+      tmp11 = tmp1 + tmp2;
+      tmp12 = tmp1 - tmp2;
+
+      z1 = (tmp12 + tmp13) * FIX_0_541196100;
+
+      int out[8];
+      if (pass == 0)
+      {
+        out[0] = LSHIFT(tmp10 + tmp11, PASS1_BITS);
+        out[4] = LSHIFT(tmp10 - tmp11, PASS1_BITS);
+        out[2] = DESCALE(z1 + tmp13 * FIX_0_765366865, CONST_BITS - PASS1_BITS);
+        out[6] = DESCALE(z1 - tmp12 * FIX_1_847759065, CONST_BITS - PASS1_BITS);
+      }
+      else
+      {
+        out[0] = DESCALE(tmp10 + tmp11, PASS1_BITS);
+        out[4] = DESCALE(tmp10 - tmp11, PASS1_BITS);
+        out[2] = DESCALE(z1 + tmp13 * FIX_0_765366865, CONST_BITS + PASS1_BITS);
+        out[6] = DESCALE(z1 - tmp12 * FIX_1_847759065, CONST_BITS + PASS1_BITS);
+      }
+
+      // 奇数部分
+      z1 = tmp4 + tmp7;
+      z2 = tmp5 + tmp6;
+      z3 = tmp4 + tmp6;
+      z4 = tmp5 + tmp7;
+      z5 = (z3 + z4) * FIX_1_175875602;
+
+      tmp4 *= FIX_0_298631336;
+      tmp5 *= FIX_2_053119869;
+      tmp6 *= FIX_3_072711026;
+      tmp7 *= FIX_1_501321110;
+      z1 *= -FIX_0_899976223;
+      z2 *= -FIX_2_562915447;
+      z3 = z3 * -FIX_1_961570560 + z5;
+      z4 = z4 * -FIX_0_390180644 + z5;
+
+      int shift = pass ? CONST_BITS + PASS1_BITS : CONST_BITS - PASS1_BITS;
+      out[7] = DESCALE(tmp4 + z1 + z3, shift);
+      out[5] = DESCALE(tmp5 + z2 + z4, shift);
+      out[3] = DESCALE(tmp6 + z2 + z3, shift);
+      out[1] = DESCALE(tmp7 + z1 + z4, shift);
+
+      for (int k = 0; k < 8; k++)
+      {
+        if (pass)
+          data[base + k * step] = out[k];
+        else
+          ws[base + k * step] = out[k];
+      }
+    }
+  }
+}
+
+/**
+ * @brief 取出一个MCU(16x8)：Y0、Y1、Cb、Cr四个块，超出图像的部分复制边缘像素
+ */
+static void load_mcu(const jpeg_encoder_t *enc, int mx, int my, short blocks[4][64])
+{
+  int x0 = mx * 16;
+  int full = x0 + 16 <= enc->width;
+
+  for (int r = 0; r < 8; r++)
+  {
+    int y = my * 8 + r;
+    if (y >= enc->height)
+      y = enc->height - 1;
+
+    const unsigned char *row = enc->yuyv + (size_t)y * enc->width * 2;
+    short *cb = blocks[2] + r * 8;
+    short *cr = blocks[3] + r * 8;
+
+    for (int i = 0; i < 8; i++)
+    {
+      short *yd = (i < 4 ? blocks[0] + i * 2 : blocks[1] + (i - 4) * 2) + r * 8;
+      int x = x0 + i * 2; // 宏像素 Y0 U Y1 V
+      const unsigned char *p;
+
+      if (full || x + 2 <= enc->width)
+      {
+        p = row + x * 2;
+        yd[0] = enc->y_lut[p[0]];
+        yd[1] = enc->y_lut[p[2]];
+      }
+      else
+      {
+        p = row + (enc->width - 2) * 2; // 最后一个宏像素
+        yd[0] = yd[1] = enc->y_lut[p[2]];
+      }
+
+      cb[i] = enc->c_lut[p[1]];
+      cr[i] = enc->c_lut[p[3]];
+    }
+  }
+}
+
+/**
+ * @brief 确保条带缓冲区至少还有need字节
+ */
+static int strip_reserve(jpeg_strip_t *s, size_t need)
+{
+  if (s->size + need <= s->capacity)
+  {
+    return 0;
+  }
+
+  size_t capacity = s->capacity ? s->capacity * 2 : 64 * 1024;
+  while (capacity < s->size + need)
+  {
+    capacity *= 2;
+  }
+
+  unsigned char *data = (unsigned char *)realloc(s->data, capacity);
+  if (!data)
+  {
+    return -1;
+  }
+  s->data = data;
+  s->capacity = capacity;
+  return 0;
+}
+
+static inline void put_bits(jpeg_strip_t *s, unsigned int code, int size)
+{
+  s->acc = (s->acc << size) | (code & ((1u << size) - 1));
+  s->bits += size;
+
+  while (s->bits >= 8)
+  {
+    unsigned char c = s->acc >> (s->bits - 8);
+    s->data[s->size++] = c;
+    if (c == 0xFF)
+    {
+      s->data[s->size++] = 0; // 0xFF后填0，避免被当作标记
+    }
+    s->bits -= 8;
+  }
+}
+
+/**
+ * @brief 输出一个值的类别码和附加位
+ */
+static inline void put_value(jpeg_strip_t *s, const huff_code_t *h, int run, int v)
+{
+  int a = v < 0 ? -v : v;
+  int nbits = a ? 32 - __builtin_clz(a) : 0;
+  int sym = (run << 4) | nbits;
+
+  put_bits(s, h->code[sym], h->size[sym]);
+  if (nbits)
+  {
+    put_bits(s, v < 0 ? v - 1 : v, nbits);
+  }
+}
+
+/**
+ * @brief 对一个量化后的块做Huffman编码
+ */
+static void encode_block(jpeg_strip_t *s, const short *q, int *last_dc,
+                         const huff_code_t *dc, const huff_code_t *ac)
+{
+  put_value(s, dc, 0, q[0] - *last_dc);
+  *last_dc = q[0];
+
+  int run = 0;
+  for (int k = 1; k < 64; k++)
+  {
+    int v = q[jpeg_zigzag_order[k]];
+    if (v == 0)
+    {
+      run++;
+      continue;
+    }
+
+    while (run > 15)
+    {
+      put_bits(s, ac->code[0xF0], ac->size[0xF0]); // ZRL
+      run -= 16;
+    }
+    put_value(s, ac, run, v);
+    run = 0;
+  }
+
+  if (run)
+  {
+    put_bits(s, ac->code[0x00], ac->size[0x00]); // EOB
+  }
+}
+
+/**
+ * @brief 编码一个条带（条带开始时DC预测归零，结尾补1对齐到字节）
+ */
+static void encode_strip(jpeg_encoder_t *enc, int index)
+{
+  jpeg_strip_t *s = &enc->strips[index];
+  short blocks[4][64];
+  short q[64];
+  int last_dc[3] = {0, 0, 0};
+
+  int my0 = index * enc->strip_rows;
+  int my1 = my0 + enc->strip_rows < enc->mcuy ? my0 + enc->strip_rows : enc->mcuy;
+
+  s->size = 0;
+  s->acc = 0;
+  s->bits = 0;
+  s->failed = 0;
+
+  for (int my = my0; my < my1; my++)
+  {
+    for (int mx = 0; mx < enc->mcux; mx++)
+    {
+      if (strip_reserve(s, JPEG_MCU_MAX_BYTES) < 0)
+      {
+        s->failed = 1;
+        return;
+      }
+
+      load_mcu(enc, mx, my, blocks);
+      for (int b = 0; b < 4; b++)
+      {
+        int t = b < 2 ? 0 : 1;          // 量化表/Huffman表：亮度或色度
+        int c = b < 2 ? 0 : b - 1;      // 分量：Y、Cb、Cr
+        fdct_islow(blocks[b]);
+        g_quantize(blocks[b], &enc->divisors[t], q);
+        encode_block(s, q, &last_dc[c], &enc->dc_code[t], &enc->ac_code[t]);
+      }
+    }
+  }
+
+  if (s->bits > 0)
+  {
+    put_bits(s, 0x7F, 8 - s->bits);
+  }
+}
+
+/**
+ * @brief 领取并编码条带，直到没有剩余（调用线程和工作线程共用）
+ *        条带在锁内领取；encode_strip读取的任务参数在本任务所有条带完成之前不会改变
+ */
+static void run_strips(jpeg_encoder_t *enc)
+{
+  pthread_mutex_lock(&enc->mutex);
+  while (enc->next_strip < enc->nstrips)
+  {
+    int index = enc->next_strip++;
+    pthread_mutex_unlock(&enc->mutex);
+
+    encode_strip(enc, index);
+
+    pthread_mutex_lock(&enc->mutex);
+    if (++enc->done_strips == enc->nstrips)
+    {
+      pthread_cond_signal(&enc->done_cond);
+    }
+  }
+  pthread_mutex_unlock(&enc->mutex);
+}
+
+/**
+ * @brief 编码线程：等待新任务
+ */
+static void *encoder_thread_func(void *arg)
+{
+  jpeg_encoder_t *enc = (jpeg_encoder_t *)arg;
+  unsigned int seen = 0;
+
+  for (;;)
+  {
+    pthread_mutex_lock(&enc->mutex);
+    while (!enc->quit && enc->generation == seen)
+    {
+      pthread_cond_wait(&enc->start_cond, &enc->mutex);
+    }
+    if (enc->quit)
+    {
+      pthread_mutex_unlock(&enc->mutex);
+      break;
+    }
+    seen = enc->generation;
+    pthread_mutex_unlock(&enc->mutex);
+
+    run_strips(enc);
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief 写出SOI到SOS的文件头
+ * @return 写出的字节数
+ */
+static unsigned int write_headers(const jpeg_encoder_t *enc, unsigned char *p, int restart_interval)
+{
+  static const unsigned char jfif[] = {
+      0xFF, JPEG_SOI,
+      0xFF, JPEG_APP0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00};
+  static const unsigned char sos[] = {
+      0xFF, JPEG_SOS, 0x00, 0x0C, 0x03, 0x01, 0x00, 0x02, 0x11, 0x03, 0x11, 0x00, 0x3F, 0x00};
+  unsigned char *start = p;
+
+  memcpy(p, jfif, sizeof(jfif));
+  p += sizeof(jfif);
+
+  // DQT：两张8位量化表，Z字形顺序
+  *p++ = 0xFF;
+  *p++ = JPEG_DQT;
+  *p++ = 0x00;
+  *p++ = 2 + 2 * 65;
+  for (int t = 0; t < 2; t++)
+  {
+    *p++ = t;
+    for (int k = 0; k < 64; k++)
+    {
+      *p++ = enc->qt[t][jpeg_zigzag_order[k]];
+    }
+  }
+
+  // SOF0：Y为2x1采样（4:2:2），Cb、Cr为1x1
+  unsigned char sof[] = {
+      0xFF, JPEG_SOF0, 0x00, 0x11, 0x08,
+      (unsigned char)(enc->height >> 8), (unsigned char)enc->height,
+      (unsigned char)(enc->width >> 8), (unsigned char)enc->width,
+      0x03, 0x01, 0x21, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01};
+  memcpy(p, sof, sizeof(sof));
+  p += sizeof(sof);
+
+  p += jpeg_write_std_dht(p);
+
+  if (restart_interval)
+  {
+    *p++ = 0xFF;
+    *p++ = JPEG_DRI;
+    *p++ = 0x00;
+    *p++ = 0x04;
+    *p++ = restart_interval >> 8;
+    *p++ = restart_interval & 0xFF;
+  }
+
+  memcpy(p, sos, sizeof(sos));
+  p += sizeof(sos);
+
+  return p - start;
+}
+
+/**
+ * @brief 创建编码器
+ */
+jpeg_encoder_t *jpeg_encoder_create(int threads)
+{
+  pthread_once(&g_quantize_once, select_quantize);
+
+  jpeg_encoder_t *enc = (jpeg_encoder_t *)malloc(sizeof(jpeg_encoder_t));
+  if (!enc)
+  {
+    perror("malloc jpeg_encoder_t failed");
+    return NULL;
+  }
+
+  memset(enc, 0, sizeof(jpeg_encoder_t));
+
+  build_huff_code(&enc->dc_code[0], jpeg_std_dc_luma_bits, jpeg_std_dc_luma_vals);
+  build_huff_code(&enc->ac_code[0], jpeg_std_ac_luma_bits, jpeg_std_ac_luma_vals);
+  build_huff_code(&enc->dc_code[1], jpeg_std_dc_chroma_bits, jpeg_std_dc_chroma_vals);
+  build_huff_code(&enc->ac_code[1], jpeg_std_ac_chroma_bits, jpeg_std_ac_chroma_vals);
+
+  // 摄像头YUV为BT.601有限范围，JFIF为全范围
+  for (int i = 0; i < 256; i++)
+  {
+    int y = i < 16 ? 0 : ((i - 16) * 255 + 109) / 219;
+    int c = i < 128 ? 128 - ((128 - i) * 255 + 112) / 224 : 128 + ((i - 128) * 255 + 112) / 224;
+    y = y > 255 ? 255 : y;
+    c = c < 0 ? 0 : (c > 255 ? 255 : c);
+    enc->y_lut[i] = y - 128;
+    enc->c_lut[i] = c - 128;
+  }
+
+  if (threads <= 0)
+  {
+    threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if (threads < 1)
+    threads = 1;
+  if (threads > JPEG_MAX_THREADS)
+    threads = JPEG_MAX_THREADS;
+
+  pthread_mutex_init(&enc->mutex, NULL);
+  pthread_cond_init(&enc->start_cond, NULL);
+  pthread_cond_init(&enc->done_cond, NULL);
+
+  for (int i = 0; i < threads - 1; i++)
+  {
+    if (pthread_create(&enc->threads[i], NULL, encoder_thread_func, enc) != 0)
+    {
+      perror("创建JPEG编码线程失败");
+      break;
+    }
+    enc->nthreads++;
+  }
+
+  printf("JPEG编码器: %d线程, 量化内核 %s\n", enc->nthreads + 1, g_quantize_name);
+  return enc;
+}
+
+/**
+ * @brief 销毁编码器
+ */
+void jpeg_encoder_destroy(jpeg_encoder_t *enc)
+{
+  if (!enc)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&enc->mutex);
+  enc->quit = 1;
+  pthread_cond_broadcast(&enc->start_cond);
+  pthread_mutex_unlock(&enc->mutex);
+
+  for (int i = 0; i < enc->nthreads; i++)
+  {
+    pthread_join(enc->threads[i], NULL);
+  }
+
+  for (int i = 0; i < JPEG_MAX_THREADS * 2; i++)
+  {
+    free(enc->strips[i].data);
+  }
+
+  pthread_cond_destroy(&enc->done_cond);
+  pthread_cond_destroy(&enc->start_cond);
+  pthread_mutex_destroy(&enc->mutex);
+  free(enc->out);
+  free(enc);
+}
+
+/**
+ * @brief 把一帧YUYV编码成JPEG
+ */
+int jpeg_encode_yuyv(jpeg_encoder_t *enc, const unsigned char *yuyv, int width, int height,
+                     int quality, const unsigned char **jpeg, unsigned int *jpeg_size)
+{
+  if (!enc || !yuyv || !jpeg || !jpeg_size ||
+      width < 2 || (width & 1) || height < 1 || width > 65535 || height > 65535)
+  {
+    return -1;
+  }
+
+  quality = quality < 1 ? 1 : (quality > 100 ? 100 : quality);
+  if (quality != enc->quality)
+  {
+    set_quality(enc, quality);
+  }
+
+  // 单线程时不用重启标记；多线程时条带数取线程数的2倍，便于负载均衡
+  int mcux = (width + 15) / 16;
+  int mcuy = (height + 7) / 8;
+  int nstrips = enc->nthreads ? (enc->nthreads + 1) * 2 : 1;
+  if (nstrips > mcuy)
+    nstrips = mcuy;
+  int strip_rows = (mcuy + nstrips - 1) / nstrips;
+  while (mcux * strip_rows > 65535) // DRI是16位
+  {
+    strip_rows--;
+  }
+  nstrips = (mcuy + strip_rows - 1) / strip_rows;
+  if (nstrips > JPEG_MAX_THREADS * 2)
+  {
+    return -1;
+  }
+
+  // 任务参数和条带计数在同一次加锁中设置：上一帧迟到的工作线程在锁内看到的
+  // nstrips/next_strip总是属于同一个任务；领到条带之后、全部完成之前这些字段不会再变
+  pthread_mutex_lock(&enc->mutex);
+  enc->yuyv = yuyv;
+  enc->width = width;
+  enc->height = height;
+  enc->mcux = mcux;
+  enc->mcuy = mcuy;
+  enc->strip_rows = strip_rows;
+  enc->nstrips = nstrips;
+  enc->next_strip = 0;
+  enc->done_strips = 0;
+  enc->generation++;
+  pthread_cond_broadcast(&enc->start_cond);
+  pthread_mutex_unlock(&enc->mutex);
+
+  run_strips(enc);
+
+  pthread_mutex_lock(&enc->mutex);
+  while (enc->done_strips < enc->nstrips)
+  {
+    pthread_cond_wait(&enc->done_cond, &enc->mutex);
+  }
+  pthread_mutex_unlock(&enc->mutex);
+
+  // 拼接：文件头 + 条带(之间插入RSTn) + EOI
+  size_t total = JPEG_HEADER_MAX + 2;
+  for (int i = 0; i < enc->nstrips; i++)
+  {
+    if (enc->strips[i].failed)
+    {
+      fprintf(stderr, "JPEG编码内存不足\n");
+      return -1;
+    }
+    total += enc->strips[i].size + 2;
+  }
+
+  if (total > enc->out_capacity)
+  {
+    unsigned char *out = (unsigned char *)realloc(enc->out, total);
+    if (!out)
+    {
+      perror("malloc jpeg output failed");
+      return -1;
+    }
+    enc->out = out;
+    enc->out_capacity = total;
+  }
+
+  unsigned char *p = enc->out;
+  p += write_headers(enc, p, enc->nstrips > 1 ? enc->mcux * enc->strip_rows : 0);
+
+  for (int i = 0; i < enc->nstrips; i++)
+  {
+    memcpy(p, enc->strips[i].data, enc->strips[i].size);
+    p += enc->strips[i].size;
+    if (i + 1 < enc->nstrips)
+    {
+      *p++ = 0xFF;
+      *p++ = JPEG_RST0 + (i & 7);
+    }
+  }
+
+  *p++ = 0xFF;
+  *p++ = JPEG_EOI;
+
+  *jpeg = enc->out;
+  *jpeg_size = p - enc->out;
+  return 0;
+}
+
+/**
+ * @brief 返回当前选用的量化内核名称
+ */
+const char *jpeg_encoder_kernel_name(void)
+{
+  pthread_once(&g_quantize_once, select_quantize);
+  return g_quantize_name;
+}
@@ -0,0 +1,47 @@
+#ifndef __JPEG_ENCODER_H__
+#define __JPEG_ENCODER_H__
+
+/*
+ * 基线JPEG编码器（不依赖libjpeg），直接读取摄像头的YUYV(4:2:2)数据：
+ * 亮度、色度按4:2:2原样编码（MCU为16x8），不经过RGB转换，
+ * 只把摄像头的有限范围YUV(16~235/240)映射到JFIF的全范围YCbCr。
+ * 整数FDCT + SIMD量化(NEON/SSE2)，标准Huffman表。
+ * 多线程时图像按MCU行切成若干条带，条带之间用重启标记(RSTn)分隔，
+ * 各条带的熵编码互不依赖，由线程池并行完成后再拼接。
+ */
+
+typedef struct jpeg_encoder jpeg_encoder_t;
+
+/**
+ * @brief 创建编码器
+ * @param threads 编码线程数（含调用线程），<=0表示使用全部在线CPU
+ * @return 成功返回编码器，失败返回NULL
+ */
+jpeg_encoder_t *jpeg_encoder_create(int threads);
+
+/**
+ * @brief 销毁编码器（结束线程池）
+ */
+void jpeg_encoder_destroy(jpeg_encoder_t *enc);
+
+/**
+ * @brief 把一帧YUYV编码成JPEG
+ *        同一编码器不能被多个线程同时调用
+ * @param enc 编码器
+ * @param yuyv YUYV数据，每行width*2字节
+ * @param width 图像宽度（偶数）
+ * @param height 图像高度
+ * @param quality 质量1~100（IJG标准量化表缩放）
+ * @param jpeg 输出JPEG数据指针，指向编码器内部缓冲区，下次编码前有效
+ * @param jpeg_size 输出JPEG数据大小
+ * @return 成功返回0，失败返回-1
+ */
+int jpeg_encode_yuyv(jpeg_encoder_t *enc, const unsigned char *yuyv, int width, int height,
+                     int quality, const unsigned char **jpeg, unsigned int *jpeg_size);
+
+/**
+ * @brief 返回当前选用的量化内核名称
+ */
+const char *jpeg_encoder_kernel_name(void);
+
+#endif // __JPEG_ENCODER_H__
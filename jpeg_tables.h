@@ -0,0 +1,55 @@
+#ifndef __JPEG_TABLES_H__
+#define __JPEG_TABLES_H__
+
+/*
+ * JPEG编解码共用的常量表（ITU-T T.81）
+ */
+
+// 标记
+#define JPEG_SOI 0xD8
+#define JPEG_EOI 0xD9
+#define JPEG_SOF0 0xC0
+#define JPEG_SOF1 0xC1
+#define JPEG_DHT 0xC4
+#define JPEG_DQT 0xDB
+#define JPEG_DRI 0xDD
+#define JPEG_SOS 0xDA
+#define JPEG_RST0 0xD0
+#define JPEG_APP0 0xE0
+
+#define JPEG_STD_DHT_SIZE 420 // jpeg_write_std_dht写出的字节数（含标记）
+
+// Z字形序号 -> 自然顺序下标
+extern const unsigned char jpeg_zigzag_order[64];
+
+// 附录K.1的标准量化表（自然顺序，质量50）
+extern const unsigned char jpeg_std_luma_quant[64];
+extern const unsigned char jpeg_std_chroma_quant[64];
+
+// 附录K.3的标准Huffman表：bits[i]为码长i+1的码字个数
+extern const unsigned char jpeg_std_dc_luma_bits[16];
+extern const unsigned char jpeg_std_dc_luma_vals[12];
+extern const unsigned char jpeg_std_dc_chroma_bits[16];
+extern const unsigned char jpeg_std_dc_chroma_vals[12];
+extern const unsigned char jpeg_std_ac_luma_bits[16];
+extern const unsigned char jpeg_std_ac_luma_vals[162];
+extern const unsigned char jpeg_std_ac_chroma_bits[16];
+extern const unsigned char jpeg_std_ac_chroma_vals[162];
+
+/**
+ * @brief 写出包含4张标准Huffman表的DHT段
+ *        UVC摄像头的MJPEG帧通常省略DHT，补上后才是完整的JPEG文件
+ * @param out 输出缓冲区，至少JPEG_STD_DHT_SIZE字节
+ * @return 写出的字节数
+ */
+unsigned int jpeg_write_std_dht(unsigned char *out);
+
+/**
+ * @brief 检查JPEG数据在SOS之前是否带有DHT段
+ * @param data JPEG数据
+ * @param size 数据大小
+ * @return 有DHT返回1，没有返回0；找到SOS时返回其标记的偏移到*sos_offset（可为NULL），未找到为0
+ */
+int jpeg_has_dht(const unsigned char *data, unsigned int size, unsigned int *sos_offset);
+
+#endif // __JPEG_TABLES_H__
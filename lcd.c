@@ -5,9 +5,113 @@
 #include <fcntl.h>//头文件。
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/fb.h>
+
+#include "lcd.h"
+#include "yuv_convert.h"
+
+#define LCD_PAGE_SIZE (LCD_WIDTH*LCD_HEIGHT*4)
+
+//缓冲模式
+#define LCD_MODE_SINGLE  0 //直接画在可见页（无法查询fb信息时的退路）
+#define LCD_MODE_FLIP    1 //虚拟分辨率中的两页，FBIOPAN_DISPLAY翻页
+#define LCD_MODE_OFFSCR  2 //离屏后台缓冲，翻页时把脏区拷贝到可见页
 
 int fd = -1;
-int *plcd = NULL;
+int *plcd = NULL; //绘制目标：始终指向后台页
+
+static int *fb_base = NULL;   //帧缓冲映射基址
+static size_t fb_map_size = 0;
+static int *lcd_pages[2];     //翻页模式下的两页
+static int lcd_back = 0;      //后台页下标
+static int lcd_mode = LCD_MODE_SINGLE;
+static int lcd_vsync = 1;
+static struct fb_var_screeninfo lcd_vinfo;
+
+//块绘制的裁剪矩形
+static lcd_rect_t lcd_clip_rect = {0,0,LCD_WIDTH,LCD_HEIGHT};
+
+//自上次翻页以来的脏区（包围盒，x1/y1不含）
+static int dmg_x0 = LCD_WIDTH, dmg_y0 = LCD_HEIGHT, dmg_x1 = 0, dmg_y1 = 0;
+
+static void lcd_damage(int x,int y,int w,int h)
+{
+    if(x < dmg_x0) dmg_x0 = x;
+    if(y < dmg_y0) dmg_y0 = y;
+    if(x + w > dmg_x1) dmg_x1 = x + w;
+    if(y + h > dmg_y1) dmg_y1 = y + h;
+}
+
+//把脏区从src页拷贝到dst页
+static void lcd_copy_damage(int *dst,const int *src)
+{
+    int y;
+    if(dmg_x1 <= dmg_x0 || dmg_y1 <= dmg_y0)
+    {
+        return ;
+    }
+
+    for(y = dmg_y0; y < dmg_y1; y++)
+    {
+        memcpy(dst + y * LCD_WIDTH + dmg_x0,src + y * LCD_WIDTH + dmg_x0,
+               (dmg_x1 - dmg_x0) * sizeof(int));
+    }
+}
+
+static void lcd_wait_vsync(void)
+{
+#ifdef FBIO_WAITFORVSYNC
+    unsigned int crtc = 0;
+    if(lcd_vsync && ioctl(fd,FBIO_WAITFORVSYNC,&crtc) == -1)
+    {
+        //驱动不支持时不再尝试
+        lcd_vsync = 0;
+    }
+#endif
+}
+
+//查询并尽量扩展虚拟分辨率，能放下两页时使用翻页模式
+static int lcd_setup_flip(void)
+{
+    struct fb_fix_screeninfo finfo;
+
+    if(ioctl(fd,FBIOGET_VSCREENINFO,&lcd_vinfo) == -1 ||
+       ioctl(fd,FBIOGET_FSCREENINFO,&finfo) == -1)
+    {
+        perror("FBIOGET_SCREENINFO failed");
+        return -1;
+    }
+
+    if(lcd_vinfo.xres != LCD_WIDTH || lcd_vinfo.yres != LCD_HEIGHT ||
+       lcd_vinfo.bits_per_pixel != 32 || finfo.line_length != LCD_WIDTH * 4)
+    {
+        printf("LCD: unexpected mode %ux%u %ubpp, no double buffering\n",
+               lcd_vinfo.xres,lcd_vinfo.yres,lcd_vinfo.bits_per_pixel);
+        return -1;
+    }
+
+    if(lcd_vinfo.yres_virtual < 2 * LCD_HEIGHT)
+    {
+        struct fb_var_screeninfo v = lcd_vinfo;
+        v.yres_virtual = 2 * LCD_HEIGHT;
+        v.yoffset = 0;
+        if(ioctl(fd,FBIOPUT_VSCREENINFO,&v) == 0)
+        {
+            ioctl(fd,FBIOGET_VSCREENINFO,&lcd_vinfo);
+            ioctl(fd,FBIOGET_FSCREENINFO,&finfo);
+        }
+    }
+
+    if(lcd_vinfo.yres_virtual < 2 * LCD_HEIGHT || finfo.smem_len < 2 * LCD_PAGE_SIZE)
+    {
+        return -1;
+    }
+
+    return 0;
+}
 
 //打开屏幕并且映射
 void open_lcd()
@@ -20,27 +124,243 @@ void open_lcd()
         return ;
     }
 
-    plcd = mmap(NULL,800*480*4,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
-    if(plcd == MAP_FAILED)
+    //2.虚拟分辨率够两页时翻页，否则使用离屏后台缓冲
+    lcd_mode = lcd_setup_flip() == 0 ? LCD_MODE_FLIP : LCD_MODE_OFFSCR;
+    fb_map_size = lcd_mode == LCD_MODE_FLIP ? 2 * LCD_PAGE_SIZE : LCD_PAGE_SIZE;
+
+    fb_base = mmap(NULL,fb_map_size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+    if(fb_base == MAP_FAILED)
     {
         perror("mmap failed\n");
+        fb_base = NULL;
         return ;
     }
+
+    if(lcd_mode == LCD_MODE_FLIP)
+    {
+        //当前可见页作为前台，另一页作为后台
+        int front = lcd_vinfo.yoffset >= LCD_HEIGHT ? 1 : 0;
+        lcd_pages[0] = fb_base;
+        lcd_pages[1] = fb_base + LCD_WIDTH * LCD_HEIGHT;
+        lcd_back = 1 - front;
+        memcpy(lcd_pages[lcd_back],lcd_pages[front],LCD_PAGE_SIZE);
+        plcd = lcd_pages[lcd_back];
+        printf("LCD: page flipping enabled\n");
+    }
+    else
+    {
+        plcd = malloc(LCD_PAGE_SIZE);
+        if(plcd == NULL)
+        {
+            //内存不足时退回直接绘制
+            lcd_mode = LCD_MODE_SINGLE;
+            plcd = fb_base;
+        }
+        else
+        {
+            memcpy(plcd,fb_base,LCD_PAGE_SIZE);
+            printf("LCD: off-screen back buffer enabled\n");
+        }
+    }
 }
 
 
 //解除映射并且关闭屏幕文件
 void close_lcd()
 {
-    munmap(plcd,800*480*4);
+    if(fb_base != NULL)
+    {
+        if(lcd_mode == LCD_MODE_FLIP && lcd_pages[1 - lcd_back] != fb_base)
+        {
+            //退出时把画面留在第0页，方便其他程序直接使用
+            memcpy(fb_base,lcd_pages[1 - lcd_back],LCD_PAGE_SIZE);
+            lcd_vinfo.yoffset = 0;
+            ioctl(fd,FBIOPAN_DISPLAY,&lcd_vinfo);
+        }
+        else if(lcd_mode == LCD_MODE_OFFSCR)
+        {
+            free(plcd);
+        }
+
+        munmap(fb_base,fb_map_size);
+        fb_base = NULL;
+        plcd = NULL;
+    }
 
     close(fd);
 }
 
 void display_point(int x,int y,int color)
 {
-    if(0<= x && x<800 && 0<= y && y<480)
+    if(0<= x && x<LCD_WIDTH && 0<= y && y<LCD_HEIGHT)
+    {
+        *(plcd + LCD_WIDTH * y + x) = color;
+        lcd_damage(x,y,1,1);
+    }
+}
+
+void lcd_flip(int keep)
+{
+    if(fb_base == NULL)
     {
-        *(plcd + 800 * y + x) = color;
+        return ;
+    }
+
+    if(lcd_mode == LCD_MODE_FLIP)
+    {
+        lcd_vinfo.yoffset = lcd_back * LCD_HEIGHT;
+        if(ioctl(fd,FBIOPAN_DISPLAY,&lcd_vinfo) == -1)
+        {
+            perror("FBIOPAN_DISPLAY failed");
+        }
+        //等到新页真正显示出来，旧页才不再被扫描，可以作为后台继续绘制
+        lcd_wait_vsync();
+
+        lcd_back = 1 - lcd_back;
+        plcd = lcd_pages[lcd_back];
+        if(keep)
+        {
+            lcd_copy_damage(plcd,lcd_pages[1 - lcd_back]);
+        }
     }
+    else if(lcd_mode == LCD_MODE_OFFSCR)
+    {
+        lcd_wait_vsync();
+        lcd_copy_damage(fb_base,plcd);
+    }
+
+    dmg_x0 = LCD_WIDTH;
+    dmg_y0 = LCD_HEIGHT;
+    dmg_x1 = 0;
+    dmg_y1 = 0;
+}
+
+void lcd_set_vsync(int enable)
+{
+    lcd_vsync = enable;
+}
+
+void lcd_set_clip(const lcd_rect_t *clip)
+{
+    lcd_rect_t r = {0,0,LCD_WIDTH,LCD_HEIGHT};
+
+    if(clip != NULL)
+    {
+        //与屏幕求交
+        int x1 = clip->x + clip->w, y1 = clip->y + clip->h;
+        r.x = clip->x < 0 ? 0 : clip->x;
+        r.y = clip->y < 0 ? 0 : clip->y;
+        r.w = (x1 > LCD_WIDTH ? LCD_WIDTH : x1) - r.x;
+        r.h = (y1 > LCD_HEIGHT ? LCD_HEIGHT : y1) - r.y;
+        if(r.w < 0) r.w = 0;
+        if(r.h < 0) r.h = 0;
+    }
+
+    lcd_clip_rect = r;
+}
+
+void lcd_get_clip(lcd_rect_t *clip)
+{
+    *clip = lcd_clip_rect;
+}
+
+//把(x0,y0)处width*height的矩形裁剪到裁剪矩形内
+//返回值：0 完全在裁剪区外；1 裁剪后的屏幕坐标(*x0,*y0)、源图偏移(*sx,*sy)和尺寸(*w,*h)
+static int lcd_clip(int *x0,int *y0,int width,int height,int *sx,int *sy,int *w,int *h)
+{
+    const lcd_rect_t *c = &lcd_clip_rect;
+
+    *sx = *x0 < c->x ? c->x - *x0 : 0;
+    *sy = *y0 < c->y ? c->y - *y0 : 0;
+    *w = width - *sx;
+    *h = height - *sy;
+    *x0 += *sx;
+    *y0 += *sy;
+
+    if(*x0 + *w > c->x + c->w)
+    {
+        *w = c->x + c->w - *x0;
+    }
+    if(*y0 + *h > c->y + c->h)
+    {
+        *h = c->y + c->h - *y0;
+    }
+
+    return plcd != NULL && *w > 0 && *h > 0;
+}
+
+void lcd_fill_rect(int x0,int y0,int width,int height,int color)
+{
+    int sx,sy,w,h;
+    if(!lcd_clip(&x0,&y0,width,height,&sx,&sy,&w,&h))
+    {
+        return ;
+    }
+
+    int x,y;
+    for(y = 0; y < h; y++)
+    {
+        int *dst = plcd + (y0 + y) * LCD_WIDTH + x0;
+        for(x = 0; x < w; x++)
+        {
+            dst[x] = color;
+        }
+    }
+
+    lcd_damage(x0,y0,w,h);
+}
+
+void lcd_blit_yuyv(const unsigned char *yuyv,int width,int height,int x0,int y0)
+{
+    int sx,sy,w,h;
+    if(!lcd_clip(&x0,&y0,width,height,&sx,&sy,&w,&h))
+    {
+        return ;
+    }
+
+    int y;
+    for(y = 0; y < h; y++)
+    {
+        //源行从宏像素(Y0 U Y1 V)边界开始
+        const unsigned char *src = yuyv + ((sy + y) * width + (sx & ~1)) * 2;
+        unsigned int *dst = (unsigned int *)plcd + (y0 + y) * LCD_WIDTH + x0;
+
+        int n = w;
+        if(sx & 1)
+        {
+            //裁剪起点落在宏像素后一半时，单独转换第一个像素
+            dst[0] = yuv_to_xrgb(src[2],src[1],src[3]);
+            src += 4;
+            dst++;
+            n--;
+        }
+        if(n & 1)
+        {
+            //裁剪终点落在宏像素前一半时，最后一个像素的V仍在源行内，单独转换
+            n--;
+            dst[n] = yuv_to_xrgb(src[n * 2],src[n * 2 + 1],src[n * 2 + 3]);
+        }
+        yuyv_to_xrgb8888(src,dst,n);
+    }
+
+    lcd_damage(x0,y0,w,h);
+}
+
+void lcd_blit_xrgb(const unsigned int *src,int src_stride,int width,int height,int x0,int y0)
+{
+    int sx,sy,w,h;
+    if(!lcd_clip(&x0,&y0,width,height,&sx,&sy,&w,&h))
+    {
+        return ;
+    }
+
+    int y;
+    for(y = 0; y < h; y++)
+    {
+        memcpy((unsigned int *)plcd + (y0 + y) * LCD_WIDTH + x0,
+               src + (sy + y) * src_stride + sx,
+               w * sizeof(unsigned int));
+    }
+
+    lcd_damage(x0,y0,w,h);
 }
\ No newline at end of file
@@ -1,6 +1,18 @@
 #ifndef __LCD_H__
 #define __LCD_H__
 
+#define LCD_WIDTH  800
+#define LCD_HEIGHT 480
+
+//屏幕上的矩形区域
+typedef struct
+{
+    int x;
+    int y;
+    int w;
+    int h;
+} lcd_rect_t;
+
 void open_lcd();
 
 //解除映射并且关闭屏幕文件
@@ -8,4 +20,44 @@ void close_lcd();
 
 void display_point(int x,int y,int color);
 
-#endif
\ No newline at end of file
+/*
+    lcd_flip: 把后台页显示出来（FBIOPAN_DISPLAY翻页，或把脏区拷贝到可见页）
+    所有绘制函数都画在后台页，调用lcd_flip之后才会出现在屏幕上。
+    @keep: 非0时把本次绘制的区域同步到新的后台页（界面等只画一次的内容）；
+           每帧都会整体重画的区域（视频）传0，省去拷贝
+*/
+void lcd_flip(int keep);
+
+/*
+    lcd_fill_rect: 用纯色填充一个矩形
+*/
+void lcd_fill_rect(int x0,int y0,int width,int height,int color);
+
+/*
+    lcd_set_clip: 设置块绘制(lcd_blit_*, lcd_fill_rect)的裁剪矩形，clip为NULL时恢复为整个屏幕
+    lcd_get_clip: 取得当前裁剪矩形
+*/
+void lcd_set_clip(const lcd_rect_t *clip);
+void lcd_get_clip(lcd_rect_t *clip);
+
+//开关翻页时的FBIO_WAITFORVSYNC等待（默认开启，驱动不支持时自动关闭）
+void lcd_set_vsync(int enable);
+
+/*
+    lcd_blit_yuyv: 把一幅YUYV图像逐行转换后直接写入帧缓冲
+    @yuyv: YUYV图像数据
+    @width,height: 图像尺寸
+    @x0,y0: 显示起始位置的坐标（可以部分超出屏幕，按矩形一次性裁剪）
+*/
+void lcd_blit_yuyv(const unsigned char *yuyv,int width,int height,int x0,int y0);
+
+/*
+    lcd_blit_xrgb: 把一幅XRGB8888图像逐行复制到帧缓冲
+    @src: 像素数据
+    @src_stride: 源图像每行的像素个数
+    @width,height: 图像尺寸
+    @x0,y0: 显示起始位置的坐标
+*/
+void lcd_blit_xrgb(const unsigned int *src,int src_stride,int width,int height,int x0,int y0);
+
+#endif
@@ -20,8 +20,15 @@ int main(int argc, char *argv[])
   printf("[1/4] 初始化LCD显示...\n");
   open_lcd();
 
+  // 预先解码界面图片，之后切换界面只是内存拷贝
+  bmp_load("./main.bmp");
+  bmp_load("./ui.bmp");
+  bmp_load("./blank.bmp");
+
   printf("显示开始界面...\n");
-  bmp_display("./main.bmp", 0, 0); // 显示开始界面背景
+  compositor_init();
+  compositor_set_image(COMP_LAYER_BACKGROUND, "./main.bmp", 0, 0, NULL); // 显示开始界面背景
+  compositor_render();
 
   printf("点击屏幕'进入'按钮启动系统...\n");
   ts_point pt;
@@ -47,6 +54,7 @@ int main(int argc, char *argv[])
   // 正常退出
   printf("主程序退出\n");
 
+  bmp_cache_clear();
   close_lcd();
   return 0;
 }
\ No newline at end of file
@@ -8,6 +8,135 @@ static camera_module_t *g_cam_module = NULL;
 static server_module_t *g_srv_module = NULL;
 static int g_system_running = 0;
 
+// 监控系统启动参数
+typedef struct
+{
+  const char *device;     // 摄像头设备
+  camera_config_t camera; // 采集目标（格式、分辨率、帧率）
+  int jpeg_quality;       // YUYV截屏的JPEG质量，0表示发送原始YUYV
+  int live;               // 直播模式：每帧都广播给客户端
+  int delta;              // 直播帧按块增量编码
+  int motion;             // 运动检测自动截屏
+  char rtp_group[64];     // 非空时直播帧同时以RTP组播发送
+  int rtp_port;
+  int http_port;          // 非0时提供HTTP MJPEG服务
+} monitor_options_t;
+
+/**
+ * @brief 解析命令行参数
+ *        用法: video_server [-d 设备] [-s 宽x高] [-f 帧率] [-y] [-q 质量] [-l] [-D] [-m] [-u [组播地址[:端口]]] [-H [端口]]
+ *        默认优先用MJPEG（原样转发给客户端），-y 只采集YUYV
+ *        YUYV截屏按 -q 质量(1~100)编码成JPEG再发送，-q 0 发送原始YUYV
+ *        -l 直播模式：除截屏外，每一帧都广播给所有客户端
+ *        -D 低带宽直播：只发送变化的16x16块和定期关键帧（隐含 -l -y）
+ *        -m 运动检测：画面有运动时自动截屏并把运动框通知客户端（隐含 -y）
+ *        -u 组播：每帧以RTP/UDP只发送一次到组播组（默认 239.255.0.1:5004），局域网内客户端用 -u 接收
+ *        -H 浏览器观看：在该端口（默认8080）提供 /stream MJPEG直播和 /snapshot 截屏
+ */
+static void parse_options(int argc, char *argv[], monitor_options_t *opt)
+{
+  static const unsigned int formats[] = {V4L2_PIX_FMT_MJPEG, V4L2_PIX_FMT_JPEG, V4L2_PIX_FMT_YUYV, 0};
+  static const unsigned int yuyv_only[] = {V4L2_PIX_FMT_YUYV, 0};
+
+  memset(opt, 0, sizeof(*opt));
+  opt->device = "/dev/video7";
+  opt->camera.width = FRAME_WIDTH;
+  opt->camera.height = FRAME_HEIGHT;
+  opt->camera.fps = 30;
+  opt->camera.formats = formats;
+  opt->camera.buffers = CAMERA_BUFFER_COUNT;
+  opt->jpeg_quality = JPEG_QUALITY;
+  opt->rtp_port = RTP_DEFAULT_PORT;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+    {
+      opt->device = argv[++i];
+    }
+    else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+    {
+      if (sscanf(argv[++i], "%dx%d", &opt->camera.width, &opt->camera.height) != 2)
+      {
+        fprintf(stderr, "无效的分辨率: %s\n", argv[i]);
+        opt->camera.width = FRAME_WIDTH;
+        opt->camera.height = FRAME_HEIGHT;
+      }
+    }
+    else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+    {
+      opt->camera.fps = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-y") == 0)
+    {
+      opt->camera.formats = yuyv_only;
+    }
+    else if (strcmp(argv[i], "-l") == 0)
+    {
+      opt->live = 1;
+    }
+    else if (strcmp(argv[i], "-D") == 0)
+    {
+      opt->live = 1;
+      opt->delta = 1;
+      opt->camera.formats = yuyv_only;
+    }
+    else if (strcmp(argv[i], "-m") == 0)
+    {
+      opt->motion = 1;
+      opt->camera.formats = yuyv_only;
+    }
+    else if (strcmp(argv[i], "-u") == 0)
+    {
+      // 地址可省略：下一个参数不是选项时才当作地址
+      const char *group = RTP_DEFAULT_GROUP;
+      if (i + 1 < argc && argv[i + 1][0] != '-')
+      {
+        group = argv[++i];
+      }
+      snprintf(opt->rtp_group, sizeof(opt->rtp_group), "%s", group);
+
+      char *colon = strchr(opt->rtp_group, ':');
+      if (colon)
+      {
+        *colon = '\0';
+        opt->rtp_port = atoi(colon + 1);
+        if (opt->rtp_port <= 0 || opt->rtp_port > 65535)
+        {
+          fprintf(stderr, "无效的组播端口: %s\n", colon + 1);
+          opt->rtp_port = RTP_DEFAULT_PORT;
+        }
+      }
+    }
+    else if (strcmp(argv[i], "-H") == 0)
+    {
+      opt->http_port = HTTP_DEFAULT_PORT;
+      if (i + 1 < argc && argv[i + 1][0] != '-')
+      {
+        opt->http_port = atoi(argv[++i]);
+        if (opt->http_port <= 0 || opt->http_port > 65535)
+        {
+          fprintf(stderr, "无效的HTTP端口: %s\n", argv[i]);
+          opt->http_port = HTTP_DEFAULT_PORT;
+        }
+      }
+    }
+    else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc)
+    {
+      opt->jpeg_quality = atoi(argv[++i]);
+      if (opt->jpeg_quality < 0 || opt->jpeg_quality > 100)
+      {
+        fprintf(stderr, "无效的JPEG质量: %s\n", argv[i]);
+        opt->jpeg_quality = JPEG_QUALITY;
+      }
+    }
+    else
+    {
+      fprintf(stderr, "忽略未知参数: %s\n", argv[i]);
+    }
+  }
+}
+
 /**
  * @brief 触摸屏控制线程
  */
@@ -28,11 +157,8 @@ void *touch_control_thread()
       printf("点击了'退出'按钮\n");
       g_system_running = 0;
 
-      // 强制停止服务器，中断accept阻塞
-      if (g_srv_module && g_srv_module->server_fd >= 0)
-      {
-        shutdown(g_srv_module->server_fd, SHUT_RDWR);
-      }
+      // 中断网络事件循环
+      server_module_interrupt(g_srv_module);
 
       // ❌ 不要在这里调用back_menu()，会导致段错误
       // back_menu()应该在资源清理完成后由主函数调用
@@ -56,55 +182,16 @@ void *touch_control_thread()
 }
 
 /**
- * @brief 服务器接受连接线程
+ * @brief 网络事件线程
  */
 void *server_accept_thread(void *arg)
 {
   server_module_t *server = (server_module_t *)arg;
 
-  printf("服务器接受连接线程启动\n");
-
-  // 主循环: 接受客户端连接
-  while (g_system_running && server->is_running)
-  {
-    struct sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
-
-    int *client_sock = malloc(sizeof(int));
-    if (!client_sock)
-    {
-      continue;
-    }
+  printf("服务器网络事件线程启动\n");
+  server_module_run(server);
+  printf("服务器网络事件线程退出\n");
 
-    *client_sock = accept(server->server_fd, (struct sockaddr *)&client_addr, &client_len);
-
-    if (*client_sock < 0)
-    {
-      // accept被中断，检查是否需要退出
-      if (!g_system_running || !server->is_running)
-      {
-        printf("服务器正在关闭，停止接受新连接\n");
-        free(client_sock);
-        break;
-      }
-      perror("accept失败");
-      free(client_sock);
-      continue;
-    }
-
-    // 为每个客户端创建处理线程
-    pthread_t tid;
-    if (pthread_create(&tid, NULL, client_handler_wrapper, client_sock) != 0)
-    {
-      perror("创建客户端处理线程失败");
-      close(*client_sock);
-      free(client_sock);
-      continue;
-    }
-    pthread_detach(tid); // 分离线程,自动回收资源
-  }
-
-  printf("服务器接受连接线程退出\n");
   return NULL;
 }
 
@@ -117,12 +204,21 @@ int video_monitor(int argc, char *argv[])
   printf("   启动视频监控系统\n");
   printf("========================================\n");
 
-  // 显示UI界面
-  bmp_display("./ui.bmp", 0, 0);
+  // 显示UI界面：左侧交给视频层，只重画右侧按钮面板
+  lcd_rect_t video_rect = {VIDEO_REGION_X, VIDEO_REGION_Y, VIDEO_REGION_W, VIDEO_REGION_H};
+  lcd_rect_t panel_rect = {PANEL_REGION_X, PANEL_REGION_Y, PANEL_REGION_W, PANEL_REGION_H};
+  compositor_set_image(COMP_LAYER_BACKGROUND, "./blank.bmp", 0, 0, NULL);
+  compositor_set_image(COMP_LAYER_OVERLAY, "./ui.bmp", 0, 0, &panel_rect);
+  compositor_set_video(1, &video_rect);
+  compositor_render();
 
   // 1. 初始化摄像头模块
-  printf("[1/3] 初始化摄像头模块...\n");
-  g_cam_module = camera_module_init("/dev/video7", FRAME_WIDTH, FRAME_HEIGHT);
+  monitor_options_t opt;
+  parse_options(argc, argv, &opt);
+
+  printf("[1/3] 初始化摄像头模块 (%s, 目标 %dx%d@%dfps)...\n",
+         opt.device, opt.camera.width, opt.camera.height, opt.camera.fps);
+  g_cam_module = camera_module_init(opt.device, &opt.camera);
   if (!g_cam_module)
   {
     fprintf(stderr, "摄像头模块初始化失败\n");
@@ -146,6 +242,13 @@ int video_monitor(int argc, char *argv[])
     camera_module_close(g_cam_module);
     return -1;
   }
+  g_srv_module->jpeg_quality = opt.jpeg_quality;
+  g_srv_module->live_mode = opt.live;
+  g_srv_module->delta_mode = opt.delta;
+  g_srv_module->motion_mode = opt.motion;
+  g_srv_module->rtp_group = opt.rtp_group[0] ? opt.rtp_group : NULL;
+  g_srv_module->rtp_port = opt.rtp_port;
+  g_srv_module->http_port = opt.http_port;
 
   if (server_module_start(g_srv_module) < 0)
   {
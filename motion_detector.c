@@ -0,0 +1,381 @@
+#include "motion_detector.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MOTION_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MOTION_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+// 计算一行格（MOTION_CELL行像素）中每格的亮度均值
+typedef void (*cell_row_fn)(const unsigned char *yuyv, int stride, int cells, unsigned char *mean);
+
+struct motion_detector
+{
+  int width;
+  int height;
+  int grid_w; // 格数（不足一格的右/下边缘忽略）
+  int grid_h;
+  unsigned char *cur;  // 当前帧格亮度
+  unsigned short *bg;  // 背景格亮度（8.8定点）
+  unsigned char *mask; // 1：活动格，2：已归入区域
+  int *stack;          // 区域生长用的栈
+  int have_bg;
+  int active;
+  int on_count;
+  int off_count;
+};
+
+static cell_row_fn g_cell_row;
+static const char *g_cell_row_name = "c";
+static pthread_once_t g_cell_row_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief 标量实现：YUYV中偶数字节是亮度
+ */
+static void cell_row_c(const unsigned char *yuyv, int stride, int cells, unsigned char *mean)
+{
+  for (int c = 0; c < cells; c++)
+  {
+    const unsigned char *p = yuyv + c * MOTION_CELL * 2;
+    unsigned int sum = 0;
+    for (int y = 0; y < MOTION_CELL; y++)
+    {
+      for (int x = 0; x < MOTION_CELL * 2; x += 2)
+      {
+        sum += p[x];
+      }
+      p += stride;
+    }
+    mean[c] = (sum + MOTION_CELL * MOTION_CELL / 2) / (MOTION_CELL * MOTION_CELL);
+  }
+}
+
+#ifdef MOTION_HAVE_NEON
+/**
+ * @brief NEON实现：一格一行正好16字节，屏蔽色度后按16位累加（8行不会溢出）
+ */
+static void cell_row_neon(const unsigned char *yuyv, int stride, int cells, unsigned char *mean)
+{
+  const uint16x8_t luma = vdupq_n_u16(0x00FF);
+
+  for (int c = 0; c < cells; c++)
+  {
+    const unsigned char *p = yuyv + c * MOTION_CELL * 2;
+    uint16x8_t acc = vdupq_n_u16(0);
+    for (int y = 0; y < MOTION_CELL; y++)
+    {
+      acc = vaddq_u16(acc, vandq_u16(vreinterpretq_u16_u8(vld1q_u8(p)), luma));
+      p += stride;
+    }
+
+    uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(acc));
+    unsigned int total = (unsigned int)(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+    mean[c] = (total + MOTION_CELL * MOTION_CELL / 2) / (MOTION_CELL * MOTION_CELL);
+  }
+}
+#endif // MOTION_HAVE_NEON
+
+#ifdef MOTION_HAVE_X86
+/**
+ * @brief SSE2实现：屏蔽色度后用_mm_sad_epu8对零求和
+ */
+__attribute__((target("sse2"))) static void cell_row_sse2(const unsigned char *yuyv, int stride, int cells, unsigned char *mean)
+{
+  const __m128i luma = _mm_set1_epi16(0x00FF);
+  const __m128i zero = _mm_setzero_si128();
+
+  for (int c = 0; c < cells; c++)
+  {
+    const unsigned char *p = yuyv + c * MOTION_CELL * 2;
+    __m128i acc = _mm_setzero_si128();
+    for (int y = 0; y < MOTION_CELL; y++)
+    {
+      __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i *)p), luma);
+      acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+      p += stride;
+    }
+
+    unsigned int total = _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+    mean[c] = (total + MOTION_CELL * MOTION_CELL / 2) / (MOTION_CELL * MOTION_CELL);
+  }
+}
+#endif // MOTION_HAVE_X86
+
+/**
+ * @brief 选择内核（只执行一次），MOTION_KERNEL=c|sse2|neon 可强制指定
+ */
+static void select_cell_row(void)
+{
+  const char *force = getenv("MOTION_KERNEL");
+
+  g_cell_row = cell_row_c;
+
+#ifdef MOTION_HAVE_NEON
+  if (!force || strcmp(force, "neon") == 0)
+  {
+    g_cell_row = cell_row_neon;
+    g_cell_row_name = "neon";
+  }
+#endif
+
+#ifdef MOTION_HAVE_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2") && (!force || strcmp(force, "sse2") == 0))
+  {
+    g_cell_row = cell_row_sse2;
+    g_cell_row_name = "sse2";
+  }
+#endif
+
+  (void)force;
+}
+
+/**
+ * @brief 创建检测器
+ */
+motion_detector_t *motion_detector_create(int width, int height)
+{
+  if (width < MOTION_CELL || height < MOTION_CELL || (width & 1))
+  {
+    fprintf(stderr, "运动检测不支持的分辨率: %dx%d\n", width, height);
+    return NULL;
+  }
+
+  motion_detector_t *det = (motion_detector_t *)calloc(1, sizeof(motion_detector_t));
+  if (!det)
+  {
+    perror("malloc motion_detector_t failed");
+    return NULL;
+  }
+
+  det->width = width;
+  det->height = height;
+  det->grid_w = width / MOTION_CELL;
+  det->grid_h = height / MOTION_CELL;
+
+  int cells = det->grid_w * det->grid_h;
+  det->cur = (unsigned char *)malloc(cells);
+  det->bg = (unsigned short *)malloc(cells * sizeof(unsigned short));
+  det->mask = (unsigned char *)malloc(cells);
+  det->stack = (int *)malloc(cells * sizeof(int));
+  if (!det->cur || !det->bg || !det->mask || !det->stack)
+  {
+    perror("malloc motion buffer failed");
+    motion_detector_destroy(det);
+    return NULL;
+  }
+
+  pthread_once(&g_cell_row_once, select_cell_row);
+  return det;
+}
+
+/**
+ * @brief 销毁检测器
+ */
+void motion_detector_destroy(motion_detector_t *det)
+{
+  if (!det)
+  {
+    return;
+  }
+
+  free(det->cur);
+  free(det->bg);
+  free(det->mask);
+  free(det->stack);
+  free(det);
+}
+
+/**
+ * @brief 从活动格seed开始生长出一个区域（4邻域），返回区域格数和外接框（格坐标）
+ */
+static int grow_region(motion_detector_t *det, int seed, int *x0, int *y0, int *x1, int *y1)
+{
+  int top = 0;
+  int count = 0;
+
+  *x0 = *x1 = seed % det->grid_w;
+  *y0 = *y1 = seed / det->grid_w;
+  det->mask[seed] = 2;
+  det->stack[top++] = seed;
+
+  while (top > 0)
+  {
+    int i = det->stack[--top];
+    int x = i % det->grid_w;
+    int y = i / det->grid_w;
+    count++;
+
+    *x0 = x < *x0 ? x : *x0;
+    *x1 = x > *x1 ? x : *x1;
+    *y0 = y < *y0 ? y : *y0;
+    *y1 = y > *y1 ? y : *y1;
+
+    // 每个格入栈前就标记，栈深度不会超过格数
+    int neighbors[4] = {x > 0 ? i - 1 : -1, x + 1 < det->grid_w ? i + 1 : -1,
+                        y > 0 ? i - det->grid_w : -1, y + 1 < det->grid_h ? i + det->grid_w : -1};
+    for (int k = 0; k < 4; k++)
+    {
+      int n = neighbors[k];
+      if (n >= 0 && det->mask[n] == 1)
+      {
+        det->mask[n] = 2;
+        det->stack[top++] = n;
+      }
+    }
+  }
+
+  return count;
+}
+
+/**
+ * @brief 按面积插入运动框，只保留最大的MOTION_MAX_BOXES个
+ */
+static void insert_box(motion_result_t *result, int *areas, const motion_box_t *box, int area)
+{
+  int pos = result->box_count;
+  if (pos == MOTION_MAX_BOXES)
+  {
+    if (area <= areas[pos - 1])
+    {
+      return;
+    }
+    pos--;
+  }
+  else
+  {
+    result->box_count++;
+  }
+
+  while (pos > 0 && areas[pos - 1] < area)
+  {
+    result->boxes[pos] = result->boxes[pos - 1];
+    areas[pos] = areas[pos - 1];
+    pos--;
+  }
+  result->boxes[pos] = *box;
+  areas[pos] = area;
+}
+
+/**
+ * @brief 检测一帧
+ */
+int motion_detect_yuyv(motion_detector_t *det, const unsigned char *yuyv, motion_result_t *result)
+{
+  if (!det || !yuyv || !result)
+  {
+    return -1;
+  }
+
+  int stride = det->width * 2;
+  int cells = det->grid_w * det->grid_h;
+
+  memset(result, 0, sizeof(*result));
+
+  // 缩小的亮度图
+  for (int gy = 0; gy < det->grid_h; gy++)
+  {
+    g_cell_row(yuyv + gy * MOTION_CELL * stride, stride, det->grid_w, det->cur + gy * det->grid_w);
+  }
+
+  if (!det->have_bg)
+  {
+    for (int i = 0; i < cells; i++)
+    {
+      det->bg[i] = det->cur[i] << 8;
+    }
+    det->have_bg = 1;
+    result->active = det->active;
+    return 0;
+  }
+
+  // 与背景比较，同时更新背景（活动格学得更慢）
+  int active_cells = 0;
+  for (int i = 0; i < cells; i++)
+  {
+    int bg = det->bg[i];
+    int diff = det->cur[i] - ((bg + 128) >> 8);
+    int moving = diff > MOTION_CELL_THRESHOLD || diff < -MOTION_CELL_THRESHOLD;
+
+    det->mask[i] = moving;
+    active_cells += moving;
+    det->bg[i] = bg + (((det->cur[i] << 8) - bg) >> (moving ? MOTION_FG_SHIFT : MOTION_BG_SHIFT));
+  }
+
+  if (active_cells * 100 > cells * MOTION_LIGHT_PERCENT)
+  {
+    // 光照变化：直接以当前帧为背景
+    for (int i = 0; i < cells; i++)
+    {
+      det->bg[i] = det->cur[i] << 8;
+    }
+  }
+  else if (active_cells >= MOTION_MIN_CELLS)
+  {
+    int areas[MOTION_MAX_BOXES];
+    for (int i = 0; i < cells; i++)
+    {
+      if (det->mask[i] != 1)
+      {
+        continue;
+      }
+
+      int x0, y0, x1, y1;
+      int count = grow_region(det, i, &x0, &y0, &x1, &y1);
+      if (count < MOTION_MIN_CELLS)
+      {
+        continue;
+      }
+
+      motion_box_t box;
+      box.x = x0 * MOTION_CELL;
+      box.y = y0 * MOTION_CELL;
+      box.w = (x1 - x0 + 1) * MOTION_CELL;
+      box.h = (y1 - y0 + 1) * MOTION_CELL;
+      insert_box(result, areas, &box, count);
+      result->cells += count;
+    }
+  }
+
+  // 迟滞：连续若干帧才切换状态
+  if (!det->active)
+  {
+    det->on_count = result->cells > 0 ? det->on_count + 1 : 0;
+    if (det->on_count >= MOTION_ON_FRAMES)
+    {
+      det->active = 1;
+      det->off_count = 0;
+      result->changed = 1;
+    }
+  }
+  else
+  {
+    det->off_count = result->cells > 0 ? 0 : det->off_count + 1;
+    if (det->off_count >= MOTION_OFF_FRAMES)
+    {
+      det->active = 0;
+      det->on_count = 0;
+      result->changed = 1;
+    }
+  }
+
+  result->active = det->active;
+  return 0;
+}
+
+/**
+ * @brief 返回当前选用的内核名称
+ */
+const char *motion_kernel_name(void)
+{
+  pthread_once(&g_cell_row_once, select_cell_row);
+  return g_cell_row_name;
+}
@@ -0,0 +1,70 @@
+#ifndef __MOTION_DETECTOR_H__
+#define __MOTION_DETECTOR_H__
+
+/*
+ * 运动检测（只用YUYV中的亮度）：
+ * 图像按MOTION_CELL x MOTION_CELL像素分格，每格取亮度均值（SIMD: NEON/SSE2）得到缩小的亮度图，
+ * 与定点滑动平均的背景模型比较，差值超过阈值的格为活动格；相邻活动格连成区域，
+ * 足够大的区域输出为运动框。运动的开始/结束带迟滞（连续若干帧才切换状态），避免抖动。
+ * 画面大面积同时变化（开关灯、自动曝光）按光照变化处理：重置背景，不报运动。
+ */
+
+#define MOTION_CELL 8            // 格边长（像素）
+#define MOTION_MAX_BOXES 8       // 每帧最多输出的运动框数
+#define MOTION_CELL_THRESHOLD 12 // 格亮度与背景之差的阈值
+#define MOTION_MIN_CELLS 3       // 区域至少包含的活动格数
+#define MOTION_ON_FRAMES 3       // 连续多少帧有运动才进入运动状态
+#define MOTION_OFF_FRAMES 15     // 连续多少帧无运动才退出运动状态
+#define MOTION_BG_SHIFT 5        // 背景学习速率：每帧向当前值靠近1/32
+#define MOTION_FG_SHIFT 8        // 活动格的背景学习速率（静止下来的物体最终并入背景）
+#define MOTION_LIGHT_PERCENT 50  // 活动格超过该比例视为光照变化
+
+typedef struct motion_detector motion_detector_t;
+
+// 运动框（像素坐标）
+typedef struct
+{
+  unsigned short x;
+  unsigned short y;
+  unsigned short w;
+  unsigned short h;
+} motion_box_t;
+
+// 单帧检测结果
+typedef struct
+{
+  int active;   // 当前是否处于运动状态（已过迟滞）
+  int changed;  // 本帧运动状态是否发生切换（开始或结束）
+  int cells;    // 本帧计入运动区域的格数
+  int box_count;
+  motion_box_t boxes[MOTION_MAX_BOXES]; // 按面积从大到小
+} motion_result_t;
+
+/**
+ * @brief 创建检测器
+ * @param width 图像宽度（偶数）
+ * @param height 图像高度
+ * @return 成功返回检测器，失败返回NULL
+ */
+motion_detector_t *motion_detector_create(int width, int height);
+
+/**
+ * @brief 销毁检测器
+ */
+void motion_detector_destroy(motion_detector_t *det);
+
+/**
+ * @brief 检测一帧
+ * @param det 检测器
+ * @param yuyv YUYV数据，每行width*2字节
+ * @param result 输出检测结果
+ * @return 成功返回0，失败返回-1
+ */
+int motion_detect_yuyv(motion_detector_t *det, const unsigned char *yuyv, motion_result_t *result);
+
+/**
+ * @brief 返回当前选用的内核名称
+ */
+const char *motion_kernel_name(void);
+
+#endif // __MOTION_DETECTOR_H__
@@ -0,0 +1,176 @@
+#include "protocol.h"
+#include <string.h>
+#include <time.h>
+
+void protocol_put_le16(unsigned char *p, unsigned int v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+void protocol_put_le32(unsigned char *p, unsigned int v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+void protocol_put_le64(unsigned char *p, unsigned long long v)
+{
+  protocol_put_le32(p, (unsigned int)v);
+  protocol_put_le32(p + 4, (unsigned int)(v >> 32));
+}
+
+unsigned int protocol_get_le16(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+unsigned int protocol_get_le32(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+unsigned long long protocol_get_le64(const unsigned char *p)
+{
+  return protocol_get_le32(p) | ((unsigned long long)protocol_get_le32(p + 4) << 32);
+}
+
+static unsigned long long clock_us(clockid_t clock)
+{
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief 当前CLOCK_MONOTONIC时间（微秒）
+ */
+unsigned long long protocol_monotonic_us(void)
+{
+  return clock_us(CLOCK_MONOTONIC);
+}
+
+/**
+ * @brief 当前CLOCK_REALTIME时间（微秒）
+ */
+unsigned long long protocol_realtime_us(void)
+{
+  return clock_us(CLOCK_REALTIME);
+}
+
+/**
+ * @brief 按指定版本编码帧包头
+ */
+unsigned int protocol_encode_frame(unsigned char *out, const protocol_frame_t *frame, unsigned int version)
+{
+  if (version < 2)
+  {
+    // v1：秒级实时时钟，没有序号
+    protocol_put_le32(out, PROTOCOL_MAGIC);
+    protocol_put_le32(out + 4, frame->frame_size);
+    protocol_put_le32(out + 8, frame->width);
+    protocol_put_le32(out + 12, frame->height);
+    protocol_put_le32(out + 16, frame->format);
+    protocol_put_le32(out + 20, (unsigned int)time(NULL));
+    return PROTOCOL_V1_HEADER_SIZE;
+  }
+
+  memset(out, 0, PROTOCOL_V2_HEADER_SIZE);
+  protocol_put_le32(out, PROTOCOL_MAGIC);
+  protocol_put_le16(out + 4, 2);
+  protocol_put_le16(out + 6, PROTOCOL_V2_HEADER_SIZE);
+  protocol_put_le32(out + 8, frame->frame_size);
+  protocol_put_le16(out + 12, frame->width);
+  protocol_put_le16(out + 14, frame->height);
+  out[16] = frame->format;
+  out[17] = frame->flags;
+  protocol_put_le16(out + 18, frame->stream_id);
+  protocol_put_le64(out + 24, frame->seq);
+  protocol_put_le64(out + 32, frame->capture_us);
+  protocol_put_le64(out + 40, frame->send_us);
+  return PROTOCOL_V2_HEADER_SIZE;
+}
+
+/**
+ * @brief 解码v1包头
+ */
+int protocol_decode_v1(const unsigned char *in, protocol_frame_t *frame)
+{
+  if (protocol_get_le32(in) != PROTOCOL_MAGIC)
+  {
+    return -1;
+  }
+
+  memset(frame, 0, sizeof(*frame));
+  frame->version = 1;
+  frame->header_len = PROTOCOL_V1_HEADER_SIZE;
+  frame->frame_size = protocol_get_le32(in + 4);
+  frame->width = protocol_get_le32(in + 8);
+  frame->height = protocol_get_le32(in + 12);
+  frame->format = protocol_get_le32(in + 16);
+  frame->send_us = protocol_get_le32(in + 20) * 1000000ULL;
+  return 0;
+}
+
+/**
+ * @brief 解码v2包头
+ */
+int protocol_decode_v2(const unsigned char *in, unsigned int size, protocol_frame_t *frame)
+{
+  if (size < PROTOCOL_V2_HEADER_SIZE || protocol_get_le32(in) != PROTOCOL_MAGIC)
+  {
+    return -1;
+  }
+
+  unsigned int version = protocol_get_le16(in + 4);
+  unsigned int header_len = protocol_get_le16(in + 6);
+  if (version < 2 || header_len < PROTOCOL_V2_HEADER_SIZE)
+  {
+    return -1;
+  }
+
+  frame->version = version;
+  frame->header_len = header_len;
+  frame->frame_size = protocol_get_le32(in + 8);
+  frame->width = protocol_get_le16(in + 12);
+  frame->height = protocol_get_le16(in + 14);
+  frame->format = in[16];
+  frame->flags = in[17];
+  frame->stream_id = protocol_get_le16(in + 18);
+  frame->seq = protocol_get_le64(in + 24);
+  frame->capture_us = protocol_get_le64(in + 32);
+  frame->send_us = protocol_get_le64(in + 40);
+  return 0;
+}
+
+/**
+ * @brief 编码控制消息
+ */
+unsigned int protocol_encode_ctrl(unsigned char *out, unsigned int type, const void *payload, unsigned int length)
+{
+  protocol_put_le32(out, PROTOCOL_CTRL_MAGIC);
+  protocol_put_le16(out + 4, type);
+  protocol_put_le16(out + 6, length);
+  if (length)
+  {
+    memcpy(out + PROTOCOL_CTRL_HEADER_SIZE, payload, length);
+  }
+  return PROTOCOL_CTRL_HEADER_SIZE + length;
+}
+
+/**
+ * @brief 解码控制消息头
+ */
+int protocol_decode_ctrl(const unsigned char *in, unsigned int *type, unsigned int *length)
+{
+  if (protocol_get_le32(in) != PROTOCOL_CTRL_MAGIC)
+  {
+    return -1;
+  }
+
+  *type = protocol_get_le16(in + 4);
+  *length = protocol_get_le16(in + 6);
+  return *length > PROTOCOL_CTRL_PAYLOAD_MAX ? -1 : 0;
+}
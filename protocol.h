@@ -0,0 +1,145 @@
+#ifndef __PROTOCOL_H__
+#define __PROTOCOL_H__
+
+/*
+ * 服务器与客户端之间的传输协议（server_module.c 和 video_client.c 共用）
+ *
+ * 服务器 -> 客户端的每个单元以4字节小端魔数开头：
+ *   0x12345678  图像帧：包头 + frame_size字节的图像数据，包头格式取决于协商的版本
+ *   "SCRM"      控制消息：8字节控制头 + 负载
+ * 客户端 -> 服务器只发送控制消息。
+ *
+ * v1包头（24字节，老客户端）：
+ *   magic u32 | frame_size u32 | width u32 | height u32 | format u32 | timestamp u32(秒)
+ * v2包头（PROTOCOL_V2_HEADER_SIZE字节，所有字段小端）：
+ *   0  magic u32        4  version u16       6  header_len u16
+ *   8  frame_size u32   12 width u16         14 height u16
+ *   16 format u8        17 flags u8          18 stream_id u16
+ *   20 reserved u32     24 seq u64           32 capture_us u64   40 send_us u64
+ *   capture_us为V4L2采集时间戳，send_us为开始发送的时间，均为服务器CLOCK_MONOTONIC微秒。
+ *   header_len大于已知长度时，多出的字段由新版本定义，旧客户端跳过即可。
+ *
+ * 版本协商：客户端连接后发送HELLO(最高版本)，服务器回复HELLO(采用的版本、时钟)，
+ * 回复之后的帧使用新版本包头；服务器不回复（老服务器）则一直是v1。
+ *
+ * 命令：客户端随时可以发送SUBSCRIBE（分辨率/裁剪/格式）、STREAM（订阅/退订直播、最大帧率）、
+ * SNAPSHOT（拉取一张截屏）和PING，服务器只发送客户端要求的内容。
+ */
+
+#define PROTOCOL_MAGIC 0x12345678
+#define PROTOCOL_CTRL_MAGIC 0x4D524353 // "SCRM"（小端）
+#define PROTOCOL_VERSION 2             // 本端支持的最高版本
+
+#define PROTOCOL_V1_HEADER_SIZE 24
+#define PROTOCOL_V2_HEADER_SIZE 48
+#define PROTOCOL_HEADER_MAX 64 // 编码后包头的最大长度
+
+#define PROTOCOL_CTRL_HEADER_SIZE 8 // magic u32 | type u16 | length u16
+#define PROTOCOL_CTRL_PAYLOAD_MAX 248
+
+// 图像格式（包头format字段）
+#define FRAME_FORMAT_YUYV 0
+#define FRAME_FORMAT_MJPEG 1 // 摄像头输出的JPEG帧原样转发（可能不含DHT，按MJPEG缺省Huffman表解码）
+#define FRAME_FORMAT_JPEG 2  // 服务器把YUYV帧编码成的完整JPEG（4:2:2，带DHT）
+#define FRAME_FORMAT_YUYV_DELTA 3 // YUYV块级增量帧（负载格式见delta_codec.h）
+#define FRAME_FORMAT_I420 4       // 平面YUV 4:2:0：Y平面w*h，之后U、V平面各(w/2)*(h/2)
+
+// 包头flags
+#define PROTOCOL_FLAG_SNAPSHOT 0x01 // 截屏帧（否则为直播帧）
+#define PROTOCOL_FLAG_KEYFRAME 0x02 // 增量流中的关键帧（可独立解码）
+
+// 控制消息类型
+#define PROTOCOL_CTRL_HELLO 1 // 客户端：u16最高版本 u16保留；服务器：u16采用版本 u16保留 u64单调时钟 u64实时时钟（微秒）
+#define PROTOCOL_CTRL_MOTION 2 // 服务器：u64帧序号 u16宽 u16高 u8状态(1运动中/0结束) u8框数 u16保留，之后每框u16 x,y,w,h
+// 客户端：u8缩小倍数(1/2/4) u8格式(YUYV/I420/JPEG) u16保留 u16裁剪x,y,w,h（w或h为0表示整帧）
+// 服务器：同样格式回复实际生效的参数（对齐、限制到图像范围后）
+#define PROTOCOL_CTRL_SUBSCRIBE 3
+// 客户端：u8直播(1订阅/0退订) u8推送(是否接收板端主动的截屏和运动通知) u16最大帧率(0不限)，
+// 直播/推送为PROTOCOL_STREAM_KEEP时保持不变；服务器：回复生效的值
+#define PROTOCOL_CTRL_STREAM 4
+#define PROTOCOL_CTRL_SNAPSHOT 5 // 客户端：无负载，请求一张截屏（服务器用下一帧回复，只发给该客户端）
+#define PROTOCOL_CTRL_PING 6     // 客户端：u64令牌；服务器：u64令牌 u64单调时钟（微秒）
+
+#define PROTOCOL_HELLO_REQUEST_SIZE 4
+#define PROTOCOL_HELLO_REPLY_SIZE 20
+#define PROTOCOL_MOTION_HEADER_SIZE 16
+#define PROTOCOL_MOTION_BOX_SIZE 8
+#define PROTOCOL_SUBSCRIBE_SIZE 12
+#define PROTOCOL_STREAM_SIZE 4
+#define PROTOCOL_STREAM_KEEP 0xFF
+#define PROTOCOL_PING_REQUEST_SIZE 8
+#define PROTOCOL_PING_REPLY_SIZE 16
+
+// 解码后的帧包头
+typedef struct
+{
+  unsigned int version;
+  unsigned int header_len;
+  unsigned int frame_size;
+  unsigned int width;
+  unsigned int height;
+  unsigned int format;
+  unsigned int flags;
+  unsigned int stream_id;
+  unsigned long long seq;        // v1为0
+  unsigned long long capture_us; // v1为0
+  unsigned long long send_us;    // v1为timestamp秒数*1000000（实时时钟）
+} protocol_frame_t;
+
+/**
+ * @brief 小端读写
+ */
+void protocol_put_le16(unsigned char *p, unsigned int v);
+void protocol_put_le32(unsigned char *p, unsigned int v);
+void protocol_put_le64(unsigned char *p, unsigned long long v);
+unsigned int protocol_get_le16(const unsigned char *p);
+unsigned int protocol_get_le32(const unsigned char *p);
+unsigned long long protocol_get_le64(const unsigned char *p);
+
+/**
+ * @brief 当前CLOCK_MONOTONIC时间（微秒）
+ */
+unsigned long long protocol_monotonic_us(void);
+
+/**
+ * @brief 当前CLOCK_REALTIME时间（微秒）
+ */
+unsigned long long protocol_realtime_us(void);
+
+/**
+ * @brief 按指定版本编码帧包头
+ * @param out 输出缓冲区，至少PROTOCOL_HEADER_MAX字节
+ * @param frame 包头字段
+ * @param version 1或2
+ * @return 包头字节数
+ */
+unsigned int protocol_encode_frame(unsigned char *out, const protocol_frame_t *frame, unsigned int version);
+
+/**
+ * @brief 解码v1包头（PROTOCOL_V1_HEADER_SIZE字节）
+ * @return 成功返回0，魔数错误返回-1
+ */
+int protocol_decode_v1(const unsigned char *in, protocol_frame_t *frame);
+
+/**
+ * @brief 解码v2包头
+ * @param in 包头数据
+ * @param size 可用字节数（至少PROTOCOL_V2_HEADER_SIZE）
+ * @return 成功返回0，魔数/版本/长度错误返回-1
+ */
+int protocol_decode_v2(const unsigned char *in, unsigned int size, protocol_frame_t *frame);
+
+/**
+ * @brief 编码控制消息
+ * @param out 输出缓冲区，至少PROTOCOL_CTRL_HEADER_SIZE + length字节
+ * @return 消息总字节数
+ */
+unsigned int protocol_encode_ctrl(unsigned char *out, unsigned int type, const void *payload, unsigned int length);
+
+/**
+ * @brief 解码控制消息头
+ * @return 成功返回0，魔数错误或负载过长返回-1
+ */
+int protocol_decode_ctrl(const unsigned char *in, unsigned int *type, unsigned int *length);
+
+#endif // __PROTOCOL_H__
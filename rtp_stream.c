@@ -0,0 +1,473 @@
+#define _GNU_SOURCE // sendmmsg/recvmmsg
+#include "rtp_stream.h"
+#include "protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define RTP_SNDBUF (1024 * 1024)
+#define RTP_RCVBUF (4 * 1024 * 1024)
+#define RTP_REORDER_WINDOW (RTP_CLOCK_RATE * 10) // 时间戳回退超过10秒视为发送端重启，而不是迟到的分片
+
+struct rtp_sender
+{
+  int sock;
+  unsigned int ssrc;
+  unsigned int seq;
+};
+
+// RTP头是网络字节序（大端）
+static void put_be16(unsigned char *p, unsigned int v)
+{
+  p[0] = v >> 8;
+  p[1] = v;
+}
+
+static void put_be32(unsigned char *p, unsigned int v)
+{
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+static unsigned int get_be16(const unsigned char *p)
+{
+  return (p[0] << 8) | p[1];
+}
+
+static unsigned int get_be32(const unsigned char *p)
+{
+  return ((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/**
+ * @brief 创建发送端
+ */
+rtp_sender_t *rtp_sender_create(const char *group, int port, int ttl)
+{
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, group, &addr.sin_addr) <= 0)
+  {
+    fprintf(stderr, "无效的组播地址: %s\n", group);
+    return NULL;
+  }
+
+  rtp_sender_t *sender = (rtp_sender_t *)calloc(1, sizeof(rtp_sender_t));
+  if (!sender)
+  {
+    perror("malloc rtp_sender_t failed");
+    return NULL;
+  }
+
+  sender->sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (sender->sock < 0)
+  {
+    perror("socket创建失败");
+    free(sender);
+    return NULL;
+  }
+
+  // 回环：同一台机器上的接收端也能收到（方便本机测试）
+  unsigned char mttl = ttl;
+  unsigned char loop = 1;
+  int sndbuf = RTP_SNDBUF;
+  setsockopt(sender->sock, IPPROTO_IP, IP_MULTICAST_TTL, &mttl, sizeof(mttl));
+  setsockopt(sender->sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+  setsockopt(sender->sock, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+  // connect之后sendmmsg不需要逐个填写目的地址
+  if (connect(sender->sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+  {
+    perror("connect组播地址失败");
+    close(sender->sock);
+    free(sender);
+    return NULL;
+  }
+
+  sender->ssrc = (unsigned int)(protocol_realtime_us() ^ ((unsigned long long)getpid() << 16));
+  sender->seq = sender->ssrc & 0xFFFF;
+  return sender;
+}
+
+/**
+ * @brief 销毁发送端
+ */
+void rtp_sender_destroy(rtp_sender_t *sender)
+{
+  if (!sender)
+  {
+    return;
+  }
+
+  close(sender->sock);
+  free(sender);
+}
+
+/**
+ * @brief 分片发送一个单元
+ */
+int rtp_send_unit(rtp_sender_t *sender, const unsigned char *header, unsigned int header_size,
+                  const unsigned char *payload, unsigned int payload_size, unsigned long long capture_us)
+{
+  unsigned int total = header_size + payload_size;
+  if (total > RTP_UNIT_MAX)
+  {
+    fprintf(stderr, "RTP单元过大: %u bytes\n", total);
+    return -1;
+  }
+
+  unsigned int timestamp = (unsigned int)(capture_us * (RTP_CLOCK_RATE / 1000) / 1000);
+  unsigned char heads[RTP_BATCH][RTP_HEADER_SIZE + RTP_PAYLOAD_HEADER_SIZE];
+  struct iovec iov[RTP_BATCH][3];
+  struct mmsghdr msgs[RTP_BATCH];
+  unsigned int offset = 0;
+
+  while (offset < total)
+  {
+    // 一批最多RTP_BATCH个分片，每个分片是 头 + 包头的一段 + 图像数据的一段（分片可能跨过包头和数据的边界）
+    int count = 0;
+    for (; count < RTP_BATCH && offset < total; count++)
+    {
+      unsigned int end = offset + (total - offset < RTP_CHUNK ? total - offset : RTP_CHUNK);
+      unsigned char *h = heads[count];
+      int n = 0;
+
+      h[0] = 0x80; // V=2
+      h[1] = RTP_PAYLOAD_TYPE | (end == total ? 0x80 : 0);
+      put_be16(h + 2, sender->seq++);
+      put_be32(h + 4, timestamp);
+      put_be32(h + 8, sender->ssrc);
+      protocol_put_le32(h + RTP_HEADER_SIZE, offset);
+      protocol_put_le32(h + RTP_HEADER_SIZE + 4, total);
+
+      iov[count][n].iov_base = h;
+      iov[count][n].iov_len = RTP_HEADER_SIZE + RTP_PAYLOAD_HEADER_SIZE;
+      n++;
+      if (offset < header_size)
+      {
+        iov[count][n].iov_base = (void *)(header + offset);
+        iov[count][n].iov_len = (end < header_size ? end : header_size) - offset;
+        n++;
+      }
+      if (end > header_size)
+      {
+        unsigned int from = offset > header_size ? offset - header_size : 0;
+        iov[count][n].iov_base = (void *)(payload + from);
+        iov[count][n].iov_len = end - header_size - from;
+        n++;
+      }
+
+      memset(&msgs[count], 0, sizeof(msgs[count]));
+      msgs[count].msg_hdr.msg_iov = iov[count];
+      msgs[count].msg_hdr.msg_iovlen = n;
+      offset = end;
+    }
+
+    for (int sent = 0; sent < count;)
+    {
+      int ret = sendmmsg(sender->sock, msgs + sent, count - sent, 0);
+      if (ret < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        perror("sendmmsg failed");
+        return -1;
+      }
+      sent += ret;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * @brief 加入组播组，开始接收
+ */
+int rtp_receiver_open(rtp_receiver_t *receiver, const char *group, int port)
+{
+  memset(receiver, 0, sizeof(*receiver));
+  receiver->sock = -1;
+
+  struct in_addr group_addr;
+  if (inet_pton(AF_INET, group, &group_addr) <= 0)
+  {
+    fprintf(stderr, "无效的组播地址: %s\n", group);
+    return -1;
+  }
+
+  receiver->datagrams = malloc(RTP_BATCH * sizeof(*receiver->datagrams));
+  if (!receiver->datagrams)
+  {
+    perror("malloc rtp buffer failed");
+    return -1;
+  }
+
+  receiver->sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (receiver->sock < 0)
+  {
+    perror("socket创建失败");
+    rtp_receiver_close(receiver);
+    return -1;
+  }
+
+  // 同一台机器上可以有多个接收端
+  int opt = 1;
+  int rcvbuf = RTP_RCVBUF;
+  setsockopt(receiver->sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+  setsockopt(receiver->sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(receiver->sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+  {
+    perror("bind失败");
+    rtp_receiver_close(receiver);
+    return -1;
+  }
+
+  if (IN_MULTICAST(ntohl(group_addr.s_addr)))
+  {
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr = group_addr;
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(receiver->sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+    {
+      perror("加入组播组失败");
+      rtp_receiver_close(receiver);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * @brief 开始重组一个新单元
+ */
+static int start_unit(rtp_receiver_t *receiver, unsigned int timestamp, unsigned int size)
+{
+  if (size > receiver->unit_capacity)
+  {
+    unsigned char *unit = realloc(receiver->unit, size);
+    if (!unit)
+    {
+      perror("malloc rtp unit failed");
+      return -1;
+    }
+    receiver->unit = unit;
+
+    unsigned char *map = realloc(receiver->chunk_map, (size + RTP_CHUNK - 1) / RTP_CHUNK);
+    if (!map)
+    {
+      perror("malloc rtp unit failed");
+      return -1;
+    }
+    receiver->chunk_map = map;
+    receiver->unit_capacity = size;
+  }
+
+  receiver->unit_size = size;
+  receiver->chunks = (size + RTP_CHUNK - 1) / RTP_CHUNK;
+  receiver->chunks_received = 0;
+  memset(receiver->chunk_map, 0, receiver->chunks);
+  receiver->timestamp = timestamp;
+  receiver->active = 1;
+  return 0;
+}
+
+/**
+ * @brief 处理一个数据报
+ * @return 单元收齐返回1，否则返回0
+ */
+static int process_datagram(rtp_receiver_t *receiver, const unsigned char *d, unsigned int len)
+{
+  if (len <= RTP_HEADER_SIZE + RTP_PAYLOAD_HEADER_SIZE || (d[0] & 0xC0) != 0x80 ||
+      (d[1] & 0x7F) != RTP_PAYLOAD_TYPE)
+  {
+    return 0;
+  }
+
+  // 只接收锁定的发送端：组里另一个发送端的分片会写乱正在重组的单元
+  unsigned int ssrc = get_be32(d + 8);
+  unsigned long long now = protocol_monotonic_us();
+  if (receiver->have_ssrc && ssrc != receiver->ssrc)
+  {
+    if (now - receiver->ssrc_us < RTP_SSRC_TIMEOUT_US)
+    {
+      receiver->foreign++;
+      return 0;
+    }
+    // 锁定的发送端已沉默（重启后SSRC会变），改为跟随新的发送端
+    if (receiver->active)
+    {
+      receiver->dropped++;
+    }
+    receiver->active = 0;
+    receiver->have_seq = 0;
+    receiver->have_timestamp = 0;
+    receiver->have_ssrc = 0;
+  }
+  receiver->ssrc = ssrc;
+  receiver->have_ssrc = 1;
+  receiver->ssrc_us = now;
+  receiver->packets++;
+
+  // 序号只向前推进，乱序到达的旧分片不算丢包
+  unsigned int seq = get_be16(d + 2);
+  unsigned int gap = (seq - receiver->next_seq) & 0xFFFF;
+  if (!receiver->have_seq || gap < 0x8000)
+  {
+    receiver->lost_packets += receiver->have_seq ? gap : 0;
+    receiver->next_seq = (seq + 1) & 0xFFFF;
+    receiver->have_seq = 1;
+  }
+
+  unsigned int timestamp = get_be32(d + 4);
+  unsigned int offset = protocol_get_le32(d + RTP_HEADER_SIZE);
+  unsigned int total = protocol_get_le32(d + RTP_HEADER_SIZE + 4);
+  unsigned int length = len - RTP_HEADER_SIZE - RTP_PAYLOAD_HEADER_SIZE;
+  if (total == 0 || total > RTP_UNIT_MAX || offset % RTP_CHUNK != 0 || offset >= total ||
+      length != (total - offset < RTP_CHUNK ? total - offset : RTP_CHUNK))
+  {
+    return 0;
+  }
+
+  if (!receiver->have_timestamp || timestamp != receiver->timestamp)
+  {
+    int diff = (int)(timestamp - receiver->timestamp);
+    if (receiver->have_timestamp && diff < 0 && diff > -RTP_REORDER_WINDOW)
+    {
+      return 0; // 已经放弃或完成的帧迟到的分片
+    }
+    if (receiver->active)
+    {
+      receiver->dropped++; // 上一帧没收齐
+    }
+    if (start_unit(receiver, timestamp, total) < 0)
+    {
+      receiver->active = 0;
+      return 0;
+    }
+    receiver->have_timestamp = 1;
+  }
+  else if (!receiver->active || total != receiver->unit_size)
+  {
+    return 0; // 已完成帧的重复分片，或长度不一致
+  }
+
+  unsigned int index = offset / RTP_CHUNK;
+  if (receiver->chunk_map[index])
+  {
+    return 0;
+  }
+  receiver->chunk_map[index] = 1;
+  memcpy(receiver->unit + offset, d + RTP_HEADER_SIZE + RTP_PAYLOAD_HEADER_SIZE, length);
+
+  if (++receiver->chunks_received < receiver->chunks)
+  {
+    return 0;
+  }
+  receiver->active = 0;
+  receiver->frames++;
+  return 1;
+}
+
+/**
+ * @brief 接收下一个完整的单元
+ */
+int rtp_receive_unit(rtp_receiver_t *receiver, const unsigned char **unit, unsigned int *size, int timeout_ms)
+{
+  for (;;)
+  {
+    while (receiver->batch_pos < receiver->batch_count)
+    {
+      int i = receiver->batch_pos++;
+      if (process_datagram(receiver, receiver->datagrams[i], receiver->lengths[i]))
+      {
+        *unit = receiver->unit;
+        *size = receiver->unit_size;
+        return 1;
+      }
+    }
+
+    struct pollfd pfd;
+    pfd.fd = receiver->sock;
+    pfd.events = POLLIN;
+    int ret = poll(&pfd, 1, timeout_ms);
+    if (ret == 0 || (ret < 0 && errno == EINTR))
+    {
+      return 0;
+    }
+    if (ret < 0)
+    {
+      perror("poll failed");
+      return -1;
+    }
+
+    // 一次系统调用取一批数据报
+    struct mmsghdr msgs[RTP_BATCH];
+    struct iovec iov[RTP_BATCH];
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < RTP_BATCH; i++)
+    {
+      iov[i].iov_base = receiver->datagrams[i];
+      iov[i].iov_len = RTP_DATAGRAM_MAX;
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int n = recvmmsg(receiver->sock, msgs, RTP_BATCH, MSG_DONTWAIT, NULL);
+    if (n < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      {
+        continue;
+      }
+      perror("recvmmsg failed");
+      return -1;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+      // 被截断的数据报不是本协议的
+      receiver->lengths[i] = (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) ? 0 : msgs[i].msg_len;
+    }
+    receiver->batch_count = n;
+    receiver->batch_pos = 0;
+  }
+}
+
+/**
+ * @brief 退出组播组并释放资源
+ */
+void rtp_receiver_close(rtp_receiver_t *receiver)
+{
+  if (receiver->sock >= 0)
+  {
+    close(receiver->sock); // 关闭socket时内核自动退出组播组
+    receiver->sock = -1;
+  }
+  free(receiver->unit);
+  free(receiver->chunk_map);
+  free(receiver->datagrams);
+  receiver->unit = NULL;
+  receiver->chunk_map = NULL;
+  receiver->datagrams = NULL;
+  receiver->unit_capacity = 0;
+}
@@ -0,0 +1,116 @@
+#ifndef __RTP_STREAM_H__
+#define __RTP_STREAM_H__
+
+/*
+ * RTP/UDP组播直播（server_module.c 和 video_client.c 共用）：
+ * 每帧只发送一次到组播组，局域网内任意多个客户端加入组即可接收，板子的上行只付一份带宽。
+ *
+ * 一个“单元”= v2帧包头（protocol.h）+ 图像数据，切成定长分片，每个分片一个UDP数据报：
+ *   RTP头（12字节，RFC 3550）：V=2 | PT=RTP_PAYLOAD_TYPE | 序号 | 90kHz时间戳（同一帧相同）| SSRC
+ *     最后一个分片置marker位
+ *   负载头（8字节，小端）：单元内偏移 u32 | 单元总长度 u32
+ *   之后是最多RTP_CHUNK字节的数据，除最后一个分片外都是RTP_CHUNK字节
+ * 接收端按偏移把分片放回单元，可以乱序；单元的分片未收齐就来了新的帧，整帧丢弃（容忍丢包，不重传）。
+ * 接收端锁定第一个发送端的SSRC，组里其它发送端的数据报丢弃；锁定的发送端沉默RTP_SSRC_TIMEOUT_US后
+ * 才改为跟随新的SSRC（发送端重启）。
+ */
+
+#define RTP_HEADER_SIZE 12
+#define RTP_PAYLOAD_HEADER_SIZE 8
+#define RTP_DATAGRAM_MAX 1400 // UDP负载上限（以太网MTU 1500减去IP/UDP头，留出隧道等余量）
+#define RTP_CHUNK (RTP_DATAGRAM_MAX - RTP_HEADER_SIZE - RTP_PAYLOAD_HEADER_SIZE)
+#define RTP_PAYLOAD_TYPE 96   // 动态负载类型
+#define RTP_CLOCK_RATE 90000  // 视频时间戳时钟（Hz）
+#define RTP_UNIT_MAX (16 * 1024 * 1024)
+#define RTP_BATCH 32          // 每次sendmmsg/recvmmsg的数据报数
+#define RTP_SSRC_TIMEOUT_US 2000000 // 锁定的发送端沉默多久后接受新的SSRC
+
+#define RTP_DEFAULT_GROUP "239.255.0.1"
+#define RTP_DEFAULT_PORT 5004
+
+typedef struct rtp_sender rtp_sender_t;
+
+// 接收端状态（rtp_receiver_open初始化，rtp_receiver_close释放）
+typedef struct
+{
+  int sock;
+  unsigned char *unit;        // 正在重组的单元
+  unsigned int unit_size;
+  unsigned int unit_capacity;
+  unsigned char *chunk_map;   // 已收到的分片（每分片1字节）
+  unsigned int chunks;        // 单元的分片数
+  unsigned int chunks_received;
+  unsigned int timestamp;     // 最近一帧的RTP时间戳
+  int have_timestamp;
+  int active;                 // 是否有未完成的单元
+  unsigned int next_seq;      // 期望的下一个RTP序号
+  int have_seq;
+  unsigned int ssrc;          // 锁定的发送端
+  int have_ssrc;
+  unsigned long long ssrc_us; // 最近一次收到锁定发送端数据报的时间（单调时钟）
+
+  // recvmmsg批量接收：一批里后面的数据报留到下次调用处理
+  unsigned char (*datagrams)[RTP_DATAGRAM_MAX];
+  unsigned int lengths[RTP_BATCH];
+  int batch_count;
+  int batch_pos;
+
+  unsigned long long packets;      // 收到的数据报数
+  unsigned long long lost_packets; // 按序号推算丢失的数据报数
+  unsigned long long frames;       // 完整收到的帧数
+  unsigned long long dropped;      // 分片不全而丢弃的帧数
+  unsigned long long foreign;      // 其它发送端（SSRC不同）的数据报数
+} rtp_receiver_t;
+
+/**
+ * @brief 创建发送端
+ * @param group 组播地址（也可以是单播地址）
+ * @param port 目的端口
+ * @param ttl 组播TTL，1表示不出本网段
+ * @return 成功返回发送端，失败返回NULL
+ */
+rtp_sender_t *rtp_sender_create(const char *group, int port, int ttl);
+
+/**
+ * @brief 销毁发送端
+ */
+void rtp_sender_destroy(rtp_sender_t *sender);
+
+/**
+ * @brief 分片发送一个单元（包头 + 图像数据不需要拼接，直接作为分散的iovec发送）
+ * @param sender 发送端
+ * @param header 帧包头
+ * @param header_size 包头字节数
+ * @param payload 图像数据
+ * @param payload_size 图像数据字节数
+ * @param capture_us 采集时间（微秒），换算成RTP时间戳
+ * @return 成功返回0，失败返回-1
+ */
+int rtp_send_unit(rtp_sender_t *sender, const unsigned char *header, unsigned int header_size,
+                  const unsigned char *payload, unsigned int payload_size, unsigned long long capture_us);
+
+/**
+ * @brief 加入组播组，开始接收
+ * @param receiver 接收端状态
+ * @param group 组播地址
+ * @param port 端口
+ * @return 成功返回0，失败返回-1
+ */
+int rtp_receiver_open(rtp_receiver_t *receiver, const char *group, int port);
+
+/**
+ * @brief 接收下一个完整的单元
+ * @param receiver 接收端状态
+ * @param unit 输出单元指针，指向接收端内部缓冲区，下次调用前有效
+ * @param size 输出单元字节数
+ * @param timeout_ms 最多等待的毫秒数
+ * @return 收到完整单元返回1，超时返回0，出错返回-1
+ */
+int rtp_receive_unit(rtp_receiver_t *receiver, const unsigned char **unit, unsigned int *size, int timeout_ms);
+
+/**
+ * @brief 退出组播组并释放资源
+ */
+void rtp_receiver_close(rtp_receiver_t *receiver);
+
+#endif // __RTP_STREAM_H__
@@ -1,116 +1,1835 @@
+#define _GNU_SOURCE // accept4
 #include "server_module.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <linux/errqueue.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/sockios.h>
 #include <arpa/inet.h>
 #include <time.h>
 #include <errno.h>
 #include "lcd.h"
+#include "compositor.h"
+#include "jpeg_tables.h"
 
-// 全局客户端socket列表（用于截屏广播）
-#define MAX_CLIENT_SOCKETS 10
-static int g_client_sockets[MAX_CLIENT_SOCKETS];
+#define MAX_EVENTS 64 // 每次epoll_wait最多处理的事件数
+
+// MSG_ZEROCOPY需要Linux 4.14+的内核和头文件，旧工具链退回普通sendmsg
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define SERVER_HAVE_ZEROCOPY 1
+#endif
+
+#define ZEROCOPY_MIN_SIZE (16 * 1024) // 图像数据小于该值时直接拷贝，零拷贝的页锁定开销不划算
+#define ZEROCOPY_PENDING_MAX 32       // 每个客户端最多等待完成通知的零拷贝发送数
+
+// 码率控制：内核发送队列里未发出的数据限制在RATE_NOTSENT_LOWAT左右，积压留在应用层队列
+// （满时丢弃最旧的帧），每RATE_INTERVAL_MS根据丢帧情况为每个客户端调整档位
+#define RATE_INTERVAL_MS 500
+#define RATE_NOTSENT_LOWAT (128 * 1024)
+#define RATE_UP_INTERVALS 4    // 连续多少个周期没有丢帧才尝试升一档
+#define RATE_UP_INTERVALS_MAX 64 // 升档后马上又拥塞时等待周期数加倍，最多到这里
+#define RATE_LOW_QUALITY 40    // 低质量档位的JPEG质量
+
+#define MAX_TRANSFORMS 8 // 每帧最多计算的不同变换数，其余订阅这一帧收原始直播帧
+
+#define CLIENT_HEADER_MAX HTTP_PART_HEADER_MAX // 每个客户端的当前帧包头缓冲区（不小于PROTOCOL_HEADER_MAX）
+
+// HTTP客户端的状态（client_t.http）
+#define HTTP_STATE_NONE 0     // 不是HTTP客户端
+#define HTTP_STATE_REQUEST 1  // 等待请求行
+#define HTTP_STATE_STREAM 2   // 正在观看MJPEG流
+#define HTTP_STATE_SNAPSHOT 3 // 等待一张截屏
+#define HTTP_STATE_DONE 4     // 响应发完后关闭
+
+// 码率档位：依次降低帧率、改用低质量JPEG（摄像头输出YUYV时才有低质量版本）
+typedef struct
+{
+  int divisor;     // 每divisor帧发送一帧
+  int low_quality; // 发送低质量版本
+} rate_level_t;
+
+static const rate_level_t g_rate_levels[] = {{1, 0}, {2, 0}, {2, 1}, {4, 1}, {8, 1}, {30, 1}};
+#define RATE_LEVELS (int)(sizeof(g_rate_levels) / sizeof(g_rate_levels[0]))
+
+// 已连接的客户端：由网络事件线程统一收发，每个客户端一个有界发送队列
+typedef struct client
+{
+  int sock;
+  int closed;                // 已断开，等本轮事件处理完再释放
+  struct client *next_closed;
+  int live;                  // 是否接收直播帧（新连接取live_mode，STREAM命令修改）
+  int push;                  // 是否接收板端主动推送的截屏和运动通知
+  int snapshot_request;      // 请求了一张截屏，直播线程取到下一帧时发送
+  unsigned int live_interval_us;    // 最大帧率对应的直播帧间隔（0不限）
+  unsigned long long live_next_us;  // 下一个直播帧最早的采集时间
+  int need_key;              // 增量流：下一帧必须是关键帧（新连接或队列丢过包，增量链已断开）
+  int transform_set;         // 是否订阅了变换（否则收原始直播帧），与transform一起持g_client_mutex修改
+  frame_transform_t transform;
+  int http;                  // HTTP_STATE_*：浏览器连接只收JPEG，帧前加HTTP段头而不是协议包头（持g_client_mutex修改）
+  frame_queue_t queue;       // 待发送的数据包
+  frame_packet_t *sending;   // 正在发送的数据包（已出队）
+  unsigned int sent;         // sending已发送的字节数
+  int want_write;            // 是否已注册EPOLLOUT
+  unsigned long long frames; // 已发送完的帧数
+  char peer[32];             // 客户端地址（日志用）
+
+  // 协议版本：HELLO回复发出之后才切换到next_version，之前排队的帧仍按旧版本编码
+  unsigned int version;
+  unsigned int next_version;
+  unsigned char header[CLIENT_HEADER_MAX]; // 按本客户端版本编码的当前帧包头（HTTP客户端为段头/响应头）
+  unsigned int header_size;
+
+  // 控制消息：发送缓冲区（在帧与帧之间插入）和接收缓冲区
+  unsigned char ctrl_out[2 * (PROTOCOL_CTRL_HEADER_SIZE + PROTOCOL_CTRL_PAYLOAD_MAX)];
+  unsigned int ctrl_len;
+  unsigned int ctrl_sent;
+  unsigned char ctrl_in[PROTOCOL_CTRL_HEADER_SIZE + PROTOCOL_CTRL_PAYLOAD_MAX];
+  unsigned int ctrl_in_len;
+
+  // 零拷贝发送：内核发完之前数据包不能释放，按发送序号等待完成通知
+  int zerocopy;                                         // 是否启用MSG_ZEROCOPY
+  unsigned int zc_next_id;                              // 下一次零拷贝sendmsg的序号（内核从0开始计数）
+  unsigned int zc_ids[ZEROCOPY_PENDING_MAX];
+  frame_packet_t *zc_packets[ZEROCOPY_PENDING_MAX];     // 等待完成的数据包（持有引用），NULL表示已完成
+  int zc_head;
+  int zc_count;
+  unsigned long long zc_sends;                          // 零拷贝发送次数
+  unsigned long long zc_copied;                         // 内核退回拷贝的次数
+
+  // 码率控制：网络事件线程统计并调整档位（持g_client_mutex修改），直播线程持锁读取
+  int notsent_lowat;                // 是否设置了TCP_NOTSENT_LOWAT
+  int rate_level;                   // g_rate_levels的下标
+  int rate_skip;                    // 本档位已跳过的帧数（直播线程）
+  int rate_good;                    // 连续没有丢帧的周期数
+  int rate_up_wait;                 // 升档需要的周期数
+  int rate_probing;                 // 刚升档，还在观察
+  unsigned long long bytes_sent;    // 写入socket的总字节数
+  unsigned long long rate_bytes;    // 上个周期结束时的bytes_sent
+  int rate_outq;                    // 上个周期结束时内核发送队列的字节数
+  unsigned long long rate_dropped;  // 上个周期结束时队列的丢帧数
+  unsigned int throughput;          // 最近一个周期对端确认的字节数/秒
+} client_t;
+
+// 全局客户端列表（用于截屏和直播广播）
+// 只有网络事件线程增删客户端，广播线程持锁遍历
+#define MAX_CLIENT_SOCKETS 256
+static client_t *g_clients[MAX_CLIENT_SOCKETS];
 static int g_client_count = 0;
 static pthread_mutex_t g_client_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_demand_cond = PTHREAD_COND_INITIALIZER; // 有客户端订阅直播或请求截屏（配合g_client_mutex）
+static client_t *g_closed_clients = NULL; // 本轮epoll_wait中已断开的客户端（仅网络事件线程访问）
+static int g_pinned_frames = 0;            // 被数据包借用的摄像头缓冲区数（原子操作）
+
+/**
+ * @brief 添加客户端
+ * @return 成功返回0，客户端已满返回-1
+ */
+static int add_client(client_t *client)
+{
+  int ret = -1;
+
+  pthread_mutex_lock(&g_client_mutex);
+  if (g_client_count < MAX_CLIENT_SOCKETS)
+  {
+    g_clients[g_client_count++] = client;
+    printf("添加客户端socket: %d, 当前客户端数: %d\n", client->sock, g_client_count);
+    ret = 0;
+  }
+  pthread_mutex_unlock(&g_client_mutex);
+
+  return ret;
+}
+
+/**
+ * @brief 移除客户端（之后不会再有数据包入队）
+ */
+static void remove_client(client_t *client)
+{
+  pthread_mutex_lock(&g_client_mutex);
+  for (int i = 0; i < g_client_count; i++)
+  {
+    if (g_clients[i] == client)
+    {
+      // 将后面的元素前移
+      for (int j = i; j < g_client_count - 1; j++)
+      {
+        g_clients[j] = g_clients[j + 1];
+      }
+      g_client_count--;
+      printf("移除客户端socket: %d, 当前客户端数: %d\n", client->sock, g_client_count);
+      break;
+    }
+  }
+  pthread_mutex_unlock(&g_client_mutex);
+}
+
+/**
+ * @brief 等待有客户端需要帧（订阅直播或请求截屏，开启组播时总是需要），没有需求时直播线程在这里休眠，不取帧也不编码
+ * @param need_low 输出是否有客户端处于低质量档位
+ * @param snapshots 输出请求截屏的客户端数
+ * @return 订阅直播的客户端数（服务器停止时可能和snapshots同为0）
+ */
+static int wait_for_demand(server_module_t *server, int *need_low, int *snapshots)
+{
+  int count = 0;
+  int low = 0;
+  int requests = 0;
+
+  pthread_mutex_lock(&g_client_mutex);
+  while (server->is_running)
+  {
+    for (int i = 0; i < g_client_count; i++)
+    {
+      count += g_clients[i]->live;
+      low |= g_clients[i]->live && g_rate_levels[g_clients[i]->rate_level].low_quality;
+      requests += g_clients[i]->snapshot_request;
+    }
+    if (count > 0 || requests > 0 || server->rtp_sender)
+    {
+      break;
+    }
+
+    // 定时醒来检查is_running
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += 1;
+    pthread_cond_timedwait(&g_demand_cond, &g_client_mutex, &ts);
+  }
+  pthread_mutex_unlock(&g_client_mutex);
+
+  *need_low = low;
+  *snapshots = requests;
+  return count;
+}
+
+/**
+ * @brief 按客户端的最大帧率判断这一帧是否该发送（持g_client_mutex调用）
+ *        按固定间隔排出发送时刻，采集时间的抖动不会让实际帧率低于设定值
+ */
+static int live_frame_due(client_t *client, unsigned long long capture_us)
+{
+  if (!client->live_interval_us)
+  {
+    return 1;
+  }
+  if (capture_us < client->live_next_us)
+  {
+    return 0;
+  }
+
+  client->live_next_us += client->live_interval_us;
+  if (client->live_next_us <= capture_us)
+  {
+    client->live_next_us = capture_us + client->live_interval_us; // 第一帧或落后太多，重新排
+  }
+  return 1;
+}
+
+/**
+ * @brief 收集订阅直播的客户端要求的不同变换（每种只算一次）
+ * @param transforms 输出，最多MAX_TRANSFORMS个
+ * @return 变换数
+ */
+static int collect_transforms(frame_transform_t *transforms)
+{
+  int count = 0;
+
+  pthread_mutex_lock(&g_client_mutex);
+  for (int i = 0; i < g_client_count && count < MAX_TRANSFORMS; i++)
+  {
+    client_t *client = g_clients[i];
+    if (!client->live || !client->transform_set)
+    {
+      continue;
+    }
+
+    int k = 0;
+    while (k < count && !frame_transform_equal(&transforms[k], &client->transform))
+    {
+      k++;
+    }
+    if (k == count)
+    {
+      transforms[count++] = client->transform;
+    }
+  }
+  pthread_mutex_unlock(&g_client_mutex);
+
+  return count;
+}
+
+/**
+ * @brief 唤醒网络事件线程
+ */
+static void wake_reactor(server_module_t *server)
+{
+  unsigned long long one = 1;
+  if (server->wake_fd >= 0 && write(server->wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+  {
+    perror("write eventfd failed");
+  }
+}
+
+/**
+ * @brief 把板端主动推送的数据包（截屏、运动通知）放入客户端的发送队列，由网络事件线程负责发送
+ * @return 入队的客户端数
+ */
+static int broadcast_packet(server_module_t *server, frame_packet_t *packet)
+{
+  int count = 0;
+
+  pthread_mutex_lock(&g_client_mutex);
+  for (int i = 0; i < g_client_count; i++)
+  {
+    client_t *client = g_clients[i];
+    if (!client->push)
+    {
+      continue;
+    }
+
+    client->need_key |= frame_queue_push(&client->queue, packet) > 0; // 挤掉了增量流的包
+    count++;
+  }
+  pthread_mutex_unlock(&g_client_mutex);
+
+  if (count > 0)
+  {
+    wake_reactor(server);
+  }
+  return count;
+}
+
+/**
+ * @brief 广播直播帧：按每个客户端的最大帧率和码率档位跳帧，低质量档位的客户端发送low（没有时发送packet），
+ *        订阅了变换的客户端发送对应的变换结果（本帧没有算出时发送packet）
+ * @param transforms 本帧的变换，variants为对应的数据包（可为NULL）
+ * @param http 1：只发给HTTP观看者（packet和low都是完整JPEG），0：只发给协议客户端
+ * @return 入队的客户端数
+ */
+static int broadcast_live(server_module_t *server, unsigned long long capture_us, frame_packet_t *packet,
+                          frame_packet_t *low, const frame_transform_t *transforms, frame_packet_t **variants,
+                          int variant_count, int http)
+{
+  int count = 0;
+
+  pthread_mutex_lock(&g_client_mutex);
+  for (int i = 0; i < g_client_count; i++)
+  {
+    client_t *client = g_clients[i];
+    const rate_level_t *level = &g_rate_levels[client->rate_level];
+    if (!client->live || (client->http != HTTP_STATE_NONE) != http || !live_frame_due(client, capture_us) ||
+        ++client->rate_skip < level->divisor)
+    {
+      continue;
+    }
+    client->rate_skip = 0;
+
+    frame_packet_t *send = level->low_quality && low ? low : packet;
+    for (int k = 0; client->transform_set && k < variant_count; k++)
+    {
+      if (variants[k] && frame_transform_equal(&transforms[k], &client->transform))
+      {
+        send = variants[k];
+        break;
+      }
+    }
+
+    frame_queue_push(&client->queue, send);
+    count++;
+  }
+  pthread_mutex_unlock(&g_client_mutex);
+
+  if (count > 0)
+  {
+    wake_reactor(server);
+  }
+  return count;
+}
+
+/**
+ * @brief 修改客户端关注的epoll事件
+ */
+static void set_want_write(int epfd, client_t *client, int want)
+{
+  if (client->want_write == want)
+  {
+    return;
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN | EPOLLRDHUP | (want ? EPOLLOUT : 0);
+  ev.data.ptr = client;
+  if (epoll_ctl(epfd, EPOLL_CTL_MOD, client->sock, &ev) < 0)
+  {
+    perror("epoll_ctl MOD failed");
+    return;
+  }
+  client->want_write = want;
+}
+
+/**
+ * @brief 断开客户端（同一批事件里可能还有它的事件，内存稍后由free_closed_clients释放）
+ */
+static void close_client(int epfd, client_t *client)
+{
+  printf("[客户端 %s] 已断开，发送 %llu 帧，丢弃 %llu 帧，零拷贝 %llu 次（退回拷贝 %llu 次），最终码率档位 %d\n",
+         client->peer, client->frames, client->queue.dropped, client->zc_sends, client->zc_copied, client->rate_level);
+
+  // 从客户端列表中移除
+  remove_client(client);
+  epoll_ctl(epfd, EPOLL_CTL_DEL, client->sock, NULL);
+  close(client->sock);
+
+  client->closed = 1;
+  client->next_closed = g_closed_clients;
+  g_closed_clients = client;
+}
+
+/**
+ * @brief 释放已断开的客户端
+ */
+static void free_closed_clients(void)
+{
+  while (g_closed_clients)
+  {
+    client_t *client = g_closed_clients;
+    g_closed_clients = client->next_closed;
+
+    frame_packet_unref(client->sending);
+    for (int i = 0; i < client->zc_count; i++)
+    {
+      frame_packet_unref(client->zc_packets[(client->zc_head + i) % ZEROCOPY_PENDING_MAX]);
+    }
+    frame_queue_destroy(&client->queue);
+    free(client);
+  }
+}
+
+#ifdef SERVER_HAVE_ZEROCOPY
+/**
+ * @brief 记录一次零拷贝发送，数据包要等内核完成通知后才能释放
+ */
+static void zerocopy_track(client_t *client, frame_packet_t *packet)
+{
+  int slot = (client->zc_head + client->zc_count) % ZEROCOPY_PENDING_MAX;
+  client->zc_ids[slot] = client->zc_next_id++;
+  client->zc_packets[slot] = frame_packet_ref(packet);
+  client->zc_count++;
+  client->zc_sends++;
+}
+
+/**
+ * @brief 读取错误队列中的零拷贝完成通知，释放已完成的数据包
+ */
+static void zerocopy_complete(client_t *client)
+{
+  for (;;)
+  {
+    char control[128];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if (recvmsg(client->sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+    {
+      break; // EAGAIN：没有更多通知
+    }
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+    {
+      if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+            (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+      {
+        continue;
+      }
+
+      struct sock_extended_err *err = (struct sock_extended_err *)CMSG_DATA(cm);
+      if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+      {
+        continue;
+      }
+
+      // [ee_info, ee_data] 区间内的发送已完成
+      unsigned int lo = err->ee_info, hi = err->ee_data;
+      for (int k = 0; k < client->zc_count; k++)
+      {
+        int slot = (client->zc_head + k) % ZEROCOPY_PENDING_MAX;
+        unsigned int id = client->zc_ids[slot];
+        if (client->zc_packets[slot] && id - lo <= hi - lo)
+        {
+          frame_packet_unref(client->zc_packets[slot]);
+          client->zc_packets[slot] = NULL;
+        }
+      }
+
+      // 内核实际做了拷贝（例如回环），零拷贝没有收益，之后不再使用
+      if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+      {
+        client->zc_copied++;
+        client->zerocopy = 0;
+      }
+    }
+  }
+
+  while (client->zc_count > 0 && !client->zc_packets[client->zc_head])
+  {
+    client->zc_head = (client->zc_head + 1) % ZEROCOPY_PENDING_MAX;
+    client->zc_count--;
+  }
+}
+#endif // SERVER_HAVE_ZEROCOPY
+
+/**
+ * @brief 处理EPOLLERR：零拷贝完成通知也通过错误队列上报，只有SO_ERROR非0才是真正的错误
+ * @return 连接正常返回0，出错返回-1
+ */
+static int check_client_error(client_t *client)
+{
+#ifdef SERVER_HAVE_ZEROCOPY
+  zerocopy_complete(client);
+#endif
+
+  int error = 0;
+  socklen_t len = sizeof(error);
+  if (getsockopt(client->sock, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0)
+  {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief 非阻塞发送队列中的数据包，直到发完或socket缓冲区满
+ *        包头和图像数据用sendmsg一次发出；图像数据较大时包头单独发送，图像数据使用MSG_ZEROCOPY
+ * @return 成功返回0，连接出错返回-1
+ */
+static int flush_client(int epfd, client_t *client)
+{
+  for (;;)
+  {
+    // 控制消息只在帧与帧之间发送
+    if (!client->sending && client->ctrl_sent < client->ctrl_len)
+    {
+      ssize_t n = send(client->sock, client->ctrl_out + client->ctrl_sent, client->ctrl_len - client->ctrl_sent,
+                       MSG_NOSIGNAL | MSG_DONTWAIT);
+      if (n < 0)
+      {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+          set_want_write(epfd, client, 1);
+          return 0;
+        }
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        perror("send failed");
+        return -1;
+      }
+
+      client->ctrl_sent += n;
+      client->bytes_sent += n;
+      if (client->ctrl_sent == client->ctrl_len)
+      {
+        client->ctrl_sent = client->ctrl_len = 0;
+        client->version = client->next_version; // HELLO回复已发出，之后的帧使用新版本
+      }
+      continue;
+    }
+
+    if (!client->sending)
+    {
+#ifdef SIOCOUTQNSD
+      // 内核里还有足够多未发出的数据：等它降到RATE_NOTSENT_LOWAT以下（EPOLLOUT）再取下一帧，
+      // 积压留在应用层队列里，慢客户端丢的是旧帧，而不是在内核里攒出越来越大的延迟
+      int notsent = 0;
+      if (client->notsent_lowat && ioctl(client->sock, SIOCOUTQNSD, &notsent) == 0 &&
+          notsent >= RATE_NOTSENT_LOWAT)
+      {
+        set_want_write(epfd, client, 1);
+        return 0;
+      }
+#endif
+
+      client->sending = frame_queue_pop(&client->queue);
+      client->sent = 0;
+      if (!client->sending)
+      {
+        if (client->http == HTTP_STATE_DONE)
+        {
+          return -1; // HTTP响应已发完，关闭连接
+        }
+        break;
+      }
+
+      if (client->sending->is_ctrl)
+      {
+        // 控制消息原样发送，v1客户端和浏览器不认识控制消息，直接丢弃
+        if (client->version < 2 || client->http)
+        {
+          frame_packet_unref(client->sending);
+          client->sending = NULL;
+          continue;
+        }
+        memcpy(client->header, client->sending->header, client->sending->header_size);
+        client->header_size = client->sending->header_size;
+      }
+      else if (client->http)
+      {
+        // 浏览器：直播流每帧前加multipart段头，截屏前加响应头
+        client->header_size = client->http == HTTP_STATE_STREAM
+                                  ? http_encode_part(client->header, client->frames == 0, client->sending->payload_size)
+                                  : http_encode_jpeg(client->header, client->sending->payload_size);
+      }
+      else
+      {
+        // 数据包里是v2包头，按本客户端的版本重新编码并填入发送时间
+        protocol_frame_t info;
+        protocol_decode_v2(client->sending->header, client->sending->header_size, &info);
+        info.send_us = protocol_monotonic_us();
+        client->header_size = protocol_encode_frame(client->header, &info, client->version);
+      }
+    }
+
+    frame_packet_t *packet = client->sending;
+    unsigned int total = client->header_size + packet->payload_size;
+    unsigned int header_left = client->sent < client->header_size ? client->header_size - client->sent : 0;
+    unsigned int offset = client->sent - (client->header_size - header_left); // 图像数据已发出的字节数
+    struct iovec iov[2];
+    int iovcnt = 0;
+    int flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+
+#ifdef SERVER_HAVE_ZEROCOPY
+    // 零拷贝时内核一直锁定发送的内存直到完成通知，而client->header马上会被下一帧改写，
+    // 客户端断开时还会被释放：包头先用普通发送发完，MSG_ZEROCOPY只用于数据包持有的图像数据
+    int zerocopy = client->zerocopy && client->zc_count < ZEROCOPY_PENDING_MAX &&
+                   packet->payload_size - offset >= ZEROCOPY_MIN_SIZE;
+    if (zerocopy && header_left > 0)
+    {
+      zerocopy = 0;
+      iov[iovcnt].iov_base = client->header + client->sent;
+      iov[iovcnt].iov_len = header_left;
+      iovcnt++;
+    }
+    else
+#endif
+    {
+      if (header_left > 0)
+      {
+        iov[iovcnt].iov_base = client->header + client->sent;
+        iov[iovcnt].iov_len = header_left;
+        iovcnt++;
+      }
+      if (offset < packet->payload_size)
+      {
+        iov[iovcnt].iov_base = (void *)(packet->payload + offset);
+        iov[iovcnt].iov_len = packet->payload_size - offset;
+        iovcnt++;
+      }
+    }
+
+#ifdef SERVER_HAVE_ZEROCOPY
+    if (zerocopy)
+    {
+      flags |= MSG_ZEROCOPY;
+    }
+#endif
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+
+    ssize_t n = sendmsg(client->sock, &msg, flags);
+    if (n < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        set_want_write(epfd, client, 1); // 等socket可写再继续
+        return 0;
+      }
+      if (errno == EINTR)
+      {
+        continue;
+      }
+#ifdef SERVER_HAVE_ZEROCOPY
+      // ENOBUFS：超出optmem限制；EFAULT：缓冲区无法锁定（部分驱动的mmap内存），改用普通发送
+      if (zerocopy && (errno == ENOBUFS || errno == EFAULT))
+      {
+        fprintf(stderr, "[客户端 %s] 零拷贝发送失败(%s)，改用普通发送\n", client->peer, strerror(errno));
+        client->zerocopy = 0;
+        continue;
+      }
+#endif
+      perror("sendmsg failed");
+      return -1;
+    }
+
+#ifdef SERVER_HAVE_ZEROCOPY
+    if (zerocopy)
+    {
+      zerocopy_track(client, packet);
+    }
+#endif
+
+    client->sent += n;
+    client->bytes_sent += n;
+    if (client->sent == total)
+    {
+      client->frames += !packet->is_ctrl;
+      frame_packet_unref(packet);
+      client->sending = NULL;
+
+      if (client->http == HTTP_STATE_SNAPSHOT)
+      {
+        pthread_mutex_lock(&g_client_mutex);
+        client->http = HTTP_STATE_DONE;
+        pthread_mutex_unlock(&g_client_mutex);
+      }
+    }
+  }
+
+  set_want_write(epfd, client, 0);
+  return 0;
+}
+
+/**
+ * @brief 发送所有客户端新入队的数据包（eventfd唤醒时调用）
+ */
+static void flush_all_clients(int epfd)
+{
+  // 倒序遍历，close_client会把后面的元素前移
+  for (int i = g_client_count - 1; i >= 0; i--)
+  {
+    client_t *client = g_clients[i];
+    if (!client->want_write && flush_client(epfd, client) < 0)
+    {
+      close_client(epfd, client);
+    }
+  }
+}
+
+/**
+ * @brief 追加一条待发送的控制消息
+ * @return 成功返回0，缓冲区满返回-1
+ */
+static int queue_ctrl(client_t *client, unsigned int type, const void *payload, unsigned int length)
+{
+  if (client->ctrl_len + PROTOCOL_CTRL_HEADER_SIZE + length > sizeof(client->ctrl_out))
+  {
+    return -1;
+  }
+
+  client->ctrl_len += protocol_encode_ctrl(client->ctrl_out + client->ctrl_len, type, payload, length);
+  return 0;
+}
+
+/**
+ * @brief 码率控制：统计一个周期的吞吐和丢帧，调整客户端档位
+ *        本周期队列丢过帧（链路跟不上当前档位）降一档；连续rate_up_wait个周期没有丢帧升一档试探，
+ *        试探失败（升档后马上又丢帧）则下次等待的周期数加倍，避免在两个档位之间来回跳
+ */
+static void update_rate(client_t *client, unsigned long long elapsed_us)
+{
+  // 对端确认的字节数 = 本周期写入socket的字节数 - 内核发送队列（未发出+未确认）的增量
+  int outq = 0;
+  ioctl(client->sock, SIOCOUTQ, &outq);
+  long long acked = (long long)(client->bytes_sent - client->rate_bytes) - (outq - client->rate_outq);
+  client->throughput = acked > 0 ? acked * 1000000ULL / elapsed_us : 0;
+  client->rate_bytes = client->bytes_sent;
+  client->rate_outq = outq;
+
+  unsigned long long dropped = client->queue.dropped - client->rate_dropped;
+  client->rate_dropped = client->queue.dropped;
+
+  int level = client->rate_level;
+  if (dropped > 0)
+  {
+    client->rate_good = 0;
+    if (client->rate_probing)
+    {
+      client->rate_probing = 0;
+      client->rate_up_wait = client->rate_up_wait * 2 < RATE_UP_INTERVALS_MAX ? client->rate_up_wait * 2
+                                                                               : RATE_UP_INTERVALS_MAX;
+    }
+    level += level + 1 < RATE_LEVELS;
+  }
+  else if (++client->rate_good >= client->rate_up_wait)
+  {
+    client->rate_good = 0;
+    if (client->rate_probing)
+    {
+      client->rate_probing = 0;
+      client->rate_up_wait = RATE_UP_INTERVALS;
+    }
+    if (level > 0)
+    {
+      level--;
+      client->rate_probing = 1;
+    }
+  }
+
+  if (level == client->rate_level)
+  {
+    return;
+  }
+
+  unsigned int rtt = 0;
+  struct tcp_info info;
+  socklen_t len = sizeof(info);
+  if (getsockopt(client->sock, IPPROTO_TCP, TCP_INFO, &info, &len) == 0)
+  {
+    rtt = info.tcpi_rtt;
+  }
+  printf("[客户端 %s] 码率档位 %d -> %d（每%d帧发1帧%s），吞吐 %.1f KB/s，RTT %.1f ms，本周期丢帧 %llu\n",
+         client->peer, client->rate_level, level, g_rate_levels[level].divisor,
+         g_rate_levels[level].low_quality ? "，低质量" : "", client->throughput / 1024.0, rtt / 1000.0, dropped);
+
+  pthread_mutex_lock(&g_client_mutex);
+  client->rate_level = level;
+  client->rate_skip = 0;
+  pthread_mutex_unlock(&g_client_mutex);
+}
+
+/**
+ * @brief 处理一条客户端控制消息
+ */
+static void handle_ctrl(server_module_t *server, client_t *client, unsigned int type, const unsigned char *payload,
+                        unsigned int length)
+{
+  switch (type)
+  {
+  case PROTOCOL_CTRL_HELLO:
+  {
+    if (length < PROTOCOL_HELLO_REQUEST_SIZE)
+    {
+      break;
+    }
+
+    unsigned int version = protocol_get_le16(payload);
+    version = version > PROTOCOL_VERSION ? PROTOCOL_VERSION : (version < 1 ? 1 : version);
+
+    // 回复采用的版本和服务器时钟，客户端据此换算采集/发送时间戳
+    unsigned char reply[PROTOCOL_HELLO_REPLY_SIZE];
+    protocol_put_le16(reply, version);
+    protocol_put_le16(reply + 2, 0);
+    protocol_put_le64(reply + 4, protocol_monotonic_us());
+    protocol_put_le64(reply + 12, protocol_realtime_us());
+    if (queue_ctrl(client, PROTOCOL_CTRL_HELLO, reply, sizeof(reply)) == 0)
+    {
+      client->next_version = version;
+      printf("[客户端 %s] 协商协议版本 v%u\n", client->peer, version);
+    }
+    break;
+  }
+
+  case PROTOCOL_CTRL_SUBSCRIBE:
+  {
+    if (length < PROTOCOL_SUBSCRIBE_SIZE)
+    {
+      break;
+    }
+
+    camera_t *cam = server->camera_module->camera;
+    frame_transform_t transform;
+    transform.scale = payload[0];
+    transform.format = payload[1];
+    transform.x = protocol_get_le16(payload + 4);
+    transform.y = protocol_get_le16(payload + 6);
+    transform.w = protocol_get_le16(payload + 8);
+    transform.h = protocol_get_le16(payload + 10);
+    frame_transform_normalize(&transform, cam->width, cam->height);
+    if (transform.format == FRAME_FORMAT_JPEG && !server->jpeg_encoder)
+    {
+      transform.format = FRAME_FORMAT_YUYV;
+    }
+
+    int live_format = server->jpeg_encoder && server->jpeg_quality > 0 ? FRAME_FORMAT_JPEG : FRAME_FORMAT_YUYV;
+    int set = !frame_transform_is_identity(&transform, cam->width, cam->height, live_format);
+    if (camera_is_compressed(cam) || server->delta_encoder)
+    {
+      // 只有YUYV直播流支持变换，回复实际收到的原始流
+      transform.x = transform.y = 0;
+      transform.w = cam->width;
+      transform.h = cam->height;
+      transform.scale = 1;
+      transform.format = camera_is_compressed(cam) ? FRAME_FORMAT_MJPEG : FRAME_FORMAT_YUYV_DELTA;
+      set = 0;
+    }
+
+    pthread_mutex_lock(&g_client_mutex);
+    client->transform = transform;
+    client->transform_set = set;
+    pthread_mutex_unlock(&g_client_mutex);
+
+    unsigned char reply[PROTOCOL_SUBSCRIBE_SIZE];
+    reply[0] = transform.scale;
+    reply[1] = transform.format;
+    protocol_put_le16(reply + 2, 0);
+    protocol_put_le16(reply + 4, transform.x);
+    protocol_put_le16(reply + 6, transform.y);
+    protocol_put_le16(reply + 8, transform.w);
+    protocol_put_le16(reply + 10, transform.h);
+    queue_ctrl(client, PROTOCOL_CTRL_SUBSCRIBE, reply, sizeof(reply));
+    printf("[客户端 %s] 订阅 裁剪(%u,%u %ux%u) 缩小%u倍 格式%u\n", client->peer, transform.x, transform.y,
+           transform.w, transform.h, transform.scale, transform.format);
+    break;
+  }
+
+  case PROTOCOL_CTRL_STREAM:
+  {
+    if (length < PROTOCOL_STREAM_SIZE)
+    {
+      break;
+    }
+
+    unsigned int fps = protocol_get_le16(payload + 2);
+    if (server->delta_encoder)
+    {
+      fps = 0; // 增量流跳帧会断开增量链，只能靠码率控制
+    }
+
+    pthread_mutex_lock(&g_client_mutex);
+    int live = payload[0] == PROTOCOL_STREAM_KEEP ? client->live : payload[0] != 0;
+    int push = payload[1] == PROTOCOL_STREAM_KEEP ? client->push : payload[1] != 0;
+    client->need_key |= live && !client->live; // 重新订阅增量流要从关键帧开始
+    client->live = live;
+    client->push = push;
+    client->live_interval_us = fps ? 1000000 / fps : 0;
+    client->live_next_us = 0;
+    pthread_cond_signal(&g_demand_cond);
+    pthread_mutex_unlock(&g_client_mutex);
+
+    unsigned char reply[PROTOCOL_STREAM_SIZE];
+    reply[0] = live;
+    reply[1] = push;
+    protocol_put_le16(reply + 2, fps);
+    queue_ctrl(client, PROTOCOL_CTRL_STREAM, reply, sizeof(reply));
+    printf("[客户端 %s] 直播%s，推送%s，最大帧率 %u\n", client->peer, live ? "开" : "关", push ? "开" : "关", fps);
+    break;
+  }
+
+  case PROTOCOL_CTRL_SNAPSHOT:
+    // 直播线程取到下一帧时回复
+    pthread_mutex_lock(&g_client_mutex);
+    client->snapshot_request = 1;
+    pthread_cond_signal(&g_demand_cond);
+    pthread_mutex_unlock(&g_client_mutex);
+    break;
+
+  case PROTOCOL_CTRL_PING:
+  {
+    if (length < PROTOCOL_PING_REQUEST_SIZE)
+    {
+      break;
+    }
+
+    unsigned char reply[PROTOCOL_PING_REPLY_SIZE];
+    memcpy(reply, payload, PROTOCOL_PING_REQUEST_SIZE);
+    protocol_put_le64(reply + 8, protocol_monotonic_us());
+    queue_ctrl(client, PROTOCOL_CTRL_PING, reply, sizeof(reply));
+    break;
+  }
+
+  default:
+    printf("[客户端 %s] 忽略未知控制消息 %u\n", client->peer, type);
+    break;
+  }
+}
+
+/**
+ * @brief 回应浏览器的请求：直播流订阅直播，截屏等直播线程取到下一帧，其它响应发完即关闭
+ */
+static void start_http_response(client_t *client, int route)
+{
+  client->ctrl_len = http_encode_response(client->ctrl_out, sizeof(client->ctrl_out), route);
+  client->ctrl_sent = 0;
+
+  pthread_mutex_lock(&g_client_mutex);
+  if (route == HTTP_ROUTE_STREAM)
+  {
+    client->http = HTTP_STATE_STREAM;
+    client->live = 1;
+  }
+  else if (route == HTTP_ROUTE_SNAPSHOT)
+  {
+    client->http = HTTP_STATE_SNAPSHOT;
+    client->snapshot_request = 1;
+  }
+  else
+  {
+    client->http = HTTP_STATE_DONE;
+  }
+  pthread_cond_signal(&g_demand_cond);
+  pthread_mutex_unlock(&g_client_mutex);
+
+  static const char *names[] = {"", "网页", "MJPEG直播", "截屏", "不存在的资源", "无效请求"};
+  printf("[HTTP %s] 请求%s\n", client->peer, names[route]);
+}
+
+/**
+ * @brief 读取浏览器的请求行（之后的请求头和数据直接丢弃）
+ * @return 成功返回0，对端关闭、出错或请求行过长返回-1
+ */
+static int read_http_request(int epfd, client_t *client)
+{
+  for (;;)
+  {
+    ssize_t n = recv(client->sock, client->ctrl_in + client->ctrl_in_len,
+                     sizeof(client->ctrl_in) - client->ctrl_in_len, MSG_DONTWAIT);
+    if (n == 0)
+    {
+      return -1;
+    }
+    if (n < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        break;
+      }
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return -1;
+    }
+    if (client->http != HTTP_STATE_REQUEST)
+    {
+      continue;
+    }
+
+    int route;
+    client->ctrl_in_len += n;
+    if (http_parse_request(client->ctrl_in, client->ctrl_in_len, &route) == 0)
+    {
+      if (client->ctrl_in_len == sizeof(client->ctrl_in))
+      {
+        fprintf(stderr, "[HTTP %s] 请求行过长\n", client->peer);
+        return -1;
+      }
+      continue;
+    }
+
+    client->ctrl_in_len = 0;
+    start_http_response(client, route);
+  }
+
+  if (client->ctrl_len > 0 && !client->want_write)
+  {
+    return flush_client(epfd, client);
+  }
+  return 0;
+}
 
 /**
- * @brief 发送完整数据
+ * @brief 读取并处理客户端发来的控制消息
+ * @return 成功返回0，对端关闭、出错或协议错误返回-1
  */
-static int send_full(int sock, const void *data, size_t size)
+static int read_client(server_module_t *server, int epfd, client_t *client)
 {
-  size_t sent = 0;
-  while (sent < size)
+  if (client->http)
   {
-    int n = send(sock, (char *)data + sent, size - sent, 0);
+    return read_http_request(epfd, client);
+  }
+
+  for (;;)
+  {
+    ssize_t n = recv(client->sock, client->ctrl_in + client->ctrl_in_len,
+                     sizeof(client->ctrl_in) - client->ctrl_in_len, MSG_DONTWAIT);
+    if (n == 0)
+    {
+      return -1;
+    }
     if (n < 0)
     {
-      perror("send failed");
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        break;
+      }
+      if (errno == EINTR)
+      {
+        continue;
+      }
       return -1;
     }
-    sent += n;
+    client->ctrl_in_len += n;
+
+    // 取出所有完整的消息
+    unsigned int pos = 0;
+    while (client->ctrl_in_len - pos >= PROTOCOL_CTRL_HEADER_SIZE)
+    {
+      unsigned int type, length;
+      if (protocol_decode_ctrl(client->ctrl_in + pos, &type, &length) < 0)
+      {
+        fprintf(stderr, "[客户端 %s] 无效的控制消息\n", client->peer);
+        return -1;
+      }
+      if (client->ctrl_in_len - pos < PROTOCOL_CTRL_HEADER_SIZE + length)
+      {
+        break;
+      }
+
+      handle_ctrl(server, client, type, client->ctrl_in + pos + PROTOCOL_CTRL_HEADER_SIZE, length);
+      pos += PROTOCOL_CTRL_HEADER_SIZE + length;
+    }
+
+    memmove(client->ctrl_in, client->ctrl_in + pos, client->ctrl_in_len - pos);
+    client->ctrl_in_len -= pos;
+  }
+
+  // 有回复要发送
+  if (client->ctrl_len > 0 && !client->want_write)
+  {
+    return flush_client(epfd, client);
+  }
+  return 0;
+}
+
+/**
+ * @brief 接受所有等待中的连接
+ * @param http 是否HTTP端口（浏览器连接先等请求行，不收直播和推送）
+ */
+static void accept_clients(server_module_t *server, int epfd, int http)
+{
+  int listen_fd = http ? server->http_fd : server->server_fd;
+
+  for (;;)
+  {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int sock = accept4(listen_fd, (struct sockaddr *)&addr, &addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (sock < 0)
+    {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && server->is_running)
+      {
+        perror("accept失败");
+      }
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return;
+    }
+
+    client_t *client = (client_t *)calloc(1, sizeof(client_t));
+    if (!client)
+    {
+      perror("malloc client_t failed");
+      close(sock);
+      continue;
+    }
+    client->sock = sock;
+    client->live = http ? 0 : server->live_mode;
+    client->push = !http;
+    client->http = http ? HTTP_STATE_REQUEST : HTTP_STATE_NONE;
+    client->need_key = 1;
+    client->version = client->next_version = 1; // 客户端发送HELLO之前按v1发送
+    snprintf(client->peer, sizeof(client->peer), "%s:%d", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+    frame_queue_init(&client->queue);
+
+#ifdef SERVER_HAVE_ZEROCOPY
+    int one = 1;
+    client->zerocopy = setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0; // 内核4.14+
+#endif
+
+#ifdef TCP_NOTSENT_LOWAT
+    int lowat = RATE_NOTSENT_LOWAT;
+    client->notsent_lowat = setsockopt(sock, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat)) == 0; // 内核3.12+
+#endif
+    client->rate_up_wait = RATE_UP_INTERVALS;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = client;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, sock, &ev) < 0)
+    {
+      perror("epoll_ctl ADD failed");
+      frame_queue_destroy(&client->queue);
+      free(client);
+      close(sock);
+      continue;
+    }
+
+    // 添加到客户端列表
+    if (add_client(client) < 0)
+    {
+      fprintf(stderr, "客户端数已达上限，拒绝连接: %s\n", client->peer);
+      epoll_ctl(epfd, EPOLL_CTL_DEL, sock, NULL);
+      frame_queue_destroy(&client->queue);
+      free(client);
+      close(sock);
+      continue;
+    }
+
+    printf("[%s %s] 已连接\n", http ? "HTTP" : "客户端", client->peer);
+  }
+}
+
+/**
+ * @brief 帧的采集时间（CLOCK_MONOTONIC微秒）
+ */
+static unsigned long long frame_capture_us(const camera_frame_t *frame)
+{
+  return (unsigned long long)frame->timestamp.tv_sec * 1000000ULL + frame->timestamp.tv_usec;
+}
+
+/**
+ * @brief 编码数据包头（v2，发送时再按各客户端的版本转换）
+ * @return 包头字节数
+ */
+static unsigned int encode_header(unsigned char *out, int width, int height, const camera_frame_t *frame,
+                                  unsigned int format, unsigned int flags, unsigned int size)
+{
+  protocol_frame_t info;
+  memset(&info, 0, sizeof(info));
+  info.frame_size = size;
+  info.width = width;
+  info.height = height;
+  info.format = format;
+  info.flags = flags;
+  info.stream_id = 0;
+  info.seq = frame->seq;
+  info.capture_us = frame_capture_us(frame);
+  return protocol_encode_frame(out, &info, 2);
+}
+
+/**
+ * @brief 打包一帧：包头 + 图像数据（拷贝）
+ */
+static frame_packet_t *make_packet(int width, int height, const camera_frame_t *frame, unsigned int format,
+                                   unsigned int flags, const unsigned char *data, unsigned int size)
+{
+  unsigned char header[PROTOCOL_HEADER_MAX];
+  unsigned int header_size = encode_header(header, width, height, frame, format, flags, size);
+
+  frame_packet_t *packet = frame_packet_alloc(header, header_size, size);
+  if (!packet)
+  {
+    return NULL;
+  }
+
+  memcpy(packet->data, data, size);
+  return packet;
+}
+
+/**
+ * @brief 数据包释放时归还借用的摄像头缓冲区
+ */
+static void release_pinned_frame(void *owner, void *data)
+{
+  camera_module_release_frame((camera_module_t *)owner, (camera_frame_t *)data);
+  __sync_fetch_and_sub(&g_pinned_frames, 1);
+}
+
+/**
+ * @brief 打包一帧：图像数据直接借用摄像头缓冲区（不拷贝）
+ *        借用的缓冲区数有上限，保证采集线程始终有空闲缓冲区；超出时退回拷贝
+ */
+static frame_packet_t *pin_packet(server_module_t *server, camera_frame_t *frame,
+                                  unsigned int format, unsigned int flags)
+{
+  camera_module_t *cam_module = server->camera_module;
+  camera_t *cam = cam_module->camera;
+  int limit = cam->buffer_count / 2;
+
+  if (__sync_add_and_fetch(&g_pinned_frames, 1) > limit)
+  {
+    __sync_fetch_and_sub(&g_pinned_frames, 1);
+    return make_packet(cam->width, cam->height, frame, format, flags, frame->data, frame->size);
+  }
+
+  unsigned char header[PROTOCOL_HEADER_MAX];
+  unsigned int header_size = encode_header(header, cam->width, cam->height, frame, format, flags, frame->size);
+
+  camera_module_ref_frame(frame);
+  frame_packet_t *packet = frame_packet_wrap(header, header_size, frame->data, frame->size,
+                                             release_pinned_frame, cam_module, frame);
+  if (!packet)
+  {
+    release_pinned_frame(cam_module, frame);
+  }
+  return packet;
+}
+
+/**
+ * @brief 把一帧摄像头数据转换成待发送的数据包（每帧只做一次）
+ *        MJPEG原样转发，YUYV按quality编码成JPEG（0或失败则发送原始YUYV）
+ */
+static frame_packet_t *build_packet(server_module_t *server, camera_frame_t *frame, unsigned int flags, int quality)
+{
+  camera_t *cam = server->camera_module->camera;
+  frame_packet_t *packet = NULL;
+
+  if (camera_is_compressed(cam))
+  {
+    return pin_packet(server, frame, FRAME_FORMAT_MJPEG, flags);
+  }
+
+  if (server->jpeg_encoder && quality > 0)
+  {
+    const unsigned char *jpeg = NULL;
+    unsigned int jpeg_size = 0;
+
+    // 截屏（触摸线程）和直播线程共用编码器，编码输出下次编码时会被覆盖，只能拷贝
+    pthread_mutex_lock(&server->jpeg_mutex);
+    if (jpeg_encode_yuyv(server->jpeg_encoder, frame->data, cam->width, cam->height,
+                         quality, &jpeg, &jpeg_size) == 0)
+    {
+      packet = make_packet(cam->width, cam->height, frame, FRAME_FORMAT_JPEG, flags, jpeg, jpeg_size);
+    }
+    else
+    {
+      fprintf(stderr, "JPEG编码失败，发送原始YUYV\n");
+    }
+    pthread_mutex_unlock(&server->jpeg_mutex);
+  }
+
+  if (!packet)
+  {
+    packet = pin_packet(server, frame, FRAME_FORMAT_YUYV, flags);
+  }
+  return packet;
+}
+
+/**
+ * @brief 对一帧做订阅的变换并打包（只在直播线程中调用，YUYV摄像头）
+ *        YUYV/I420直接输出到数据包里；JPEG先变换到临时缓冲区再编码
+ */
+static frame_packet_t *build_transform_packet(server_module_t *server, camera_frame_t *frame,
+                                              const frame_transform_t *transform)
+{
+  camera_t *cam = server->camera_module->camera;
+  int out_w, out_h;
+  unsigned int size = frame_transform_output_size(transform, &out_w, &out_h);
+
+  if (frame->size < (unsigned int)cam->width * cam->height * 2)
+  {
+    return NULL;
+  }
+
+  if (transform->format != FRAME_FORMAT_JPEG)
+  {
+    unsigned char header[PROTOCOL_HEADER_MAX];
+    unsigned int header_size = encode_header(header, out_w, out_h, frame, transform->format, 0, size);
+    frame_packet_t *packet = frame_packet_alloc(header, header_size, size);
+    if (packet && frame_transform_apply(transform, frame->data, cam->width, packet->data) < 0)
+    {
+      frame_packet_unref(packet);
+      packet = NULL;
+    }
+    return packet;
+  }
+
+  unsigned char *yuyv = (unsigned char *)malloc(size);
+  if (!yuyv)
+  {
+    perror("malloc transform buffer failed");
+    return NULL;
+  }
+
+  frame_packet_t *packet = NULL;
+  if (frame_transform_apply(transform, frame->data, cam->width, yuyv) == 0)
+  {
+    const unsigned char *jpeg = NULL;
+    unsigned int jpeg_size = 0;
+    int quality = server->jpeg_quality > 0 ? server->jpeg_quality : JPEG_QUALITY;
+
+    pthread_mutex_lock(&server->jpeg_mutex);
+    if (jpeg_encode_yuyv(server->jpeg_encoder, yuyv, out_w, out_h, quality, &jpeg, &jpeg_size) == 0)
+    {
+      packet = make_packet(out_w, out_h, frame, FRAME_FORMAT_JPEG, 0, jpeg, jpeg_size);
+    }
+    pthread_mutex_unlock(&server->jpeg_mutex);
+  }
+
+  free(yuyv);
+  return packet;
+}
+
+/**
+ * @brief 增量编码一帧（只在直播线程中调用）
+ * @param is_key 输出是否为关键帧
+ */
+static frame_packet_t *build_delta_packet(server_module_t *server, camera_frame_t *frame, int *is_key)
+{
+  camera_t *cam = server->camera_module->camera;
+  const unsigned char *data;
+  unsigned int size;
+
+  if (frame->size < (unsigned int)cam->width * cam->height * 2)
+  {
+    return NULL;
+  }
+
+  int type = delta_encode_yuyv(server->delta_encoder, frame->data, frame->seq, &data, &size);
+  if (type < 0)
+  {
+    return NULL;
+  }
+
+  *is_key = type == DELTA_TYPE_KEY;
+  return make_packet(cam->width, cam->height, frame, FRAME_FORMAT_YUYV_DELTA, *is_key ? PROTOCOL_FLAG_KEYFRAME : 0,
+                     data, size);
+}
+
+/**
+ * @brief 广播增量流的一帧
+ *        需要重新同步的客户端改发当前重建图像的关键帧（与本帧序号相同），其它客户端不受影响；
+ *        队列满的客户端跳过本帧而不是挤掉旧包（否则队列里的增量链会断开），有空位后再重新同步
+ */
+static int broadcast_delta(server_module_t *server, camera_frame_t *frame, frame_packet_t *packet, int is_key)
+{
+  camera_t *cam = server->camera_module->camera;
+  frame_packet_t *resync = NULL;
+  int count = 0;
+
+  pthread_mutex_lock(&g_client_mutex);
+  for (int i = 0; i < g_client_count; i++)
+  {
+    client_t *client = g_clients[i];
+    frame_packet_t *send = packet;
+    if (!client->live || client->http)
+    {
+      continue;
+    }
+
+    // 持有g_client_mutex时只有网络事件线程会出队，队列不会被别人填满
+    if (frame_queue_full(&client->queue))
+    {
+      client->need_key = 1;
+      continue;
+    }
+
+    if (client->need_key && !is_key)
+    {
+      const unsigned char *data;
+      unsigned int size;
+      if (!resync && delta_encode_resync(server->delta_encoder, &data, &size) == 0)
+      {
+        resync = make_packet(cam->width, cam->height, frame, FRAME_FORMAT_YUYV_DELTA, PROTOCOL_FLAG_KEYFRAME,
+                             data, size);
+      }
+      if (!resync)
+      {
+        continue;
+      }
+      send = resync;
+    }
+
+    frame_queue_push(&client->queue, send);
+    client->need_key = 0;
+    count++;
+  }
+  pthread_mutex_unlock(&g_client_mutex);
+
+  frame_packet_unref(resync);
+  if (count > 0)
+  {
+    wake_reactor(server);
+  }
+  return count;
+}
+
+/**
+ * @brief 把直播帧以RTP组播发送一次（包头按v2编码，填入发送时间）
+ */
+static void multicast_packet(server_module_t *server, frame_packet_t *packet)
+{
+  protocol_frame_t info;
+  unsigned char header[PROTOCOL_HEADER_MAX];
+
+  protocol_decode_v2(packet->header, packet->header_size, &info);
+  info.send_us = protocol_monotonic_us();
+  unsigned int header_size = protocol_encode_frame(header, &info, 2);
+  rtp_send_unit(server->rtp_sender, header, header_size, packet->payload, packet->payload_size, info.capture_us);
+}
+
+/**
+ * @brief 统计这一帧按最大帧率应该发送的直播客户端数（不修改状态）
+ * @param http_due 输出其中HTTP观看者的数量（不计入返回值）
+ * @return 协议客户端数
+ */
+static int count_due_clients(unsigned long long capture_us, int *http_due)
+{
+  int count = 0;
+  int http = 0;
+
+  pthread_mutex_lock(&g_client_mutex);
+  for (int i = 0; i < g_client_count; i++)
+  {
+    client_t *client = g_clients[i];
+    if (!client->live || (client->live_interval_us && capture_us < client->live_next_us))
+    {
+      continue;
+    }
+    if (client->http)
+    {
+      http++;
+    }
+    else
+    {
+      count++;
+    }
+  }
+  pthread_mutex_unlock(&g_client_mutex);
+
+  *http_due = http;
+  return count;
+}
+
+/**
+ * @brief 浏览器用的JPEG数据包：packet已是完整JPEG时直接共用，摄像头MJPEG帧缺DHT时补上，
+ *        YUYV和增量流另外编码一次（所有HTTP客户端共用结果）
+ * @param packet 本帧已打包的数据包（可为NULL）
+ * @return 新的引用，失败返回NULL
+ */
+static frame_packet_t *build_http_packet(server_module_t *server, camera_frame_t *frame, frame_packet_t *packet,
+                                         unsigned int flags)
+{
+  protocol_frame_t info;
+
+  if (packet && protocol_decode_v2(packet->header, packet->header_size, &info) == 0)
+  {
+    if (info.format == FRAME_FORMAT_JPEG)
+    {
+      return frame_packet_ref(packet);
+    }
+
+    unsigned int sos = 0;
+    if (info.format == FRAME_FORMAT_MJPEG)
+    {
+      if (jpeg_has_dht(packet->payload, packet->payload_size, &sos) || sos == 0)
+      {
+        return frame_packet_ref(packet);
+      }
+
+      // 在SOS前插入标准Huffman表
+      unsigned char header[PROTOCOL_HEADER_MAX];
+      info.format = FRAME_FORMAT_JPEG;
+      info.frame_size = packet->payload_size + JPEG_STD_DHT_SIZE;
+      unsigned int header_size = protocol_encode_frame(header, &info, 2);
+      frame_packet_t *full = frame_packet_alloc(header, header_size, info.frame_size);
+      if (!full)
+      {
+        return NULL;
+      }
+      memcpy(full->data, packet->payload, sos);
+      jpeg_write_std_dht(full->data + sos);
+      memcpy(full->data + sos + JPEG_STD_DHT_SIZE, packet->payload + sos, packet->payload_size - sos);
+      return full;
+    }
+  }
+
+  if (!server->jpeg_encoder)
+  {
+    return NULL;
+  }
+  return build_packet(server, frame, flags, server->jpeg_quality > 0 ? server->jpeg_quality : JPEG_QUALITY);
+}
+
+/**
+ * @brief 给浏览器观看者发送这一帧
+ * @param packet 本帧已打包的数据包（可为NULL）
+ * @param low 低质量档位的JPEG（可为NULL）
+ */
+static void broadcast_http(server_module_t *server, camera_frame_t *frame, frame_packet_t *packet, frame_packet_t *low)
+{
+  frame_packet_t *http = build_http_packet(server, frame, packet, 0);
+  if (http)
+  {
+    broadcast_live(server, frame_capture_us(frame), http, low, NULL, NULL, 0, 1);
+    frame_packet_unref(http);
   }
-  return 0;
 }
 
 /**
- * @brief 添加客户端socket
+ * @brief 给请求了截屏的客户端发送这一帧（所有请求者共用一个数据包，浏览器共用一个JPEG），打包失败时请求保留到下一帧
  */
-static void add_client_socket(int sock)
+static void send_requested_snapshots(server_module_t *server, camera_frame_t *frame)
 {
+  frame_packet_t *packet = build_packet(server, frame, PROTOCOL_FLAG_SNAPSHOT, server->jpeg_quality);
+  if (!packet)
+  {
+    return;
+  }
+
+  // 截屏包在队列满时不会被直播帧挤掉
+  packet->is_snapshot = 1;
+
+  // 有浏览器请求截屏时，在加锁之前准备好JPEG
+  int want_http = 0;
   pthread_mutex_lock(&g_client_mutex);
-  if (g_client_count < MAX_CLIENT_SOCKETS)
+  for (int i = 0; i < g_client_count; i++)
+  {
+    want_http |= g_clients[i]->snapshot_request && g_clients[i]->http;
+  }
+  pthread_mutex_unlock(&g_client_mutex);
+
+  frame_packet_t *http = want_http ? build_http_packet(server, frame, packet, PROTOCOL_FLAG_SNAPSHOT) : NULL;
+  if (http)
+  {
+    http->is_snapshot = 1;
+  }
+
+  int count = 0;
+  pthread_mutex_lock(&g_client_mutex);
+  for (int i = 0; i < g_client_count; i++)
   {
-    g_client_sockets[g_client_count++] = sock;
-    printf("添加客户端socket: %d, 当前客户端数: %d\n", sock, g_client_count);
+    client_t *client = g_clients[i];
+    frame_packet_t *send = client->http ? http : packet;
+    if (!client->snapshot_request || !send)
+    {
+      continue;
+    }
+
+    client->snapshot_request = 0;
+    client->need_key |= frame_queue_push(&client->queue, send) > 0;
+    count++;
   }
   pthread_mutex_unlock(&g_client_mutex);
+
+  frame_packet_unref(packet);
+  frame_packet_unref(http);
+  if (count > 0)
+  {
+    wake_reactor(server);
+  }
 }
 
 /**
- * @brief 移除客户端socket
+ * @brief 直播线程：有需求时每采集到一帧打包一次，放入订阅客户端的队列，并回应截屏请求
  */
-static void remove_client_socket(int sock)
+static void *live_thread_func(void *arg)
 {
-  pthread_mutex_lock(&g_client_mutex);
-  for (int i = 0; i < g_client_count; i++)
+  server_module_t *server = (server_module_t *)arg;
+  unsigned long long seq = 0;
+
+  printf("直播线程启动\n");
+
+  while (server->is_running)
   {
-    if (g_client_sockets[i] == sock)
+    // 没有观看者也没有截屏请求时不取帧、不编码
+    int need_low = 0;
+    int snapshots = 0;
+    int live = wait_for_demand(server, &need_low, &snapshots);
+    if (live == 0 && snapshots == 0 && !server->rtp_sender)
     {
-      // 将后面的元素前移
-      for (int j = i; j < g_client_count - 1; j++)
+      continue;
+    }
+
+    camera_frame_t *frame = camera_module_acquire_frame(server->camera_module, seq, 1000);
+    if (!frame)
+    {
+      continue;
+    }
+    seq = frame->seq;
+
+    if (snapshots > 0)
+    {
+      send_requested_snapshots(server, frame);
+    }
+
+    // 所有观看者都限了帧率且这一帧都不需要时跳过编码
+    unsigned long long capture_us = frame_capture_us(frame);
+    int http_due = 0;
+    int due = live > 0 ? count_due_clients(capture_us, &http_due) : 0;
+    if (due == 0 && http_due == 0 && !server->rtp_sender)
+    {
+      camera_module_release_frame(server->camera_module, frame);
+      continue;
+    }
+
+    if (server->delta_encoder)
+    {
+      // 重新同步用的关键帧要用到帧的序号和时间戳，广播完才释放
+      int is_key = 0;
+      frame_packet_t *packet = due > 0 ? build_delta_packet(server, frame, &is_key) : NULL;
+      if (packet)
       {
-        g_client_sockets[j] = g_client_sockets[j + 1];
+        broadcast_delta(server, frame, packet, is_key);
+        frame_packet_unref(packet);
       }
-      g_client_count--;
-      printf("移除客户端socket: %d, 当前客户端数: %d\n", sock, g_client_count);
-      break;
+
+      // 组播会丢包、浏览器不认识增量帧，都发送完整帧
+      if (server->rtp_sender || http_due > 0)
+      {
+        packet = build_packet(server, frame, 0, server->jpeg_quality);
+        if (packet && server->rtp_sender)
+        {
+          multicast_packet(server, packet);
+        }
+        if (http_due > 0)
+        {
+          broadcast_http(server, frame, packet, NULL);
+        }
+        frame_packet_unref(packet);
+      }
+      camera_module_release_frame(server->camera_module, frame);
+      continue;
+    }
+
+    frame_packet_t *packet = build_packet(server, frame, 0, server->jpeg_quality);
+    if (packet && server->rtp_sender)
+    {
+      multicast_packet(server, packet);
+    }
+
+    // 有客户端降到低质量档位时，每帧再编码一个低质量版本（所有这些客户端共用）
+    frame_packet_t *low = NULL;
+    if (need_low && (due > 0 || http_due > 0) && server->jpeg_encoder &&
+        (server->jpeg_quality <= 0 || server->jpeg_quality > RATE_LOW_QUALITY))
+    {
+      low = build_packet(server, frame, 0, RATE_LOW_QUALITY);
+    }
+
+    if (http_due > 0)
+    {
+      broadcast_http(server, frame, packet, low);
+    }
+    if (due == 0)
+    {
+      camera_module_release_frame(server->camera_module, frame);
+      frame_packet_unref(packet);
+      frame_packet_unref(low);
+      continue;
+    }
+
+    // 订阅的变换：每种不同的变换每帧只算一次，订阅相同变换的客户端共用数据包
+    frame_transform_t transforms[MAX_TRANSFORMS];
+    frame_packet_t *variants[MAX_TRANSFORMS];
+    int variant_count = 0;
+    if (!camera_is_compressed(server->camera_module->camera))
+    {
+      variant_count = collect_transforms(transforms);
+    }
+    for (int k = 0; k < variant_count; k++)
+    {
+      variants[k] = build_transform_packet(server, frame, &transforms[k]);
+    }
+    camera_module_release_frame(server->camera_module, frame);
+
+    if (packet)
+    {
+      broadcast_live(server, capture_us, packet, low, transforms, variants, variant_count, 0);
+      frame_packet_unref(packet);
+    }
+    frame_packet_unref(low);
+    for (int k = 0; k < variant_count; k++)
+    {
+      frame_packet_unref(variants[k]);
     }
   }
-  pthread_mutex_unlock(&g_client_mutex);
+
+  printf("直播线程退出\n");
+  return NULL;
 }
 
 /**
- * @brief 客户端处理线程（不再主动发送帧）
+ * @brief 把运动检测结果作为控制消息放入所有客户端的队列（与截屏帧保持先后顺序）
  */
-void *client_handler_wrapper(void *arg)
+static void broadcast_motion(server_module_t *server, unsigned long long seq, const motion_result_t *result)
 {
-  int client_sock = *(int *)arg;
-  free(arg);
+  camera_t *cam = server->camera_module->camera;
+  unsigned char msg[PROTOCOL_CTRL_HEADER_SIZE + PROTOCOL_CTRL_PAYLOAD_MAX];
+  unsigned char *p = msg + PROTOCOL_CTRL_HEADER_SIZE;
+
+  protocol_put_le64(p, seq);
+  protocol_put_le16(p + 8, cam->width);
+  protocol_put_le16(p + 10, cam->height);
+  p[12] = result->active;
+  p[13] = result->box_count;
+  protocol_put_le16(p + 14, 0);
+  p += PROTOCOL_MOTION_HEADER_SIZE;
+  for (int i = 0; i < result->box_count; i++)
+  {
+    protocol_put_le16(p, result->boxes[i].x);
+    protocol_put_le16(p + 2, result->boxes[i].y);
+    protocol_put_le16(p + 4, result->boxes[i].w);
+    protocol_put_le16(p + 6, result->boxes[i].h);
+    p += PROTOCOL_MOTION_BOX_SIZE;
+  }
+
+  unsigned int length = p - msg - PROTOCOL_CTRL_HEADER_SIZE;
+  protocol_encode_ctrl(msg, PROTOCOL_CTRL_MOTION, msg + PROTOCOL_CTRL_HEADER_SIZE, length);
+
+  frame_packet_t *packet = frame_packet_alloc(msg, PROTOCOL_CTRL_HEADER_SIZE, length);
+  if (!packet)
+  {
+    return;
+  }
+  memcpy(packet->data, msg + PROTOCOL_CTRL_HEADER_SIZE, length);
+
+  // 和截屏一样发给所有客户端，队列满时不被直播帧挤掉
+  packet->is_ctrl = 1;
+  packet->is_snapshot = 1;
+  broadcast_packet(server, packet);
+  frame_packet_unref(packet);
+}
 
-  struct sockaddr_in addr;
-  socklen_t addr_len = sizeof(addr);
-  getpeername(client_sock, (struct sockaddr *)&addr, &addr_len);
-  printf("[客户端 %s:%d] 已连接\n", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+/**
+ * @brief 运动检测线程：每帧检测一次，运动开始时（持续期间按间隔）自动截屏，并通知运动框
+ */
+static void *motion_thread_func(void *arg)
+{
+  server_module_t *server = (server_module_t *)arg;
+  camera_t *cam = server->camera_module->camera;
+  unsigned long long seq = 0;
+  unsigned long long last_capture_us = 0;
 
-  // 添加到客户端列表
-  add_client_socket(client_sock);
+  printf("运动检测线程启动（内核: %s）\n", motion_kernel_name());
 
-  // 保持连接，等待截屏指令
-  char buffer[256];
-  while (1)
+  while (server->is_running)
   {
-    // 检测客户端是否断开（通过接收数据判断）
-    int n = recv(client_sock, buffer, sizeof(buffer), MSG_PEEK | MSG_DONTWAIT);
-    if (n == 0)
+    camera_frame_t *frame = camera_module_acquire_frame(server->camera_module, seq, 1000);
+    if (!frame)
     {
-      // 客户端断开连接
-      break;
+      continue;
     }
-    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+    seq = frame->seq;
+
+    motion_result_t result;
+    int ret = -1;
+    if (frame->size >= (unsigned int)cam->width * cam->height * 2)
     {
-      break;
+      ret = motion_detect_yuyv(server->motion_detector, frame->data, &result);
     }
-    sleep(1);
-  }
+    camera_module_release_frame(server->camera_module, frame);
 
-  printf("[客户端 %s:%d] 已断开\n", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+    if (ret < 0 || (!result.active && !result.changed))
+    {
+      continue;
+    }
 
-  // 从客户端列表中移除
-  remove_client_socket(client_sock);
-  close(client_sock);
+    unsigned long long now = protocol_monotonic_us();
+    if (result.active && !result.changed && now - last_capture_us < MOTION_CAPTURE_INTERVAL_MS * 1000ULL)
+    {
+      continue;
+    }
+
+    broadcast_motion(server, seq, &result);
+    if (result.active)
+    {
+      printf("检测到运动: %d 个区域, %d 格\n", result.box_count, result.cells);
+      server_module_send_capture(server);
+      last_capture_us = now;
+    }
+    else
+    {
+      printf("运动结束\n");
+    }
+  }
+
+  printf("运动检测线程退出\n");
   return NULL;
 }
 
@@ -124,14 +1843,15 @@ static void *display_thread_func(void *arg)
 
   while (server->is_running)
   {
-    // 在LCD上显示摄像头画面
-    if (camera_module_display(server->camera_module, 0, 0) < 0)
+    // 在LCD上显示摄像头画面（阻塞等待采集线程发布新帧，帧率跟随摄像头）
+    if (camera_module_display(server->camera_module, VIDEO_REGION_X, VIDEO_REGION_Y) < 0)
     {
       usleep(10000);
       continue;
     }
 
-    usleep(50000); // 50ms, 约20fps
+    // 整帧画完后再翻页，视频区每帧都会重画，无需同步到新后台页
+    lcd_flip(0);
   }
 
   printf("本地显示线程退出\n");
@@ -160,29 +1880,52 @@ server_module_t *server_module_init(camera_module_t *camera_module)
   server->server_fd = -1;
   server->is_running = 0;
   server->camera_module = camera_module;
+  server->jpeg_quality = JPEG_QUALITY;
+  server->live_mode = 0;
+  server->delta_mode = 0;
+  server->motion_mode = 0;
+  server->rtp_group = NULL;
+  server->rtp_port = RTP_DEFAULT_PORT;
+  server->http_port = 0;
+  server->http_fd = -1;
+  pthread_mutex_init(&server->jpeg_mutex, NULL);
+
+  // 其它线程有新数据包要发送时，通过eventfd唤醒网络事件线程
+  server->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (server->wake_fd < 0)
+  {
+    perror("eventfd failed");
+    pthread_mutex_destroy(&server->jpeg_mutex);
+    free(server);
+    return NULL;
+  }
+
+  // 摄像头只能输出YUYV时，截屏和直播帧在服务器端编码成JPEG
+  if (!camera_is_compressed(camera_module->camera))
+  {
+    server->jpeg_encoder = jpeg_encoder_create(0);
+    if (!server->jpeg_encoder)
+    {
+      fprintf(stderr, "JPEG编码器创建失败，截屏将发送原始YUYV\n");
+    }
+  }
 
   // 初始化客户端列表
   g_client_count = 0;
-  memset(g_client_sockets, 0, sizeof(g_client_sockets));
+  memset(g_clients, 0, sizeof(g_clients));
 
   printf("服务器模块初始化成功\n");
   return server;
 }
 
 /**
- * @brief 启动服务器
+ * @brief 创建监听socket
+ * @return 成功返回socket，失败返回-1
  */
-int server_module_start(server_module_t *server)
+static int create_listen_socket(int port)
 {
-  if (!server)
-  {
-    return -1;
-  }
-
-  // 创建TCP服务器
-  printf("创建TCP服务器 (端口:%d)...\n", PORT);
-  server->server_fd = socket(AF_INET, SOCK_STREAM, 0);
-  if (server->server_fd < 0)
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
   {
     perror("socket创建失败");
     return -1;
@@ -190,31 +1933,62 @@ int server_module_start(server_module_t *server)
 
   // 设置端口复用
   int opt = 1;
-  setsockopt(server->server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
 
   // 绑定地址
   struct sockaddr_in server_addr;
   memset(&server_addr, 0, sizeof(server_addr));
   server_addr.sin_family = AF_INET;
   server_addr.sin_addr.s_addr = INADDR_ANY;
-  server_addr.sin_port = htons(PORT);
+  server_addr.sin_port = htons(port);
 
-  if (bind(server->server_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+  if (bind(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
   {
     perror("bind失败");
-    close(server->server_fd);
+    close(fd);
     return -1;
   }
 
   // 监听
-  if (listen(server->server_fd, MAX_CLIENTS) < 0)
+  if (listen(fd, MAX_CLIENTS) < 0)
   {
     perror("listen失败");
-    close(server->server_fd);
+    close(fd);
+    return -1;
+  }
+
+  printf("服务器正在监听端口 %d...\n", port);
+  return fd;
+}
+
+/**
+ * @brief 启动服务器
+ */
+int server_module_start(server_module_t *server)
+{
+  if (!server)
+  {
+    return -1;
+  }
+
+  // 创建TCP服务器
+  printf("创建TCP服务器 (端口:%d)...\n", PORT);
+  server->server_fd = create_listen_socket(PORT);
+  if (server->server_fd < 0)
+  {
     return -1;
   }
 
-  printf("服务器正在监听端口 %d...\n", PORT);
+  // HTTP服务起不来不影响主服务
+  if (server->http_port > 0 && server->http_fd < 0)
+  {
+    printf("创建HTTP服务 (端口:%d)...\n", server->http_port);
+    server->http_fd = create_listen_socket(server->http_port);
+    if (server->http_fd >= 0)
+    {
+      printf("浏览器打开 http://<板子IP>:%d/ 观看直播，/snapshot 获取截屏\n", server->http_port);
+    }
+  }
 
   // 启动本地显示线程
   printf("启动本地显示线程...\n");
@@ -223,9 +1997,69 @@ int server_module_start(server_module_t *server)
   {
     perror("创建显示线程失败");
     close(server->server_fd);
+    server->server_fd = -1;
+    if (server->http_fd >= 0)
+    {
+      close(server->http_fd);
+      server->http_fd = -1;
+    }
     return -1;
   }
 
+  if (server->delta_mode && !server->delta_encoder)
+  {
+    camera_t *cam = server->camera_module->camera;
+    if (camera_is_compressed(cam))
+    {
+      fprintf(stderr, "摄像头输出MJPEG，不支持增量编码\n");
+    }
+    else if ((server->delta_encoder = delta_encoder_create(cam->width, cam->height, 0, 0)) != NULL)
+    {
+      printf("直播帧使用增量编码（SAD内核: %s）\n", delta_kernel_name());
+    }
+  }
+
+  if (server->rtp_group && !server->rtp_sender)
+  {
+    server->rtp_sender = rtp_sender_create(server->rtp_group, server->rtp_port, 1);
+    if (server->rtp_sender)
+    {
+      printf("直播帧同时以RTP组播发送到 %s:%d\n", server->rtp_group, server->rtp_port);
+    }
+  }
+
+  // 直播线程：非直播模式下也要回应客户端的直播订阅和截屏请求，没有需求时休眠
+  printf("启动直播线程...\n");
+  if (pthread_create(&server->live_thread, NULL, live_thread_func, server) != 0)
+  {
+    perror("创建直播线程失败");
+    server->live_thread = 0;
+  }
+
+  // 运动检测：摄像头输出YUYV时才有亮度数据可用
+  if (server->motion_mode)
+  {
+    camera_t *cam = server->camera_module->camera;
+    if (camera_is_compressed(cam))
+    {
+      fprintf(stderr, "摄像头输出MJPEG，不支持运动检测（使用 -y 采集YUYV）\n");
+    }
+    else if (!server->motion_detector &&
+             !(server->motion_detector = motion_detector_create(cam->width, cam->height)))
+    {
+      fprintf(stderr, "运动检测器创建失败\n");
+    }
+    else
+    {
+      printf("启动运动检测线程...\n");
+      if (pthread_create(&server->motion_thread, NULL, motion_thread_func, server) != 0)
+      {
+        perror("创建运动检测线程失败");
+        server->motion_thread = 0;
+      }
+    }
+  }
+
   printf("服务器启动成功\n");
   return 0;
 }
@@ -253,10 +2087,14 @@ int server_module_stop(server_module_t *server)
   // 关闭服务器socket（只关闭一次）
   if (server->server_fd >= 0)
   {
-    shutdown(server->server_fd, SHUT_RDWR); // 先shutdown中断阻塞
     close(server->server_fd);
     server->server_fd = -1;
   }
+  if (server->http_fd >= 0)
+  {
+    close(server->http_fd);
+    server->http_fd = -1;
+  }
 
   // 等待显示线程退出（不使用cancel，让它自然退出）
   if (server->display_thread)
@@ -280,18 +2118,23 @@ int server_module_stop(server_module_t *server)
     server->display_thread = 0;
   }
 
-  // 关闭所有客户端连接
-  pthread_mutex_lock(&g_client_mutex);
-  for (int i = 0; i < g_client_count; i++)
+  if (server->live_thread)
   {
-    if (g_client_sockets[i] >= 0)
-    {
-      close(g_client_sockets[i]);
-      g_client_sockets[i] = -1;
-    }
+    pthread_mutex_lock(&g_client_mutex);
+    pthread_cond_broadcast(&g_demand_cond);
+    pthread_mutex_unlock(&g_client_mutex);
+    pthread_join(server->live_thread, NULL);
+    server->live_thread = 0;
   }
-  g_client_count = 0;
-  pthread_mutex_unlock(&g_client_mutex);
+
+  if (server->motion_thread)
+  {
+    pthread_join(server->motion_thread, NULL);
+    server->motion_thread = 0;
+  }
+
+  // 网络事件线程若仍在运行，唤醒它退出（客户端连接由它关闭）
+  wake_reactor(server);
 
   printf("服务器已停止\n");
   return 0;
@@ -308,6 +2151,12 @@ void server_module_close(server_module_t *server)
   }
 
   server_module_stop(server);
+  jpeg_encoder_destroy(server->jpeg_encoder);
+  delta_encoder_destroy(server->delta_encoder);
+  motion_detector_destroy(server->motion_detector);
+  rtp_sender_destroy(server->rtp_sender);
+  pthread_mutex_destroy(&server->jpeg_mutex);
+  close(server->wake_fd);
   free(server);
   printf("服务器模块已关闭\n");
 }
@@ -322,57 +2171,32 @@ int server_module_send_capture(server_module_t *server)
     return -1;
   }
 
-  unsigned char *yuyv_data = NULL;
-  unsigned int data_size = 0;
-
-  // 获取截屏帧
-  if (camera_module_capture_frame(server->camera_module, &yuyv_data, &data_size) < 0)
+  // 与LCD、直播共享最新帧
+  camera_frame_t *frame = camera_module_acquire_frame(server->camera_module, 0, 1000);
+  if (!frame)
   {
     fprintf(stderr, "获取截屏帧失败\n");
     return -1;
   }
 
-  // 准备数据包头
-  frame_header_t header;
-  header.magic = 0x12345678;
-  header.frame_size = data_size;
-  header.width = FRAME_WIDTH;
-  header.height = FRAME_HEIGHT;
-  header.format = 0; // YUYV
-  header.timestamp = (unsigned int)time(NULL);
-
-  printf("发送截屏帧给所有客户端，大小: %u bytes\n", data_size);
-
-  // 广播给所有客户端
-  pthread_mutex_lock(&g_client_mutex);
-  for (int i = 0; i < g_client_count; i++)
+  frame_packet_t *packet = build_packet(server, frame, PROTOCOL_FLAG_SNAPSHOT, server->jpeg_quality);
+  camera_module_release_frame(server->camera_module, frame);
+  if (!packet)
   {
-    int sock = g_client_sockets[i];
-
-    // 发送数据包头
-    if (send_full(sock, &header, sizeof(header)) < 0)
-    {
-      fprintf(stderr, "发送包头失败，客户端: %d\n", sock);
-      continue;
-    }
-
-    // 发送图像数据
-    if (send_full(sock, yuyv_data, data_size) < 0)
-    {
-      fprintf(stderr, "发送图像数据失败，客户端: %d\n", sock);
-      continue;
-    }
-
-    printf("成功发送截屏到客户端: %d\n", sock);
+    return -1;
   }
-  pthread_mutex_unlock(&g_client_mutex);
 
-  printf("截屏发送完成\n");
+  // 截屏包在队列满时不会被直播帧挤掉
+  packet->is_snapshot = 1;
+  int count = broadcast_packet(server, packet);
+  printf("截屏已提交给 %d 个客户端，大小: %u bytes\n", count, packet->payload_size);
+  frame_packet_unref(packet);
+
   return 0;
 }
 
 /**
- * @brief 服务器主循环（接受客户端连接）
+ * @brief 网络事件循环：accept、断开检测、读取命令、非阻塞发送都在这一个线程里完成
  */
 int server_module_run(server_module_t *server)
 {
@@ -381,46 +2205,120 @@ int server_module_run(server_module_t *server)
     return -1;
   }
 
-  printf("========================================\n");
-  printf("系统运行中...\n");
-  printf("等待客户端连接...\n");
-  printf("========================================\n\n");
+  int epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (epfd < 0)
+  {
+    perror("epoll_create1 failed");
+    return -1;
+  }
+
+  fcntl(server->server_fd, F_SETFL, fcntl(server->server_fd, F_GETFL) | O_NONBLOCK);
 
-  // 主循环: 接受客户端连接
-  while (server->is_running)
+  // 监听socket和eventfd用它们在server中的地址区分，客户端用client_t指针
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = &server->server_fd;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, server->server_fd, &ev);
+  ev.events = EPOLLIN;
+  ev.data.ptr = &server->wake_fd;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, server->wake_fd, &ev);
+  if (server->http_fd >= 0)
   {
-    struct sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
+    fcntl(server->http_fd, F_SETFL, fcntl(server->http_fd, F_GETFL) | O_NONBLOCK);
+    ev.events = EPOLLIN;
+    ev.data.ptr = &server->http_fd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, server->http_fd, &ev);
+  }
+
+  printf("网络事件线程启动，等待客户端连接...\n");
 
-    int *client_sock = malloc(sizeof(int));
-    if (!client_sock)
+  struct epoll_event events[MAX_EVENTS];
+  unsigned long long rate_us = protocol_monotonic_us();
+  while (server->is_running)
+  {
+    int n = epoll_wait(epfd, events, MAX_EVENTS, RATE_INTERVAL_MS);
+    if (n < 0)
     {
-      continue;
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      perror("epoll_wait failed");
+      break;
     }
 
-    *client_sock = accept(server->server_fd, (struct sockaddr *)&client_addr, &client_len);
-
-    if (*client_sock < 0)
+    for (int i = 0; i < n; i++)
     {
-      if (server->is_running)
+      void *ptr = events[i].data.ptr;
+      unsigned int mask = events[i].events;
+
+      if (ptr == &server->server_fd || ptr == &server->http_fd)
       {
-        perror("accept失败");
+        accept_clients(server, epfd, ptr == &server->http_fd);
+      }
+      else if (ptr == &server->wake_fd)
+      {
+        unsigned long long value;
+        if (read(server->wake_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        {
+          perror("read eventfd failed");
+        }
+        flush_all_clients(epfd);
+      }
+      else
+      {
+        client_t *client = (client_t *)ptr;
+        if (client->closed)
+        {
+          continue;
+        }
+
+        if ((mask & (EPOLLHUP | EPOLLRDHUP)) ||
+            ((mask & EPOLLERR) && check_client_error(client) < 0) ||
+            ((mask & EPOLLIN) && read_client(server, epfd, client) < 0) ||
+            ((mask & EPOLLOUT) && flush_client(epfd, client) < 0))
+        {
+          close_client(epfd, client);
+        }
       }
-      free(client_sock);
-      continue;
     }
 
-    // 为每个客户端创建处理线程
-    pthread_t tid;
-    if (pthread_create(&tid, NULL, client_handler_wrapper, client_sock) != 0)
+    free_closed_clients();
+
+    // 码率控制周期
+    unsigned long long now = protocol_monotonic_us();
+    if (now - rate_us >= RATE_INTERVAL_MS * 1000ULL)
     {
-      perror("创建客户端处理线程失败");
-      close(*client_sock);
-      free(client_sock);
-      continue;
+      for (int i = 0; i < g_client_count; i++)
+      {
+        update_rate(g_clients[i], now - rate_us);
+      }
+      rate_us = now;
     }
-    pthread_detach(tid); // 分离线程,自动回收资源
   }
 
+  // 断开所有客户端
+  while (g_client_count > 0)
+  {
+    close_client(epfd, g_clients[g_client_count - 1]);
+  }
+  free_closed_clients();
+  close(epfd);
+
+  printf("网络事件线程退出\n");
   return 0;
 }
+
+/**
+ * @brief 中断网络事件循环
+ */
+void server_module_interrupt(server_module_t *server)
+{
+  if (!server)
+  {
+    return;
+  }
+
+  server->is_running = 0;
+  wake_reactor(server);
+}
@@ -2,30 +2,45 @@
 #define __SERVER_MODULE_H__
 
 #include "camera_module.h"
+#include "jpeg_encoder.h"
+#include "delta_codec.h"
+#include "motion_detector.h"
+#include "frame_transform.h"
+#include "rtp_stream.h"
+#include "http_stream.h"
+#include "frame_queue.h"
+#include "protocol.h"
 
 #define PORT 8888
-#define MAX_CLIENTS 5
-#define FRAME_WIDTH 640
-#define FRAME_HEIGHT 480
-
-// 数据包头结构
-typedef struct
-{
-  unsigned int magic;      // 魔数 0x12345678
-  unsigned int frame_size; // 帧数据大小
-  unsigned int width;      // 图像宽度
-  unsigned int height;     // 图像高度
-  unsigned int format;     // 图像格式 (0=YUYV)
-  unsigned int timestamp;  // 时间戳
-} frame_header_t;
+#define MAX_CLIENTS 32 // listen等待队列长度
+#define FRAME_WIDTH 640  // 默认采集宽度（实际值以协商结果为准）
+#define FRAME_HEIGHT 480 // 默认采集高度
+#define JPEG_QUALITY 80  // YUYV帧编码成JPEG的默认质量
+#define MOTION_CAPTURE_INTERVAL_MS 1000 // 运动持续期间自动截屏的最小间隔
 
 // 服务器模块结构
 typedef struct
 {
   int server_fd;
+  int wake_fd; // eventfd：唤醒网络事件线程
   int is_running;
   camera_module_t *camera_module;
   pthread_t display_thread;
+  int jpeg_quality;  // YUYV帧的JPEG编码质量，0表示发送原始YUYV
+  jpeg_encoder_t *jpeg_encoder;
+  pthread_mutex_t jpeg_mutex; // 截屏和直播共用编码器
+  int live_mode;              // 直播模式：新连接默认订阅直播（客户端可用STREAM命令订阅/退订）
+  pthread_t live_thread;
+  int delta_mode;                 // 直播帧按块增量编码（仅YUYV摄像头）
+  delta_encoder_t *delta_encoder; // 只在直播线程中使用
+  int motion_mode;                     // 运动检测：有运动时自动截屏并通知运动框（仅YUYV摄像头）
+  motion_detector_t *motion_detector; // 只在运动检测线程中使用
+  pthread_t motion_thread;
+  const char *rtp_group;    // 非NULL时直播帧另外以RTP/UDP组播发送一份（不管有没有TCP观看者）
+  int rtp_port;
+  rtp_sender_t *rtp_sender; // 只在直播线程中使用
+  int http_port; // 非0时同时在该端口提供HTTP MJPEG服务（浏览器观看）
+  int http_fd;
 } server_module_t;
 
 /**
@@ -63,10 +78,17 @@ void server_module_close(server_module_t *server);
 int server_module_send_capture(server_module_t *server);
 
 /**
- * @brief 客户端处理线程包装器
- * @param arg 客户端socket指针
- * @return NULL
+ * @brief 网络事件循环（accept、断开检测、读取命令、非阻塞发送），
+ *        阻塞到server_module_interrupt或server_module_stop被调用
+ * @param server 服务器模块指针
+ * @return 成功返回0，失败返回-1
+ */
+int server_module_run(server_module_t *server);
+
+/**
+ * @brief 中断网络事件循环，使server_module_run返回
+ * @param server 服务器模块指针
  */
-void *client_handler_wrapper(void *arg);
+void server_module_interrupt(server_module_t *server);
 
 #endif // __SERVER_MODULE_H__
@@ -0,0 +1,147 @@
+/*
+ * JPEG解码器回归测试（make check）：
+ * 多线程编码（带DRI和RSTn）的图像在各个缩小倍数下都和源图一致，
+ * 码字超出码长范围的DHT被拒绝而不是写坏查找表。
+ */
+#include "../jpeg_decoder.h"
+#include "../jpeg_encoder.h"
+#include "../jpeg_tables.h"
+#include "test_image.h"
+#include <stdio.h>
+#include <string.h>
+
+#define WIDTH 200
+#define HEIGHT 120
+#define MIN_PSNR 30.0
+
+static int failures = 0;
+
+#define CHECK(cond, msg)                   \
+  do                                       \
+  {                                        \
+    if (!(cond))                           \
+    {                                      \
+      printf("FAIL: %s\n", msg);           \
+      failures++;                          \
+    }                                      \
+    else                                   \
+    {                                      \
+      printf("ok: %s\n", msg);             \
+    }                                      \
+  } while (0)
+
+static void count_rows(void *arg, const unsigned int *xrgb, int stride, int y, int width, int rows)
+{
+  *(int *)arg += rows;
+}
+
+/**
+ * @brief 检查JPEG数据在SOS之前有没有DRI段
+ */
+static int has_dri(const unsigned char *jpeg, unsigned int size)
+{
+  unsigned int pos = 2; // 跳过SOI
+  while (pos + 4 <= size && jpeg[pos] == 0xFF && jpeg[pos + 1] != JPEG_SOS)
+  {
+    if (jpeg[pos + 1] == JPEG_DRI)
+    {
+      return 1;
+    }
+    pos += 2 + ((jpeg[pos + 2] << 8) | jpeg[pos + 3]);
+  }
+  return 0;
+}
+
+/**
+ * @brief 按scale解码并和源图比较
+ */
+static void check_decode(jpeg_decoder_t *dec, const unsigned char *jpeg, unsigned int jpeg_size,
+                         const unsigned char *yuyv, int scale)
+{
+  static unsigned int pixels[WIDTH * HEIGHT];
+  test_image_t img = {pixels, (WIDTH + scale - 1) / scale, (HEIGHT + scale - 1) / scale, 0};
+  char msg[64];
+
+  int ret = jpeg_decode(dec, jpeg, jpeg_size, scale, test_collect_rows, &img);
+  double psnr = ret == 0 && img.rows == img.height ? test_psnr(yuyv, WIDTH, HEIGHT, &img, scale) : 0;
+  snprintf(msg, sizeof(msg), "解码正常图像 1/%d（PSNR %.1f dB）", scale, psnr);
+  CHECK(psnr >= MIN_PSNR, msg);
+}
+
+/**
+ * @brief 生成SOI + 一个DHT段 + EOI
+ * @param bits 16个码长个数
+ * @return 字节数
+ */
+static unsigned int build_dht_jpeg(unsigned char *out, const unsigned char *bits)
+{
+  unsigned int n = 0, p = 0;
+  for (int i = 0; i < 16; i++)
+  {
+    n += bits[i];
+  }
+
+  out[p++] = 0xFF;
+  out[p++] = JPEG_SOI;
+  out[p++] = 0xFF;
+  out[p++] = JPEG_DHT;
+  out[p++] = (2 + 17 + n) >> 8;
+  out[p++] = (2 + 17 + n) & 0xFF;
+  out[p++] = 0x00; // DC表0
+  memcpy(out + p, bits, 16);
+  p += 16;
+  memset(out + p, 0, n);
+  p += n;
+  out[p++] = 0xFF;
+  out[p++] = JPEG_EOI;
+  return p;
+}
+
+int main(void)
+{
+  jpeg_decoder_t *dec = jpeg_decoder_create();
+  jpeg_encoder_t *enc = jpeg_encoder_create(4); // 多线程编码：条带之间插入RSTn
+  static unsigned char yuyv[WIDTH * HEIGHT * 2];
+  unsigned char bad[2 + 4 + 17 + 256 + 2];
+  unsigned char bits[16];
+  const unsigned char *jpeg;
+  unsigned int jpeg_size;
+  int rows = 0;
+
+  if (!dec || !enc)
+  {
+    printf("FAIL: 创建编解码器\n");
+    return 1;
+  }
+
+  test_make_yuyv(yuyv, WIDTH, HEIGHT);
+  CHECK(jpeg_encode_yuyv(enc, yuyv, WIDTH, HEIGHT, 90, &jpeg, &jpeg_size) == 0, "编码YUYV");
+  CHECK(has_dri(jpeg, jpeg_size), "多线程编码带DRI");
+  for (int scale = 1; scale <= 8; scale *= 2)
+  {
+    check_decode(dec, jpeg, jpeg_size, yuyv, scale);
+  }
+
+  // 码长1的码字只有2个，200个会越过9位查找表
+  memset(bits, 0, sizeof(bits));
+  bits[0] = 200;
+  CHECK(jpeg_decode(dec, bad, build_dht_jpeg(bad, bits), 1, count_rows, &rows) < 0, "拒绝码长1有200个码字的DHT");
+
+  // 码长3最多8个码字
+  memset(bits, 0, sizeof(bits));
+  bits[2] = 9;
+  CHECK(jpeg_decode(dec, bad, build_dht_jpeg(bad, bits), 1, count_rows, &rows) < 0, "拒绝码长3有9个码字的DHT");
+
+  // 码长16的码字：前面的码长已用满码字空间
+  memset(bits, 0, sizeof(bits));
+  bits[0] = 2;
+  bits[15] = 1;
+  CHECK(jpeg_decode(dec, bad, build_dht_jpeg(bad, bits), 1, count_rows, &rows) < 0, "拒绝码字空间已满后的DHT");
+
+  // 拒绝坏码表后解码器仍可用
+  check_decode(dec, jpeg, jpeg_size, yuyv, 1);
+
+  jpeg_encoder_destroy(enc);
+  jpeg_decoder_destroy(dec);
+  return failures ? 1 : 0;
+}
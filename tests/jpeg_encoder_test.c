@@ -0,0 +1,85 @@
+/*
+ * JPEG编码器回归测试（make check）：
+ * 多线程编码器连续编码不同尺寸的图像（build_packet和build_transform_packet就是这样用的），
+ * 每一帧都要能解码，且和源图一致。
+ */
+#include "../jpeg_decoder.h"
+#include "../jpeg_encoder.h"
+#include "test_image.h"
+#include <stdio.h>
+
+#define ROUNDS 200
+#define MIN_PSNR 30.0
+
+static const int sizes[][2] = {{320, 240}, {64, 48}, {642, 122}, {16, 8}};
+#define NSIZES (int)(sizeof(sizes) / sizeof(sizes[0]))
+
+int main(void)
+{
+  jpeg_encoder_t *enc = jpeg_encoder_create(4);
+  jpeg_decoder_t *dec = jpeg_decoder_create();
+  unsigned char *yuyv[NSIZES];
+  test_image_t img;
+  int failures = 0;
+
+  if (!enc || !dec)
+  {
+    printf("FAIL: 创建编解码器\n");
+    return 1;
+  }
+
+  img.pixels = malloc(642 * 240 * sizeof(unsigned int));
+  for (int i = 0; i < NSIZES; i++)
+  {
+    yuyv[i] = malloc(sizes[i][0] * sizes[i][1] * 2);
+    test_make_yuyv(yuyv[i], sizes[i][0], sizes[i][1]);
+  }
+
+  double worst = 99.0;
+  for (int round = 0; round < ROUNDS && failures < 5; round++)
+  {
+    int i = round % NSIZES;
+    int width = sizes[i][0], height = sizes[i][1];
+    const unsigned char *jpeg;
+    unsigned int jpeg_size;
+
+    if (jpeg_encode_yuyv(enc, yuyv[i], width, height, 90, &jpeg, &jpeg_size) < 0)
+    {
+      printf("FAIL: 第%d轮编码%dx%d\n", round, width, height);
+      failures++;
+      continue;
+    }
+
+    img.width = width;
+    img.height = height;
+    img.rows = 0;
+    if (jpeg_decode(dec, jpeg, jpeg_size, 1, test_collect_rows, &img) < 0 || img.rows != height)
+    {
+      printf("FAIL: 第%d轮解码%dx%d\n", round, width, height);
+      failures++;
+      continue;
+    }
+
+    double psnr = test_psnr(yuyv[i], width, height, &img, 1);
+    worst = psnr < worst ? psnr : worst;
+    if (psnr < MIN_PSNR)
+    {
+      printf("FAIL: 第%d轮%dx%d PSNR %.1f dB\n", round, width, height, psnr);
+      failures++;
+    }
+  }
+
+  if (!failures)
+  {
+    printf("ok: 多线程交替编码%d种尺寸%d轮，最低PSNR %.1f dB\n", NSIZES, ROUNDS, worst);
+  }
+
+  for (int i = 0; i < NSIZES; i++)
+  {
+    free(yuyv[i]);
+  }
+  free(img.pixels);
+  jpeg_decoder_destroy(dec);
+  jpeg_encoder_destroy(enc);
+  return failures ? 1 : 0;
+}
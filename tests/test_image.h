@@ -0,0 +1,92 @@
+#ifndef __TEST_IMAGE_H__
+#define __TEST_IMAGE_H__
+
+/*
+ * 测试共用：生成YUYV测试图，收集解码输出，按PSNR和源图比较
+ */
+#include "../yuv_convert.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 解码输出缓冲区
+typedef struct
+{
+  unsigned int *pixels;
+  int width;
+  int height;
+  int rows;
+} test_image_t;
+
+/**
+ * @brief 生成平滑的YUYV渐变图（有限范围），JPEG压缩后误差小，适合按PSNR比较
+ */
+static inline void test_make_yuyv(unsigned char *yuyv, int width, int height)
+{
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x += 2)
+    {
+      unsigned char *p = yuyv + (y * width + x) * 2;
+      p[0] = 16 + (x * 219) / width;
+      p[1] = 64 + (y * 128) / height;
+      p[2] = 16 + ((x + 1) * 219) / width;
+      p[3] = 192 - (x * 128) / width;
+    }
+  }
+}
+
+/**
+ * @brief jpeg_decode的输出回调：写入test_image_t
+ */
+static inline void test_collect_rows(void *arg, const unsigned int *xrgb, int stride, int y, int width, int rows)
+{
+  test_image_t *img = (test_image_t *)arg;
+  for (int r = 0; r < rows && y + r < img->height; r++)
+  {
+    memcpy(img->pixels + (y + r) * img->width, xrgb + r * stride,
+           (width < img->width ? width : img->width) * sizeof(unsigned int));
+  }
+  img->rows += rows;
+}
+
+/**
+ * @brief 解码图与源图的PSNR（dB）：源图按scale*scale的块取平均后与解码图逐通道比较
+ */
+static inline double test_psnr(const unsigned char *yuyv, int width, int height, const test_image_t *img, int scale)
+{
+  double sse = 0;
+  long count = 0;
+
+  for (int oy = 0; oy < img->height; oy++)
+  {
+    for (int ox = 0; ox < img->width; ox++)
+    {
+      int sum[3] = {0, 0, 0}, n = 0;
+      for (int y = oy * scale; y < (oy + 1) * scale && y < height; y++)
+      {
+        for (int x = ox * scale; x < (ox + 1) * scale && x < width; x++)
+        {
+          const unsigned char *p = yuyv + (y * width + (x & ~1)) * 2;
+          unsigned int rgb = yuv_to_xrgb(p[(x & 1) * 2], p[1], p[3]);
+          sum[0] += (rgb >> 16) & 0xFF;
+          sum[1] += (rgb >> 8) & 0xFF;
+          sum[2] += rgb & 0xFF;
+          n++;
+        }
+      }
+
+      unsigned int out = img->pixels[oy * img->width + ox];
+      for (int c = 0; c < 3; c++)
+      {
+        double d = (double)sum[c] / n - ((out >> (16 - 8 * c)) & 0xFF);
+        sse += d * d;
+        count++;
+      }
+    }
+  }
+
+  return sse == 0 ? 99.0 : 10 * log10(255.0 * 255.0 * count / sse);
+}
+
+#endif // __TEST_IMAGE_H__
@@ -0,0 +1,148 @@
+/*
+ * YUYV转换内核回归测试（make check）：
+ * 本机能运行的每个内核（SSE2、AVX2，ARM上的NEON）对随机YUYV行的输出都必须和标量实现逐字节相同，
+ * 像素数覆盖奇数和各种行尾长度。内核用YUV_KERNEL环境变量强制选择，每个内核在单独的子进程中测试。
+ * 标量实现本身和camera.c的yuyv_to_rgb888定点公式逐个(Y,U,V)比较。
+ */
+#include "../yuv_convert.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define MAX_PIXELS 1000
+#define ROUNDS 20
+
+static const char *kernels[] = {"c", "sse2", "avx2", "neon"};
+
+static inline int clip(int value)
+{
+  return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+/**
+ * @brief yuv_to_xrgb和camera.c原来的定点公式对所有(Y,U,V)一致
+ */
+static int check_formula(void)
+{
+  for (int y = 0; y < 256; y++)
+  {
+    for (int u = 0; u < 256; u++)
+    {
+      for (int v = 0; v < 256; v++)
+      {
+        int c = y - 16, d = u - 128, e = v - 128;
+        unsigned int expect = 0xFF000000 | (clip((298 * c + 409 * e + 128) >> 8) << 16) |
+                              (clip((298 * c - 100 * d - 208 * e + 128) >> 8) << 8) |
+                              clip((298 * c + 516 * d + 128) >> 8);
+        if (yuv_to_xrgb(y, u, v) != expect)
+        {
+          printf("FAIL: 标量公式在Y=%d U=%d V=%d时和camera.c不一致\n", y, u, v);
+          return 1;
+        }
+      }
+    }
+  }
+
+  printf("ok: 标量公式与camera.c一致\n");
+  return 0;
+}
+
+/**
+ * @brief 测试当前选用的内核（子进程中运行）
+ * @return 通过返回0，内核不可用返回2，不一致返回1
+ */
+static int check_kernel(const char *name)
+{
+  if (strcmp(yuv_convert_kernel_name(), name) != 0)
+  {
+    return 2;
+  }
+
+  srand(12345);
+  for (int pixels = 1; pixels <= MAX_PIXELS; pixels += pixels < 300 ? 1 : 37)
+  {
+    for (int round = 0; round < ROUNDS; round++)
+    {
+      // 缓冲区大小正好，越界读写能被sanitizer发现
+      unsigned char *yuyv = malloc(pixels * 2);
+      unsigned int *expect = malloc(pixels * sizeof(unsigned int));
+      unsigned int *xrgb = malloc(pixels * sizeof(unsigned int));
+      unsigned char *rgb = malloc(pixels * 3);
+      unsigned char *expect_rgb = malloc(pixels * 3);
+
+      for (int i = 0; i < pixels * 2; i++)
+      {
+        yuyv[i] = rand();
+      }
+
+      yuyv_to_xrgb8888_c(yuyv, expect, pixels);
+      yuyv_to_xrgb8888(yuyv, xrgb, pixels);
+
+      for (int i = 0; i < pixels; i++)
+      {
+        expect_rgb[i * 3] = expect[i];
+        expect_rgb[i * 3 + 1] = expect[i] >> 8;
+        expect_rgb[i * 3 + 2] = expect[i] >> 16;
+      }
+      yuyv_to_rgb24(yuyv, rgb, pixels, 1);
+
+      int ok = memcmp(xrgb, expect, pixels * sizeof(unsigned int)) == 0 && memcmp(rgb, expect_rgb, pixels * 3) == 0;
+      free(yuyv);
+      free(expect);
+      free(xrgb);
+      free(rgb);
+      free(expect_rgb);
+      if (!ok)
+      {
+        printf("FAIL: 内核%s在%d个像素时和标量实现不一致\n", name, pixels);
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+int main(void)
+{
+  int failures = check_formula();
+
+  for (unsigned int k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+  {
+    // 内核在第一次转换时选定，每个内核用一个新进程
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+      perror("fork");
+      return 1;
+    }
+    if (pid == 0)
+    {
+      setenv("YUV_KERNEL", kernels[k], 1);
+      int ret = check_kernel(kernels[k]);
+      fflush(stdout);
+      _exit(ret);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    int code = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+    if (code == 2)
+    {
+      printf("skip: 本机不能运行内核%s\n", kernels[k]);
+    }
+    else if (code == 0)
+    {
+      printf("ok: 内核%s与标量实现逐字节一致\n", kernels[k]);
+    }
+    else
+    {
+      failures++;
+    }
+  }
+
+  return failures ? 1 : 0;
+}
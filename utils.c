@@ -24,8 +24,11 @@ void signal_handler(int sig)
  */
 void back_menu(void)
 {
-  clear_screen();
-  bmp_display("./main.bmp", 0, 0);
+  // main.bmp覆盖整个屏幕，不需要先用blank.bmp清屏
+  compositor_set_video(0, NULL);
+  compositor_set_image(COMP_LAYER_OVERLAY, NULL, 0, 0, NULL);
+  compositor_set_image(COMP_LAYER_BACKGROUND, "./main.bmp", 0, 0, NULL);
+  compositor_render();
 }
 
 /**
@@ -33,5 +36,8 @@ void back_menu(void)
  */
 void clear_screen(void)
 {
-  bmp_display("./blank.bmp", 0, 0);
+  compositor_set_video(0, NULL);
+  compositor_set_image(COMP_LAYER_OVERLAY, NULL, 0, 0, NULL);
+  compositor_set_image(COMP_LAYER_BACKGROUND, "./blank.bmp", 0, 0, NULL);
+  compositor_render();
 }
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -9,123 +10,1450 @@
 #include <signal.h>
 #include <time.h>
 #include <errno.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include "jpeg_tables.h"
+#include "protocol.h"
+#include "delta_codec.h"
+#include "frame_transform.h"
+#include "rtp_stream.h"
+#include "yuv_convert.h"
+#include "frame_pipeline.h"
+#include "frame_recorder.h"
+#include "frame_bench.h"
 
-#define FRAME_WIDTH 640
-#define FRAME_HEIGHT 480
+#define MAX_FRAME_WIDTH 4096  // 接受的最大分辨率（防止异常包头导致超大分配）
+#define MAX_FRAME_HEIGHT 4096
+#define MAX_FRAME_SIZE (MAX_FRAME_WIDTH * MAX_FRAME_HEIGHT * 2)
+#define BMP_HEADER_SIZE 54 // BITMAPFILEHEADER(14) + BITMAPINFOHEADER(40)
+#define SAVE_WORKERS 2     // 默认保存线程数
+#define SAVE_WORKERS_MAX 16
+#define SLOT_INITIAL_SIZE (640 * 480 * 2) // 缓冲区预分配大小（VGA YUYV），更大的帧按需扩容
+#define MAX_SERVERS 16
+#define RX_BUFFER_SIZE 65536      // 控制消息和帧包头的接收缓冲区（v2包头长度是16位，一定放得下）
+#define CONN_READS_PER_EVENT 16   // 每个连接每次最多读几次，多个服务器之间轮流
+#define RECONNECT_MIN_MS 500      // 重连退避：每次失败间隔加倍，连上后恢复
+#define RECONNECT_MAX_MS 30000
 
+// 连接状态
+#define CONN_WAITING 0    // 等待重连
+#define CONN_CONNECTING 1 // 非阻塞connect进行中
+#define CONN_CONNECTED 2
+
+// 接收统计（v2包头才有序号和时间戳）
+typedef struct
+{
+  unsigned long long last_seq;
+  unsigned long long lost;          // 序号跳过的帧数
+  unsigned long long frames;        // 参与统计的帧数
+  long long server_us_sum;          // 服务器内部延迟（采集->发送）
+  long long server_us_max;
+  long long e2e_us_sum;             // 端到端延迟（采集->收到，依赖两端时钟同步）
+  long long clock_offset_us;        // 服务器实时时钟 - 单调时钟（HELLO回复中给出）
+  int have_clock;
+} recv_stats_t;
+
+// 命令行选项
+typedef struct
+{
+  frame_transform_t transform; // SUBSCRIBE参数
+  int subscribe;               // 是否发送SUBSCRIBE
+  int stream;                  // 是否发送STREAM
+  int live;                    // 订阅直播（PROTOCOL_STREAM_KEEP：服务器默认）
+  int push;                    // 接收板端主动推送的截屏
+  int max_fps;                 // 直播最大帧率，0不限
+  int snapshot_interval;       // 每隔多少秒请求一张截屏，0不请求
+  int multicast;               // 从组播组接收直播帧（不连接服务器，不能发命令）
+  int bmp;                     // 非JPEG帧保存为BMP（默认PPM）
+  int workers;                 // 保存线程数
+  int slots;                   // 帧缓冲区个数（保存队列上限）
+  const char *record;          // 录像文件名前缀，NULL时每帧保存一个文件
+  int bench;                   // 基准测试：只统计吞吐量、抖动和延迟，不保存图像
+  char hosts[MAX_SERVERS][64]; // 服务器列表（组播模式下只有一个组播地址）
+  int ports[MAX_SERVERS];
+  int server_count;
+} client_options_t;
+
+// 一个服务器连接（或组播组）
 typedef struct
 {
-  unsigned int magic;      // 魔数 0x12345678
-  unsigned int frame_size; // 帧数据大小
-  unsigned int width;      // 图像宽度
-  unsigned int height;     // 图像高度
-  unsigned int format;     // 图像格式 (0=YUYV)
-  unsigned int timestamp;  // 时间戳
-} frame_header_t;
+  char host[64];
+  int port;
+  char label[80];            // 输出前缀，只有一个服务器时为空
+  char dir[80];              // 输出目录，只有一个服务器时为空（当前目录）
+  char record_prefix[256];
+  int fd;
+  int state;
+  unsigned int version;      // 当前协议版本，收到HELLO回复时更新
+  recv_stats_t stats;
+  delta_decoder_t delta;     // 增量流：在本地重建完整图像
+  frame_recorder_t recorder; // 录像（只由保存线程使用）
+  frame_bench_t bench;
+  rtp_receiver_t rtp;
+
+  // 接收状态：控制消息和帧包头先在rx中拼完整，图像数据直接收进帧缓冲区
+  unsigned char *rx;
+  unsigned int rx_len;
+  protocol_frame_t frame;    // 正在接收的帧
+  int in_payload;
+  unsigned char *dest;       // 图像数据的去处：缓冲池的缓冲区，或没有空闲缓冲区时的discard
+  unsigned int received;
+  frame_slot_t *slot;
+  unsigned char *discard;
+  unsigned int discard_capacity;
+
+  int frame_count;
+  int backoff_ms;
+  unsigned long long retry_us;         // 下次重连的时间（单调时钟）
+  unsigned long long next_snapshot_us; // 下次请求截屏的时间
+  unsigned long long connects;
+} server_conn_t;
+
+typedef struct
+{
+  const client_options_t *opt;
+  server_conn_t conns[MAX_SERVERS];
+  int conn_count;
+  int epfd;
+  frame_pipeline_t pipeline;
+} client_t;
+
+// 保存图像用的缓冲区：文件头 + 像素数据，整个文件一次write写出，在帧之间重复使用
+typedef struct
+{
+  unsigned char *data;
+  unsigned int capacity;
+} image_buffer_t;
+
+// 保存线程：从流水线取帧，转换格式后写盘
+typedef struct
+{
+  pthread_t thread;
+  client_t *client;
+} save_worker_t;
+
+static int g_running = 1;
+
+/**
+ * @brief 信号处理函数
+ */
+void signal_handler(int sig)
+{
+  printf("\n接收到信号 %d, 正在关闭客户端...\n", sig);
+  g_running = 0;
+}
+
+/**
+ * @brief 发送一条控制消息
+ */
+static int send_ctrl(int sock, unsigned int type, const void *payload, unsigned int length)
+{
+  unsigned char msg[PROTOCOL_CTRL_HEADER_SIZE + PROTOCOL_CTRL_PAYLOAD_MAX];
+  unsigned int size = protocol_encode_ctrl(msg, type, payload, length);
+
+  return send(sock, msg, size, MSG_NOSIGNAL) == (ssize_t)size ? 0 : -1;
+}
+
+/**
+ * @brief 发送HELLO，请求使用本端支持的最高协议版本
+ */
+static int send_hello(int sock)
+{
+  unsigned char payload[PROTOCOL_HELLO_REQUEST_SIZE];
+
+  protocol_put_le16(payload, PROTOCOL_VERSION);
+  protocol_put_le16(payload + 2, 0);
+  return send_ctrl(sock, PROTOCOL_CTRL_HELLO, payload, sizeof(payload));
+}
+
+/**
+ * @brief 发送STREAM：订阅/退订直播，设置最大帧率
+ */
+static int send_stream(int sock, const client_options_t *opt)
+{
+  unsigned char payload[PROTOCOL_STREAM_SIZE];
+
+  payload[0] = opt->live;
+  payload[1] = opt->push;
+  protocol_put_le16(payload + 2, opt->max_fps);
+  return send_ctrl(sock, PROTOCOL_CTRL_STREAM, payload, sizeof(payload));
+}
+
+/**
+ * @brief 请求一张截屏，同时发送PING测量往返时间（令牌为本地单调时钟）
+ */
+static int request_snapshot(int sock)
+{
+  unsigned char token[PROTOCOL_PING_REQUEST_SIZE];
+
+  protocol_put_le64(token, protocol_monotonic_us());
+  if (send_ctrl(sock, PROTOCOL_CTRL_PING, token, sizeof(token)) < 0)
+  {
+    return -1;
+  }
+  return send_ctrl(sock, PROTOCOL_CTRL_SNAPSHOT, NULL, 0);
+}
+
+/**
+ * @brief 发送SUBSCRIBE：请求服务器裁剪/缩小直播帧或改用其它格式
+ */
+static int send_subscribe(int sock, const frame_transform_t *transform)
+{
+  unsigned char payload[PROTOCOL_SUBSCRIBE_SIZE];
+
+  payload[0] = transform->scale;
+  payload[1] = transform->format;
+  protocol_put_le16(payload + 2, 0);
+  protocol_put_le16(payload + 4, transform->x);
+  protocol_put_le16(payload + 6, transform->y);
+  protocol_put_le16(payload + 8, transform->w);
+  protocol_put_le16(payload + 10, transform->h);
+  return send_ctrl(sock, PROTOCOL_CTRL_SUBSCRIBE, payload, sizeof(payload));
+}
+
+/**
+ * @brief 处理服务器发来的控制消息
+ */
+static void handle_ctrl(server_conn_t *conn, unsigned int type, const unsigned char *payload, unsigned int length)
+{
+  if (type == PROTOCOL_CTRL_HELLO && length >= PROTOCOL_HELLO_REPLY_SIZE)
+  {
+    conn->version = protocol_get_le16(payload);
+    conn->stats.clock_offset_us = (long long)(protocol_get_le64(payload + 12) - protocol_get_le64(payload + 4));
+    conn->stats.have_clock = 1;
+    printf("%s服务器采用协议 v%u\n", conn->label, conn->version);
+  }
+  else if (type == PROTOCOL_CTRL_MOTION && length >= PROTOCOL_MOTION_HEADER_SIZE)
+  {
+    unsigned int count = payload[13];
+    if (PROTOCOL_MOTION_HEADER_SIZE + count * PROTOCOL_MOTION_BOX_SIZE > length)
+    {
+      count = (length - PROTOCOL_MOTION_HEADER_SIZE) / PROTOCOL_MOTION_BOX_SIZE;
+    }
+
+    printf("%s[运动] %s (帧 %llu)", conn->label, payload[12] ? "检测到运动" : "运动结束", protocol_get_le64(payload));
+    for (unsigned int i = 0; i < count; i++)
+    {
+      const unsigned char *box = payload + PROTOCOL_MOTION_HEADER_SIZE + i * PROTOCOL_MOTION_BOX_SIZE;
+      printf(" [%u,%u %ux%u]", protocol_get_le16(box), protocol_get_le16(box + 2),
+             protocol_get_le16(box + 4), protocol_get_le16(box + 6));
+    }
+    printf("\n");
+  }
+  else if (type == PROTOCOL_CTRL_SUBSCRIBE && length >= PROTOCOL_SUBSCRIBE_SIZE)
+  {
+    printf("%s服务器订阅生效: 裁剪(%u,%u %ux%u) 缩小%u倍 格式%u\n", conn->label, protocol_get_le16(payload + 4),
+           protocol_get_le16(payload + 6), protocol_get_le16(payload + 8), protocol_get_le16(payload + 10),
+           payload[0], payload[1]);
+  }
+  else if (type == PROTOCOL_CTRL_STREAM && length >= PROTOCOL_STREAM_SIZE)
+  {
+    printf("%s服务器确认: 直播%s, 推送%s, 最大帧率 %u\n", conn->label, payload[0] ? "开" : "关",
+           payload[1] ? "开" : "关", protocol_get_le16(payload + 2));
+  }
+  else if (type == PROTOCOL_CTRL_PING && length >= PROTOCOL_PING_REPLY_SIZE)
+  {
+    printf("%sPING往返: %.1f ms\n", conn->label, (protocol_monotonic_us() - protocol_get_le64(payload)) / 1000.0);
+  }
+}
+
+/**
+ * @brief 从组播接收下一帧（分片不全的帧在rtp_stream中丢弃），不等待
+ *        包头无效的单元丢弃后继续处理同一批里剩下的数据报，直到socket读空
+ * @param data 输出图像数据指针，指向接收端缓冲区，下次接收前有效
+ * @return 收到一帧返回1，没有完整的帧返回0，出错返回-1
+ */
+static int recv_rtp_frame(rtp_receiver_t *receiver, protocol_frame_t *frame, const unsigned char **data)
+{
+  const unsigned char *unit;
+  unsigned int size;
+
+  for (;;)
+  {
+    int ret = rtp_receive_unit(receiver, &unit, &size, 0);
+    if (ret <= 0)
+    {
+      return ret;
+    }
+
+    if (protocol_decode_v2(unit, size, frame) < 0 || frame->header_len > size ||
+        frame->frame_size > size - frame->header_len)
+    {
+      fprintf(stderr, "组播单元包头无效，丢弃\n");
+      continue;
+    }
+    *data = unit + frame->header_len;
+    return 1;
+  }
+}
+
+/**
+ * @brief 更新丢帧和延迟统计
+ */
+static void update_stats(recv_stats_t *stats, const protocol_frame_t *frame)
+{
+  if (frame->version < 2)
+  {
+    return;
+  }
+
+  // 截屏可能与已收到的直播帧是同一帧，只统计序号前进的帧
+  if (frame->seq <= stats->last_seq)
+  {
+    return;
+  }
+  if (stats->last_seq && frame->seq > stats->last_seq + 1)
+  {
+    stats->lost += frame->seq - stats->last_seq - 1;
+  }
+  stats->last_seq = frame->seq;
+
+  long long server_us = (long long)(frame->send_us - frame->capture_us);
+  stats->frames++;
+  stats->server_us_sum += server_us;
+  if (server_us > stats->server_us_max)
+  {
+    stats->server_us_max = server_us;
+  }
+  if (stats->have_clock)
+  {
+    stats->e2e_us_sum += (long long)protocol_realtime_us() - ((long long)frame->capture_us + stats->clock_offset_us);
+  }
+}
+
+/**
+ * @brief 保证缓冲区至少有size字节
+ * @return 成功返回缓冲区，失败返回NULL
+ */
+static unsigned char *image_buffer_reserve(image_buffer_t *buf, unsigned int size)
+{
+  if (size > buf->capacity)
+  {
+    unsigned char *data = realloc(buf->data, size);
+    if (!data)
+    {
+      perror("malloc失败");
+      return NULL;
+    }
+    buf->data = data;
+    buf->capacity = size;
+  }
+  return buf->data;
+}
+
+/**
+ * @brief 把整个文件内容写出（一般一次write完成）
+ * @return 成功返回0，失败返回-1
+ */
+static int write_file(const char *filename, const unsigned char *data, unsigned int size)
+{
+  int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+  {
+    perror("打开文件失败");
+    return -1;
+  }
+
+  unsigned int written = 0;
+  while (written < size)
+  {
+    ssize_t n = write(fd, data + written, size - written);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      perror("写文件失败");
+      close(fd);
+      return -1;
+    }
+    written += n;
+  }
+
+  close(fd);
+  return 0;
+}
+
+/**
+ * @brief 生成保存的文件名：<目录>/frame_NNNN.<扩展名>，目录为空时在当前目录
+ */
+static void frame_filename(char *out, size_t size, const char *dir, int frame_num, const char *ext)
+{
+  snprintf(out, size, "%s%sframe_%04d.%s", dir, dir[0] ? "/" : "", frame_num, ext);
+}
+
+/**
+ * @brief YUYV转RGB24并保存为PPM文件（整帧用SIMD内核转换，饱和到0~255）
+ */
+void save_frame_as_ppm(image_buffer_t *buf, const char *dir, const unsigned char *yuyv, int width, int height,
+                       int frame_num)
+{
+  char filename[128];
+  frame_filename(filename, sizeof(filename), dir, frame_num, "ppm");
+
+  char header[32];
+  unsigned int header_size = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+  unsigned int size = header_size + (unsigned int)width * height * 3;
+  unsigned char *out = image_buffer_reserve(buf, size);
+  if (!out)
+  {
+    return;
+  }
+
+  memcpy(out, header, header_size);
+  yuyv_to_rgb24(yuyv, out + header_size, width * height, 0);
+  if (write_file(filename, out, size) == 0)
+  {
+    printf("保存帧 %d 到 %s\n", frame_num, filename);
+  }
+}
+
+/**
+ * @brief YUYV转24位BMP并保存（与mirror/camera.c的yuv2bmp布局相同：BGR，行从下往上，每行4字节对齐）
+ */
+void save_frame_as_bmp(image_buffer_t *buf, const char *dir, const unsigned char *yuyv, int width, int height,
+                       int frame_num)
+{
+  char filename[128];
+  frame_filename(filename, sizeof(filename), dir, frame_num, "bmp");
+
+  unsigned int row_bytes = ((unsigned int)width * 3 + 3) & ~3u;
+  unsigned int size = BMP_HEADER_SIZE + row_bytes * height;
+  unsigned char *out = image_buffer_reserve(buf, size);
+  if (!out)
+  {
+    return;
+  }
+
+  // BITMAPFILEHEADER + BITMAPINFOHEADER（小端）
+  memset(out, 0, BMP_HEADER_SIZE);
+  out[0] = 'B';
+  out[1] = 'M';
+  protocol_put_le32(out + 2, size);
+  protocol_put_le32(out + 10, BMP_HEADER_SIZE);
+  protocol_put_le32(out + 14, 40);
+  protocol_put_le32(out + 18, width);
+  protocol_put_le32(out + 22, height);
+  protocol_put_le16(out + 26, 1);  // 平面数
+  protocol_put_le16(out + 28, 24); // 每像素位数
+  protocol_put_le32(out + 34, row_bytes * height);
+
+  for (int y = 0; y < height; y++)
+  {
+    unsigned char *row = out + BMP_HEADER_SIZE + (size_t)(height - 1 - y) * row_bytes;
+    yuyv_to_rgb24(yuyv + (size_t)y * width * 2, row, width, 1);
+    memset(row + width * 3, 0, row_bytes - width * 3);
+  }
+
+  if (write_file(filename, out, size) == 0)
+  {
+    printf("保存帧 %d 到 %s\n", frame_num, filename);
+  }
+}
+
+/**
+ * @brief 按选项保存为PPM或BMP
+ */
+static void save_frame_image(image_buffer_t *buf, int bmp, const char *dir, const unsigned char *yuyv, int width,
+                             int height, int frame_num)
+{
+  if (bmp)
+  {
+    save_frame_as_bmp(buf, dir, yuyv, width, height, frame_num);
+  }
+  else
+  {
+    save_frame_as_ppm(buf, dir, yuyv, width, height, frame_num);
+  }
+}
+
+/**
+ * @brief 返回图像格式名称
+ */
+static const char *format_name(unsigned int format)
+{
+  switch (format)
+  {
+  case FRAME_FORMAT_YUYV:
+    return "YUYV";
+  case FRAME_FORMAT_MJPEG:
+    return "MJPEG";
+  case FRAME_FORMAT_JPEG:
+    return "JPEG";
+  case FRAME_FORMAT_YUYV_DELTA:
+    return "YUYV-DELTA";
+  case FRAME_FORMAT_I420:
+    return "I420";
+  default:
+    return "Unknown";
+  }
+}
+
+/**
+ * @brief 把MJPEG/JPEG帧保存为JPG文件
+ *        服务器编码的JPEG自带DHT；摄像头的MJPEG帧常省略DHT（默认使用标准Huffman表），保存时补上，普通看图软件才能打开
+ */
+void save_frame_as_jpeg(const char *dir, const unsigned char *jpeg, unsigned int size, int frame_num)
+{
+  char filename[128];
+  frame_filename(filename, sizeof(filename), dir, frame_num, "jpg");
+
+  FILE *fp = fopen(filename, "wb");
+  if (!fp)
+  {
+    perror("打开文件失败");
+    return;
+  }
+
+  unsigned int sos = 0;
+  if (size > 4 && !jpeg_has_dht(jpeg, size, &sos) && sos > 0)
+  {
+    unsigned char dht[JPEG_STD_DHT_SIZE];
+    unsigned int dht_size = jpeg_write_std_dht(dht);
+
+    fwrite(jpeg, 1, sos, fp);
+    fwrite(dht, 1, dht_size, fp);
+    fwrite(jpeg + sos, 1, size - sos, fp);
+  }
+  else
+  {
+    fwrite(jpeg, 1, size, fp);
+  }
+
+  fclose(fp);
+  printf("保存帧 %d 到 %s\n", frame_num, filename);
+}
+
+/**
+ * @brief 保存线程：从队列取帧，转换格式并写盘（或追加到录像文件），完成后把缓冲区还回缓冲池
+ *        增量帧已由接收线程解码为YUYV，这里只会遇到JPEG、YUYV和I420
+ */
+static void *save_worker_thread(void *arg)
+{
+  client_t *client = ((save_worker_t *)arg)->client;
+  int bmp = client->opt->bmp;
+
+  // 每个线程有自己的转换缓冲区，在帧之间重复使用
+  image_buffer_t image;
+  image_buffer_t yuyv;
+  memset(&image, 0, sizeof(image));
+  memset(&yuyv, 0, sizeof(yuyv));
+
+  frame_slot_t *slot;
+  while ((slot = frame_pipeline_take(&client->pipeline)) != NULL)
+  {
+    const protocol_frame_t *header = &slot->header;
+    server_conn_t *conn = &client->conns[slot->source];
+
+    if (client->opt->record)
+    {
+      // 优先用服务器的采集时间，老服务器用收到的时间
+      frame_recorder_write(&conn->recorder, header, slot->data,
+                           header->version >= 2 ? header->capture_us : slot->recv_us);
+    }
+    else if (header->format == FRAME_FORMAT_MJPEG || header->format == FRAME_FORMAT_JPEG)
+    {
+      save_frame_as_jpeg(conn->dir, slot->data, header->frame_size, slot->frame_num);
+    }
+    else if (header->format == FRAME_FORMAT_YUYV)
+    {
+      save_frame_image(&image, bmp, conn->dir, slot->data, header->width, header->height, slot->frame_num);
+    }
+    else if (header->format == FRAME_FORMAT_I420)
+    {
+      unsigned char *out = image_buffer_reserve(&yuyv, header->width * header->height * 2);
+      if (out)
+      {
+        frame_i420_to_yuyv(slot->data, header->width, header->height, out);
+        save_frame_image(&image, bmp, conn->dir, out, header->width, header->height, slot->frame_num);
+      }
+    }
+
+    frame_pipeline_release(&client->pipeline, slot);
+  }
+
+  free(image.data);
+  free(yuyv.data);
+  return NULL;
+}
+
+/**
+ * @brief 解析一个服务器地址：“IP:端口”，或者“IP 端口”两个参数
+ * @return 成功返回0，参数错误返回-1
+ */
+static int add_server(client_options_t *opt, int argc, char *argv[], int *i)
+{
+  const char *arg = argv[*i];
+  const char *colon = strrchr(arg, ':');
+  const char *port;
+  size_t len;
+
+  if (opt->server_count >= MAX_SERVERS)
+  {
+    fprintf(stderr, "最多 %d 个服务器\n", MAX_SERVERS);
+    return -1;
+  }
+  if (colon)
+  {
+    len = colon - arg;
+    port = colon + 1;
+  }
+  else if (*i + 1 < argc)
+  {
+    len = strlen(arg);
+    port = argv[++*i];
+  }
+  else
+  {
+    return -1;
+  }
+
+  char *end;
+  long value = strtol(port, &end, 10);
+  if (len == 0 || len >= sizeof(opt->hosts[0]) || *end != '\0' || value <= 0 || value > 65535)
+  {
+    return -1;
+  }
+
+  char *host = opt->hosts[opt->server_count];
+  struct in_addr addr;
+  memcpy(host, arg, len);
+  host[len] = '\0';
+  if (inet_pton(AF_INET, host, &addr) <= 0)
+  {
+    fprintf(stderr, "无效的IP地址: %s\n", host);
+    return -1;
+  }
+
+  opt->ports[opt->server_count++] = value;
+  return 0;
+}
+
+/**
+ * @brief 解析命令行：服务器地址和选项
+ * @return 成功返回0，参数错误返回-1
+ */
+static int parse_options(int argc, char *argv[], client_options_t *opt)
+{
+  frame_transform_t *transform = &opt->transform;
+
+  memset(opt, 0, sizeof(*opt));
+  transform->scale = 1;
+  transform->format = FRAME_FORMAT_YUYV;
+  opt->live = PROTOCOL_STREAM_KEEP;
+  opt->push = PROTOCOL_STREAM_KEEP;
+  opt->workers = SAVE_WORKERS;
+  opt->slots = FRAME_PIPELINE_SLOTS;
+
+  for (int i = 1; i < argc; i++)
+  {
+    // 服务器地址
+    if (argv[i][0] != '-')
+    {
+      if (add_server(opt, argc, argv, &i) < 0)
+      {
+        return -1;
+      }
+      continue;
+    }
+    if (strcmp(argv[i], "-u") == 0)
+    {
+      opt->multicast = 1;
+      continue;
+    }
+    if (strcmp(argv[i], "-b") == 0)
+    {
+      opt->bmp = 1;
+      continue;
+    }
+    if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+    {
+      opt->workers = atoi(argv[++i]);
+      if (opt->workers < 1 || opt->workers > SAVE_WORKERS_MAX)
+      {
+        return -1;
+      }
+      continue;
+    }
+    if (strcmp(argv[i], "-q") == 0 && i + 1 < argc)
+    {
+      opt->slots = atoi(argv[++i]);
+      if (opt->slots < 1 || opt->slots > FRAME_PIPELINE_MAX_SLOTS)
+      {
+        return -1;
+      }
+      continue;
+    }
+    if (strcmp(argv[i], "--bench") == 0)
+    {
+      opt->bench = 1;
+      continue;
+    }
+    if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+    {
+      opt->record = argv[++i];
+      continue;
+    }
+    if (strcmp(argv[i], "-L") == 0 || strcmp(argv[i], "-n") == 0)
+    {
+      opt->live = argv[i][1] == 'L';
+      opt->stream = 1;
+      continue;
+    }
+    if (strcmp(argv[i], "-P") == 0)
+    {
+      opt->push = 0;
+      opt->stream = 1;
+      continue;
+    }
+    if (strcmp(argv[i], "-F") == 0 && i + 1 < argc)
+    {
+      opt->max_fps = atoi(argv[++i]);
+      opt->stream = 1;
+      if (opt->max_fps < 0 || opt->max_fps > 65535)
+      {
+        return -1;
+      }
+      continue;
+    }
+    if (strcmp(argv[i], "-S") == 0 && i + 1 < argc)
+    {
+      opt->snapshot_interval = atoi(argv[++i]);
+      if (opt->snapshot_interval <= 0)
+      {
+        return -1;
+      }
+      continue;
+    }
+
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+    {
+      transform->scale = atoi(argv[++i]);
+      if (transform->scale != 1 && transform->scale != 2 && transform->scale != 4)
+      {
+        return -1;
+      }
+    }
+    else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+    {
+      unsigned int x, y, w, h;
+      if (sscanf(argv[++i], "%u,%u,%u,%u", &x, &y, &w, &h) != 4)
+      {
+        return -1;
+      }
+      transform->x = x;
+      transform->y = y;
+      transform->w = w;
+      transform->h = h;
+    }
+    else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+    {
+      const char *name = argv[++i];
+      if (strcmp(name, "yuyv") == 0)
+      {
+        transform->format = FRAME_FORMAT_YUYV;
+      }
+      else if (strcmp(name, "i420") == 0)
+      {
+        transform->format = FRAME_FORMAT_I420;
+      }
+      else if (strcmp(name, "jpeg") == 0)
+      {
+        transform->format = FRAME_FORMAT_JPEG;
+      }
+      else
+      {
+        return -1;
+      }
+    }
+    else
+    {
+      return -1;
+    }
+    opt->subscribe = 1;
+  }
+
+  // 录像按到达顺序追加，只用一个保存线程；基准测试不保存图像
+  if (opt->record && opt->bench)
+  {
+    return -1;
+  }
+  if (opt->record || opt->bench)
+  {
+    opt->workers = 1;
+  }
+
+  // 组播只能被动接收一个组
+  if (opt->server_count == 0 ||
+      (opt->multicast && (opt->server_count > 1 || opt->subscribe || opt->stream || opt->snapshot_interval)))
+  {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief 关闭连接，按退避时间安排重连（每次失败间隔加倍，连上后恢复）
+ */
+static void conn_retry_later(client_t *client, server_conn_t *conn)
+{
+  if (conn->fd >= 0)
+  {
+    epoll_ctl(client->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    conn->fd = -1;
+  }
+  if (conn->slot)
+  {
+    frame_pipeline_release(&client->pipeline, conn->slot);
+    conn->slot = NULL;
+  }
+  conn->rx_len = 0;
+  conn->in_payload = 0;
+
+  // 重连后服务器从关键帧重新开始
+  delta_decoder_free(&conn->delta);
+
+  conn->state = CONN_WAITING;
+  conn->retry_us = protocol_monotonic_us() + conn->backoff_ms * 1000ull;
+  printf("%s%.1f 秒后重连\n", conn->label, conn->backoff_ms / 1000.0);
+  conn->backoff_ms = conn->backoff_ms * 2 < RECONNECT_MAX_MS ? conn->backoff_ms * 2 : RECONNECT_MAX_MS;
+}
+
+/**
+ * @brief 连接建立：协商协议版本，发送订阅参数
+ */
+static void conn_connected(client_t *client, server_conn_t *conn)
+{
+  const client_options_t *opt = client->opt;
+  struct epoll_event ev;
+
+  ev.events = EPOLLIN;
+  ev.data.ptr = conn;
+  epoll_ctl(client->epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+
+  conn->state = CONN_CONNECTED;
+  conn->backoff_ms = RECONNECT_MIN_MS;
+  conn->connects++;
+  conn->next_snapshot_us = protocol_monotonic_us();
+  printf("%s成功连接到服务器!\n", conn->label);
+
+  // 协商协议版本（老服务器不回复，保持v1）；服务器重启后序号从头开始
+  conn->version = 1;
+  conn->stats.last_seq = 0;
+  if (send_hello(conn->fd) < 0)
+  {
+    perror("发送HELLO失败");
+  }
+  if (opt->subscribe && send_subscribe(conn->fd, &opt->transform) < 0)
+  {
+    perror("发送SUBSCRIBE失败");
+  }
+  if (opt->stream && send_stream(conn->fd, opt) < 0)
+  {
+    perror("发送STREAM失败");
+  }
+}
+
+/**
+ * @brief 开始非阻塞连接服务器
+ */
+static void conn_connect(client_t *client, server_conn_t *conn)
+{
+  printf("%s正在连接服务器 %s:%d...\n", conn->label, conn->host, conn->port);
+
+  conn->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (conn->fd < 0)
+  {
+    perror("socket创建失败");
+    conn_retry_later(client, conn);
+    return;
+  }
+
+  struct sockaddr_in server_addr;
+  memset(&server_addr, 0, sizeof(server_addr));
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_port = htons(conn->port);
+  inet_pton(AF_INET, conn->host, &server_addr.sin_addr);
+
+  // 连接完成时可写
+  struct epoll_event ev;
+  ev.events = EPOLLOUT;
+  ev.data.ptr = conn;
+  if (epoll_ctl(client->epfd, EPOLL_CTL_ADD, conn->fd, &ev) < 0)
+  {
+    perror("epoll_ctl failed");
+    conn_retry_later(client, conn);
+    return;
+  }
+
+  if (connect(conn->fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) == 0)
+  {
+    conn_connected(client, conn);
+  }
+  else if (errno == EINPROGRESS)
+  {
+    conn->state = CONN_CONNECTING;
+  }
+  else
+  {
+    perror("连接服务器失败");
+    conn_retry_later(client, conn);
+  }
+}
+
+/**
+ * @brief 非阻塞连接的结果
+ */
+static void conn_connect_done(client_t *client, server_conn_t *conn)
+{
+  int err = 0;
+  socklen_t len = sizeof(err);
+
+  if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+  {
+    err = errno;
+  }
+  if (err)
+  {
+    fprintf(stderr, "%s连接服务器失败: %s\n", conn->label, strerror(err));
+    conn_retry_later(client, conn);
+    return;
+  }
+  conn_connected(client, conn);
+}
+
+/**
+ * @brief 收到帧包头：检查大小，取空闲缓冲区；保存线程跟不上时照常读出数据，但不保存这一帧
+ * @return 成功返回0，包头无效返回-1
+ */
+static int begin_frame(client_t *client, server_conn_t *conn)
+{
+  const protocol_frame_t *header = &conn->frame;
 
-static int g_running = 1;
+  if (header->frame_size > MAX_FRAME_SIZE ||
+      header->width > MAX_FRAME_WIDTH || header->height > MAX_FRAME_HEIGHT)
+  {
+    fprintf(stderr, "%s错误: 帧过大 (%ux%u, %u bytes, 最大 %d bytes)\n", conn->label,
+            header->width, header->height, header->frame_size, MAX_FRAME_SIZE);
+    return -1;
+  }
+
+  if ((header->format == FRAME_FORMAT_YUYV && header->frame_size < header->width * header->height * 2) ||
+      (header->format == FRAME_FORMAT_I420 &&
+       ((header->width | header->height) & 1 || header->frame_size < header->width * header->height * 3 / 2)))
+  {
+    fprintf(stderr, "%s错误: 帧大小 %u 与分辨率 %ux%u 不符\n", conn->label,
+            header->frame_size, header->width, header->height);
+    return -1;
+  }
+
+  // 缓冲区按包头中的帧大小扩容，分辨率由各服务器自己决定；基准测试直接收进discard
+  conn->slot = client->opt->bench ? NULL : frame_pipeline_acquire(&client->pipeline);
+  if (conn->slot && frame_slot_reserve(conn->slot, header->frame_size) < 0)
+  {
+    frame_pipeline_release(&client->pipeline, conn->slot);
+    conn->slot = NULL;
+  }
+
+  // 组播的整帧已在接收端缓冲区中，不需要discard
+  conn->dest = conn->slot ? conn->slot->data : conn->discard;
+  if (!conn->slot && conn->fd >= 0 && header->frame_size > conn->discard_capacity)
+  {
+    conn->dest = realloc(conn->discard, header->frame_size);
+    if (!conn->dest)
+    {
+      perror("malloc失败");
+      return -1;
+    }
+    conn->discard = conn->dest;
+    conn->discard_capacity = header->frame_size;
+  }
+
+  conn->in_payload = 1;
+  conn->received = 0;
+  return 0;
+}
 
 /**
- * @brief 信号处理函数
+ * @brief 一帧收完：统计、显示，交给保存线程
+ * @param data 图像数据（TCP已在conn->dest中，组播在接收端缓冲区中）
  */
-void signal_handler(int sig)
+static void finish_frame(client_t *client, server_conn_t *conn, const unsigned char *data)
 {
-  printf("\n接收到信号 %d, 正在关闭客户端...\n", sig);
-  g_running = 0;
+  const client_options_t *opt = client->opt;
+  protocol_frame_t header = conn->frame;
+  frame_slot_t *slot = conn->slot;
+
+  conn->in_payload = 0;
+  conn->slot = NULL;
+  conn->frame_count++;
+  update_stats(&conn->stats, &header);
+
+  // 基准测试：只记录到达时间和延迟（采集时间换算到实时时钟后比较，时钟差导致的负值按0计）
+  if (opt->bench)
+  {
+    unsigned long long arrival_us = protocol_monotonic_us();
+    long long latency_us = -1;
+    if (header.version >= 2 && conn->stats.have_clock)
+    {
+      latency_us = (long long)protocol_realtime_us() - ((long long)header.capture_us + conn->stats.clock_offset_us);
+      latency_us = latency_us > 0 ? latency_us : 0;
+    }
+    frame_bench_add(&conn->bench, arrival_us, header.header_len + header.frame_size, latency_us);
+    return;
+  }
+
+  if (slot && data != slot->data)
+  {
+    memcpy(slot->data, data, header.frame_size);
+  }
+
+  // 显示接收信息
+  time_t current_time = time(NULL);
+  struct tm *tm_info = localtime(&current_time);
+  char time_str[64];
+  strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
+
+  printf("\n========================================\n");
+  printf("%s接收到截屏 #%d\n", conn->label, conn->frame_count);
+  printf("  时间: %s\n", time_str);
+  printf("  分辨率: %dx%d\n", header.width, header.height);
+  printf("  格式: %s\n", format_name(header.format));
+  printf("  大小: %u bytes\n", header.frame_size);
+  if (header.version >= 2)
+  {
+    printf("  序号: %llu%s, 服务器延迟: %.1f ms\n", header.seq,
+           (header.flags & PROTOCOL_FLAG_SNAPSHOT) ? " (截屏)" : "",
+           (long long)(header.send_us - header.capture_us) / 1000.0);
+  }
+  printf("========================================\n");
+
+  // 增量帧要按顺序全部解码才能维持参考帧（包括保存队列满而不保存的帧），所以在接收线程解码，
+  // 之后按YUYV交给保存线程
+  int keep = 1;
+  if (header.format == FRAME_FORMAT_YUYV_DELTA)
+  {
+    int ret = delta_decode(&conn->delta, data, header.frame_size, header.width, header.height);
+    if (ret != 0)
+    {
+      fprintf(stderr, ret > 0 ? "缺少参考帧，等待关键帧\n" : "增量帧数据错误，等待关键帧\n");
+      keep = 0;
+    }
+    else if (slot)
+    {
+      unsigned int size = header.width * header.height * 2;
+      if (frame_slot_reserve(slot, size) < 0)
+      {
+        keep = 0;
+      }
+      else
+      {
+        memcpy(slot->data, conn->delta.frame, size);
+        header.format = FRAME_FORMAT_YUYV;
+        header.frame_size = size;
+      }
+    }
+  }
+  else if (header.format != FRAME_FORMAT_MJPEG && header.format != FRAME_FORMAT_JPEG &&
+           header.format != FRAME_FORMAT_YUYV && header.format != FRAME_FORMAT_I420)
+  {
+    fprintf(stderr, "未知图像格式 %u，不保存\n", header.format);
+    keep = 0;
+  }
+
+  // 交给保存线程
+  if (!slot)
+  {
+    printf("保存队列已满 (%d/%d)，丢弃帧 #%d\n", opt->slots, opt->slots, conn->frame_count);
+  }
+  else if (!keep)
+  {
+    frame_pipeline_release(&client->pipeline, slot);
+  }
+  else
+  {
+    slot->header = header;
+    slot->frame_num = conn->frame_count;
+    slot->source = conn - client->conns;
+    slot->recv_us = protocol_monotonic_us();
+    printf("保存队列: %d/%d\n", frame_pipeline_submit(&client->pipeline, slot), opt->slots);
+  }
 }
 
 /**
- * @brief 接收完整数据
+ * @brief 解析rx中完整的控制消息和帧包头，包头之后已收到的图像数据移到帧缓冲区
+ * @return 成功返回0，协议错误返回-1
  */
-int recv_full(int sock, void *buffer, size_t size)
+static int conn_parse(client_t *client, server_conn_t *conn)
 {
-  size_t received = 0;
-  while (received < size)
+  unsigned int pos = 0;
+  int ret = 0;
+
+  while (!conn->in_payload)
   {
-    int n = recv(sock, (char *)buffer + received, size - received, 0);
-    if (n <= 0)
+    const unsigned char *p = conn->rx + pos;
+    unsigned int avail = conn->rx_len - pos;
+    unsigned int header_len;
+    if (avail < 4)
+    {
+      break;
+    }
+
+    unsigned int magic = protocol_get_le32(p);
+    if (magic == PROTOCOL_CTRL_MAGIC)
     {
-      if (n < 0)
+      unsigned int type, length;
+      if (avail < PROTOCOL_CTRL_HEADER_SIZE)
       {
-        perror("recv failed");
+        break;
       }
-      else
+      if (protocol_decode_ctrl(p, &type, &length) < 0)
       {
-        printf("连接已关闭\n");
+        ret = -1;
+        break;
       }
+      if (avail < PROTOCOL_CTRL_HEADER_SIZE + length)
+      {
+        break;
+      }
+      handle_ctrl(conn, type, p + PROTOCOL_CTRL_HEADER_SIZE, length);
+      pos += PROTOCOL_CTRL_HEADER_SIZE + length;
+      continue;
+    }
+
+    if (magic != PROTOCOL_MAGIC)
+    {
+      fprintf(stderr, "%s错误: 无效的数据包魔数 0x%08X (期望 0x%08X)\n", conn->label, magic, PROTOCOL_MAGIC);
+      ret = -1;
+      break;
+    }
+
+    if (conn->version < 2)
+    {
+      header_len = PROTOCOL_V1_HEADER_SIZE;
+      if (avail < header_len)
+      {
+        break;
+      }
+      ret = protocol_decode_v1(p, &conn->frame);
+    }
+    else
+    {
+      // v2：包头长度在版本之后，比已知长度多出的字段忽略
+      if (avail < 8)
+      {
+        break;
+      }
+      header_len = protocol_get_le16(p + 6);
+      if (header_len < PROTOCOL_V2_HEADER_SIZE)
+      {
+        fprintf(stderr, "%s错误: 包头长度 %u 无效\n", conn->label, header_len);
+        ret = -1;
+        break;
+      }
+      if (avail < header_len)
+      {
+        break;
+      }
+      ret = protocol_decode_v2(p, header_len, &conn->frame);
+    }
+    if (ret < 0 || begin_frame(client, conn) < 0)
+    {
+      ret = -1;
+      break;
+    }
+    pos += header_len;
+
+    // 和包头一起收到的图像数据
+    unsigned int n = conn->rx_len - pos;
+    if (n > conn->frame.frame_size)
+    {
+      n = conn->frame.frame_size;
+    }
+    if (n > 0)
+    {
+      memcpy(conn->dest, conn->rx + pos, n);
+    }
+    conn->received = n;
+    pos += n;
+    if (conn->received == conn->frame.frame_size)
+    {
+      finish_frame(client, conn, conn->dest);
+    }
+  }
+
+  memmove(conn->rx, conn->rx + pos, conn->rx_len - pos);
+  conn->rx_len -= pos;
+  return ret;
+}
+
+/**
+ * @brief 读取连接上的数据：图像数据直接收进帧缓冲区，其余的先收进rx再解析
+ * @return 成功返回0，连接关闭或协议错误返回-1
+ */
+static int conn_read(client_t *client, server_conn_t *conn)
+{
+  for (int i = 0; i < CONN_READS_PER_EVENT; i++)
+  {
+    ssize_t n;
+    if (conn->in_payload)
+    {
+      n = recv(conn->fd, conn->dest + conn->received, conn->frame.frame_size - conn->received, 0);
+    }
+    else
+    {
+      n = recv(conn->fd, conn->rx + conn->rx_len, RX_BUFFER_SIZE - conn->rx_len, 0);
+    }
+
+    if (n < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        return 0;
+      }
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      perror("recv failed");
       return -1;
     }
-    received += n;
+    if (n == 0)
+    {
+      printf("%s连接已关闭\n", conn->label);
+      return -1;
+    }
+
+    if (conn->in_payload)
+    {
+      conn->received += n;
+      if (conn->received == conn->frame.frame_size)
+      {
+        finish_frame(client, conn, conn->dest);
+      }
+    }
+    else
+    {
+      conn->rx_len += n;
+      if (conn_parse(client, conn) < 0)
+      {
+        return -1;
+      }
+    }
   }
   return 0;
 }
 
 /**
- * @brief YUYV转RGB24并保存为PPM文件
+ * @brief 组播：处理已收到的完整帧
+ * @return 出错返回-1
  */
-void save_frame_as_ppm(const unsigned char *yuyv, int width, int height, int frame_num)
+static int rtp_read(client_t *client, server_conn_t *conn)
 {
-  char filename[64];
-  snprintf(filename, sizeof(filename), "frame_%04d.ppm", frame_num);
+  const unsigned char *data;
 
-  FILE *fp = fopen(filename, "wb");
-  if (!fp)
+  while (g_running)
   {
-    perror("打开文件失败");
-    return;
+    int ret = recv_rtp_frame(&conn->rtp, &conn->frame, &data);
+    if (ret <= 0)
+    {
+      return ret;
+    }
+    if (begin_frame(client, conn) == 0)
+    {
+      finish_frame(client, conn, data);
+    }
   }
+  return 0;
+}
 
-  // 写入PPM文件头
-  fprintf(fp, "P6\n%d %d\n255\n", width, height);
+/**
+ * @brief 按间隔拉取截屏，计算下次需要醒来的时间
+ * @return 距下次定时任务的毫秒数
+ */
+static int run_timers(client_t *client)
+{
+  const client_options_t *opt = client->opt;
+  unsigned long long now = protocol_monotonic_us();
+  unsigned long long next = now + 1000000;
 
-  // 转换YUYV到RGB24并写入
-  for (int i = 0; i < width * height / 2; i++)
+  for (int i = 0; i < client->conn_count; i++)
   {
-    int y0 = yuyv[i * 4];
-    int u = yuyv[i * 4 + 1];
-    int y1 = yuyv[i * 4 + 2];
-    int v = yuyv[i * 4 + 3];
+    server_conn_t *conn = &client->conns[i];
+
+    if (conn->state == CONN_WAITING && now >= conn->retry_us)
+    {
+      conn_connect(client, conn);
+    }
+    if (conn->state == CONN_CONNECTED && opt->snapshot_interval > 0 && now >= conn->next_snapshot_us)
+    {
+      if (request_snapshot(conn->fd) < 0)
+      {
+        perror("请求截屏失败");
+      }
+      conn->next_snapshot_us = now + opt->snapshot_interval * 1000000ull;
+    }
+
+    if (conn->state == CONN_WAITING && conn->retry_us < next)
+    {
+      next = conn->retry_us;
+    }
+    if (conn->state == CONN_CONNECTED && opt->snapshot_interval > 0 && conn->next_snapshot_us < next)
+    {
+      next = conn->next_snapshot_us;
+    }
+  }
+
+  return next > now ? (int)((next - now + 999) / 1000) : 0;
+}
 
-    // 转换第一个像素
-    int c = y0 - 16;
-    int d = u - 128;
-    int e = v - 128;
+/**
+ * @brief 初始化一个连接：多个服务器时每个服务器的文件保存到各自的目录<IP>_<端口>
+ * @return 成功返回0，失败返回-1
+ */
+static int conn_init(client_t *client, server_conn_t *conn, const char *host, int port)
+{
+  const client_options_t *opt = client->opt;
 
-    unsigned char r = ((298 * c + 409 * e + 128) >> 8);
-    unsigned char g = ((298 * c - 100 * d - 208 * e + 128) >> 8);
-    unsigned char b = ((298 * c + 516 * d + 128) >> 8);
+  memset(conn, 0, sizeof(*conn));
+  snprintf(conn->host, sizeof(conn->host), "%s", host);
+  conn->port = port;
+  conn->fd = -1;
+  conn->state = CONN_WAITING;
+  conn->backoff_ms = RECONNECT_MIN_MS;
 
-    fputc(r > 255 ? 255 : (r < 0 ? 0 : r), fp);
-    fputc(g > 255 ? 255 : (g < 0 ? 0 : g), fp);
-    fputc(b > 255 ? 255 : (b < 0 ? 0 : b), fp);
+  if (opt->server_count > 1)
+  {
+    snprintf(conn->label, sizeof(conn->label), "[%s:%d] ", host, port);
+    snprintf(conn->dir, sizeof(conn->dir), "%s_%d", host, port);
+    if (!opt->bench && mkdir(conn->dir, 0755) < 0 && errno != EEXIST)
+    {
+      perror("创建输出目录失败");
+      return -1;
+    }
+  }
+  if (opt->record)
+  {
+    snprintf(conn->record_prefix, sizeof(conn->record_prefix), "%s%s%s", conn->dir, conn->dir[0] ? "/" : "",
+             opt->record);
+  }
+  frame_recorder_init(&conn->recorder, conn->record_prefix);
+  frame_bench_init(&conn->bench);
 
-    // 转换第二个像素
-    c = y1 - 16;
-    r = ((298 * c + 409 * e + 128) >> 8);
-    g = ((298 * c - 100 * d - 208 * e + 128) >> 8);
-    b = ((298 * c + 516 * d + 128) >> 8);
+  conn->rx = malloc(RX_BUFFER_SIZE);
+  if (!conn->rx)
+  {
+    perror("malloc失败");
+    return -1;
+  }
+  return 0;
+}
 
-    fputc(r > 255 ? 255 : (r < 0 ? 0 : r), fp);
-    fputc(g > 255 ? 255 : (g < 0 ? 0 : g), fp);
-    fputc(b > 255 ? 255 : (b < 0 ? 0 : b), fp);
+/**
+ * @brief 打印一个连接的统计信息
+ */
+static void print_conn_stats(const client_options_t *opt, const server_conn_t *conn)
+{
+  if (conn->label[0])
+  {
+    printf("%s\n", conn->label);
+  }
+  printf("  接收截屏数: %d\n", conn->frame_count);
+  printf("  协议版本: v%u\n", conn->version);
+  if (conn->stats.frames > 0)
+  {
+    printf("  丢帧数: %llu\n", conn->stats.lost);
+    printf("  服务器延迟: 平均 %.1f ms, 最大 %.1f ms\n",
+           conn->stats.server_us_sum / 1000.0 / conn->stats.frames, conn->stats.server_us_max / 1000.0);
+    if (conn->stats.have_clock)
+    {
+      printf("  端到端延迟(需两端时钟同步): 平均 %.1f ms\n", conn->stats.e2e_us_sum / 1000.0 / conn->stats.frames);
+    }
   }
+  if (opt->multicast)
+  {
+    printf("  组播数据报: 收到 %llu, 丢失 %llu\n", conn->rtp.packets, conn->rtp.lost_packets);
+    printf("  组播帧: 完整 %llu, 分片不全丢弃 %llu\n", conn->rtp.frames, conn->rtp.dropped);
+    if (conn->rtp.foreign)
+    {
+      printf("  其它发送端的数据报: %llu（已忽略）\n", conn->rtp.foreign);
+    }
+  }
+  else if (conn->connects > 1)
+  {
+    printf("  重连次数: %llu\n", conn->connects - 1);
+  }
+  if (opt->record)
+  {
+    printf("  录像: %d 个文件, %llu 帧, %.1f MB\n", conn->recorder.files, conn->recorder.total_frames,
+           conn->recorder.total_bytes / (1024.0 * 1024.0));
+  }
+  if (opt->bench)
+  {
+    frame_bench_report(&conn->bench);
+  }
+}
 
-  fclose(fp);
-  printf("保存帧 %d 到 %s\n", frame_num, filename);
+/**
+ * @brief 关闭所有连接，释放接收缓冲区（帧缓冲区已还回缓冲池）
+ */
+static void client_free(client_t *client)
+{
+  for (int i = 0; i < client->conn_count; i++)
+  {
+    server_conn_t *conn = &client->conns[i];
+    if (conn->fd >= 0)
+    {
+      close(conn->fd);
+    }
+    if (client->opt->multicast && conn->state == CONN_CONNECTED)
+    {
+      rtp_receiver_close(&conn->rtp);
+    }
+    delta_decoder_free(&conn->delta);
+    frame_bench_free(&conn->bench);
+    free(conn->discard);
+    free(conn->rx);
+  }
+  close(client->epfd);
 }
 
 int main(int argc, char *argv[])
 {
-  if (argc != 3)
+  client_options_t opt;
+  static client_t client;
+
+  if (parse_options(argc, argv, &opt) < 0)
   {
-    fprintf(stderr, "用法: %s <服务器IP> <端口>\n", argv[0]);
-    fprintf(stderr, "示例: %s 192.168.1.100 8888\n", argv[0]);
+    fprintf(stderr, "用法: %s <服务器IP> <端口> [<服务器IP>:<端口> ...] [-s 1|2|4] [-c x,y,w,h] [-f yuyv|i420|jpeg] "
+                    "[-L|-n] [-P] [-F 帧率] [-S 秒] [-b] [-w 线程数] [-q 帧数] [-r 前缀] [--bench]\n",
+            argv[0]);
+    fprintf(stderr, "      %s <组播地址> <端口> -u [-b] [-w 线程数] [-q 帧数] [-r 前缀] [--bench]\n", argv[0]);
+    fprintf(stderr, "  可以同时接收最多%d个服务器（IP:端口），每个服务器的文件保存到目录<IP>_<端口>，断线自动重连\n",
+            MAX_SERVERS);
+    fprintf(stderr, "  -s  直播帧缩小倍数\n");
+    fprintf(stderr, "  -c  只接收该矩形区域（原图像素坐标）\n");
+    fprintf(stderr, "  -f  直播帧格式（i420比yuyv小25%%）\n");
+    fprintf(stderr, "  -L  订阅直播帧（默认由服务器是否开启直播模式决定）\n");
+    fprintf(stderr, "  -n  不接收直播帧\n");
+    fprintf(stderr, "  -P  不接收板端主动推送的截屏和运动通知\n");
+    fprintf(stderr, "  -F  直播最大帧率\n");
+    fprintf(stderr, "  -S  每隔若干秒向服务器请求一张截屏\n");
+    fprintf(stderr, "  -u  加入组播组接收直播帧（服务器以 -u 启动），只能再加 -b、-w、-q、-r、--bench\n");
+    fprintf(stderr, "  -b  非JPEG帧保存为BMP（默认PPM）\n");
+    fprintf(stderr, "  -w  转换和写盘的线程数（默认%d）\n", SAVE_WORKERS);
+    fprintf(stderr, "  -q  等待写盘的最大帧数，写盘跟不上时丢弃新帧（默认%d）\n", FRAME_PIPELINE_SLOTS);
+    fprintf(stderr, "  -r  录像：JPEG帧写入<前缀>_NNN.avi，YUYV/I420帧写入<前缀>_NNN.y4m，不再每帧一个文件\n");
+    fprintf(stderr, "  --bench  基准测试：不保存图像，退出时输出吞吐量、到达间隔抖动、采集->收到延迟的分位数和CSV直方图\n");
+    fprintf(stderr, "示例: %s 192.168.1.100 8888 -s 2 -f i420\n", argv[0]);
+    fprintf(stderr, "      %s 192.168.1.100 8888 -n -S 5\n", argv[0]);
+    fprintf(stderr, "      %s 192.168.1.100:8888 192.168.1.101:8888 -L -r rec\n", argv[0]);
+    fprintf(stderr, "      %s 192.168.1.100 8888 -L -f jpeg --bench\n", argv[0]);
     return 1;
   }
 
-  const char *server_ip = argv[1];
-  int server_port = atoi(argv[2]);
-
   // 注册信号处理
   signal(SIGINT, signal_handler);
   signal(SIGTERM, signal_handler);
@@ -134,120 +1462,169 @@ int main(int argc, char *argv[])
   printf("   智能家庭视频监控系统 - 客户端\n");
   printf("========================================\n\n");
 
-  // 1. 创建套接字
-  printf("正在连接服务器 %s:%d...\n", server_ip, server_port);
-  int sock_fd = socket(AF_INET, SOCK_STREAM, 0);
-  if (sock_fd < 0)
+  client.opt = &opt;
+  client.epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (client.epfd < 0)
   {
-    perror("socket创建失败");
+    perror("epoll_create1 failed");
     return 1;
   }
 
-  // 2. 连接服务器
-  struct sockaddr_in server_addr;
-  memset(&server_addr, 0, sizeof(server_addr));
-  server_addr.sin_family = AF_INET;
-  server_addr.sin_port = htons(server_port);
+  // 1. 初始化连接（组播模式下加入组播组，服务器在主循环中连接）
+  int ret = 0;
+  for (int i = 0; i < opt.server_count && ret == 0; i++)
+  {
+    ret = conn_init(&client, &client.conns[i], opt.hosts[i], opt.ports[i]);
+    client.conn_count++;
+  }
+  if (ret == 0 && opt.multicast)
+  {
+    server_conn_t *conn = &client.conns[0];
+    struct epoll_event ev;
+
+    printf("正在加入组播组 %s:%d...\n", conn->host, conn->port);
+    if (rtp_receiver_open(&conn->rtp, conn->host, conn->port) < 0)
+    {
+      ret = -1;
+    }
+    else
+    {
+      printf("已加入组播组!\n\n");
+      conn->state = CONN_CONNECTED;
+      conn->version = 2;
+      ev.events = EPOLLIN;
+      ev.data.ptr = conn;
+      epoll_ctl(client.epfd, EPOLL_CTL_ADD, conn->rtp.sock, &ev);
+    }
+  }
+
+  // 2. 启动保存线程：本线程只负责把帧收进缓冲池，转换和写盘由保存线程完成，
+  // 磁盘慢时socket照样按线路速率读空
+  save_worker_t workers[SAVE_WORKERS_MAX];
+  int worker_count = 0;
 
-  if (inet_pton(AF_INET, server_ip, &server_addr.sin_addr) <= 0)
+  if (ret == 0 && frame_pipeline_init(&client.pipeline, opt.slots, SLOT_INITIAL_SIZE) == 0)
   {
-    fprintf(stderr, "无效的IP地址\n");
-    close(sock_fd);
-    return 1;
+    // 信号只由接收线程处理，Ctrl+C才能打断epoll_wait
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+    for (; worker_count < opt.workers; worker_count++)
+    {
+      workers[worker_count].client = &client;
+      if (pthread_create(&workers[worker_count].thread, NULL, save_worker_thread, &workers[worker_count]) != 0)
+      {
+        fprintf(stderr, "创建保存线程失败\n");
+        break;
+      }
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (worker_count == 0)
+    {
+      frame_pipeline_destroy(&client.pipeline);
+    }
   }
 
-  if (connect(sock_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+  if (worker_count == 0)
   {
-    perror("连接服务器失败");
-    close(sock_fd);
+    client_free(&client);
     return 1;
   }
 
-  printf("成功连接到服务器!\n\n");
   printf("========================================\n");
   printf("正在等待接收截屏图像...\n");
   printf("按 Ctrl+C 退出\n");
   printf("提示: 在服务器端点击【截屏】按钮发送图片\n");
   printf("========================================\n\n");
 
-  // 3. 接收截屏图像
-  int frame_count = 0;
+  // 3. 接收截屏图像：所有服务器在一个epoll循环中处理
   time_t start_time = time(NULL);
 
-  unsigned char *frame_buffer = malloc(FRAME_WIDTH * FRAME_HEIGHT * 2);
-  if (!frame_buffer)
-  {
-    perror("malloc失败");
-    close(sock_fd);
-    return 1;
-  }
-
   while (g_running)
   {
-    frame_header_t header;
+    struct epoll_event events[MAX_SERVERS];
+    int timeout = run_timers(&client);
 
-    // 接收数据包头
-    printf("等待接收截屏...\n");
-    if (recv_full(sock_fd, &header, sizeof(header)) < 0)
+    int n = epoll_wait(client.epfd, events, MAX_SERVERS, timeout);
+    if (n < 0)
     {
-      if (g_running)
+      if (errno == EINTR)
       {
-        fprintf(stderr, "接收数据包头失败\n");
+        continue;
       }
+      perror("epoll_wait failed");
       break;
     }
 
-    // 验证魔数
-    if (header.magic != 0x12345678)
+    for (int i = 0; i < n; i++)
     {
-      fprintf(stderr, "错误: 无效的数据包魔数 0x%08X (期望 0x12345678)\n", header.magic);
-      break;
-    }
+      server_conn_t *conn = (server_conn_t *)events[i].data.ptr;
 
-    // 接收图像数据
-    if (header.frame_size > FRAME_WIDTH * FRAME_HEIGHT * 2)
-    {
-      fprintf(stderr, "错误: 帧大小过大 (%u bytes, 最大 %d bytes)\n",
-              header.frame_size, FRAME_WIDTH * FRAME_HEIGHT * 2);
-      break;
+      if (opt.multicast)
+      {
+        if (rtp_read(&client, conn) < 0)
+        {
+          g_running = 0;
+        }
+      }
+      else if (conn->state == CONN_CONNECTING)
+      {
+        conn_connect_done(&client, conn);
+      }
+      else if (conn->state == CONN_CONNECTED && conn_read(&client, conn) < 0)
+      {
+        conn_retry_later(&client, conn);
+      }
     }
+  }
 
-    printf("接收图像数据中... (大小: %u bytes)\n", header.frame_size);
-    if (recv_full(sock_fd, frame_buffer, header.frame_size) < 0)
+  // 保存线程写完已排队的帧后退出
+  for (int i = 0; i < client.conn_count; i++)
+  {
+    if (client.conns[i].slot)
     {
-      fprintf(stderr, "接收图像数据失败\n");
-      break;
+      frame_pipeline_release(&client.pipeline, client.conns[i].slot);
     }
-
-    frame_count++;
-
-    // 显示接收信息
-    time_t current_time = time(NULL);
-    struct tm *tm_info = localtime(&current_time);
-    char time_str[64];
-    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
-
-    printf("\n========================================\n");
-    printf("接收到截屏 #%d\n", frame_count);
-    printf("  时间: %s\n", time_str);
-    printf("  分辨率: %dx%d\n", header.width, header.height);
-    printf("  格式: %s\n", header.format == 0 ? "YUYV" : "Unknown");
-    printf("  大小: %u bytes\n", header.frame_size);
-    printf("========================================\n");
-
-    // 保存图像
-    save_frame_as_ppm(frame_buffer, header.width, header.height, frame_count);
+  }
+  frame_pipeline_close(&client.pipeline);
+  for (int i = 0; i < worker_count; i++)
+  {
+    pthread_join(workers[i].thread, NULL);
+  }
+  for (int i = 0; i < client.conn_count; i++)
+  {
+    frame_recorder_close(&client.conns[i].recorder);
   }
 
   printf("\n\n========================================\n");
   printf("客户端统计信息:\n");
-  printf("  接收截屏数: %d\n", frame_count);
+  for (int i = 0; i < client.conn_count; i++)
+  {
+    print_conn_stats(&opt, &client.conns[i]);
+  }
+  printf("  保存队列: 入队 %llu, 最大深度 %d/%d, 写盘跟不上丢弃 %llu 帧 (%d 个保存线程)\n",
+         client.pipeline.queued, client.pipeline.max_depth, opt.slots, client.pipeline.dropped, worker_count);
   printf("  运行时间: %.0f 秒\n", difftime(time(NULL), start_time));
   printf("========================================\n");
 
+  if (opt.bench)
+  {
+    printf("\n# 直方图（CSV，桶宽%dms，最后一个桶包含更大的值）\n", BENCH_BUCKET_US / 1000);
+    printf("server,bucket_ms,latency_frames,interval_frames\n");
+    for (int i = 0; i < client.conn_count; i++)
+    {
+      char name[80];
+      snprintf(name, sizeof(name), "%s:%d", client.conns[i].host, client.conns[i].port);
+      frame_bench_print_csv(&client.conns[i].bench, name);
+    }
+  }
+
   // 清理资源
-  free(frame_buffer);
-  close(sock_fd);
+  client_free(&client);
+  frame_pipeline_destroy(&client.pipeline);
   printf("客户端已关闭\n");
 
   return 0;
@@ -0,0 +1,311 @@
+#include "yuv_convert.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define YUV_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define YUV_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+typedef void (*yuyv_to_xrgb_fn)(const unsigned char *yuyv, unsigned int *xrgb, int pixels);
+
+static yuyv_to_xrgb_fn g_kernel = yuyv_to_xrgb8888_c;
+static const char *g_kernel_name = "c";
+static pthread_once_t g_kernel_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief 标量转换从第start个像素（偶数）开始的部分，SIMD内核用它处理行尾不足一组的像素
+ *        只读pixels*2字节：像素数为奇数时最后一个像素没有自己的V，用前一个宏像素的V
+ */
+static void yuyv_to_xrgb8888_tail(const unsigned char *yuyv, unsigned int *xrgb, int start, int pixels)
+{
+  int i;
+  for (i = start; i + 2 <= pixels; i += 2)
+  {
+    int u = yuyv[i * 2 + 1];
+    int v = yuyv[i * 2 + 3];
+    xrgb[i] = yuv_to_xrgb(yuyv[i * 2], u, v);
+    xrgb[i + 1] = yuv_to_xrgb(yuyv[i * 2 + 2], u, v);
+  }
+
+  if (i < pixels)
+  {
+    int v = i > 0 ? yuyv[i * 2 - 1] : 128; // 只有一个像素时按无色差处理
+    xrgb[i] = yuv_to_xrgb(yuyv[i * 2], yuyv[i * 2 + 1], v);
+  }
+}
+
+/**
+ * @brief 标量实现
+ */
+void yuyv_to_xrgb8888_c(const unsigned char *yuyv, unsigned int *xrgb, int pixels)
+{
+  yuyv_to_xrgb8888_tail(yuyv, xrgb, 0, pixels);
+}
+
+#ifdef YUV_HAVE_NEON
+/**
+ * @brief 计算一个颜色通道: clip((298*c + chroma + 128) >> 8)
+ */
+static inline uint8x8_t neon_channel(int16x8_t c, int32x4_t chroma_lo, int32x4_t chroma_hi)
+{
+  const int32x4_t round = vdupq_n_s32(128);
+  int32x4_t lo = vmlal_n_s16(vaddq_s32(chroma_lo, round), vget_low_s16(c), 298);
+  int32x4_t hi = vmlal_n_s16(vaddq_s32(chroma_hi, round), vget_high_s16(c), 298);
+
+  // 算术右移+饱和到int16，再饱和到[0,255]，与clip()结果一致
+  return vqmovun_s16(vcombine_s16(vqshrn_n_s32(lo, 8), vqshrn_n_s32(hi, 8)));
+}
+
+/**
+ * @brief NEON实现：每次16个像素，vld4解交织Y0/U/Y1/V，vst4直接写XRGB
+ */
+static void yuyv_to_xrgb8888_neon(const unsigned char *yuyv, unsigned int *xrgb, int pixels)
+{
+  const int16x8_t k16 = vdupq_n_s16(16);
+  const int16x8_t k128 = vdupq_n_s16(128);
+  int i;
+
+  for (i = 0; i + 16 <= pixels; i += 16)
+  {
+    uint8x8x4_t in = vld4_u8(yuyv + i * 2);
+
+    int16x8_t c0 = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(in.val[0])), k16);
+    int16x8_t d = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(in.val[1])), k128);
+    int16x8_t c1 = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(in.val[2])), k16);
+    int16x8_t e = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(in.val[3])), k128);
+
+    // 色度项（每个宏像素一份，两个像素共用）
+    int32x4_t r_lo = vmull_n_s16(vget_low_s16(e), 409);
+    int32x4_t r_hi = vmull_n_s16(vget_high_s16(e), 409);
+    int32x4_t g_lo = vmlal_n_s16(vmull_n_s16(vget_low_s16(d), -100), vget_low_s16(e), -208);
+    int32x4_t g_hi = vmlal_n_s16(vmull_n_s16(vget_high_s16(d), -100), vget_high_s16(e), -208);
+    int32x4_t b_lo = vmull_n_s16(vget_low_s16(d), 516);
+    int32x4_t b_hi = vmull_n_s16(vget_high_s16(d), 516);
+
+    // 偶数像素用Y0，奇数像素用Y1，再交织回原顺序
+    uint8x8x2_t r = vzip_u8(neon_channel(c0, r_lo, r_hi), neon_channel(c1, r_lo, r_hi));
+    uint8x8x2_t g = vzip_u8(neon_channel(c0, g_lo, g_hi), neon_channel(c1, g_lo, g_hi));
+    uint8x8x2_t b = vzip_u8(neon_channel(c0, b_lo, b_hi), neon_channel(c1, b_lo, b_hi));
+
+    // 小端序 0xFFRRGGBB 在内存中为 B G R A
+    uint8x16x4_t out;
+    out.val[0] = vcombine_u8(b.val[0], b.val[1]);
+    out.val[1] = vcombine_u8(g.val[0], g.val[1]);
+    out.val[2] = vcombine_u8(r.val[0], r.val[1]);
+    out.val[3] = vdupq_n_u8(0xFF);
+    vst4q_u8((uint8_t *)(xrgb + i), out);
+  }
+
+  yuyv_to_xrgb8888_tail(yuyv, xrgb, i, pixels);
+}
+#endif // YUV_HAVE_NEON
+
+#ifdef YUV_HAVE_X86
+/**
+ * @brief SSE2实现：每次8个像素
+ *        每个32位通道是一个像素的(Y,U)或(Y,V)，用pmaddwd做16x16->32位乘加，结果与标量一致
+ */
+__attribute__((target("sse2"))) static void yuyv_to_xrgb8888_sse2(const unsigned char *yuyv, unsigned int *xrgb, int pixels)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i bias = _mm_set_epi16(128, 16, 128, 16, 128, 16, 128, 16);
+  const __m128i ky = _mm_set_epi16(0, 298, 0, 298, 0, 298, 0, 298);
+  const __m128i kr = _mm_set_epi16(409, 0, 409, 0, 409, 0, 409, 0);
+  const __m128i kg = _mm_set_epi16(-208, -100, -208, -100, -208, -100, -208, -100);
+  const __m128i kb = _mm_set_epi16(0, 516, 0, 516, 0, 516, 0, 516);
+  const __m128i round = _mm_set1_epi32(128);
+  const __m128i alpha = _mm_set1_epi16(255);
+  int i;
+
+  for (i = 0; i + 8 <= pixels; i += 8)
+  {
+    __m128i in = _mm_loadu_si128((const __m128i *)(yuyv + i * 2));
+
+    // s: c0 d0 c1 e0 c2 d1 c3 e1（已减去偏移）
+    __m128i s_lo = _mm_sub_epi16(_mm_unpacklo_epi8(in, zero), bias);
+    __m128i s_hi = _mm_sub_epi16(_mm_unpackhi_epi8(in, zero), bias);
+
+    // t: 每个像素通道都放入所在宏像素的(d, e)
+    __m128i t_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_lo, _MM_SHUFFLE(3, 1, 3, 1)), _MM_SHUFFLE(3, 1, 3, 1));
+    __m128i t_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_hi, _MM_SHUFFLE(3, 1, 3, 1)), _MM_SHUFFLE(3, 1, 3, 1));
+
+    __m128i y_lo = _mm_add_epi32(_mm_madd_epi16(s_lo, ky), round);
+    __m128i y_hi = _mm_add_epi32(_mm_madd_epi16(s_hi, ky), round);
+
+    __m128i r = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(y_lo, _mm_madd_epi16(t_lo, kr)), 8),
+                                _mm_srai_epi32(_mm_add_epi32(y_hi, _mm_madd_epi16(t_hi, kr)), 8));
+    __m128i g = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(y_lo, _mm_madd_epi16(t_lo, kg)), 8),
+                                _mm_srai_epi32(_mm_add_epi32(y_hi, _mm_madd_epi16(t_hi, kg)), 8));
+    __m128i b = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(y_lo, _mm_madd_epi16(t_lo, kb)), 8),
+                                _mm_srai_epi32(_mm_add_epi32(y_hi, _mm_madd_epi16(t_hi, kb)), 8));
+
+    // 饱和到[0,255]：低8字节B/R，高8字节G/A
+    __m128i bg = _mm_packus_epi16(b, g);
+    __m128i ra = _mm_packus_epi16(r, alpha);
+    bg = _mm_unpacklo_epi8(bg, _mm_srli_si128(bg, 8));
+    ra = _mm_unpacklo_epi8(ra, _mm_srli_si128(ra, 8));
+
+    _mm_storeu_si128((__m128i *)(xrgb + i), _mm_unpacklo_epi16(bg, ra));
+    _mm_storeu_si128((__m128i *)(xrgb + i + 4), _mm_unpackhi_epi16(bg, ra));
+  }
+
+  yuyv_to_xrgb8888_tail(yuyv, xrgb, i, pixels);
+}
+
+/**
+ * @brief AVX2实现：每次8个像素，每个32位通道直接得到一个像素
+ */
+__attribute__((target("avx2"))) static void yuyv_to_xrgb8888_avx2(const unsigned char *yuyv, unsigned int *xrgb, int pixels)
+{
+  const __m256i bias = _mm256_set1_epi32(0x00800010);    // (16, 128)
+  const __m256i ky = _mm256_set1_epi32(298);             // (298, 0)
+  const __m256i kr = _mm256_set1_epi32(409 << 16);       // (0, 409)
+  const __m256i kg = _mm256_set1_epi32((int)0xFF30FF9C); // (-100, -208)
+  const __m256i kb = _mm256_set1_epi32(516);             // (516, 0)
+  const __m256i round = _mm256_set1_epi32(128);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i max = _mm256_set1_epi32(255);
+  const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+  int i;
+
+  for (i = 0; i + 8 <= pixels; i += 8)
+  {
+    __m256i s = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(yuyv + i * 2))), bias);
+    __m256i t = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, _MM_SHUFFLE(3, 1, 3, 1)), _MM_SHUFFLE(3, 1, 3, 1));
+    __m256i y = _mm256_add_epi32(_mm256_madd_epi16(s, ky), round);
+
+    __m256i r = _mm256_srai_epi32(_mm256_add_epi32(y, _mm256_madd_epi16(t, kr)), 8);
+    __m256i g = _mm256_srai_epi32(_mm256_add_epi32(y, _mm256_madd_epi16(t, kg)), 8);
+    __m256i b = _mm256_srai_epi32(_mm256_add_epi32(y, _mm256_madd_epi16(t, kb)), 8);
+
+    r = _mm256_min_epi32(_mm256_max_epi32(r, zero), max);
+    g = _mm256_min_epi32(_mm256_max_epi32(g, zero), max);
+    b = _mm256_min_epi32(_mm256_max_epi32(b, zero), max);
+
+    __m256i out = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(r, 16), _mm256_slli_epi32(g, 8)),
+                                  _mm256_or_si256(b, alpha));
+    _mm256_storeu_si256((__m256i *)(xrgb + i), out);
+  }
+
+  yuyv_to_xrgb8888_tail(yuyv, xrgb, i, pixels);
+}
+#endif // YUV_HAVE_X86
+
+#ifdef YUV_HAVE_NEON
+/**
+ * @brief 检测CPU是否支持NEON（AArch64必然支持，ARMv7查询/proc/cpuinfo）
+ */
+static int cpu_has_neon(void)
+{
+#if defined(__aarch64__)
+  return 1;
+#else
+  FILE *fp = fopen("/proc/cpuinfo", "r");
+  if (!fp)
+  {
+    return 0;
+  }
+
+  char line[512];
+  int found = 0;
+  while (!found && fgets(line, sizeof(line), fp))
+  {
+    if (strncmp(line, "Features", 8) == 0 && (strstr(line, " neon") || strstr(line, " asimd")))
+    {
+      found = 1;
+    }
+  }
+
+  fclose(fp);
+  return found;
+#endif
+}
+#endif
+
+/**
+ * @brief 选择内核（只执行一次）
+ */
+static void select_kernel(void)
+{
+  const char *force = getenv("YUV_KERNEL");
+
+#ifdef YUV_HAVE_NEON
+  if (cpu_has_neon() && (!force || strcmp(force, "neon") == 0))
+  {
+    g_kernel = yuyv_to_xrgb8888_neon;
+    g_kernel_name = "neon";
+  }
+#endif
+
+#ifdef YUV_HAVE_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && (!force || strcmp(force, "avx2") == 0))
+  {
+    g_kernel = yuyv_to_xrgb8888_avx2;
+    g_kernel_name = "avx2";
+  }
+  else if (__builtin_cpu_supports("sse2") && (!force || strcmp(force, "sse2") == 0))
+  {
+    g_kernel = yuyv_to_xrgb8888_sse2;
+    g_kernel_name = "sse2";
+  }
+#endif
+
+  (void)force;
+}
+
+/**
+ * @brief YUYV转XRGB8888（运行时分派）
+ */
+void yuyv_to_xrgb8888(const unsigned char *yuyv, unsigned int *xrgb, int pixels)
+{
+  pthread_once(&g_kernel_once, select_kernel);
+  g_kernel(yuyv, xrgb, pixels);
+}
+
+/**
+ * @brief YUYV转24位RGB：每次用SIMD内核转换一段到栈上的XRGB缓冲区，再紧缩成3字节像素
+ */
+void yuyv_to_rgb24(const unsigned char *yuyv, unsigned char *rgb, int pixels, int bgr)
+{
+  unsigned int xrgb[YUV_RGB24_BLOCK + 1];
+  int r = bgr ? 2 : 0; // R、B在输出像素中的位置
+  int b = 2 - r;
+  int count;
+
+  pthread_once(&g_kernel_once, select_kernel);
+  for (int i = 0; i < pixels; i += count)
+  {
+    // 像素数为奇数时最后一个像素要用前一个宏像素的V：只剩YUV_RGB24_BLOCK+1个时一起转换，
+    // 不让最后一段只有一个像素
+    count = pixels - i > YUV_RGB24_BLOCK + 1 ? YUV_RGB24_BLOCK : pixels - i;
+    g_kernel(yuyv + i * 2, xrgb, count);
+
+    unsigned char *out = rgb + i * 3;
+    for (int k = 0; k < count; k++)
+    {
+      unsigned int p = xrgb[k];
+      out[r] = p >> 16;
+      out[1] = p >> 8;
+      out[b] = p;
+      out += 3;
+    }
+  }
+}
+
+/**
+ * @brief 返回当前选用的内核名称
+ */
+const char *yuv_convert_kernel_name(void)
+{
+  pthread_once(&g_kernel_once, select_kernel);
+  return g_kernel_name;
+}
@@ -0,0 +1,66 @@
+#ifndef __YUV_CONVERT_H__
+#define __YUV_CONVERT_H__
+
+/*
+ * YUYV(4:2:2) -> XRGB8888 颜色转换内核
+ * 公式与camera.c中yuyv_to_rgb888的定点公式完全一致（逐位相同）:
+ *   R = clip((298*(Y-16) + 409*(V-128) + 128) >> 8)
+ *   G = clip((298*(Y-16) - 100*(U-128) - 208*(V-128) + 128) >> 8)
+ *   B = clip((298*(Y-16) + 516*(U-128) + 128) >> 8)
+ * 输出像素为 0xFFRRGGBB，与LCD帧缓冲格式相同。
+ * 运行时根据CPU选择 NEON / AVX2 / SSE2 / C 实现，
+ * 可用环境变量 YUV_KERNEL=c|sse2|avx2|neon 强制指定（用于对比验证）。
+ * 客户端保存PPM/BMP时也用同一组内核（yuyv_to_rgb24）。
+ */
+
+#define YUV_RGB24_BLOCK 256 // yuyv_to_rgb24每段的像素数（偶数，保持宏像素对齐）
+
+/**
+ * @brief 单个像素的标量转换（参考实现）
+ */
+static inline unsigned int yuv_to_xrgb(int y, int u, int v)
+{
+  int c = y - 16;
+  int d = u - 128;
+  int e = v - 128;
+
+  int r = (298 * c + 409 * e + 128) >> 8;
+  int g = (298 * c - 100 * d - 208 * e + 128) >> 8;
+  int b = (298 * c + 516 * d + 128) >> 8;
+
+  r = r < 0 ? 0 : (r > 255 ? 255 : r);
+  g = g < 0 ? 0 : (g > 255 ? 255 : g);
+  b = b < 0 ? 0 : (b > 255 ? 255 : b);
+
+  return 0xFF000000u | (r << 16) | (g << 8) | b;
+}
+
+/**
+ * @brief YUYV转XRGB8888（运行时分派到最快的内核）
+ * @param yuyv YUYV数据，必须从宏像素(Y0 U Y1 V)边界开始
+ * @param xrgb 输出缓冲区，至少pixels个32位像素
+ * @param pixels 像素个数，只读取pixels*2字节；为奇数时最后一个像素用前一个宏像素的V
+ *               （需要精确颜色时调用者自己转换最后一个像素，见lcd_blit_yuyv）
+ */
+void yuyv_to_xrgb8888(const unsigned char *yuyv, unsigned int *xrgb, int pixels);
+
+/**
+ * @brief YUYV转XRGB8888的标量实现（用于校验SIMD内核）
+ */
+void yuyv_to_xrgb8888_c(const unsigned char *yuyv, unsigned int *xrgb, int pixels);
+
+/**
+ * @brief YUYV转24位RGB（图像文件用），内部按YUV_RGB24_BLOCK像素一段调用上面的内核
+ * @param yuyv YUYV数据，必须从宏像素边界开始
+ * @param rgb 输出缓冲区，至少pixels*3字节
+ * @param pixels 像素个数
+ * @param bgr 0：按R、G、B顺序输出（PPM），非0：按B、G、R顺序输出（BMP）
+ */
+void yuyv_to_rgb24(const unsigned char *yuyv, unsigned char *rgb, int pixels, int bgr);
+
+/**
+ * @brief 返回当前选用的内核名称
+ */
+const char *yuv_convert_kernel_name(void);
+
+#endif // __YUV_CONVERT_H__